@@ -288,3 +288,23 @@ bool ParaEngine::MeshEntity::GetBoundingBox(Vector3* pMin, Vector3* pMax)
 	*pMax = GetAABBMax();
 	return true;
 }
+
+size_t ParaEngine::MeshEntity::GetMemoryUsage()
+{
+	size_t nBytes = 0;
+	if (m_bIsInitialized)
+	{
+		for (auto& lod : m_MeshLODs)
+		{
+			if (lod.m_pStaticMesh)
+				nBytes += lod.m_pStaticMesh->GetPolyCount() * (sizeof(mesh_vertex_normal) + 3 * sizeof(uint16));
+		}
+	}
+	return nBytes;
+}
+
+bool ParaEngine::MeshEntity::IsEvictable()
+{
+	const std::string& sFileName = GetFileName();
+	return !sFileName.empty() && CParaFile::DoesAssetFileExist(sFileName.c_str());
+}
@@ -151,6 +151,11 @@ namespace ParaEngine
 
 		/** Get AABB bounding box of the asset object. if the asset contains an OOB, it will return true. */
 		virtual bool GetBoundingBox(Vector3* pMin, Vector3* pMax);
+
+		/** estimated as one vertex and three indices per triangle of all loaded LODs. */
+		virtual size_t GetMemoryUsage();
+		/** true if the mesh file exists, so that it can be loaded again after unloading. */
+		virtual bool IsEvictable();
 	public:
 		Vector3 m_vMin;
 		Vector3 m_vMax;
@@ -20,6 +20,7 @@
 #include "ParaEngineInfo.h"
 #include "NPLHelper.h"
 #include "AsyncLoader.h"
+#include "TickScheduler.h"
 #include "TextureEntity.h"
 #include "ParaEngineSettings.h"
 #include "NPLRuntime.h"
@@ -1174,6 +1175,7 @@ void ParaEngine::ParaEngineSettings::LoadNameIndex()
 	m_name_to_index["BufferPicking"] = 7;
 	m_name_to_index["OverlayPicking"] = 8;
 	m_name_to_index["AsyncLoader"] = 9;
+	m_name_to_index["TickScheduler"] = 10;
 }
 
 IAttributeFields* ParaEngine::ParaEngineSettings::GetChildAttributeObject(const std::string& sName)
@@ -1204,6 +1206,8 @@ IAttributeFields* ParaEngine::ParaEngineSettings::GetChildAttributeObject(int nR
 		return CGlobals::GetAssetManager()->LoadBufferPick("overlay");
 	else if (nRowIndex == 9)
 		return &(CAsyncLoader::GetSingleton());
+	else if (nRowIndex == 10)
+		return &(CTickScheduler::GetSingleton());
 	else
 		return NULL;
 }
@@ -63,6 +63,20 @@ IParaPhysicsActor* ParaEngine::CParaPhysicsImp::RaycastClosestShape(const PARAVE
 	return NULL;
 }
 
+int ParaEngine::CParaPhysicsImp::RaycastClosestShapes(const ParaPhysicsRayQuery* pQueries, int nCount, ParaPhysicsQueryHit* pHits)
+{
+	for (int i = 0; i < nCount; ++i)
+		pHits[i].m_pActor = NULL;
+	return 0;
+}
+
+int ParaEngine::CParaPhysicsImp::SweepSphereClosestShapes(const ParaPhysicsSweepQuery* pQueries, int nCount, ParaPhysicsQueryHit* pHits)
+{
+	for (int i = 0; i < nCount; ++i)
+		pHits[i].m_pActor = NULL;
+	return 0;
+}
+
 void ParaEngine::CParaPhysicsImp::SetDebugDrawer(IParaDebugDraw* debugDrawer)
 {
 	m_pDebugDrawer = debugDrawer;
@@ -90,3 +104,7 @@ int ParaEngine::CParaPhysicsImp::GetDebugDrawMode()
 {
 	return m_nDebugMode;
 }
+
+void ParaEngine::CParaPhysicsImp::SetShapeCacheDirectory(const char* sDirectory)
+{
+}
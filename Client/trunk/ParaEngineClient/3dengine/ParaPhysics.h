@@ -27,6 +27,10 @@ namespace ParaEngine
 
 		virtual IParaPhysicsActor* RaycastClosestShape(const PARAVECTOR3& vOrigin, const PARAVECTOR3& vDirection, DWORD dwType, RayCastHitResult& hit, short dwGroupMask, float fSensorRange);
 
+		virtual int RaycastClosestShapes(const ParaPhysicsRayQuery* pQueries, int nCount, ParaPhysicsQueryHit* pHits);
+
+		virtual int SweepSphereClosestShapes(const ParaPhysicsSweepQuery* pQueries, int nCount, ParaPhysicsQueryHit* pHits);
+
 		virtual void SetDebugDrawer(IParaDebugDraw* debugDrawer);
 
 		virtual IParaDebugDraw* GetDebugDrawer();
@@ -38,6 +42,8 @@ namespace ParaEngine
 		virtual void SetDebugDrawMode(int debugMode);
 
 		virtual int GetDebugDrawMode();
+
+		virtual void SetShapeCacheDirectory(const char* sDirectory);
 	protected:
 		IParaDebugDraw* m_pDebugDrawer;
 		int m_nDebugMode;
@@ -271,6 +271,29 @@ bool ParaEngine::ParaXEntity::GetBoundingBox(Vector3* pMin, Vector3* pMax)
 	return false;
 }
 
+size_t ParaEngine::ParaXEntity::GetMemoryUsage()
+{
+	size_t nBytes = 0;
+	if (m_bIsInitialized)
+	{
+		for (auto& lod : m_MeshLODs)
+		{
+			if (lod.m_pParaXMesh)
+			{
+				const ParaXModelObjNum& objNum = lod.m_pParaXMesh->m_objNum;
+				nBytes += objNum.nVertices * sizeof(ModelVertex) + objNum.nIndices * sizeof(uint16);
+			}
+		}
+	}
+	return nBytes;
+}
+
+bool ParaEngine::ParaXEntity::IsEvictable()
+{
+	const std::string& sFileName = GetFileName();
+	return !sFileName.empty() && CParaFile::DoesAssetFileExist(sFileName.c_str());
+}
+
 int ParaEngine::ParaXEntity::GetChildAttributeObjectCount(int nColumnIndex /*= 0*/)
 {
 	return (int)m_MeshLODs.size();
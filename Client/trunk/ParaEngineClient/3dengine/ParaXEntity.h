@@ -132,6 +132,11 @@ namespace ParaEngine
 
 		/** Get AABB bounding box of the asset object. if the asset contains an OOB, it will return true. */
 		virtual bool GetBoundingBox(Vector3* pMin, Vector3* pMax);
+
+		/** vertices and indices of all loaded LODs. */
+		virtual size_t GetMemoryUsage();
+		/** true if the model file exists, so that it can be loaded again after unloading. */
+		virtual bool IsEvictable();
 	private:
 		/// mesh objects in LOD list. each mesh may contain materials and textures, but you can simply 
 		/// ignore them. The default setting is rendering with materials. See CParaXStaticMesh for more details
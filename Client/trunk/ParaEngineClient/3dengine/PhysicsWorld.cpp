@@ -55,6 +55,31 @@ const char* PHYSICS_DLL_FILE_PATH = "PhysicsBT_d.dll";
 const char* PHYSICS_DLL_FILE_PATH = "PhysicsBT.dll";
 #endif
 
+/** serialized BVH trees of static meshes are cached in this directory, see IParaPhysics::SetShapeCacheDirectory() */
+#define PHYSICS_SHAPE_CACHE_DIR		"temp/physics_cache/"
+
+/** scaling factors are quantized to this many steps per unit, when finding the shape of a static mesh. */
+#define PHYSICS_SCALE_QUANTIZATION	1000.f
+
+ParaEngine::CPhysicsWorld::TriangleMeshShapeKey::TriangleMeshShapeKey(void* pEntity, float fScalingX, float fScalingY, float fScalingZ)
+	: m_pEntity(pEntity)
+{
+	m_nScale[0] = (int32)floor(fScalingX * PHYSICS_SCALE_QUANTIZATION + 0.5f);
+	m_nScale[1] = (int32)floor(fScalingY * PHYSICS_SCALE_QUANTIZATION + 0.5f);
+	m_nScale[2] = (int32)floor(fScalingZ * PHYSICS_SCALE_QUANTIZATION + 0.5f);
+}
+
+bool ParaEngine::CPhysicsWorld::TriangleMeshShapeKey::operator<(const TriangleMeshShapeKey& r) const
+{
+	if (m_pEntity != r.m_pEntity)
+		return m_pEntity < r.m_pEntity;
+	if (m_nScale[0] != r.m_nScale[0])
+		return m_nScale[0] < r.m_nScale[0];
+	if (m_nScale[1] != r.m_nScale[1])
+		return m_nScale[1] < r.m_nScale[1];
+	return m_nScale[2] < r.m_nScale[2];
+}
+
 CPhysicsWorld::CPhysicsWorld()
 : m_pPhysicsWorld(NULL), m_bRunDynamicSimulation(false)
 {
@@ -77,6 +102,10 @@ void CPhysicsWorld::InitPhysics()
 	}
 	pPhysics->InitPhysics();
 	pPhysics->SetDebugDrawer(CGlobals::GetScene()->GetDebugDrawer());
+
+	std::string sCacheDir = CParaFile::GetWritablePath() + PHYSICS_SHAPE_CACHE_DIR;
+	if (CParaFile::CreateDirectory(sCacheDir.c_str()))
+		pPhysics->SetShapeCacheDirectory(sCacheDir.c_str());
 }
 
 
@@ -92,11 +121,22 @@ void CPhysicsWorld::ExitPhysics()
 
 	for( itCurCP = m_listMeshShapes.begin(); itCurCP != itEndCP; ++ itCurCP)
 	{
-		delete * itCurCP;
+		delete itCurCP->second;
 	}
 	m_listMeshShapes.clear();
 }
 
+CPhysicsWorld::TriangleMeshShape* CPhysicsWorld::FindMeshShape(void* pEntity, float fScalingX, float fScalingY, float fScalingZ)
+{
+	TriangleMeshShape_Map_Type::iterator it = m_listMeshShapes.find(TriangleMeshShapeKey(pEntity, fScalingX, fScalingY, fScalingZ));
+	return (it != m_listMeshShapes.end()) ? it->second : NULL;
+}
+
+void CPhysicsWorld::AddMeshShape(TriangleMeshShape* pShape)
+{
+	m_listMeshShapes[TriangleMeshShapeKey(pShape->m_pMeshEntity, pShape->m_vScale.x, pShape->m_vScale.y, pShape->m_vScale.z)] = pShape;
+}
+
 void CPhysicsWorld::ResetPhysics()
 {
 	ExitPhysics();
@@ -135,22 +175,8 @@ IParaPhysicsActor* ParaEngine::CPhysicsWorld::CreateStaticMesh( MeshEntity* ppMe
 	float fScalingX,fScalingY,fScalingZ;
 	Math::GetMatrixScaling(globalMat, &fScalingX,&fScalingY,&fScalingZ);
 	
-	// TODO: use a sorted set to store the shape list. it is more efficient
-	TriangleMeshShape_Map_Type::iterator itCurCP, itEndCP = m_listMeshShapes.end();
-
-	for( itCurCP = m_listMeshShapes.begin(); itCurCP != itEndCP; ++ itCurCP)
-	{
-		if((*itCurCP)->m_pMeshEntity == ppMesh)
-		{
-			// keep mesh for every scale level
-			Vector3 vScale = (*itCurCP)->m_vScale;
-			if(Vector3(vScale.x-fScalingX,vScale.y-fScalingY,vScale.z-fScalingZ).squaredLength() < FLT_TOLERANCE)
-			{
-				MeshShape = (*itCurCP);
-				break;
-			}			
-		}
-	}
+	// keep mesh for every scale level
+	MeshShape = FindMeshShape(ppMesh, fScalingX, fScalingY, fScalingZ);
 
 	if(MeshShape == NULL)
 	{
@@ -186,7 +212,7 @@ IParaPhysicsActor* ParaEngine::CPhysicsWorld::CreateStaticMesh( MeshEntity* ppMe
 				MeshShape = new TriangleMeshShape();
 				MeshShape->m_pMeshEntity  = ppMesh;
 				MeshShape->m_vScale = Vector3(fScalingX, fScalingY, fScalingZ);
-				m_listMeshShapes.push_back(MeshShape);
+				AddMeshShape(MeshShape);
 
 				// scale the vertex if necessary
 				if(Vector3(fScalingX-1.0f,fScalingY-1.0f,fScalingZ-1.0f).squaredLength() > FLT_TOLERANCE)
@@ -287,22 +313,8 @@ IParaPhysicsActor* ParaEngine::CPhysicsWorld::CreateStaticMesh(ParaXEntity* ppMe
 	float fScalingX, fScalingY, fScalingZ;
 	Math::GetMatrixScaling(globalMat, &fScalingX, &fScalingY, &fScalingZ);
 
-	// TODO: use a sorted set to store the shape list. it is more efficient
-	TriangleMeshShape_Map_Type::iterator itCurCP, itEndCP = m_listMeshShapes.end();
-
-	for (itCurCP = m_listMeshShapes.begin(); itCurCP != itEndCP; ++itCurCP)
-	{
-		if ((*itCurCP)->m_pParaXEntity == ppMesh)
-		{
-			// keep mesh for every scale level
-			Vector3 vScale = (*itCurCP)->m_vScale;
-			if (Vector3(vScale.x - fScalingX, vScale.y - fScalingY, vScale.z - fScalingZ).squaredLength() < FLT_TOLERANCE)
-			{
-				MeshShape = (*itCurCP);
-				break;
-			}
-		}
-	}
+	// keep mesh for every scale level
+	MeshShape = FindMeshShape(ppMesh, fScalingX, fScalingY, fScalingZ);
 
 	if (MeshShape == NULL)
 	{
@@ -338,7 +350,7 @@ IParaPhysicsActor* ParaEngine::CPhysicsWorld::CreateStaticMesh(ParaXEntity* ppMe
 				MeshShape = new TriangleMeshShape();
 				MeshShape->m_pParaXEntity = ppMesh;
 				MeshShape->m_vScale = Vector3(fScalingX, fScalingY, fScalingZ);
-				m_listMeshShapes.push_back(MeshShape);
+				AddMeshShape(MeshShape);
 
 				// scale the vertex if necessary
 				if (Vector3(fScalingX - 1.0f, fScalingY - 1.0f, fScalingZ - 1.0f).squaredLength() > FLT_TOLERANCE)
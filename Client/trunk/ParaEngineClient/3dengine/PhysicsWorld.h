@@ -1,6 +1,6 @@
 #pragma once
 #include "IParaPhysics.h"
-#include <list>
+#include <map>
 
 /** different physics engine has different winding order. */
 // #define INVERT_PHYSICS_FACE_WINDING
@@ -19,7 +19,18 @@ namespace ParaEngine
 	{
 	public:
 		class TriangleMeshShape;
-		typedef std::list<TriangleMeshShape*> TriangleMeshShape_Map_Type;
+
+		/** a shape is shared by all static meshes of the same mesh entity and (quantized) scaling factor. */
+		struct TriangleMeshShapeKey
+		{
+		public:
+			TriangleMeshShapeKey(void* pEntity, float fScalingX, float fScalingY, float fScalingZ);
+			bool operator<(const TriangleMeshShapeKey& r) const;
+
+			void* m_pEntity;
+			int32 m_nScale[3];
+		};
+		typedef std::map<TriangleMeshShapeKey, TriangleMeshShape*> TriangleMeshShape_Map_Type;
 
 		struct SubMeshPhysicsShape
 		{
@@ -101,6 +112,11 @@ namespace ParaEngine
 		/** get the physics interface. create one if one does not exist. */
 		IParaPhysics* GetPhysicsInterface();
 
+	protected:
+		/** get the shape of the given mesh entity and scaling, return NULL if not created. */
+		TriangleMeshShape* FindMeshShape(void* pEntity, float fScalingX, float fScalingY, float fScalingZ);
+		void AddMeshShape(TriangleMeshShape* pShape);
+
 	public:
 		/** the main physic interface. */
 		IParaPhysics*     m_pPhysicsWorld;
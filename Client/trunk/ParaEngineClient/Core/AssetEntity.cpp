@@ -24,13 +24,17 @@ using namespace ParaEngine;
 //#define DEFAULT_ASSET_SERVER_URL		"http://www.paraengine.com/"
 static string g_sUrlAssetServer = DEFAULT_ASSET_SERVER_URL;
 
+int AssetEntity::g_nAccessFrame = 0;
 
-AssetEntity::AssetEntity() :m_bIsValid(true), m_bIsInitialized(false), m_bIsLocked(false), m_assetState(ASSET_STATE_NORMAL)
+
+AssetEntity::AssetEntity() :m_bIsValid(true), m_bIsInitialized(false), m_bIsLocked(false), m_assetState(ASSET_STATE_NORMAL),
+	m_nLastAccessFrame(g_nAccessFrame), m_pClockPrev(NULL), m_pClockNext(NULL), m_nCountedBytes(0)
 {
 
 }
 
-AssetEntity::AssetEntity(const AssetKey& key) : m_bIsValid(true), m_bIsInitialized(false), m_bIsLocked(false), m_key(key), m_assetState(ASSET_STATE_NORMAL)
+AssetEntity::AssetEntity(const AssetKey& key) : m_bIsValid(true), m_bIsInitialized(false), m_bIsLocked(false), m_key(key), m_assetState(ASSET_STATE_NORMAL),
+	m_nLastAccessFrame(g_nAccessFrame), m_pClockPrev(NULL), m_pClockNext(NULL), m_nCountedBytes(0)
 {
 
 }
@@ -273,5 +277,7 @@ int AssetEntity::InstallFields(CAttributeClass* pClass, bool bOverride)
 	pClass->AddField("IsLocked", FieldType_Bool, (void*)0, (void*)IsLocked_s, NULL, NULL, bOverride);
 	pClass->AddField("IsInitialized", FieldType_Bool, (void*)0, (void*)IsInitialized_s, NULL, NULL, bOverride);
 	pClass->AddField("State", FieldType_Int, (void*)SetState_s, (void*)GetState_s, NULL, NULL, bOverride);
+	pClass->AddField("MemoryUsage", FieldType_Int, (void*)0, (void*)GetMemoryUsage_s, NULL, NULL, bOverride);
+	pClass->AddField("LastAccessFrame", FieldType_Int, (void*)0, (void*)GetLastAccessFrame_s, NULL, NULL, bOverride);
 	return S_OK;
 }
\ No newline at end of file
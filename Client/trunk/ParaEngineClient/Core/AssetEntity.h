@@ -46,6 +46,9 @@ namespace ParaEngine
 		ATTRIBUTE_METHOD1(AssetEntity, GetState_s, int*)		{ *p1 = (int)cls->GetState(); return S_OK; }
 		ATTRIBUTE_METHOD1(AssetEntity, SetState_s, int)		{ cls->SetState((AssetState)p1); return S_OK; }
 
+		ATTRIBUTE_METHOD1(AssetEntity, GetMemoryUsage_s, int*)		{ *p1 = (int)cls->GetMemoryUsage(); return S_OK; }
+		ATTRIBUTE_METHOD1(AssetEntity, GetLastAccessFrame_s, int*)		{ *p1 = cls->GetLastAccessFrame(); return S_OK; }
+
 	public:
 
 		/** the asset state. an asset may be local or remote. if remote, it may take time for the asset to sync with the server. 
@@ -202,6 +205,7 @@ namespace ParaEngine
 		* automatically, during resource pointer retrieval function.
 		* E.g. During each frame render routine, call this function if the asset is used.*/
 		void LoadAsset(){
+			m_nLastAccessFrame = g_nAccessFrame;
 			if(!m_bIsInitialized)
 			{
 				InitDeviceObjects();
@@ -248,6 +252,22 @@ namespace ParaEngine
 
 		/** Get AABB bounding box of the asset object. if the asset contains an OOB, it will return true. */
 		virtual bool GetBoundingBox(Vector3* pMin, Vector3* pMax) { return false; };
+
+		/** estimated number of bytes used by the loaded asset in system and device memory. It is 0 if the asset is not loaded.
+		* This function must not load the asset. */
+		virtual size_t GetMemoryUsage() { return 0; };
+
+		/** whether UnloadAsset() can be called at any time to free memory, so that the next LoadAsset() restores the same content.
+		* This is false for assets whose content is not loaded from a file, such as render targets. */
+		virtual bool IsEvictable() { return false; };
+
+		/** the access frame when LoadAsset() was last called. */
+		inline int GetLastAccessFrame() { return m_nLastAccessFrame; }
+
+		/** the current access frame, which is increased by one every render frame. */
+		static int GetAccessFrame() { return g_nAccessFrame; }
+		/** called once per render frame by the asset manager. */
+		static void AdvanceAccessFrame() { ++g_nAccessFrame; }
 	public:
 		/** this is the unique key object. */
 		AssetKey m_key;
@@ -269,6 +289,20 @@ namespace ParaEngine
 		* in all conditions, this is either empty or a local disk file name. 
 		*/
 		string m_localfilename;
+
+		/** current access frame number, see AdvanceAccessFrame() */
+		static int g_nAccessFrame;
+
+		/** the access frame when LoadAsset() was last called. */
+		int m_nLastAccessFrame;
+
+		/** intrusive clock list of the owner AssetManager, see AssetManager::CollectGarbageIncremental() */
+		AssetEntity* m_pClockPrev;
+		AssetEntity* m_pClockNext;
+		/** memory usage of this asset last counted by the owner AssetManager */
+		size_t m_nCountedBytes;
+
+		template <class IDTYPE, class ClassImpType, class ETYPE> friend class AssetManager;
 	};
 }
 
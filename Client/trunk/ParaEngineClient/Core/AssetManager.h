@@ -8,6 +8,12 @@ namespace ParaEngine
 	* AssetManager manages a set of asset entities of a certain type.
 	* IDTYPE must be AssetEntity derived class. ClassImpType is the actually implement of the type. 
 	* We can access the singleton via AssetManager<type>::GetInstance()
+	*
+	* Entities are also kept in an intrusive list that is swept like a clock (second-chance) algorithm. If a memory budget is set,
+	* CollectGarbageIncremental() is called once per frame to advance the clock hand over a few entities at the tail of the list,
+	* update the memory usage of the pool and unload entities that are not used for a while until the pool is under budget.
+	* LoadAsset() only stamps the access frame of an entity and never moves it in the list, so touching an asset costs no list operation.
+	* The stamp is its second chance: the sweep skips entities that are used recently. Assets used by visible objects are touched every frame by LoadAsset(), so they are never unloaded.
 	*/
 	template <class IDTYPE, class ClassImpType = IDTYPE, class ETYPE = AssetEntity>
 	class AssetManager : public IAttributeFields
@@ -18,6 +24,7 @@ namespace ParaEngine
 		typedef std::map<AssetKey, ETYPE*> AssetItemsSet_t;
 
 		AssetManager()
+			: m_pClockHead(NULL), m_pClockTail(NULL), m_nMemoryUsage(0), m_nMemoryBudget(0), m_nEvictIdleFrames(150), m_nEvictStepsPerFrame(64)
 		{
 			static_assert(std::is_convertible<IDTYPE*, AssetEntity*>::value, "Invalid Type for AssetManager!");
 			// since asset manager is kind of singleton pattern, we will always set reference count to 1 during creation. 
@@ -76,6 +83,8 @@ namespace ParaEngine
 					OUTPUT_LOG("warning: asset <%s> exits with ref %d\n", pAsset->m_key.c_str(), pAsset->GetRefCount()-1);
 				}
 #endif
+				itCurCP->second->m_pClockPrev = itCurCP->second->m_pClockNext = NULL;
+				itCurCP->second->m_nCountedBytes = 0;
 				// normally, it should have 0 reference count at this place. And a delete this operation is performed. 
 				itCurCP->second->Release();
 
@@ -84,6 +93,8 @@ namespace ParaEngine
 				//delete ((IDTYPE*)(*itCurCP));
 			}
 			m_items.clear();
+			m_pClockHead = m_pClockTail = NULL;
+			m_nMemoryUsage = 0;
 
 			// clean up named references
 			m_names.clear();
@@ -143,6 +154,9 @@ namespace ParaEngine
 			{
 				m_items.erase(itCur);
 			}
+			UnlinkClock(entity);
+			m_nMemoryUsage -= entity->m_nCountedBytes;
+			entity->m_nCountedBytes = 0;
 
 			// check references
 			if(entity->GetRefCount() > 1) 
@@ -252,6 +266,7 @@ namespace ParaEngine
 				}
 				m_items[key] = pEntity;
 				pEntity->addref();
+				LinkClock(pEntity);
 
 				// add a lower cased map
 				std::string sNameLowered;
@@ -303,6 +318,7 @@ namespace ParaEngine
 				}
 				m_items[key] = pEntity;
 				pEntity->addref();
+				LinkClock(pEntity);
 
 				// add a lower cased map
 				std::string sNameLowered;
@@ -347,6 +363,70 @@ namespace ParaEngine
 			}
 		}
 
+		/** max number of bytes used by loaded assets in this pool. 0 (default) means unlimited. */
+		void SetMemoryBudget(size_t nBytes) { m_nMemoryBudget = nBytes; }
+		size_t GetMemoryBudget() { return m_nMemoryBudget; }
+
+		/** an asset is only unloaded if it has not been used for this number of frames. default to 150. */
+		void SetEvictIdleFrames(int nFrames) { m_nEvictIdleFrames = nFrames; }
+		int GetEvictIdleFrames() { return m_nEvictIdleFrames; }
+
+		/** max number of entities visited by each CollectGarbageIncremental() call. default to 64 */
+		void SetEvictStepsPerFrame(int nSteps) { m_nEvictStepsPerFrame = nSteps; }
+		int GetEvictStepsPerFrame() { return m_nEvictStepsPerFrame; }
+
+		/** memory usage of the pool as counted by CollectGarbageIncremental(). It is only exact after all entities are visited. */
+		size_t GetMemoryUsage() { return m_nMemoryUsage; }
+
+		/** count the memory usage of all entities in the pool. */
+		size_t CountMemoryUsage()
+		{
+			m_nMemoryUsage = 0;
+			for (AssetEntity* pEntity = m_pClockHead; pEntity != 0; pEntity = pEntity->m_pClockNext)
+			{
+				pEntity->m_nCountedBytes = pEntity->GetMemoryUsage();
+				m_nMemoryUsage += pEntity->m_nCountedBytes;
+			}
+			return m_nMemoryUsage;
+		}
+
+		/** advance the clock hand: visit at most GetEvictStepsPerFrame() entities from the tail of the list, which are moved to the head afterwards.
+		* The list order is the sweep order, not the access order. whether an entity is used recently is told by its access frame only.
+		* If the pool is over budget, visited entities that are loaded, evictable, not locked and not used for GetEvictIdleFrames() frames are unloaded.
+		* Unloaded entities are loaded again the next time they are used.
+		* this function does nothing if there is no memory budget. It should be called once per frame.
+		* @return the number of unloaded entities.
+		*/
+		int CollectGarbageIncremental()
+		{
+			if (m_nMemoryBudget == 0)
+				return 0;
+			int nEvictCount = 0;
+			int nCurFrame = AssetEntity::GetAccessFrame();
+			int nSteps = (std::min)(m_nEvictStepsPerFrame, (int)m_items.size());
+			for (int i = 0; i < nSteps; ++i)
+			{
+				AssetEntity* pEntity = m_pClockTail;
+				size_t nBytes = pEntity->GetMemoryUsage();
+				m_nMemoryUsage = m_nMemoryUsage + nBytes - pEntity->m_nCountedBytes;
+				pEntity->m_nCountedBytes = nBytes;
+				if (nBytes > 0 && m_nMemoryUsage > m_nMemoryBudget && (nCurFrame - pEntity->GetLastAccessFrame()) > m_nEvictIdleFrames
+					&& !pEntity->IsLocked() && pEntity->IsEvictable())
+				{
+					pEntity->UnloadAsset();
+					m_nMemoryUsage -= nBytes;
+					pEntity->m_nCountedBytes = 0;
+					++nEvictCount;
+				}
+				if (pEntity != m_pClockHead)
+				{
+					UnlinkClock(pEntity);
+					LinkClock(pEntity);
+				}
+			}
+			return nEvictCount;
+		}
+
 		/**
 		* check if the entity exist, if so call Refresh().  
 		* @param sEntityName: the asset entity key
@@ -421,6 +501,43 @@ namespace ParaEngine
 				itCurCP->second->RendererRecreated();
 			}
 		}
+	protected:
+		/** add to the head of the clock list. */
+		void LinkClock(AssetEntity* pEntity)
+		{
+			pEntity->m_pClockPrev = NULL;
+			pEntity->m_pClockNext = m_pClockHead;
+			if (m_pClockHead)
+				m_pClockHead->m_pClockPrev = pEntity;
+			else
+				m_pClockTail = pEntity;
+			m_pClockHead = pEntity;
+		}
+		/** remove from the clock list. */
+		void UnlinkClock(AssetEntity* pEntity)
+		{
+			if (pEntity->m_pClockPrev)
+				pEntity->m_pClockPrev->m_pClockNext = pEntity->m_pClockNext;
+			else if (m_pClockHead == pEntity)
+				m_pClockHead = pEntity->m_pClockNext;
+			else
+				return;
+			if (pEntity->m_pClockNext)
+				pEntity->m_pClockNext->m_pClockPrev = pEntity->m_pClockPrev;
+			else
+				m_pClockTail = pEntity->m_pClockPrev;
+			pEntity->m_pClockPrev = pEntity->m_pClockNext = NULL;
+		}
+
+		/** intrusive clock list of all entities. the tail is the next to be swept, the head is the most recently swept or added. */
+		AssetEntity* m_pClockHead;
+		AssetEntity* m_pClockTail;
+		/** memory usage of all entities, see GetMemoryUsage() */
+		size_t m_nMemoryUsage;
+		size_t m_nMemoryBudget;
+		int m_nEvictIdleFrames;
+		int m_nEvictStepsPerFrame;
+
 	public:
 		/** identifier */
 		std::string m_sName;
@@ -8,6 +8,7 @@
 //-----------------------------------------------------------------------------
 #include "ParaEngine.h"
 #include "AssetManifest.h"
+#include "ImageEntity.h"
 #include "ContentLoaderTexture.h"
 
 using namespace ParaEngine;
@@ -159,7 +160,7 @@ HRESULT ParaEngine::CTextureLoader::Load()
 //
 //////////////////////////////////////////////////////////////////////////
 ParaEngine::CTextureProcessor::CTextureProcessor(asset_ptr<TextureEntity>& pAsset)
-	:m_cBytes(0), m_pData(NULL), m_pDevice(NULL), m_ppTexture(NULL), m_dwTextureFormat(D3DFMT_UNKNOWN), m_nMipLevels(D3DX_DEFAULT), m_dwColorKey(0)
+	:m_cBytes(0), m_pData(NULL), m_pDevice(NULL), m_ppTexture(NULL), m_dwTextureFormat(D3DFMT_UNKNOWN), m_nMipLevels(D3DX_DEFAULT), m_dwColorKey(0), m_pImage(NULL)
 {
 	m_asset = pAsset;
 }
@@ -194,7 +195,10 @@ HRESULT ParaEngine::CTextureProcessor::UnLockDeviceObject()
 	{
 		if (GetRenderDevice() == 0)
 			return E_FAIL;
-		m_asset->LoadFromMemory(m_pData, m_cBytes, m_nMipLevels, m_dwTextureFormat, m_ppTexture);
+		if (m_pImage)
+			m_asset->LoadFromImage(m_pImage, m_dwTextureFormat, m_nMipLevels, m_ppTexture);
+		else
+			m_asset->LoadFromMemory(m_pData, m_cBytes, m_nMipLevels, m_dwTextureFormat, m_ppTexture);
 		// Please note that for TextureEntity::TextureSequence, the texture may be locked multiple times. 
 		m_asset->UnLock();
 	}
@@ -203,6 +207,7 @@ HRESULT ParaEngine::CTextureProcessor::UnLockDeviceObject()
 
 HRESULT ParaEngine::CTextureProcessor::CleanUp()
 {
+	SAFE_DELETE(m_pImage);
 	return S_OK;
 }
 
@@ -216,6 +221,10 @@ HRESULT ParaEngine::CTextureProcessor::Process(void* pData, int cBytes)
 {
 	m_pData = (char*)pData;
 	m_cBytes = cBytes;
+	// decode on this processing thread, so that only the upload is left for the render thread.
+	SAFE_DELETE(m_pImage);
+	if (m_pData && m_cBytes > 0)
+		m_pImage = TextureEntity::DecodeImage(m_pData, m_cBytes);
 	return S_OK;
 }
 
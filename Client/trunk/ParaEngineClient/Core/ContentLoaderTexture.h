@@ -91,6 +91,8 @@ namespace ParaEngine
 
 		char* m_pData;
 		int m_cBytes;
+		/** the image decoded from m_pData by a processing thread. NULL if it can only be decoded by the device. */
+		ImageEntity* m_pImage;
 	private:
 		// This is a private function that either Locks and copies the data (D3D9) 
 		bool PopulateTexture();
@@ -60,6 +60,20 @@ std::string MouseEvent::ToScriptCode()const
 	return GenerateOnMouseScript(m_MouseState, m_x, m_y);
 };
 
+bool MouseEvent::Accumulate(const IEvent& e)
+{
+	const MouseEvent* pEvent = dynamic_cast<const MouseEvent*>(&e);
+	if (pEvent && pEvent->m_nEventType == m_nEventType && (m_nEventType == EVENT_MOUSE_MOVE || m_nEventType == EVENT_MOUSE_WHEEL))
+	{
+		// mouse move and wheel events carry delta values
+		m_MouseState = pEvent->m_MouseState;
+		m_x += pEvent->m_x;
+		m_y += pEvent->m_y;
+		return true;
+	}
+	return false;
+}
+
 //////////////////////////////////////////////////////////////////////////
 //
 // key event
@@ -18,6 +18,7 @@ namespace ParaEngine
 
 		/** get event id */
 		virtual int GetEventID() const { return m_nEventID; }
+		virtual IEvent* Clone() const { return new Event(*this); }
 	public:
 		Event(int nEventType, const char* sCode);
 		Event(int nEventType, int nID, const char* sCode);
@@ -38,6 +39,9 @@ namespace ParaEngine
 		/** get event type */
 		virtual int GetEventType()  const { return m_nEventType; }
 		string ToScriptCode()const;
+		virtual IEvent* Clone() const { return new MouseEvent(*this); }
+		/** mouse move and wheel deltas are added up. */
+		virtual bool Accumulate(const IEvent& e);
 	};
 
 	/** simple key events struct*/
@@ -52,6 +56,7 @@ namespace ParaEngine
 		/** get event type */
 		virtual int GetEventType()  const { return m_nEventType; }
 		string ToScriptCode()const;
+		virtual IEvent* Clone() const { return new KeyEvent(*this); }
 	};
 
 	/** system events struct*/
@@ -98,6 +103,7 @@ namespace ParaEngine
 		/** get event type */
 		virtual int GetEventType()  const { return EVENT_EDITOR; }
 		string ToScriptCode()const;
+		virtual IEvent* Clone() const { return new EditorEvent(*this); }
 	};
 
 	/** network event */
@@ -112,6 +118,7 @@ namespace ParaEngine
 		/** get event type */
 		virtual int GetEventType()  const { return EVENT_NETWORK; }
 		string ToScriptCode()const;
+		virtual IEvent* Clone() const { return new NetworkEvent(*this); }
 	};
 
 	/** touch event */
@@ -152,6 +159,7 @@ namespace ParaEngine
 		/** get event type */
 		virtual int GetEventType()  const { return EVENT_TOUCH; }
 		std::string ToScriptCode() const;
+		virtual IEvent* Clone() const { return new TouchEvent(*this); }
 	};
 
 	/** the total 3d vector of force that is currently on the device, including gravity. 
@@ -172,6 +180,7 @@ namespace ParaEngine
 		virtual int GetEventType()  const { return EVENT_ACCELEROMETER; }
 
 		std::string ToScriptCode() const;
+		virtual IEvent* Clone() const { return new AccelerometerEvent(*this); }
 
 	public:
 		double m_x;
@@ -17,13 +17,13 @@ using namespace ParaEngine;
 
 
 CEventHandler::CEventHandler(DWORD nType, const string& sID, const string& sScript)
-: m_sID(sID),m_type(nType)
+: m_sID(sID),m_type(nType),m_nHandlerID(-1)
 {
 	SetScript(sScript);
 }
 
 CEventHandler::CEventHandler(const string& sID, const string& sScript)
-:m_sID(sID),m_type(0)
+:m_sID(sID),m_type(0),m_nHandlerID(-1)
 {
 	if(m_sID[0] == '_')
 	{
@@ -27,6 +27,8 @@ namespace ParaEngine
 		string			m_sCode;
 		/// event type
 		DWORD			m_type;
+		/// integer id assigned by the events center when the handler is added. 
+		int				m_nHandlerID;
 	public:
 		const string& GetCode() const {return m_sCode;};
 		const string& GetFileName() const {return m_sFileName;};
@@ -42,6 +44,12 @@ namespace ParaEngine
 		inline bool IsEvent(int nEventType)const {return (m_type & (0x1<<nEventType))>0;}
 		/** get the event type. */
 		DWORD GetType(){return m_type;};
+		const string& GetID() const {return m_sID;};
+		/** integer id assigned by the events center, which can be used instead of the string id. -1 if not added. */
+		int GetHandlerID() const {return m_nHandlerID;};
+		void SetHandlerID(int nID) {m_nHandlerID = nID;};
+		/** whether the handler holds references to objects in the given lua state, so that it must be removed before the state is closed. */
+		virtual bool UsesLuaState(lua_State* L) const {return false;};
 	public:
 		
 		CEventHandler(DWORD nType, const string& sID, const string& sScript);
@@ -59,6 +67,6 @@ namespace ParaEngine
 		*   if sID begins with "_e" it is treated as a editor event.
 		*/
 		CEventHandler(const string& sID, const string& sScript);
-		~CEventHandler(void){};
+		virtual ~CEventHandler(void){};
 	};
 }
\ No newline at end of file
@@ -122,14 +122,24 @@ namespace ParaEngine
 //////////////////////////////////////////////////////////////////////////
 
 CEventsCenter::CEventsCenter(void)
+	:m_nNextHandlerID(1), m_nDispatchSerial(0)
 {
 	InvalidateEventCounts();
+	ResetEventStats();
+	for (int i = 0; i < EVENT_LAST; ++i)
+	{
+		m_coalescePolicies[i] = EVENT_COALESCE_NONE;
+		m_lastPostedIndex[i] = -1;
+	}
 	m_nMaxPoolSize = DEFAULT_EVENT_POOL_SIZE;
 }
 
 CEventsCenter::~CEventsCenter(void)
 {
 	UnregisterAllEvent();
+	for (CoalescedEvent& pending : m_coalescedEvents)
+		delete pending.m_pEvent;
+	m_coalescedEvents.clear();
 }
 
 CEventsCenter* CEventsCenter::GetInstance()
@@ -144,27 +154,31 @@ void CEventsCenter::Reset()
 
 	ParaEngine::Lock lock_(m_mutex);
 	m_unhandledEventPool.clear();
+	for (CoalescedEvent& pending : m_coalescedEvents)
+		delete pending.m_pEvent;
+	m_coalescedEvents.clear();
+	for (int i = 0; i < EVENT_LAST; ++i)
+		m_lastPostedIndex[i] = -1;
 }
 
 CEventHandler* CEventsCenter::GetEventHandlerByID(const string& sID)
 {
-	EventHandler_List_t::iterator itCurCP, itEndCP = m_sEventHandlerList.end();
-
-	for( itCurCP = m_sEventHandlerList.begin(); itCurCP != itEndCP; ++ itCurCP)
-	{
-		if((*itCurCP)->Equals(sID))
-		{
-			return (*itCurCP);
-		}
-	}
-	return NULL;
+	std::map<string, CEventHandler*>::iterator it = m_handlersByName.find(sID);
+	return (it != m_handlersByName.end()) ? it->second : NULL;
 }
 
-void CEventsCenter::AddEventHandler(CEventHandler* pEventHandler)
+int CEventsCenter::AddEventHandler(CEventHandler* pEventHandler)
 {
 	if(pEventHandler == 0)
-		return;
+		return -1;
+	CEventHandler* pOldHandler = GetEventHandlerByID(pEventHandler->GetID());
+	if (pOldHandler != 0 && pOldHandler != pEventHandler)
+		DeleteEventHandler(pOldHandler);
+
 	m_sEventHandlerList.push_back(pEventHandler);
+	pEventHandler->SetHandlerID(m_nNextHandlerID++);
+	m_handlersByName[pEventHandler->GetID()] = pEventHandler;
+	m_handlersByID[pEventHandler->GetHandlerID()] = pEventHandler;
 
 	for(int i=0;i<EVENT_LAST;++i)
 	{
@@ -174,56 +188,103 @@ void CEventsCenter::AddEventHandler(CEventHandler* pEventHandler)
 				pEventHandler, _1, _2));
 		}
 	}
+	return pEventHandler->GetHandlerID();
 }
 
-void CEventsCenter::RegisterEvent(DWORD nEventType, const string& sID, const string& sScript)
+int CEventsCenter::RegisterEvent(DWORD nEventType, const string& sID, const string& sScript)
 {
+	int nHandlerID = -1;
 	CEventHandler* pEvent = GetEventHandlerByID(sID);
-	if(pEvent==0)
+	if(pEvent==0 || pEvent->GetType() != nEventType)
 	{
-		AddEventHandler(new CEventHandler(nEventType, sID,sScript));
+		nHandlerID = AddEventHandler(new CEventHandler(nEventType, sID,sScript));
 	}
 	else
+	{
 		pEvent->SetScript(sScript);
+		nHandlerID = pEvent->GetHandlerID();
+	}
 	InvalidateEventCounts();
+	return nHandlerID;
 }
 
-void CEventsCenter::RegisterEvent(const string& sID, const string& sScript)
+int CEventsCenter::RegisterEvent(const string& sID, const string& sScript)
 {
+	int nHandlerID = -1;
 	CEventHandler* pEvent = GetEventHandlerByID(sID);
 	if(pEvent==0)
 	{
-		AddEventHandler(new CEventHandler(sID,sScript));
+		nHandlerID = AddEventHandler(new CEventHandler(sID,sScript));
 	}
 	else
+	{
 		pEvent->SetScript(sScript);
+		nHandlerID = pEvent->GetHandlerID();
+	}
 	InvalidateEventCounts();
+	return nHandlerID;
+}
+
+void CEventsCenter::DeleteEventHandler(CEventHandler* pEventHandler)
+{
+	EventHandler_List_t::iterator it = std::find(m_sEventHandlerList.begin(), m_sEventHandlerList.end(), pEventHandler);
+	if (it != m_sEventHandlerList.end())
+		m_sEventHandlerList.erase(it);
+	std::map<string, CEventHandler*>::iterator itName = m_handlersByName.find(pEventHandler->GetID());
+	if (itName != m_handlersByName.end() && itName->second == pEventHandler)
+		m_handlersByName.erase(itName);
+	m_handlersByID.erase(pEventHandler->GetHandlerID());
+	// trackable handler is automatically disconnected from m_events
+	delete pEventHandler;
 }
 
 void CEventsCenter::UnregisterEvent(const string& sID)
 {
-	EventHandler_List_t::iterator itCurCP;
+	CEventHandler* pEvent = GetEventHandlerByID(sID);
+	if (pEvent)
+		DeleteEventHandler(pEvent);
+	InvalidateEventCounts();
+}
 
-	for( itCurCP = m_sEventHandlerList.begin(); itCurCP != m_sEventHandlerList.end(); )
-	{
-		if((*itCurCP)->Equals(sID))
-		{
-			delete (*itCurCP);
-			itCurCP = m_sEventHandlerList.erase(itCurCP);
-		}
-		else
-			++ itCurCP;
-	}
+void CEventsCenter::UnregisterEvent(int nHandlerID)
+{
+	std::map<int, CEventHandler*>::iterator it = m_handlersByID.find(nHandlerID);
+	if (it != m_handlersByID.end())
+		DeleteEventHandler(it->second);
 	InvalidateEventCounts();
 }
 
 int CEventsCenter::FireEvent(const IEvent& e)
 {
 	int nType = e.GetEventType();
-	if(nType>=0 && nType<= EVENT_LAST)
+	if(nType>=0 && nType< EVENT_LAST)
 	{
-		string sScriptCode = e.ToScriptCode();
-		m_events[nType](&e, sScriptCode);
+		std::vector<IEvent*> pendingEvents;
+		{
+			ParaEngine::Lock lock_(m_mutex);
+			++m_postedCounts[nType];
+			int nPolicy = m_coalescePolicies[nType];
+			if (nPolicy != EVENT_COALESCE_NONE && e.IsAsyncMode() && CoalesceEvent_unlocked(e, nPolicy))
+				return S_OK;
+			// pending coalesced events of the same category happened before this one. 
+			int nCategory = GetEventCategory(nType);
+			for (auto it = m_coalescedEvents.begin(); it != m_coalescedEvents.end();)
+			{
+				if (GetEventCategory(it->m_pEvent->GetEventType()) == nCategory)
+				{
+					pendingEvents.push_back(it->m_pEvent);
+					it = m_coalescedEvents.erase(it);
+				}
+				else
+					++it;
+			}
+		}
+		for (IEvent* pEvent : pendingEvents)
+		{
+			DispatchEvent(*pEvent);
+			delete pEvent;
+		}
+		DispatchEvent(e);
 		return S_OK;
 	}
 	else
@@ -232,6 +293,73 @@ int CEventsCenter::FireEvent(const IEvent& e)
 	}
 }
 
+void CEventsCenter::DispatchEvent(const IEvent& e)
+{
+	int nType = e.GetEventType();
+	{
+		ParaEngine::Lock lock_(m_mutex);
+		++m_dispatchedCounts[nType];
+		++m_nDispatchSerial;
+	}
+	// do not generate the script code if no one is listening. 
+	if (m_events[nType].empty())
+		return;
+	string sScriptCode = e.ToScriptCode();
+	m_events[nType](&e, sScriptCode);
+}
+
+bool CEventsCenter::CoalesceEvent_unlocked(const IEvent& e, int nPolicy)
+{
+	int nType = e.GetEventType();
+	int nID = e.GetEventID();
+	int nLastPostedIndex = m_lastPostedIndex[GetEventCategory(nType)];
+	for (auto it = m_coalescedEvents.rbegin(); it != m_coalescedEvents.rend(); ++it)
+	{
+		IEvent*& pPending = it->m_pEvent;
+		if (pPending->GetEventType() == nType && pPending->GetEventID() == nID)
+		{
+			// do not merge across an event of the same category that is posted after the pending one. 
+			if (it->m_nPoolIndex <= nLastPostedIndex)
+				break;
+			if (nPolicy == EVENT_COALESCE_ACCUMULATE && pPending->Accumulate(e))
+			{
+				++m_coalescedCounts[nType];
+				return true;
+			}
+			IEvent* pEvent = e.Clone();
+			if (pEvent == 0)
+				return false;
+			delete pPending;
+			pPending = pEvent;
+			++m_coalescedCounts[nType];
+			return true;
+		}
+	}
+	CoalescedEvent pending;
+	pending.m_pEvent = e.Clone();
+	if (pending.m_pEvent == 0)
+		return false;
+	pending.m_nPoolIndex = (int)m_unhandledEventPool.size();
+	m_coalescedEvents.push_back(pending);
+	return true;
+}
+
+int CEventsCenter::GetEventCategory(int nEventType)
+{
+	switch (nEventType)
+	{
+	case EVENT_MOUSE_MOVE:
+	case EVENT_MOUSE_DOWN:
+	case EVENT_MOUSE_UP:
+	case EVENT_MOUSE_WHEEL:
+		return EVENT_MOUSE;
+	case EVENT_KEY_UP:
+		return EVENT_KEY;
+	default:
+		return nEventType;
+	}
+}
+
 void CEventsCenter::UnregisterAllEvent()
 {
 	EventHandler_List_t::iterator itCurCP, itEnd = m_sEventHandlerList.end();
@@ -240,6 +368,22 @@ void CEventsCenter::UnregisterAllEvent()
 		delete (*itCurCP);
 	}
 	m_sEventHandlerList.clear();
+	m_handlersByName.clear();
+	m_handlersByID.clear();
+}
+
+void CEventsCenter::UnregisterEventsOfLuaState(lua_State* L)
+{
+	EventHandler_List_t handlers;
+	for (CEventHandler* pHandler : m_sEventHandlerList)
+	{
+		if (pHandler->UsesLuaState(L))
+			handlers.push_back(pHandler);
+	}
+	for (CEventHandler* pHandler : handlers)
+		DeleteEventHandler(pHandler);
+	if (!handlers.empty())
+		InvalidateEventCounts();
 }
 
 void CEventsCenter::InvalidateEventCounts()
@@ -253,6 +397,14 @@ void CEventsCenter::InvalidateEventCounts()
 bool CEventsCenter::PostEvent(const Event& e, bool bUnique)
 {
 	ParaEngine::Lock lock_(m_mutex);
+	int nType = e.GetEventType();
+	if (nType >= 0 && nType < EVENT_LAST)
+	{
+		++m_postedCounts[nType];
+		int nPolicy = m_coalescePolicies[nType];
+		if (nPolicy != EVENT_COALESCE_NONE && CoalesceEvent_unlocked(e, nPolicy))
+			return true;
+	}
 	if(bUnique && e.GetEventID()>=0)
 	{
 		// find if there is already an event with the same id,
@@ -269,6 +421,8 @@ bool CEventsCenter::PostEvent(const Event& e, bool bUnique)
 
 	if((int)m_unhandledEventPool.size()<m_nMaxPoolSize)
 	{
+		if (nType >= 0 && nType < EVENT_LAST)
+			m_lastPostedIndex[GetEventCategory(nType)] = (int)m_unhandledEventPool.size();
 		m_unhandledEventPool.push_back(e);
 		return true;
 	}
@@ -278,21 +432,84 @@ bool CEventsCenter::PostEvent(const Event& e, bool bUnique)
 
 void CEventsCenter::FireAllUnhandledEvents()
 {
-	ParaEngine::Lock lock_(m_mutex);
+	EventHandler_Pool_t events;
+	std::vector<CoalescedEvent> coalescedEvents;
+	{
+		// take all pending events, so that handlers can post new events without dead lock. 
+		ParaEngine::Lock lock_(m_mutex);
+		if (m_unhandledEventPool.empty() && m_coalescedEvents.empty())
+			return;
+		events.swap(m_unhandledEventPool);
+		coalescedEvents.swap(m_coalescedEvents);
+		for (int i = 0; i < EVENT_LAST; ++i)
+			m_lastPostedIndex[i] = -1;
+	}
 
-	EventHandler_Pool_t::iterator itCurCP1, itEndCP1 = m_unhandledEventPool.end();
-	for( itCurCP1 = m_unhandledEventPool.begin(); itCurCP1 != itEndCP1; ++ itCurCP1)
+	// coalesced events are dispatched in the order they are queued among the posted events. 
+	size_t nCoalescedIndex = 0;
+	for (int i = 0; i < (int)events.size(); ++i)
 	{
-		Event& e = (*itCurCP1);
+		for (; nCoalescedIndex < coalescedEvents.size() && coalescedEvents[nCoalescedIndex].m_nPoolIndex <= i; ++nCoalescedIndex)
+		{
+			DispatchEvent(*(coalescedEvents[nCoalescedIndex].m_pEvent));
+			delete coalescedEvents[nCoalescedIndex].m_pEvent;
+		}
+		Event& e = events[i];
 		int nType = e.GetEventType();
-		if(nType>=0 && nType<= EVENT_LAST)
+		if(nType>=0 && nType< EVENT_LAST)
 		{
-			string sScriptCode = e.ToScriptCode();
-
-			// NOTE: fix me: There is potential dead lock situation, when the handler invokes another PostEvent(), 
-			// however, since all handlers are asynchronous, this will not happen at the moment. 
-			m_events[nType](&e, sScriptCode);
+			DispatchEvent(e);
 		}
 	}
-	m_unhandledEventPool.clear();
-}
\ No newline at end of file
+	for (; nCoalescedIndex < coalescedEvents.size(); ++nCoalescedIndex)
+	{
+		DispatchEvent(*(coalescedEvents[nCoalescedIndex].m_pEvent));
+		delete coalescedEvents[nCoalescedIndex].m_pEvent;
+	}
+}
+
+void CEventsCenter::SetCoalescePolicy(int nEventType, int nPolicy)
+{
+	if (nEventType >= 0 && nEventType < EVENT_LAST)
+		m_coalescePolicies[nEventType] = nPolicy;
+}
+
+int CEventsCenter::GetCoalescePolicy(int nEventType)
+{
+	return (nEventType >= 0 && nEventType < EVENT_LAST) ? m_coalescePolicies[nEventType] : EVENT_COALESCE_NONE;
+}
+
+int64 CEventsCenter::GetPostedEventCount(int nEventType)
+{
+	ParaEngine::Lock lock_(m_mutex);
+	return (nEventType >= 0 && nEventType < EVENT_LAST) ? m_postedCounts[nEventType] : 0;
+}
+
+int64 CEventsCenter::GetDispatchedEventCount(int nEventType)
+{
+	ParaEngine::Lock lock_(m_mutex);
+	return (nEventType >= 0 && nEventType < EVENT_LAST) ? m_dispatchedCounts[nEventType] : 0;
+}
+
+int64 CEventsCenter::GetCoalescedEventCount(int nEventType)
+{
+	ParaEngine::Lock lock_(m_mutex);
+	return (nEventType >= 0 && nEventType < EVENT_LAST) ? m_coalescedCounts[nEventType] : 0;
+}
+
+void CEventsCenter::ResetEventStats()
+{
+	ParaEngine::Lock lock_(m_mutex);
+	for (int i = 0; i < EVENT_LAST; ++i)
+	{
+		m_postedCounts[i] = 0;
+		m_dispatchedCounts[i] = 0;
+		m_coalescedCounts[i] = 0;
+	}
+}
+
+int64 CEventsCenter::GetDispatchSerial()
+{
+	ParaEngine::Lock lock_(m_mutex);
+	return m_nDispatchSerial;
+}
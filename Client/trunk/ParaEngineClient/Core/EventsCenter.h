@@ -3,11 +3,24 @@
 #include "util/mutex.h"
 #include <list>
 #include <vector>
+#include <map>
 
 namespace ParaEngine
 {
 	//class CEventHandler;
 	using namespace std;
+
+	/** how events of the same type and id are merged when they are posted faster than they are dispatched. */
+	enum EventCoalescePolicy
+	{
+		/** every event is dispatched. */
+		EVENT_COALESCE_NONE = 0,
+		/** only the latest pending event of the same type and id is dispatched in the next frame move. */
+		EVENT_COALESCE_KEEP_LATEST,
+		/** pending events of the same type and id are merged with IEvent::Accumulate, such as adding up mouse move deltas.
+		* events that do not support Accumulate are treated as EVENT_COALESCE_KEEP_LATEST. */
+		EVENT_COALESCE_ACCUMULATE,
+	};
 	
 	/**
 	* a global pool for user registered custom events. 
@@ -49,26 +62,33 @@ namespace ParaEngine
 		*   if sID begins with "_n" it is treated as a network event handler.
 		* @param sScript: the script to be executed when the event is triggered.This is usually a function call in NPL.
 		*	sScript should be in the following format "{NPL filename};{sCode};". this is the same format in the UI event handler
+		* @return the integer handler id, which can be used in UnregisterEvent(int). 
 		*/
-		void RegisterEvent(const string& sID, const string& sScript);
+		int RegisterEvent(const string& sID, const string& sScript);
 		/**
 		* same as above RegisterEvent(), except that it allows caller to explicitly specify the event type, instead of deriving it from the event name.
 		* @param nEventType any bit combination of EventHandler_type
 		* @param sID any unique string identifier
 		* @param sScript the NPL script. 
+		* @return the integer handler id
 		*/
-		void RegisterEvent(DWORD nEventType, const string& sID, const string& sScript);
+		int RegisterEvent(DWORD nEventType, const string& sID, const string& sScript);
 
 		/** add a given event handler. 
 		* @param pEventHandler: must be created using the default new operator. The caller does not need to delete it. 
-		*	The event center will have it deleted automatically. 
+		*	The event center will have it deleted automatically. If there is already a handler with the same string id, it is replaced. 
+		* @return the integer handler id
 		*/
-		void AddEventHandler(CEventHandler* pEventHandler);
+		int AddEventHandler(CEventHandler* pEventHandler);
 
 		/** unregister a mouse or key event handler */
 		void UnregisterEvent(const string& sID);
+		/** unregister an event handler by the integer id returned from RegisterEvent() or AddEventHandler() */
+		void UnregisterEvent(int nHandlerID);
 		/** unregister all mouse or key event handler */
 		void UnregisterAllEvent();
+		/** unregister all handlers that hold references to the given lua state. It is called before the lua state is closed. */
+		void UnregisterEventsOfLuaState(lua_State* L);
 
 		/**
 		* Fire mouse events, call all of its handler scripts with sCode immediately. 
@@ -95,6 +115,30 @@ namespace ParaEngine
 		* fire all events in the unhandled events pool. This function is called automatically during each frame move. 
 		*/
 		void FireAllUnhandledEvents();
+
+		/** set how events of the given type are coalesced. 
+		* If the policy is not EVENT_COALESCE_NONE, async events of this type passed to both FireEvent() and PostEvent() are queued 
+		* and dispatched in the next FireAllUnhandledEvents(), with at most one pending event per event id. 
+		* Events of the same category, such as mouse move and mouse down, keep their order: an event is never merged into 
+		* a pending event that is queued before another event of its category, and pending events are dispatched before 
+		* any later non-coalesced event of their category. 
+		* @param nEventType: value of EventType, such as EVENT_MOUSE_MOVE
+		* @param nPolicy: value of EventCoalescePolicy
+		*/
+		void SetCoalescePolicy(int nEventType, int nPolicy);
+		int GetCoalescePolicy(int nEventType);
+
+		/** number of events of the given type that are fired or posted. */
+		int64 GetPostedEventCount(int nEventType);
+		/** number of events of the given type that are dispatched to handlers. it is smaller than posted count if events are coalesced or dropped. */
+		int64 GetDispatchedEventCount(int nEventType);
+		/** number of events of the given type that are merged into a pending event. */
+		int64 GetCoalescedEventCount(int nEventType);
+		void ResetEventStats();
+
+		/** a number that is increased for each dispatched event. Handlers can use it to share data derived from the event, 
+		* such as the parsed message table, among all handlers of the same dispatch. */
+		int64 GetDispatchSerial();
 	private:
 
 		/**
@@ -104,6 +148,16 @@ namespace ParaEngine
 		*/
 		CEventHandler* GetEventHandlerByID(const string& sID);
 		void InvalidateEventCounts();
+		/** call all handlers of the event type. */
+		void DispatchEvent(const IEvent& e);
+		/** merge the event to the pending coalesced events. m_mutex must be locked. 
+		* @return false if the event can not be coalesced. */
+		bool CoalesceEvent_unlocked(const IEvent& e, int nPolicy);
+		/** events of the same category are kept in order when some of them are coalesced. 
+		* @return EVENT_MOUSE for all mouse events, EVENT_KEY for all key events, or the event type itself. */
+		static int GetEventCategory(int nEventType);
+		/** remove the handler from the lookup tables and delete it. */
+		void DeleteEventHandler(CEventHandler* pEventHandler);
 	private:
 		typedef std::vector<Event> EventHandler_Pool_t;
 		typedef std::vector<CEventHandler*> EventHandler_List_t;
@@ -112,12 +166,32 @@ namespace ParaEngine
 		EventHandler_Callback_t		m_events[EVENT_LAST];
 
 		EventHandler_List_t		m_sEventHandlerList;
+		/// handlers by string id and integer id
+		std::map<string, CEventHandler*> m_handlersByName;
+		std::map<int, CEventHandler*> m_handlersByID;
+		int m_nNextHandlerID;
 		EventHandler_Pool_t  m_unhandledEventPool;
+		/** a pending coalesced event, owned by the events center. */
+		struct CoalescedEvent
+		{
+			IEvent* m_pEvent;
+			/// the size of m_unhandledEventPool when it is queued, so that it is dispatched before events posted after it. 
+			int m_nPoolIndex;
+		};
+		/// pending coalesced events in the order they are first posted
+		std::vector<CoalescedEvent> m_coalescedEvents;
+		/// index in m_unhandledEventPool of the last event of each category, -1 if none. 
+		int m_lastPostedIndex[EVENT_LAST];
+		int m_coalescePolicies[EVENT_LAST];
 		/// maximum number of events which can be in the pool, default value is 50
 		int m_nMaxPoolSize;
 		/// for statistics
 		int m_eventCounts[EVENT_LAST];
-		/// mutex for post event pool
+		int64 m_postedCounts[EVENT_LAST];
+		int64 m_dispatchedCounts[EVENT_LAST];
+		int64 m_coalescedCounts[EVENT_LAST];
+		int64 m_nDispatchSerial;
+		/// mutex for post event pool and statistics
 		ParaEngine::mutex	m_mutex;
 	};
 
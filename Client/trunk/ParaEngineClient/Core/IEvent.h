@@ -19,6 +19,16 @@ namespace ParaEngine
 
 		/** get event id */
 		virtual int GetEventID() const { return 0; }
+
+		/** return a new copy of this event, which is used to keep coalesced events until the next frame move. 
+		* @return NULL if the event can not be copied, in which case it is never coalesced. */
+		virtual IEvent* Clone() const { return NULL; }
+
+		/** merge a later event of the same type and id into this one, which is used by the accumulate coalescing policy. 
+		* @return false if not supported, in which case the later event replaces this one. */
+		virtual bool Accumulate(const IEvent& e) { return false; }
+
+		virtual ~IEvent(){};
 	};
 
 	/** sync file call back function or class. */
@@ -26,7 +26,7 @@ CIPCManager* ParaEngine::CIPCManager::GetInstance()
 	return &g_sington;
 }
 
-CInterprocessQueuePtr ParaEngine::CIPCManager::CreateGetQueue( const std::string& name, IPQueueUsageEnum nUsage )
+CInterprocessQueuePtr ParaEngine::CIPCManager::CreateGetQueue( const std::string& name, IPQueueUsageEnum nUsage, bool bUseSharedMemoryRing )
 {
 	ParaEngine::Lock lock_(m_mutex);
 
@@ -37,7 +37,11 @@ CInterprocessQueuePtr ParaEngine::CIPCManager::CreateGetQueue( const std::string
 	}
 	else
 	{
-		CInterprocessQueuePtr pWatcher(new CInterprocessQueue(name.c_str(), nUsage));
+		CInterprocessQueuePtr pWatcher;
+		if(bUseSharedMemoryRing)
+			pWatcher.reset(new CInterprocessQueueShm(name.c_str(), nUsage));
+		else
+			pWatcher.reset(new CInterprocessQueue(name.c_str(), nUsage));
 		m_queues[name] = pWatcher;
 		return pWatcher;
 	}
@@ -66,4 +70,75 @@ void ParaEngine::CIPCManager::Clear()
 	ParaEngine::Lock lock_(m_mutex);
 	m_queues.clear();
 }
-#endif
\ No newline at end of file
+
+#ifdef _DEBUG
+#include "util/ParaTime.h"
+/** IPC throughput and latency benchmark between two local processes. 
+* start one process with sRole = "server" and another with sRole = "client", using the same transport. 
+* the server echoes messages of type 1 and replies to the last message of a burst(type 2).
+* @param bUseSharedMemoryRing: true to test CInterprocessQueueShm, false to test CInterprocessQueue.
+*/
+void Test_IPCQueue(const char* sRole, bool bUseSharedMemoryRing)
+{
+	using namespace ParaEngine;
+	std::string sReqName = bUseSharedMemoryRing ? "ipc_bench_ring_req" : "ipc_bench_req";
+	std::string sRespName = bUseSharedMemoryRing ? "ipc_bench_ring_resp" : "ipc_bench_resp";
+	CInterprocessQueuePtr pReq = CIPCManager::GetInstance()->CreateGetQueue(sReqName, IPQU_open_or_create, bUseSharedMemoryRing);
+	CInterprocessQueuePtr pResp = CIPCManager::GetInstance()->CreateGetQueue(sRespName, IPQU_open_or_create, bUseSharedMemoryRing);
+	if (!pReq->IsValid() || !pResp->IsValid())
+	{
+		OUTPUT_LOG("Test_IPCQueue: failed to create queues\n");
+		return;
+	}
+	InterProcessMessage msg;
+	unsigned int nPriority = 0;
+	if (strcmp(sRole, "server") == 0)
+	{
+		pReq->Clear();
+		pResp->Clear();
+		// type 3 to quit
+		while (pReq->receive(msg, nPriority) == IPRC_OK && msg.m_nMsgType != 3)
+		{
+			if (msg.m_nMsgType == 1 || msg.m_nMsgType == 2)
+				pResp->send(msg, nPriority);
+		}
+		return;
+	}
+
+	const int nSizes[] = { 128, 4096 };
+	for (int nSize : nSizes)
+	{
+		msg.reset();
+		msg.m_filename = "test.lua";
+		msg.m_code.assign(nSize, 'a');
+
+		// throughput: a burst of one way messages, and wait for the reply of the last one.
+		const int nCount = 10000;
+		int64 nFromTime = GetTimeUS();
+		msg.m_nMsgType = 0;
+		for (int i = 0; i < nCount - 1; ++i)
+			pReq->send(msg);
+		msg.m_nMsgType = 2;
+		pReq->send(msg);
+		pResp->receive(msg, nPriority);
+		int nTimeUS = (int)(GetTimeUS() - nFromTime);
+		OUTPUT_LOG("%s IPC: %d messages of %d bytes in %d us, %.1f MB/s\n", bUseSharedMemoryRing ? "ring" : "queue", nCount, nSize, nTimeUS,
+			(double)nCount * nSize / (nTimeUS > 0 ? nTimeUS : 1));
+
+		// latency: round trips
+		const int nRoundTrips = 1000;
+		msg.m_nMsgType = 1;
+		nFromTime = GetTimeUS();
+		for (int i = 0; i < nRoundTrips; ++i)
+		{
+			pReq->send(msg);
+			pResp->receive(msg, nPriority);
+		}
+		nTimeUS = (int)(GetTimeUS() - nFromTime);
+		OUTPUT_LOG("%s IPC: average round trip of %d bytes is %.2f us\n", bUseSharedMemoryRing ? "ring" : "queue", nSize, (double)nTimeUS / nRoundTrips);
+	}
+	msg.m_nMsgType = 3;
+	pReq->send(msg);
+}
+#endif
+#endif
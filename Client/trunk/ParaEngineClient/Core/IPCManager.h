@@ -6,7 +6,7 @@
 
 namespace ParaEngine
 {
-	typedef boost::shared_ptr<CInterprocessQueue> CInterprocessQueuePtr;
+	typedef boost::shared_ptr<IInterprocessQueue> CInterprocessQueuePtr;
 
 	/** file system watcher service. this is a singleton. */
 	class CIPCManager
@@ -24,8 +24,11 @@ namespace ParaEngine
 
 		/** create get a watcher by its name. 
 		* it is good practice to use the directory name as watcher name, since it will reuse it as much as possible. 
+		* @param bUseSharedMemoryRing: if true, the queue is created with the shared memory ring transport (CInterprocessQueueShm),
+		* which is much faster and supports large messages. Both processes must use the same transport for a given queue name.
+		* If a queue of the same name already exists, it is returned regardless of its transport.
 		*/
-		CInterprocessQueuePtr CreateGetQueue(const std::string& name, IPQueueUsageEnum nUsage = IPQU_open_or_create);
+		CInterprocessQueuePtr CreateGetQueue(const std::string& name, IPQueueUsageEnum nUsage = IPQU_open_or_create, bool bUseSharedMemoryRing = false);
 
 		/** delete a watcher, it will no longer receive callbacks. 
 		* @please note that if someone else still keeps a pointer to the directory watcher, it will not be deleted. 
@@ -95,6 +95,35 @@ namespace ParaEngine
 		PARAVECTOR3 m_vHitNormalWorld;
 	};
 
+	/** a ray query of IParaPhysics::RaycastClosestShapes() */
+	struct ParaPhysicsRayQuery
+	{
+		PARAVECTOR3 m_vOrigin;
+		/** normalized ray direction */
+		PARAVECTOR3 m_vDirection;
+		/** max distance. if negative, it is 200. */
+		float m_fSensorRange;
+		short m_nGroupMask;
+	};
+
+	/** a sphere sweep query of IParaPhysics::SweepSphereClosestShapes() */
+	struct ParaPhysicsSweepQuery
+	{
+		PARAVECTOR3 m_vOrigin;
+		/** normalized sweep direction */
+		PARAVECTOR3 m_vDirection;
+		/** max distance. if negative, it is 200. */
+		float m_fSensorRange;
+		float m_fRadius;
+		short m_nGroupMask;
+	};
+
+	/** the result of a batched query. m_pActor is NULL if nothing is hit. */
+	struct ParaPhysicsQueryHit : public RayCastHitResult
+	{
+		IParaPhysicsActor* m_pActor;
+	};
+
 	/** ParaPhysics core interface. 
 	*/
 	class IParaPhysics
@@ -133,6 +162,18 @@ namespace ParaEngine
 		/** ray cast a given group. */
 		virtual IParaPhysicsActor* RaycastClosestShape(const PARAVECTOR3& vOrigin, const PARAVECTOR3& vDirection, DWORD dwType, RayCastHitResult& hit, short dwGroupMask, float fSensorRange) = 0;
 
+		/** ray cast a batch of queries, which may run in parallel. The world must not be changed or stepped during the call.
+		* @param pHits: an array of nCount results, one for each query.
+		* @return the number of queries that hit something.
+		*/
+		virtual int RaycastClosestShapes(const ParaPhysicsRayQuery* pQueries, int nCount, ParaPhysicsQueryHit* pHits) = 0;
+
+		/** sweep a sphere for a batch of queries, which may run in parallel. The world must not be changed or stepped during the call.
+		* @param pHits: an array of nCount results, one for each query. m_fDistance is the distance traveled by the sphere center.
+		* @return the number of queries that hit something.
+		*/
+		virtual int SweepSphereClosestShapes(const ParaPhysicsSweepQuery* pQueries, int nCount, ParaPhysicsQueryHit* pHits) = 0;
+
 		/** set the debug draw object for debugging physics world. */
 		virtual void	SetDebugDrawer(IParaDebugDraw*	debugDrawer) = 0;
 		
@@ -150,5 +191,11 @@ namespace ParaEngine
 
 		/** bitwise of PhysicsDebugDrawModes */
 		virtual int		GetDebugDrawMode() = 0;
+
+		/** set the directory to cache the acceleration structures of triangle mesh shapes, such as serialized BVH trees.
+		* Cached files are keyed by the hash of mesh content, so that an identical mesh is loaded from the cache instead of being built again.
+		* @param sDirectory: an existing directory ending with '/'. NULL or empty to disable the cache.
+		*/
+		virtual void SetShapeCacheDirectory(const char* sDirectory) = 0;
 	};
 }
\ No newline at end of file
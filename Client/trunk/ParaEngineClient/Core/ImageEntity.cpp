@@ -13,8 +13,77 @@
 
 #include "ImageEntity.h"
 
+/// @def "PIMG"
+#define DECODED_IMAGE_FILE_MAGIC		0x474D4950
+#define DECODED_IMAGE_FILE_VERSION		2
+
 using namespace ParaEngine;
 
+namespace ParaEngine
+{
+	/** header of a decoded image file. It is followed by the pixel data. */
+	struct DecodedImageFileHeader
+	{
+		uint32 m_nMagic;
+		uint32 m_nVersion;
+		uint64 m_nContentHash;
+		/** decoder settings that change the decoded pixels, such as png alpha premultiplication. */
+		uint32 m_nDecoderFlags;
+		uint32 m_nFormat;
+		int32 m_nWidth;
+		int32 m_nHeight;
+		uint32 m_nPremultipliedAlpha;
+		uint32 m_nDataLen;
+	};
+}
+
+/** bytes per pixel of uncompressed decoded formats, 0 for other formats. */
+static int GetBytesPerPixel(D3DFORMAT format)
+{
+	switch (format)
+	{
+	case D3DFMT_A8R8G8B8: return 4;
+	case D3DFMT_R8G8B8: return 3;
+	case D3DFMT_A8L8: return 2;
+	case D3DFMT_L8: return 1;
+	default: return 0;
+	}
+}
+
+#ifdef USE_OPENGL_RENDERER
+static D3DFORMAT GetD3DFormat(Texture2D::PixelFormat format)
+{
+	switch (format)
+	{
+	case Texture2D::PixelFormat::RGBA8888: return D3DFMT_A8R8G8B8;
+	case Texture2D::PixelFormat::RGB888: return D3DFMT_R8G8B8;
+	case Texture2D::PixelFormat::AI88: return D3DFMT_A8L8;
+	case Texture2D::PixelFormat::I8: return D3DFMT_L8;
+	default: return D3DFMT_UNKNOWN;
+	}
+}
+
+static Texture2D::PixelFormat GetGLPixelFormat(D3DFORMAT format)
+{
+	switch (format)
+	{
+	case D3DFMT_R8G8B8: return Texture2D::PixelFormat::RGB888;
+	case D3DFMT_A8L8: return Texture2D::PixelFormat::AI88;
+	case D3DFMT_L8: return Texture2D::PixelFormat::I8;
+	default: return Texture2D::PixelFormat::RGBA8888;
+	}
+}
+#endif
+
+static uint32 GetDecoderFlags()
+{
+#ifdef USE_OPENGL_RENDERER
+	return Image::PNG_PREMULTIPLIED_ALPHA_ENABLED ? 1 : 0;
+#else
+	return 0;
+#endif
+}
+
 ParaEngine::ImageEntity::ImageEntity()
 	: _data(nullptr)
 	, _dataLen(0)
@@ -96,13 +165,123 @@ bool ParaEngine::ImageEntity::LoadFromRawData(const unsigned char * data, size_t
 	return ret;
 }
 
+bool ParaEngine::ImageEntity::DecodeFromMemory(const unsigned char * data, size_t dataLen)
+{
+#ifdef USE_OPENGL_RENDERER
+	Image image;
+	if (!image.initWithImageData(data, dataLen) || image.getData() == 0 || image.getNumberOfMipmaps() > 1)
+		return false;
+	int nWidth = (int)image.getWidth();
+	int nHeight = (int)image.getHeight();
+	int nPixelCount = nWidth * nHeight;
+	if (nPixelCount <= 0)
+		return false;
+
+	// the decoded format is kept, so that RGB, luminance and luminance alpha images are uploaded as they are.
+	D3DFORMAT format = GetD3DFormat(image.getRenderFormat());
+	int nBytesPerPixel = GetBytesPerPixel(format);
+	if (nBytesPerPixel == 0 || (int)image.getDataLen() < nPixelCount * nBytesPerPixel)
+		return false;
+	int nDataLen = nPixelCount * nBytesPerPixel;
+	unsigned char* pData = new (std::nothrow) unsigned char[nDataLen];
+	if (!pData)
+		return false;
+	memcpy(pData, image.getData(), nDataLen);
+
+	if (m_bIsOwnData){
+		SAFE_DELETE_ARRAY(_data);
+	}
+	_data = pData;
+	_dataLen = nDataLen;
+	m_bIsOwnData = true;
+	_width = nWidth;
+	_height = nHeight;
+	_renderFormat = format;
+	_hasPremultipliedAlpha = image.hasPremultipliedAlpha();
+	m_bIsValid = true;
+	return true;
+#else
+	return false;
+#endif
+}
+
+bool ParaEngine::ImageEntity::LoadDecodedFromFile(const std::string& filename, uint64 nContentHash)
+{
+	CParaFile file;
+	if (!file.OpenFile(filename.c_str(), true, NULL, false, FILE_ON_DISK))
+		return false;
+	if (file.getSize() < sizeof(DecodedImageFileHeader))
+		return false;
+	const DecodedImageFileHeader& header = *((const DecodedImageFileHeader*)file.getBuffer());
+	if (header.m_nMagic != DECODED_IMAGE_FILE_MAGIC || header.m_nVersion != DECODED_IMAGE_FILE_VERSION || header.m_nContentHash != nContentHash
+		|| header.m_nDecoderFlags != GetDecoderFlags() || GetBytesPerPixel((D3DFORMAT)header.m_nFormat) == 0
+		|| header.m_nWidth <= 0 || header.m_nHeight <= 0 || header.m_nDataLen != (uint32)(header.m_nWidth * header.m_nHeight * GetBytesPerPixel((D3DFORMAT)header.m_nFormat))
+		|| file.getSize() != sizeof(DecodedImageFileHeader) + header.m_nDataLen)
+	{
+		return false;
+	}
+	unsigned char* pData = new (std::nothrow) unsigned char[header.m_nDataLen];
+	if (!pData)
+		return false;
+	memcpy(pData, file.getBuffer() + sizeof(DecodedImageFileHeader), header.m_nDataLen);
+
+	if (m_bIsOwnData){
+		SAFE_DELETE_ARRAY(_data);
+	}
+	_data = pData;
+	_dataLen = header.m_nDataLen;
+	m_bIsOwnData = true;
+	_width = header.m_nWidth;
+	_height = header.m_nHeight;
+	_renderFormat = (D3DFORMAT)header.m_nFormat;
+	_hasPremultipliedAlpha = header.m_nPremultipliedAlpha != 0;
+	m_bIsValid = true;
+	return true;
+}
+
+bool ParaEngine::ImageEntity::SaveDecodedToFile(const std::string& filename, uint64 nContentHash)
+{
+	if (!IsDecoded() || !_data)
+		return false;
+	DecodedImageFileHeader header;
+	memset(&header, 0, sizeof(header));
+	header.m_nMagic = DECODED_IMAGE_FILE_MAGIC;
+	header.m_nVersion = DECODED_IMAGE_FILE_VERSION;
+	header.m_nContentHash = nContentHash;
+	header.m_nDecoderFlags = GetDecoderFlags();
+	header.m_nFormat = (uint32)_renderFormat;
+	header.m_nWidth = _width;
+	header.m_nHeight = _height;
+	header.m_nPremultipliedAlpha = _hasPremultipliedAlpha ? 1 : 0;
+	header.m_nDataLen = (uint32)_dataLen;
+
+	// write to a temp file first, so that a partially written file is never loaded by another thread or process.
+	char sTempPostfix[32];
+	snprintf(sTempPostfix, sizeof(sTempPostfix), ".%p.tmp", (void*)this);
+	std::string sTempFileName = filename + sTempPostfix;
+	{
+		CParaFile file;
+		if (!file.CreateNewFile(sTempFileName.c_str(), true))
+			return false;
+		file.write(&header, sizeof(header));
+		file.write(_data, (int)_dataLen);
+		file.close();
+	}
+	if (!CParaFile::MoveFile(sTempFileName.c_str(), filename.c_str()))
+	{
+		CParaFile::DeleteFile(sTempFileName, false);
+		return false;
+	}
+	return true;
+}
+
 bool ParaEngine::ImageEntity::SaveToFile(const std::string &filename, bool isToRGB /*= true*/)
 {
 #ifdef USE_OPENGL_RENDERER
 	std::string filepath = CParaFile::GetWritablePath() + filename;
 	CParaFile::CreateDirectory(filepath.c_str());
 	Image image;
-	image.initWithRawData(getData(), getDataLen(), getWidth(), getHeight(), getBitPerPixel());
+	image.initWithRawData(getData(), getDataLen(), getWidth(), getHeight(), getBitPerPixel(), false, GetGLPixelFormat(getRenderFormat()));
 	bool res =image.saveToFile(filepath, isToRGB);
 	if (res){
 		OUTPUT_LOG("successfully saved image to file :%s\n", filepath.c_str());
@@ -119,10 +298,7 @@ bool ParaEngine::ImageEntity::SaveToFile(const std::string &filename, bool isToR
 
 int ParaEngine::ImageEntity::getBitPerPixel()
 {
-	if (getRenderFormat() == D3DFMT_A8R8G8B8)
-		return 32;
-	else
-		return 0;
+	return GetBytesPerPixel(getRenderFormat()) * 8;
 }
 
 bool ParaEngine::ImageEntity::hasAlpha()
@@ -33,6 +33,22 @@ namespace ParaEngine
 		/** currently only support RGBA8 32bits data, such as from render target */
 		bool LoadFromRawData(const unsigned char * data, size_t dataLen, int width, int height, int bitsPerComponent, bool preMulti = false);
 
+		/** decode an image file (png, jpg) in memory to A8R8G8B8, R8G8B8, A8L8 or L8 data, whichever the file is stored in. 
+		* It does not use the render device, so it can be called from any thread.
+		* @return false if the file can not be decoded on this platform, in which case the image is not changed.
+		*/
+		bool DecodeFromMemory(const unsigned char * data, size_t dataLen);
+
+		/** whether the data is decoded pixels instead of an image file in memory. */
+		inline bool IsDecoded() { return _renderFormat != D3DFMT_UNKNOWN; }
+
+		/** load decoded data from a file saved by SaveDecodedToFile().
+		* @param nContentHash: hash of the original image file. The file is rejected if it was saved with a different hash or decoder setting.
+		*/
+		bool LoadDecodedFromFile(const std::string& filename, uint64 nContentHash);
+		/** save decoded data to a file, so that the same image file does not need to be decoded again. */
+		bool SaveDecodedToFile(const std::string& filename, uint64 nContentHash);
+
 		// Getters
 		inline unsigned char *   getData()              { return _data; }
 		inline size_t           getDataLen()            { return _dataLen; }
@@ -41,7 +57,7 @@ namespace ParaEngine
 		inline int               getWidth()              { return _width; }
 		inline int               getHeight()             { return _height; }
 		inline int               getNumberOfMipmaps()    { return _numberOfMipmaps; }
-		inline bool              hasPremultipliedAlpha() { return false; }
+		inline bool              hasPremultipliedAlpha() { return _hasPremultipliedAlpha; }
 
 		int                      getBitPerPixel();
 		bool                     hasAlpha();
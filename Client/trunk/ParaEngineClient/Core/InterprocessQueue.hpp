@@ -7,6 +7,7 @@
 	// this allows us to use IPC even in low integrity level process in vista and win7. 
 	#include "ipc_message_queue.hpp"
 #endif
+#include "ipc_shm_ring_queue.hpp"
 #include <boost/shared_ptr.hpp>
 
 #include <boost/logic/tribool.hpp>
@@ -453,6 +454,42 @@ namespace ParaEngine
 		IPRC_TIMEDOUT,
 	};
 
+	/** send a message as chunks of at most nMaxSize bytes. 
+	* with the kernel message queue, chunks of different sending processes may interleave, so there should be only one sender. */
+	template <typename MessageQueueType>
+	inline void SendMessageChunks(MessageQueueType& queue, const char* pBuffer, int nSize, int nMaxSize, unsigned int nPriority)
+	{
+		while (nSize > 0)
+		{
+			int nChunkSize = (nSize > nMaxSize) ? nMaxSize : nSize;
+			queue.send(pBuffer, nChunkSize, nPriority);
+			nSize -= nChunkSize;
+			pBuffer += nChunkSize;
+		}
+	}
+
+	/** the shared memory ring sends all chunks of a message under its producer lock, so that there can be many senders. */
+	inline void SendMessageChunks(ParaEngine::interprocess::shm_ring_queue& queue, const char* pBuffer, int nSize, int nMaxSize, unsigned int nPriority)
+	{
+		queue.send_message(pBuffer, nSize, nPriority);
+	}
+
+	/** common interface of interprocess queues with different transports. */
+	class IInterprocessQueue
+	{
+	public:
+		virtual ~IInterprocessQueue(){};
+		virtual bool IsValid() = 0;
+		virtual void Cleanup() = 0;
+		virtual bool Remove() = 0;
+		virtual void Clear() = 0;
+		virtual IPQueueReturnCodeEnum send(const InterProcessMessage& msg, unsigned int nPriority = 0) = 0;
+		virtual IPQueueReturnCodeEnum try_send(const InterProcessMessage& msg, unsigned int nPriority = 0) = 0;
+		virtual IPQueueReturnCodeEnum receive(InterProcessMessage& msg, unsigned int & nPriority) = 0;
+		virtual IPQueueReturnCodeEnum try_receive(InterProcessMessage& msg, unsigned int & nPriority) = 0;
+		virtual const std::string& GetName() = 0;
+	};
+
 	/** It is for sending and receiving InterProcessMessage. 
 	* internally we use shared memory to create the message queue. Each message queue have a globally unique string name and a fixed max size
 	* Two processes can create CInterprocessQueue using the same name and send and receive messages via it. 
@@ -511,7 +548,7 @@ namespace ParaEngine
 	</verbatim>
 	*/
 	template <int MAX_QUEUE_SIZE = 2000, int MAX_PACKET_SIZE = 256, typename MessageQueueType = boost::interprocess::message_queue>
-	class CInterprocessQueueT
+	class CInterprocessQueueT : public IInterprocessQueue
 	{
 	public:
 		typedef boost::shared_ptr< typename MessageQueueType > message_queue_t;
@@ -652,20 +689,7 @@ namespace ParaEngine
 
 					try
 					{
-						while(nSize > 0)
-						{
-							if(nSize > nMaxSize)
-							{
-								m_msg_queue->send(pBuffer, nMaxSize, nPriority);
-								nSize -= nMaxSize;
-								pBuffer += nMaxSize;
-							}
-							else
-							{
-								m_msg_queue->send(pBuffer, nSize, nPriority);
-								nSize = 0;
-							}
-						}
+						SendMessageChunks(*m_msg_queue, pBuffer, nSize, nMaxSize, nPriority);
 					}
 					catch (...)
 					{
@@ -705,20 +729,7 @@ namespace ParaEngine
 						if(nMaxMessageLength < nSize)
 							return IPRC_QUEUE_IS_FULL;
 
-						while(nSize > 0)
-						{
-							if(nSize > nMaxSize)
-							{
-								m_msg_queue->send(pBuffer, nMaxSize, nPriority);
-								nSize -= nMaxSize;
-								pBuffer += nMaxSize;
-							}
-							else
-							{
-								m_msg_queue->send(pBuffer, nSize, nPriority);
-								nSize = 0;
-							}
-						}
+						SendMessageChunks(*m_msg_queue, pBuffer, nSize, nMaxSize, nPriority);
 					}
 					catch (...)
 					{
@@ -882,5 +893,10 @@ namespace ParaEngine
 #endif
 
 	typedef CInterprocessQueueT<2000, 256, boost::interprocess::message_queue>	CInterprocessQueueFileEmu;
+
+	/** shared memory ring transport: each message takes only as many bytes as it needs, and up to 64KB is sent as a single record
+	* without entering the kernel unless the receiver is sleeping. There can be many senders, but only one receiver. 
+	*/
+	typedef CInterprocessQueueT<16, 64*1024, ParaEngine::interprocess::shm_ring_queue>	CInterprocessQueueShm;
 #pragma endregion InterprocessQueue
 }
\ No newline at end of file
@@ -14,12 +14,13 @@
 #include "NPLRuntime.h"
 #include "INPLAcitvationFile.h"
 #include "ParaEngineAppImp.h"
+#include "TickScheduler.h"
 #include "ParaEngineService.h"
 
 using namespace ParaEngine;
 
-/** 300 milliseconds per activation, since we use std::time, the smallest value is 1 second.  */
-#define MAIN_TIMER_DURATION		100
+/** delay of the first tick in milliseconds */
+#define MAIN_TIMER_START_DELAY		50
 
 /** this is only used for termination signal processing. */
 ParaEngine::CParaEngineService * g_current_service_ptr = NULL;
@@ -53,24 +54,27 @@ void CParaEngineService::AcceptKeyStroke(bool bAccept)
 class CNPLFile_ServerMainLoop : public NPL::INPLActivationFile
 {
 public:
-	CNPLFile_ServerMainLoop(CParaEngineApp* pParaEngineApp):m_pParaEngineApp(pParaEngineApp), m_fElapsedTime(0.f){};
+	CNPLFile_ServerMainLoop(CParaEngineApp* pParaEngineApp):m_pParaEngineApp(pParaEngineApp){};
 	
 	virtual NPL::NPLReturnCode OnActivate(NPL::INPLRuntimeState* pState){
-		if(m_pParaEngineApp)
+		CTickScheduler& scheduler = CTickScheduler::GetSingleton();
+		// the ticks owed while the last one was running are run back to back. 
+		do
 		{
-			m_fElapsedTime += (float)(MAIN_TIMER_DURATION / 1000.f);
-			if(m_pParaEngineApp->GetAppState() != ParaEngine::PEAppState_Exiting)
+			double fElapsedTime = scheduler.BeginTick();
+			if(m_pParaEngineApp)
 			{
-				m_pParaEngineApp->FrameMove(m_fElapsedTime);
+				if(m_pParaEngineApp->GetAppState() != ParaEngine::PEAppState_Exiting)
+				{
+					m_pParaEngineApp->FrameMove(fElapsedTime);
+				}
 			}
-		}
+		} while (scheduler.EndTick());
 		return NPL::NPL_OK;
 	};
 
 protected:
 	CParaEngineApp* m_pParaEngineApp;
-	/** number of seconds elapsed since the game engine start. */
-	float m_fElapsedTime;
 };
 	
 void CParaEngineService::handle_timeout(const boost::system::error_code& err)
@@ -104,10 +108,16 @@ void CParaEngineService::handle_timeout(const boost::system::error_code& err)
 			return;
 		}
 
-		ParaEngine::CGlobals::GetNPLRuntime()->GetMainState()->activate("ParaEngineService.cpp", "");
+		CTickScheduler& scheduler = CTickScheduler::GetSingleton();
+		if (scheduler.OnTimer())
+		{
+			// the tick runs in the NPL main thread, which calls BeginTick() and EndTick().
+			if (ParaEngine::CGlobals::GetNPLRuntime()->GetMainState()->activate("ParaEngineService.cpp", "") != NPL::NPL_OK)
+				scheduler.CancelTick();
+		}
 
-		// continue with next activation. 
-		m_main_timer.expires_from_now(boost::chrono::milliseconds(MAIN_TIMER_DURATION));
+		// continue with next activation at an absolute deadline, so that the time spent in this function does not add up. 
+		m_main_timer.expires_at(timer_type::time_point(boost::chrono::microseconds(scheduler.GetNextDeadline())));
 		m_main_timer.async_wait(boost::bind(&CParaEngineService::handle_timeout, this, boost::asio::placeholders::error));
 	}
 	else
@@ -251,8 +261,14 @@ int CParaEngineService::Run(const char* pCommandLine, CParaEngineApp* pApp)
 	auto main_loop_file = new CNPLFile_ServerMainLoop(m_pParaEngineApp);
 	ParaEngine::CGlobals::GetNPLRuntime()->GetMainState()->RegisterFile("ParaEngineService.cpp", main_loop_file);
 
+	CTickScheduler& scheduler = CTickScheduler::GetSingleton();
+	const char* sTickRate = m_pParaEngineApp->GetAppCommandLineByParam("tickrate", NULL);
+	if (sTickRate && sTickRate[0] != '\0')
+		scheduler.SetTickRate((float)atof(sTickRate));
+	scheduler.Start(MAIN_TIMER_START_DELAY * 1000);
+
 	m_work_lifetime.reset(new boost::asio::io_service::work(m_main_io_service));
-	m_main_timer.expires_from_now(boost::chrono::milliseconds(50));
+	m_main_timer.expires_at(timer_type::time_point(boost::chrono::microseconds(scheduler.GetNextDeadline())));
 	m_main_timer.async_wait(boost::bind(&CParaEngineService::handle_timeout, this, boost::asio::placeholders::error));
 
 	// start the service now
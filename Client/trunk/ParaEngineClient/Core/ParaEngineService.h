@@ -56,7 +56,7 @@ namespace ParaEngine
 		io_service some work to do then the io_service::run() function will exit immediately.*/
 		boost::scoped_ptr<boost::asio::io_service::work> m_work_lifetime;
 
-		/** the main timer that ticks 30 times a second*/
+		/** the main timer that ticks at the rate of CTickScheduler */
 		typedef basic_waitable_timer<boost::chrono::steady_clock> timer_type;
 		timer_type m_main_timer;
 
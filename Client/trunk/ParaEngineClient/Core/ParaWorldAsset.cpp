@@ -450,6 +450,19 @@ void CParaWorldAsset::RenderFrameMove(float fElapsedTime)
 	m_FlashManager.RenderFrameMove(fElapsedTime);
 #endif
 	GetVertexBufferPoolManager().TickCache();
+
+	// assets used in the last frame have the previous access frame. 
+	AssetEntity::AdvanceAccessFrame();
+	GetTextureManager().CollectGarbageIncremental();
+	GetParaXManager().CollectGarbageIncremental();
+	GetMeshManager().CollectGarbageIncremental();
+}
+
+void CParaWorldAsset::SetEvictIdleFrames(int nFrames)
+{
+	GetTextureManager().SetEvictIdleFrames(nFrames);
+	GetParaXManager().SetEvictIdleFrames(nFrames);
+	GetMeshManager().SetEvictIdleFrames(nFrames);
 }
 
 bool CParaWorldAsset::RefreshAsset(const char* filename)
@@ -1053,6 +1066,11 @@ void ParaEngine::CParaWorldAsset::SetUseLocalFileFirst(bool val)
 	CAssetManifest::GetSingleton().SetUseLocalFileFirst(val);
 }
 
+void ParaEngine::CParaWorldAsset::VerifyAssetCache()
+{
+	CAssetManifest::GetSingleton().VerifyCachedFiles();
+}
+
 #ifdef USE_DIRECTX_RENDERER
 
 LatentOcclusionQueryBank* CParaWorldAsset::GetOcclusionQueryBank(int nID)
@@ -1216,5 +1234,13 @@ int ParaEngine::CParaWorldAsset::InstallFields(CAttributeClass* pClass, bool bOv
 	pClass->AddField("EnableAssetManifest", FieldType_Bool, (void*)EnableAssetManifest_s, (void*)IsAssetManifestEnabled_s, NULL, NULL, bOverride);
 	pClass->AddField("UseLocalFileFirst", FieldType_Bool, (void*)SetUseLocalFileFirst_s, (void*)IsUseLocalFileFirst_s, NULL, NULL, bOverride);
 	pClass->AddField("DeleteTempDiskTextures", FieldType_void, (void*)DeleteTempDiskTextures_s, (void*)0, NULL, NULL, bOverride);
+	pClass->AddField("VerifyAssetCache", FieldType_void, (void*)VerifyAssetCache_s, (void*)0, NULL, NULL, bOverride);
+	pClass->AddField("TextureMemoryBudgetMB", FieldType_Int, (void*)SetTextureMemoryBudgetMB_s, (void*)GetTextureMemoryBudgetMB_s, NULL, NULL, bOverride);
+	pClass->AddField("ParaXMemoryBudgetMB", FieldType_Int, (void*)SetParaXMemoryBudgetMB_s, (void*)GetParaXMemoryBudgetMB_s, NULL, NULL, bOverride);
+	pClass->AddField("MeshMemoryBudgetMB", FieldType_Int, (void*)SetMeshMemoryBudgetMB_s, (void*)GetMeshMemoryBudgetMB_s, NULL, NULL, bOverride);
+	pClass->AddField("TextureMemoryUsageMB", FieldType_Int, (void*)0, (void*)GetTextureMemoryUsageMB_s, NULL, NULL, bOverride);
+	pClass->AddField("ParaXMemoryUsageMB", FieldType_Int, (void*)0, (void*)GetParaXMemoryUsageMB_s, NULL, NULL, bOverride);
+	pClass->AddField("MeshMemoryUsageMB", FieldType_Int, (void*)0, (void*)GetMeshMemoryUsageMB_s, NULL, NULL, bOverride);
+	pClass->AddField("EvictIdleFrames", FieldType_Int, (void*)SetEvictIdleFrames_s, (void*)GetEvictIdleFrames_s, NULL, NULL, bOverride);
 	return S_OK;
 }
@@ -69,6 +69,21 @@ namespace ParaEngine
 		ATTRIBUTE_METHOD1(CParaWorldAsset, SetUseLocalFileFirst_s, bool)	{ cls->SetUseLocalFileFirst(p1); return S_OK; }
 
 		ATTRIBUTE_METHOD(CParaWorldAsset, DeleteTempDiskTextures_s)	{ cls->DeleteTempDiskTextures(); return S_OK; }
+		ATTRIBUTE_METHOD(CParaWorldAsset, VerifyAssetCache_s)	{ cls->VerifyAssetCache(); return S_OK; }
+
+		ATTRIBUTE_METHOD1(CParaWorldAsset, GetTextureMemoryBudgetMB_s, int*)	{ *p1 = (int)(cls->GetTextureManager().GetMemoryBudget() >> 20); return S_OK; }
+		ATTRIBUTE_METHOD1(CParaWorldAsset, SetTextureMemoryBudgetMB_s, int)	{ cls->GetTextureManager().SetMemoryBudget((size_t)p1 << 20); return S_OK; }
+		ATTRIBUTE_METHOD1(CParaWorldAsset, GetParaXMemoryBudgetMB_s, int*)	{ *p1 = (int)(cls->GetParaXManager().GetMemoryBudget() >> 20); return S_OK; }
+		ATTRIBUTE_METHOD1(CParaWorldAsset, SetParaXMemoryBudgetMB_s, int)	{ cls->GetParaXManager().SetMemoryBudget((size_t)p1 << 20); return S_OK; }
+		ATTRIBUTE_METHOD1(CParaWorldAsset, GetMeshMemoryBudgetMB_s, int*)	{ *p1 = (int)(cls->GetMeshManager().GetMemoryBudget() >> 20); return S_OK; }
+		ATTRIBUTE_METHOD1(CParaWorldAsset, SetMeshMemoryBudgetMB_s, int)	{ cls->GetMeshManager().SetMemoryBudget((size_t)p1 << 20); return S_OK; }
+
+		ATTRIBUTE_METHOD1(CParaWorldAsset, GetTextureMemoryUsageMB_s, int*)	{ *p1 = (int)(cls->GetTextureManager().CountMemoryUsage() >> 20); return S_OK; }
+		ATTRIBUTE_METHOD1(CParaWorldAsset, GetParaXMemoryUsageMB_s, int*)	{ *p1 = (int)(cls->GetParaXManager().CountMemoryUsage() >> 20); return S_OK; }
+		ATTRIBUTE_METHOD1(CParaWorldAsset, GetMeshMemoryUsageMB_s, int*)	{ *p1 = (int)(cls->GetMeshManager().CountMemoryUsage() >> 20); return S_OK; }
+
+		ATTRIBUTE_METHOD1(CParaWorldAsset, GetEvictIdleFrames_s, int*)	{ *p1 = cls->GetTextureManager().GetEvictIdleFrames(); return S_OK; }
+		ATTRIBUTE_METHOD1(CParaWorldAsset, SetEvictIdleFrames_s, int)	{ cls->SetEvictIdleFrames(p1); return S_OK; }
 	public:
 		static CParaWorldAsset* GetSingleton();
 
@@ -167,6 +182,10 @@ namespace ParaEngine
 		*/
 		void RenderFrameMove(float fElapsedTime);
 
+		/** an asset is only unloaded to meet the memory budget of its pool if it has not been used for this number of frames.
+		* It applies to texture, ParaX and mesh pools. default to 150. */
+		void SetEvictIdleFrames(int nFrames);
+
 		/** initialize all assets created so far to accelerate loading during game play. */
 		void LoadAsset();
 		/** uninitialize all assets created so far to save some memory */
@@ -220,6 +239,9 @@ namespace ParaEngine
 		/** if true, asset manifest's GetFile() will return null, if a local disk or zip file is found even there is an entry in the assetmanifest. */
 		bool IsUseLocalFileFirst() const;
 		void SetUseLocalFileFirst(bool val);
+
+		/** verify all cached asset files of the asset manifest in parallel, and delete corrupted ones. */
+		void VerifyAssetCache();
 	private:
 		void SaveAssetFileMapping();
 		void DeleteTempDiskTextures();
@@ -12,6 +12,14 @@
 #include "ParaWorldAsset.h"
 #include "ImageEntity.h"
 #include "TextureEntity.h"
+#include <boost/filesystem.hpp>
+#include <algorithm>
+#include <ctime>
+
+/// @def image files smaller than this are decoded faster than their decoded data is read from the cache.
+#define IMAGE_CACHE_MIN_FILE_SIZE		16*1024
+/// @def when the cache is over budget, least recently used files are removed until it is below this percentage of the budget.
+#define IMAGE_CACHE_TRIM_PERCENT		75
 
 using namespace ParaEngine;
 
@@ -21,6 +29,8 @@ namespace ParaEngine
 	int TextureEntity::g_nTextureLOD = 0;
 	bool TextureEntity::g_bEnable32bitsTexture = true;
 	const std::string TextureEntity::DEFAULT_STATIC_TEXTURE = "Texture/whitedot.png";
+	std::string TextureEntity::g_sImageCacheDir = "temp/image_cache/";
+	int64 TextureEntity::g_nImageCacheMaxBytes = 256 * 1024 * 1024;
 
 	const TextureEntity::TextureInfo TextureEntity::TextureInfo::Empty(-1, -1, TextureEntity::TextureInfo::FMT_UNKNOWN, TextureEntity::TextureInfo::TYPE_UNKNOWN);
 }
@@ -72,6 +82,121 @@ bool TextureEntity::GiveupRawDataOwnership()
 	return true;
 }
 
+namespace
+{
+	ParaEngine::mutex s_image_cache_mutex;
+	/** total bytes of the image cache directory, -1 if it is not scanned yet. */
+	int64 s_nImageCacheBytes = -1;
+
+	/** a cache file is touched on each hit, so that its last write time is the last use time. */
+	void TouchImageCacheFile(const std::string& sFileName)
+	{
+		boost::system::error_code ec;
+		boost::filesystem::last_write_time(boost::filesystem::path(sFileName), std::time(NULL), ec);
+	}
+
+	/** count a newly saved cache file, and remove least recently used files if the cache is over TextureEntity::g_nImageCacheMaxBytes.
+	* The directory is only scanned at the first call and when the budget is exceeded.
+	*/
+	void TrimImageCache(const std::string& sFileName)
+	{
+		namespace fs = boost::filesystem;
+		boost::system::error_code ec;
+		fs::path filePath(sFileName);
+		int64 nNewBytes = (int64)fs::file_size(filePath, ec);
+		if (ec)
+			return;
+		ParaEngine::Lock lock_(s_image_cache_mutex);
+		int64 nMaxBytes = TextureEntity::g_nImageCacheMaxBytes;
+		if (s_nImageCacheBytes >= 0 && (nMaxBytes <= 0 || s_nImageCacheBytes + nNewBytes <= nMaxBytes))
+		{
+			s_nImageCacheBytes += nNewBytes;
+			return;
+		}
+
+		std::time_t nNow = std::time(NULL);
+		std::vector<std::pair<std::time_t, std::pair<int64, fs::path> > > files;
+		int64 nTotalBytes = 0;
+		for (fs::directory_iterator it(filePath.parent_path(), ec), itEnd; !ec && it != itEnd; it.increment(ec))
+		{
+			const fs::path& path = it->path();
+			boost::system::error_code ec_;
+			if (!fs::is_regular_file(path, ec_))
+				continue;
+			std::time_t nTime = fs::last_write_time(path, ec_);
+			int64 nSize = (int64)fs::file_size(path, ec_);
+			if (ec_)
+				continue;
+			if (path.extension() == ".tmp")
+			{
+				// left by a process that exited while saving.
+				if ((nNow - nTime) > 3600)
+					fs::remove(path, ec_);
+				continue;
+			}
+			nTotalBytes += nSize;
+			files.push_back(std::make_pair(nTime, std::make_pair(nSize, path)));
+		}
+		if (nMaxBytes > 0 && nTotalBytes > nMaxBytes)
+		{
+			std::sort(files.begin(), files.end());
+			int64 nTargetBytes = nMaxBytes / 100 * IMAGE_CACHE_TRIM_PERCENT;
+			int nCount = 0;
+			for (size_t i = 0; i < files.size() && nTotalBytes > nTargetBytes; ++i)
+			{
+				boost::system::error_code ec_;
+				if (fs::remove(files[i].second.second, ec_))
+				{
+					nTotalBytes -= files[i].second.first;
+					++nCount;
+				}
+			}
+			OUTPUT_LOG("image cache is over %lld bytes, %d least recently used files are removed\n", (long long)nMaxBytes, nCount);
+		}
+		s_nImageCacheBytes = nTotalBytes;
+	}
+}
+
+ImageEntity* TextureEntity::DecodeImage(const char* buffer, DWORD nFileSize)
+{
+#ifdef USE_OPENGL_RENDERER
+	if (buffer == 0 || nFileSize == 0)
+		return NULL;
+	ImageEntity* pImage = new ImageEntity();
+	std::string sCacheFileName;
+	uint64 nHash = 0;
+	if (nFileSize >= IMAGE_CACHE_MIN_FILE_SIZE && !g_sImageCacheDir.empty())
+	{
+		// FNV-1a of the file content, so that renamed or duplicated files share the same cache file.
+		nHash = 14695981039346656037ULL;
+		for (DWORD i = 0; i < nFileSize; ++i)
+		{
+			nHash ^= (unsigned char)buffer[i];
+			nHash *= 1099511628211ULL;
+		}
+		char sName[32];
+		snprintf(sName, sizeof(sName), "%016llx_%u.img", (unsigned long long)nHash, (unsigned int)nFileSize);
+		sCacheFileName = CParaFile::GetWritablePath() + g_sImageCacheDir + sName;
+		if (pImage->LoadDecodedFromFile(sCacheFileName, nHash))
+		{
+			TouchImageCacheFile(sCacheFileName);
+			return pImage;
+		}
+	}
+	if (!pImage->DecodeFromMemory((const unsigned char*)buffer, nFileSize))
+	{
+		SAFE_DELETE(pImage);
+		return NULL;
+	}
+	if (!sCacheFileName.empty() && pImage->SaveDecodedToFile(sCacheFileName, nHash))
+		TrimImageCache(sCacheFileName);
+	return pImage;
+#else
+	// D3DX decodes image files while creating the texture on the device.
+	return NULL;
+#endif
+}
+
 bool TextureEntity::LoadFromImage(ImageEntity * image, D3DFORMAT dwTextureFormat /*= D3DFMT_UNKNOWN*/, UINT nMipLevels, void** ppTexture)
 {
 	if (image)
@@ -164,6 +289,14 @@ bool TextureEntity::IsPending()
 		(GetTexture() == 0 && (GetState() != AssetEntity::ASSET_STATE_FAILED_TO_LOAD) && !(GetKey().empty()));
 }
 
+bool TextureEntity::IsEvictable()
+{
+	if ((SurfaceType != StaticTexture && SurfaceType != TextureSequence && SurfaceType != BlpTexture) || m_pRawData != 0)
+		return false;
+	const std::string& sFileName = GetLocalFileName();
+	return !sFileName.empty() && CParaFile::DoesAssetFileExist(sFileName.c_str());
+}
+
 void TextureEntity::SetTextureFPS(float FPS)
 {
 	if(SurfaceType==TextureSequence)
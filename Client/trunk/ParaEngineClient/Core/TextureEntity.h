@@ -45,6 +45,12 @@ namespace ParaEngine
 		* disabling this will reduce memory usage by 6 times, but the rendered image will not be as sharp. since DXT5 or DXT3 compression is used instead. */
 		static bool g_bEnable32bitsTexture;
 
+		/** directory relative to the writable path, where decoded images are cached by the hash of the image file content.
+		* Empty to disable the cache. default to "temp/image_cache/" */
+		static std::string g_sImageCacheDir;
+		/** max bytes of all files in g_sImageCacheDir. When it is exceeded, least recently used files are removed. 0 for no limit. default to 256MB */
+		static int64 g_nImageCacheMaxBytes;
+
 		/* get image format by filename 
 		* @return : -1 unknown, 24 dds, 13 png, 2 jpg, 17 tga
 		*/
@@ -174,6 +180,13 @@ namespace ParaEngine
 		*/
 		virtual bool LoadFromImage(ImageEntity * image, D3DFORMAT dwTextureFormat = D3DFMT_UNKNOWN, UINT nMipLevels = 0, void** ppTexture = NULL);
 
+		/** decode an image file in memory, so that only the upload is left to LoadFromImage() on the render thread.
+		* It is called by the processing threads of the async loader. Larger images are loaded from or saved to g_sImageCacheDir.
+		* @return NULL if the file can not be decoded on this platform, in which case LoadFromMemory() should be used instead.
+		* The caller should delete the returned image.
+		*/
+		static ImageEntity* DecodeImage(const char* buffer, DWORD nFileSize);
+
 
 		/** this function is mostly used internally.
 		* this function will return immediately. It will append the texture request to AsyncLoaders's IO queue.
@@ -214,6 +227,9 @@ namespace ParaEngine
 		/** whether the asset is being loaded. */
 		bool IsPending();
 
+		/** only static textures, blp textures and texture sequences that are loaded from an existing file can be unloaded to free memory. */
+		virtual bool IsEvictable();
+
 		/** set raw texture data from which to load the texture. data ownership is transfered to this entity. the caller should never delete the data. instead
 		this entity will delete the data. */
 		void SetRawData(char* pData, int nSize);
@@ -161,6 +161,61 @@ bool TextureEntityDirectX::IsLoaded()
 	return GetTexture()!=0;
 }
 
+size_t TextureEntityDirectX::GetMemoryUsage()
+{
+	if (!m_bIsInitialized)
+		return 0;
+	LPDIRECT3DTEXTURE9 pTexture = NULL;
+	int nCount = 1;
+	switch (SurfaceType)
+	{
+	case TextureEntityDirectX::StaticTexture:
+	case TextureEntityDirectX::BlpTexture:
+	case TextureEntityDirectX::RenderTarget:
+		pTexture = m_pTexture;
+		break;
+	case TextureEntityDirectX::TextureSequence:
+		if (m_pTextureSequence != 0 && m_pAnimatedTextureInfo != 0)
+		{
+			pTexture = m_pTextureSequence[0];
+			nCount = m_pAnimatedTextureInfo->m_nFrameCount;
+		}
+		break;
+	default:
+		break;
+	}
+	D3DSURFACE_DESC desc;
+	if (pTexture == 0 || FAILED(pTexture->GetLevelDesc(0, &desc)))
+		return 0;
+	int nBitsPerPixel;
+	switch (desc.Format)
+	{
+	case D3DFMT_DXT1:
+		nBitsPerPixel = 4;
+		break;
+	case D3DFMT_DXT2:
+	case D3DFMT_DXT3:
+	case D3DFMT_DXT4:
+	case D3DFMT_DXT5:
+	case D3DFMT_A8:
+	case D3DFMT_L8:
+		nBitsPerPixel = 8;
+		break;
+	case D3DFMT_R5G6B5:
+	case D3DFMT_A1R5G5B5:
+	case D3DFMT_A4R4G4B4:
+		nBitsPerPixel = 16;
+		break;
+	default:
+		nBitsPerPixel = 32;
+		break;
+	}
+	size_t nBytes = (size_t)desc.Width * desc.Height * nBitsPerPixel / 8;
+	if (pTexture->GetLevelCount() > 1)
+		nBytes = nBytes * 4 / 3;
+	return nBytes * nCount;
+}
+
 const TextureEntityDirectX::TextureInfo* TextureEntityDirectX::GetTextureInfo()
 {
 	/** lazy get. Since not all texture users want to get the texture info,
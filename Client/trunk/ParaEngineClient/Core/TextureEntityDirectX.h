@@ -58,6 +58,9 @@ namespace ParaEngine
 		*/
 		virtual const TextureInfo* GetTextureInfo();
 
+		/** size of the top level surface, plus one third if there are mip levels. */
+		virtual size_t GetMemoryUsage();
+
 		/** Get the texture for rendering */
 		virtual DeviceTexturePtr_type GetTexture();
 
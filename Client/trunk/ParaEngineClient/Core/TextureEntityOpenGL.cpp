@@ -338,6 +338,27 @@ int32 ParaEngine::TextureEntityOpenGL::GetHeight()
 	return -1;
 }
 
+size_t ParaEngine::TextureEntityOpenGL::GetMemoryUsage()
+{
+	if (!m_bIsInitialized)
+		return 0;
+	GLWrapper::Texture2D* pTexture = NULL;
+	int nCount = 1;
+	if (SurfaceType == TextureSequence)
+	{
+		if (m_pTextureSequence && m_pAnimatedTextureInfo)
+		{
+			pTexture = m_pTextureSequence[0];
+			nCount = m_pAnimatedTextureInfo->m_nFrameCount;
+		}
+	}
+	else
+		pTexture = m_texture;
+	if (!pTexture)
+		return 0;
+	return (size_t)pTexture->getPixelsWide() * pTexture->getPixelsHigh() * 16 / 3 * nCount;
+}
+
 const TextureEntityOpenGL::TextureInfo* ParaEngine::TextureEntityOpenGL::GetTextureInfo()
 {
 	if (SurfaceType == StaticTexture)
@@ -522,7 +543,13 @@ bool ParaEngine::TextureEntityOpenGL::LoadFromImage(ImageEntity * imageEntity, D
 		GLWrapper::Image image;
 		bool bRet = false;
 		if (imageEntity->getRenderFormat() == D3DFMT_A8R8G8B8)
-			bRet = image.initWithRawData((const unsigned char*)buffer, nFileSize, imageEntity->getWidth(), imageEntity->getHeight(), imageEntity->hasPremultipliedAlpha());
+			bRet = image.initWithRawData((const unsigned char*)buffer, nFileSize, imageEntity->getWidth(), imageEntity->getHeight(), 8, imageEntity->hasPremultipliedAlpha());
+		else if (imageEntity->getRenderFormat() == D3DFMT_R8G8B8)
+			bRet = image.initWithRawData((const unsigned char*)buffer, nFileSize, imageEntity->getWidth(), imageEntity->getHeight(), 8, false, GLWrapper::Texture2D::PixelFormat::RGB888);
+		else if (imageEntity->getRenderFormat() == D3DFMT_A8L8)
+			bRet = image.initWithRawData((const unsigned char*)buffer, nFileSize, imageEntity->getWidth(), imageEntity->getHeight(), 8, imageEntity->hasPremultipliedAlpha(), GLWrapper::Texture2D::PixelFormat::AI88);
+		else if (imageEntity->getRenderFormat() == D3DFMT_L8)
+			bRet = image.initWithRawData((const unsigned char*)buffer, nFileSize, imageEntity->getWidth(), imageEntity->getHeight(), 8, false, GLWrapper::Texture2D::PixelFormat::I8);
 		else
 			bRet = image.initWithImageData((const unsigned char*)buffer, nFileSize);
 		
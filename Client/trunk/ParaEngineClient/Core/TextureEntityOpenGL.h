@@ -41,6 +41,9 @@ namespace ParaEngine
 
 		virtual int32 GetWidth();
 		virtual int32 GetHeight();
+
+		/** estimated as 4 bytes per pixel, plus one third for mip levels. */
+		virtual size_t GetMemoryUsage();
 		
 		/**
 		* save any texture to a different texture file format and save with full mipmapping to disk.
@@ -0,0 +1,259 @@
+//-----------------------------------------------------------------------------
+// Class:	CTickScheduler
+// Company: ParaEngine
+// Desc: fixed rate tick scheduler with absolute deadlines and bounded catch up.
+//-----------------------------------------------------------------------------
+#include "ParaEngine.h"
+#include "TickScheduler.h"
+#include <boost/chrono.hpp>
+
+using namespace ParaEngine;
+
+/** ticks per second of the old service loop */
+#define DEFAULT_TICK_RATE		10.f
+#define DEFAULT_MAX_CATCHUP_TICKS	5
+
+ParaEngine::CTickScheduler::CTickScheduler()
+	: m_fTickRate(DEFAULT_TICK_RATE), m_nPeriodUS((int64)(1000000 / DEFAULT_TICK_RATE)), m_nMaxCatchUpTicks(DEFAULT_MAX_CATCHUP_TICKS), m_bFixedTimeStep(false),
+	m_nStartTime(0), m_nNextDeadline(0), m_nTickStartTime(0), m_fSimTime(0), m_bTickPending(false), m_nOwedTicks(0)
+{
+	ResetStats();
+}
+
+ParaEngine::CTickScheduler::~CTickScheduler()
+{
+}
+
+CTickScheduler& ParaEngine::CTickScheduler::GetSingleton()
+{
+	static CTickScheduler g_instance;
+	return g_instance;
+}
+
+int64 ParaEngine::CTickScheduler::GetClockUS()
+{
+	return (int64)boost::chrono::duration_cast<boost::chrono::microseconds>(boost::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+float ParaEngine::CTickScheduler::GetTickRate()
+{
+	return m_fTickRate;
+}
+
+void ParaEngine::CTickScheduler::SetTickRate(float fTicksPerSecond)
+{
+	ParaEngine::Lock lock_(m_mutex);
+	m_fTickRate = (std::min)((std::max)(fTicksPerSecond, 1.f), 1000.f);
+	m_nPeriodUS = (int64)(1000000 / m_fTickRate);
+}
+
+int ParaEngine::CTickScheduler::GetMaxCatchUpTicks()
+{
+	return m_nMaxCatchUpTicks;
+}
+
+void ParaEngine::CTickScheduler::SetMaxCatchUpTicks(int nCount)
+{
+	ParaEngine::Lock lock_(m_mutex);
+	m_nMaxCatchUpTicks = (std::max)(nCount, 0);
+	if (m_nOwedTicks > m_nMaxCatchUpTicks)
+	{
+		m_nDroppedTicks += m_nOwedTicks - m_nMaxCatchUpTicks;
+		m_nOwedTicks = m_nMaxCatchUpTicks;
+	}
+}
+
+bool ParaEngine::CTickScheduler::IsFixedTimeStep()
+{
+	return m_bFixedTimeStep;
+}
+
+void ParaEngine::CTickScheduler::SetFixedTimeStep(bool bFixed)
+{
+	ParaEngine::Lock lock_(m_mutex);
+	m_bFixedTimeStep = bFixed;
+}
+
+void ParaEngine::CTickScheduler::Start(int64 nDelayUS)
+{
+	ParaEngine::Lock lock_(m_mutex);
+	m_nStartTime = GetClockUS() + nDelayUS;
+	m_nNextDeadline = m_nStartTime;
+	m_fSimTime = 0;
+	m_bTickPending = false;
+	m_nOwedTicks = 0;
+	m_nStatsStartTime = m_nStartTime;
+}
+
+int64 ParaEngine::CTickScheduler::GetNextDeadline()
+{
+	ParaEngine::Lock lock_(m_mutex);
+	return m_nNextDeadline;
+}
+
+bool ParaEngine::CTickScheduler::OnTimer()
+{
+	int64 nCurTime = GetClockUS();
+	ParaEngine::Lock lock_(m_mutex);
+	int64 nLate = (std::max)(nCurTime - m_nNextDeadline, (int64)0);
+	if (nLate < m_nPeriodUS)
+	{
+		++m_nJitterCount;
+		m_nTotalJitterUS += nLate;
+		m_nMaxJitterUS = (std::max)(m_nMaxJitterUS, nLate);
+	}
+
+	bool bRunTick = !m_bTickPending;
+	if (bRunTick)
+		m_bTickPending = true;
+	else if (m_nOwedTicks < m_nMaxCatchUpTicks)
+		++m_nOwedTicks;
+	else
+		++m_nDroppedTicks;
+
+	// the next deadline is always relative to the start, so that the delay of this timer does not accumulate.
+	m_nNextDeadline += m_nPeriodUS;
+	if (nCurTime >= m_nNextDeadline)
+	{
+		int64 nOverdueTicks = (nCurTime - m_nNextDeadline) / m_nPeriodUS + 1;
+		if (nOverdueTicks > m_nMaxCatchUpTicks)
+		{
+			int64 nSkipTicks = nOverdueTicks - m_nMaxCatchUpTicks;
+			m_nNextDeadline += nSkipTicks * m_nPeriodUS;
+			m_nDroppedTicks += nSkipTicks;
+		}
+	}
+	return bRunTick;
+}
+
+double ParaEngine::CTickScheduler::BeginTick()
+{
+	int64 nCurTime = GetClockUS();
+	ParaEngine::Lock lock_(m_mutex);
+	m_nTickStartTime = nCurTime;
+	if (m_bFixedTimeStep)
+		m_fSimTime += m_nPeriodUS / 1000000.0;
+	else
+		m_fSimTime = (std::max)((nCurTime - m_nStartTime) / 1000000.0, m_fSimTime);
+	return m_fSimTime;
+}
+
+bool ParaEngine::CTickScheduler::EndTick()
+{
+	int64 nCurTime = GetClockUS();
+	ParaEngine::Lock lock_(m_mutex);
+	int64 nDuration = nCurTime - m_nTickStartTime;
+	++m_nTickCount;
+	m_nLastTickDurationUS = nDuration;
+	m_nTotalTickDurationUS += nDuration;
+	m_nMaxTickDurationUS = (std::max)(m_nMaxTickDurationUS, nDuration);
+	if (nDuration > m_nPeriodUS)
+		++m_nOverrunCount;
+	if (m_nOwedTicks > 0)
+	{
+		// the tick stays pending, since the caller runs the owed tick right away.
+		--m_nOwedTicks;
+		return true;
+	}
+	m_bTickPending = false;
+	return false;
+}
+
+void ParaEngine::CTickScheduler::CancelTick()
+{
+	ParaEngine::Lock lock_(m_mutex);
+	m_bTickPending = false;
+	m_nDroppedTicks += 1 + m_nOwedTicks;
+	m_nOwedTicks = 0;
+}
+
+double ParaEngine::CTickScheduler::GetSimulationTime()
+{
+	ParaEngine::Lock lock_(m_mutex);
+	return m_fSimTime;
+}
+
+int64 ParaEngine::CTickScheduler::GetTickCount()
+{
+	return m_nTickCount;
+}
+
+int64 ParaEngine::CTickScheduler::GetDroppedTicks()
+{
+	return m_nDroppedTicks;
+}
+
+int64 ParaEngine::CTickScheduler::GetOverrunCount()
+{
+	return m_nOverrunCount;
+}
+
+float ParaEngine::CTickScheduler::GetLastTickDuration()
+{
+	return m_nLastTickDurationUS / 1000.f;
+}
+
+float ParaEngine::CTickScheduler::GetAvgTickDuration()
+{
+	ParaEngine::Lock lock_(m_mutex);
+	return (m_nTickCount > 0) ? (float)(m_nTotalTickDurationUS / 1000.0 / m_nTickCount) : 0.f;
+}
+
+float ParaEngine::CTickScheduler::GetMaxTickDuration()
+{
+	return m_nMaxTickDurationUS / 1000.f;
+}
+
+float ParaEngine::CTickScheduler::GetAvgJitter()
+{
+	ParaEngine::Lock lock_(m_mutex);
+	return (m_nJitterCount > 0) ? (float)(m_nTotalJitterUS / 1000.0 / m_nJitterCount) : 0.f;
+}
+
+float ParaEngine::CTickScheduler::GetMaxJitter()
+{
+	return m_nMaxJitterUS / 1000.f;
+}
+
+float ParaEngine::CTickScheduler::GetActualTickRate()
+{
+	int64 nCurTime = GetClockUS();
+	ParaEngine::Lock lock_(m_mutex);
+	return (nCurTime > m_nStatsStartTime) ? (float)(m_nTickCount * 1000000.0 / (nCurTime - m_nStatsStartTime)) : 0.f;
+}
+
+void ParaEngine::CTickScheduler::ResetStats()
+{
+	ParaEngine::Lock lock_(m_mutex);
+	m_nStatsStartTime = GetClockUS();
+	m_nTickCount = 0;
+	m_nDroppedTicks = 0;
+	m_nOverrunCount = 0;
+	m_nLastTickDurationUS = 0;
+	m_nMaxTickDurationUS = 0;
+	m_nTotalTickDurationUS = 0;
+	m_nJitterCount = 0;
+	m_nMaxJitterUS = 0;
+	m_nTotalJitterUS = 0;
+}
+
+int ParaEngine::CTickScheduler::InstallFields(CAttributeClass* pClass, bool bOverride)
+{
+	IAttributeFields::InstallFields(pClass, bOverride);
+	pClass->AddField("TickRate", FieldType_Float, (void*)SetTickRate_s, (void*)GetTickRate_s, NULL, "ticks per second", bOverride);
+	pClass->AddField("MaxCatchUpTicks", FieldType_Int, (void*)SetMaxCatchUpTicks_s, (void*)GetMaxCatchUpTicks_s, NULL, "", bOverride);
+	pClass->AddField("FixedTimeStep", FieldType_Bool, (void*)SetFixedTimeStep_s, (void*)IsFixedTimeStep_s, NULL, "", bOverride);
+
+	pClass->AddField("TickCount", FieldType_Int, (void*)0, (void*)GetTickCount_s, NULL, "", bOverride);
+	pClass->AddField("DroppedTicks", FieldType_Int, (void*)0, (void*)GetDroppedTicks_s, NULL, "", bOverride);
+	pClass->AddField("OverrunCount", FieldType_Int, (void*)0, (void*)GetOverrunCount_s, NULL, "", bOverride);
+	pClass->AddField("LastTickDuration", FieldType_Float, (void*)0, (void*)GetLastTickDuration_s, NULL, "milliseconds", bOverride);
+	pClass->AddField("AvgTickDuration", FieldType_Float, (void*)0, (void*)GetAvgTickDuration_s, NULL, "milliseconds", bOverride);
+	pClass->AddField("MaxTickDuration", FieldType_Float, (void*)0, (void*)GetMaxTickDuration_s, NULL, "milliseconds", bOverride);
+	pClass->AddField("AvgJitter", FieldType_Float, (void*)0, (void*)GetAvgJitter_s, NULL, "milliseconds", bOverride);
+	pClass->AddField("MaxJitter", FieldType_Float, (void*)0, (void*)GetMaxJitter_s, NULL, "milliseconds", bOverride);
+	pClass->AddField("ActualTickRate", FieldType_Float, (void*)0, (void*)GetActualTickRate_s, NULL, "ticks per second", bOverride);
+	pClass->AddField("SimulationTime", FieldType_Double, (void*)0, (void*)GetSimulationTime_s, NULL, "seconds", bOverride);
+	pClass->AddField("ResetStats", FieldType_void, (void*)ResetStats_s, (void*)0, NULL, "", bOverride);
+	return S_OK;
+}
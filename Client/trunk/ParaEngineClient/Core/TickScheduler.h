@@ -0,0 +1,138 @@
+#pragma once
+#include "IAttributeFields.h"
+
+namespace ParaEngine
+{
+	/**
+	* fixed rate tick scheduler of the headless service loop (CParaEngineService).
+	*
+	* Ticks are scheduled at absolute deadlines (start + n * period) of the steady clock, so that the tick rate does not drift
+	* when the work of a tick takes time. If the loop falls behind, the overdue ticks are run back to back, but at most
+	* MaxCatchUpTicks of them; the rest are dropped and counted. If the previous tick is still running when a deadline is reached,
+	* the tick is owed and run right after it, also at most MaxCatchUpTicks of them.
+	* The simulation time passed to FrameMove is either the measured wall time since start, or n * period if FixedTimeStep is true.
+	*
+	* The timer calls OnTimer() in the service thread, and the tick itself calls BeginTick() and EndTick() in the NPL main thread,
+	* in a loop while EndTick() returns true.
+	* [thread safe]
+	*/
+	class CTickScheduler : public IAttributeFields
+	{
+	public:
+		CTickScheduler();
+		virtual ~CTickScheduler();
+
+		static CTickScheduler& GetSingleton();
+
+		ATTRIBUTE_DEFINE_CLASS(CTickScheduler);
+
+		/** this class should be implemented if one wants to add new attribute. This function is always called internally.*/
+		virtual int InstallFields(CAttributeClass* pClass, bool bOverride);
+
+		ATTRIBUTE_METHOD1(CTickScheduler, GetTickRate_s, float*) { *p1 = cls->GetTickRate(); return S_OK; }
+		ATTRIBUTE_METHOD1(CTickScheduler, SetTickRate_s, float) { cls->SetTickRate(p1); return S_OK; }
+		ATTRIBUTE_METHOD1(CTickScheduler, GetMaxCatchUpTicks_s, int*) { *p1 = cls->GetMaxCatchUpTicks(); return S_OK; }
+		ATTRIBUTE_METHOD1(CTickScheduler, SetMaxCatchUpTicks_s, int) { cls->SetMaxCatchUpTicks(p1); return S_OK; }
+		ATTRIBUTE_METHOD1(CTickScheduler, IsFixedTimeStep_s, bool*) { *p1 = cls->IsFixedTimeStep(); return S_OK; }
+		ATTRIBUTE_METHOD1(CTickScheduler, SetFixedTimeStep_s, bool) { cls->SetFixedTimeStep(p1); return S_OK; }
+
+		ATTRIBUTE_METHOD1(CTickScheduler, GetTickCount_s, int*) { *p1 = (int)cls->GetTickCount(); return S_OK; }
+		ATTRIBUTE_METHOD1(CTickScheduler, GetDroppedTicks_s, int*) { *p1 = (int)cls->GetDroppedTicks(); return S_OK; }
+		ATTRIBUTE_METHOD1(CTickScheduler, GetOverrunCount_s, int*) { *p1 = (int)cls->GetOverrunCount(); return S_OK; }
+		ATTRIBUTE_METHOD1(CTickScheduler, GetLastTickDuration_s, float*) { *p1 = cls->GetLastTickDuration(); return S_OK; }
+		ATTRIBUTE_METHOD1(CTickScheduler, GetAvgTickDuration_s, float*) { *p1 = cls->GetAvgTickDuration(); return S_OK; }
+		ATTRIBUTE_METHOD1(CTickScheduler, GetMaxTickDuration_s, float*) { *p1 = cls->GetMaxTickDuration(); return S_OK; }
+		ATTRIBUTE_METHOD1(CTickScheduler, GetAvgJitter_s, float*) { *p1 = cls->GetAvgJitter(); return S_OK; }
+		ATTRIBUTE_METHOD1(CTickScheduler, GetMaxJitter_s, float*) { *p1 = cls->GetMaxJitter(); return S_OK; }
+		ATTRIBUTE_METHOD1(CTickScheduler, GetActualTickRate_s, float*) { *p1 = cls->GetActualTickRate(); return S_OK; }
+		ATTRIBUTE_METHOD1(CTickScheduler, GetSimulationTime_s, double*) { *p1 = cls->GetSimulationTime(); return S_OK; }
+		ATTRIBUTE_METHOD(CTickScheduler, ResetStats_s) { cls->ResetStats(); return S_OK; }
+
+	public:
+		/** microseconds of the steady clock, which is also the clock of the service timer. */
+		static int64 GetClockUS();
+
+		/** ticks per second. default to 10, which is the rate of the old service loop. */
+		float GetTickRate();
+		/** it takes effect from the next deadline. the value is clamped to [1, 1000]. */
+		void SetTickRate(float fTicksPerSecond);
+
+		/** max number of overdue or owed ticks to run back to back when the loop falls behind. default to 5. 0 to never catch up. */
+		int GetMaxCatchUpTicks();
+		void SetMaxCatchUpTicks(int nCount);
+
+		/** if true, simulation time advances exactly one period per tick, which makes the simulation deterministic.
+		* Otherwise it is the measured wall time since start. default to false. */
+		bool IsFixedTimeStep();
+		void SetFixedTimeStep(bool bFixed);
+
+		/** start ticking. the first deadline is nDelayUS from now. */
+		void Start(int64 nDelayUS = 0);
+
+		/** called when the timer reaches GetNextDeadline(). It schedules the next deadline.
+		* @return true if a tick should be run, in which case BeginTick() and EndTick(), or CancelTick() must follow.
+		*/
+		bool OnTimer();
+
+		/** absolute deadline of the next timer in GetClockUS() */
+		int64 GetNextDeadline();
+
+		/** called before the work of a tick.
+		* @return simulation time in seconds since start, which is passed to FrameMove().
+		*/
+		double BeginTick();
+		/** called after the work of a tick.
+		* @return true if a tick was owed while this one was running, in which case BeginTick() and EndTick() should be called again right away.
+		*/
+		bool EndTick();
+		/** called instead of BeginTick() and EndTick() if the tick is not run after OnTimer() returns true. owed ticks are dropped as well. */
+		void CancelTick();
+
+		/** simulation time of the last tick in seconds */
+		double GetSimulationTime();
+
+		/** number of ticks run since start or ResetStats() */
+		int64 GetTickCount();
+		/** number of deadlines skipped because the loop was too far behind, or because MaxCatchUpTicks ticks were already owed */
+		int64 GetDroppedTicks();
+		/** number of ticks that took longer than one period */
+		int64 GetOverrunCount();
+		/** duration of the work of a tick in milliseconds */
+		float GetLastTickDuration();
+		float GetAvgTickDuration();
+		float GetMaxTickDuration();
+		/** how late the timer fired after the deadline in milliseconds. catch up ticks are not counted. */
+		float GetAvgJitter();
+		float GetMaxJitter();
+		/** ticks per second measured since start or ResetStats() */
+		float GetActualTickRate();
+
+		void ResetStats();
+	protected:
+		ParaEngine::mutex m_mutex;
+
+		float m_fTickRate;
+		int64 m_nPeriodUS;
+		int m_nMaxCatchUpTicks;
+		bool m_bFixedTimeStep;
+
+		int64 m_nStartTime;
+		int64 m_nNextDeadline;
+		int64 m_nTickStartTime;
+		double m_fSimTime;
+		bool m_bTickPending;
+		/** number of deadlines reached while a tick was pending, which are run right after it. */
+		int m_nOwedTicks;
+
+		int64 m_nStatsStartTime;
+		int64 m_nTickCount;
+		int64 m_nDroppedTicks;
+		int64 m_nOverrunCount;
+		int64 m_nLastTickDurationUS;
+		int64 m_nMaxTickDurationUS;
+		int64 m_nTotalTickDurationUS;
+		int64 m_nJitterCount;
+		int64 m_nMaxJitterUS;
+		int64 m_nTotalJitterUS;
+	};
+}
@@ -0,0 +1,521 @@
+#pragma once
+// Desc: a shared memory ring with variable length records, which has the same interface as boost::interprocess::message_queue,
+// so that it can be used as the MessageQueueType of CInterprocessQueueT.
+// Unlike message_queue, a record only takes as many bytes as the message, and sending or receiving does not enter the kernel
+// unless the other side is sleeping. On linux, sleeping and waking up is done with a shared futex word; on windows, with a named auto-reset event.
+#include <boost/interprocess/creation_tags.hpp>
+#include <boost/interprocess/exceptions.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+#ifdef WIN32
+#include <boost/interprocess/windows_shared_memory.hpp>
+#else
+#include <boost/interprocess/shared_memory_object.hpp>
+#endif
+#include <boost/shared_ptr.hpp>
+#include <stdint.h>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <string>
+#include <cstring>
+#include <climits>
+#include <algorithm>
+
+#if defined(__linux__)
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <time.h>
+#endif
+#ifndef WIN32
+#include <unistd.h>
+#include <signal.h>
+#include <errno.h>
+#endif
+
+namespace ParaEngine{  namespace interprocess{
+
+	namespace detail{
+		/** placed at the beginning of the shared memory. all positions are monotonically increasing byte offsets. */
+		struct shm_ring_header
+		{
+			/** set last by the creator, so that openers never see a half initialized ring. */
+			std::atomic<uint32_t> magic;
+			uint32_t capacity;
+			uint32_t max_msg_size;
+			uint32_t max_num_msg;
+			/** committed write position, only modified by the producer holding producer_lock. */
+			std::atomic<uint32_t> head;
+			/** read position, only modified by the consumer. */
+			std::atomic<uint32_t> tail;
+			/** serializes multiple producers. it is 0 or the process id of the owner, so that a lock held by a dead process can be taken over. */
+			std::atomic<uint32_t> producer_lock;
+			/** futex words, which are increased whenever data is written or space is freed. */
+			std::atomic<uint32_t> data_seq;
+			std::atomic<uint32_t> space_seq;
+			/** number of threads sleeping on each futex word, so that we only wake up when someone is sleeping. */
+			std::atomic<uint32_t> reader_waiting;
+			std::atomic<uint32_t> writer_waiting;
+		};
+
+		/** each record is [uint32 length][uint32 priority][bytes] */
+		struct shm_ring_record_hdr
+		{
+			uint32_t len;
+			uint32_t priority;
+		};
+
+		/** sleep and wake up on a futex word in shared memory. */
+		class shm_ring_waiter
+		{
+		public:
+			shm_ring_waiter() :m_hEvent(NULL){};
+			~shm_ring_waiter()
+			{
+#ifdef WIN32
+				if (m_hEvent)
+					::CloseHandle((HANDLE)m_hEvent);
+#endif
+			}
+			/** @param name: globally unique name of the event, only used on platforms without futex. */
+			void open(const std::string& name)
+			{
+#ifdef WIN32
+				m_hEvent = (void*)::CreateEventA(NULL, FALSE, FALSE, name.c_str());
+#endif
+			}
+
+			/** sleep until the word is no longer expected, or timeout, or spurious wake up. */
+			void wait(std::atomic<uint32_t>* pWord, uint32_t expected, int nTimeoutMS)
+			{
+#if defined(__linux__)
+				struct timespec ts;
+				ts.tv_sec = nTimeoutMS / 1000;
+				ts.tv_nsec = (nTimeoutMS % 1000) * 1000000;
+				// not FUTEX_PRIVATE_FLAG, since the word is shared by processes.
+				syscall(SYS_futex, (uint32_t*)pWord, FUTEX_WAIT, expected, &ts, NULL, 0);
+#elif defined(WIN32)
+				if (m_hEvent && pWord->load() == expected)
+					::WaitForSingleObject((HANDLE)m_hEvent, nTimeoutMS);
+#else
+				if (pWord->load() == expected)
+					std::this_thread::sleep_for(std::chrono::milliseconds(1));
+#endif
+			}
+
+			void wake(std::atomic<uint32_t>* pWord)
+			{
+#if defined(__linux__)
+				syscall(SYS_futex, (uint32_t*)pWord, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+#elif defined(WIN32)
+				if (m_hEvent)
+					::SetEvent((HANDLE)m_hEvent);
+#endif
+			}
+		private:
+			void* m_hEvent;
+		};
+	}
+
+	/**
+	* a process shared byte ring with variable length records. There can be many producers but only one consumer.
+	* Messages are received in the order they are sent, the priority is kept with the message but does not change the order.
+	* The ring capacity is max_num_msg * (max_msg_size + 8) rounded up to power of 2, and get_num_msg() returns the number of
+	* max_msg_size slots in use, so that the free space check in CInterprocessQueueT::try_send remains valid.
+	* A message larger than max_msg_size is sent with send_message() as consecutive records, which never interleave with
+	* records of other producers.
+	*/
+	class shm_ring_queue
+	{
+	public:
+		enum {
+			ring_magic = 0x474E4952, // "RING"
+			/** wake up at least this often when blocking, in case the other process dies while we sleep. */
+			max_wait_interval = 100,
+			/** milliseconds to wait for the producer lock held by a live process before giving up with an exception. */
+			max_lock_wait = 10000,
+		};
+
+		shm_ring_queue(boost::interprocess::create_only_t, const char *name, std::size_t max_num_msg, std::size_t max_msg_size)
+			: m_pHeader(NULL), m_pData(NULL)
+		{
+			create(name, max_num_msg, max_msg_size);
+		}
+
+		shm_ring_queue(boost::interprocess::open_or_create_t, const char *name, std::size_t max_num_msg, std::size_t max_msg_size)
+			: m_pHeader(NULL), m_pData(NULL)
+		{
+			try
+			{
+				open(name);
+			}
+			catch (...)
+			{
+				create(name, max_num_msg, max_msg_size);
+			}
+		}
+
+		shm_ring_queue(boost::interprocess::open_only_t, const char *name)
+			: m_pHeader(NULL), m_pData(NULL)
+		{
+			open(name);
+		}
+
+		/** blocks if the ring is full. */
+		void send(const void *buffer, std::size_t buffer_size, unsigned int priority)
+		{
+			check_size(buffer_size);
+			while (!try_send(buffer, buffer_size, priority))
+				wait_for_space(get_record_size(buffer_size));
+		}
+
+		/** send a message of any size as records of at most max_msg_size bytes. blocks if the ring is full.
+		* All records of the message are written while holding the producer lock, so that they are received back to back
+		* even if there are many producers. If the message fits in the ring, we wait for enough space before taking the lock,
+		* and commit all records at once, so that a producer dying in the middle never leaves part of a message in the ring.
+		* A message larger than the whole ring has to be committed record by record while holding the lock.
+		*/
+		void send_message(const void *buffer, std::size_t buffer_size, unsigned int priority)
+		{
+			detail::shm_ring_header& hdr = *m_pHeader;
+			uint32_t nMaxSize = hdr.max_msg_size;
+			uint64_t nNumRecords = (buffer_size + nMaxSize - 1) / nMaxSize;
+			uint64_t nTotalSize = (uint64_t)buffer_size + nNumRecords * sizeof(detail::shm_ring_record_hdr);
+			bool bFitsRing = nTotalSize <= hdr.capacity;
+			while (true)
+			{
+				if (bFitsRing)
+					wait_for_space((uint32_t)nTotalSize);
+				lock_producer();
+				if (!bFitsRing || has_free_bytes((uint32_t)nTotalSize))
+					break;
+				// another producer took the space before us.
+				unlock_producer();
+			}
+
+			const char* pData = (const char*)buffer;
+			std::size_t nLeft = buffer_size;
+			uint32_t nHead = hdr.head.load(std::memory_order_relaxed);
+			while (nLeft > 0)
+			{
+				uint32_t nSize = (uint32_t)(std::min)(nLeft, (std::size_t)nMaxSize);
+				if (!bFitsRing)
+				{
+					uint32_t nRecordSize = get_record_size(nSize);
+					while ((hdr.capacity - (nHead - hdr.tail.load(std::memory_order_acquire))) < nRecordSize)
+					{
+						commit(nHead);
+						wait_for_space(nRecordSize);
+					}
+				}
+				nHead = write_record(nHead, pData, nSize, priority);
+				pData += nSize;
+				nLeft -= nSize;
+			}
+			commit(nHead);
+			unlock_producer();
+		}
+
+		/** return false if the ring is full. */
+		bool try_send(const void *buffer, std::size_t buffer_size, unsigned int priority)
+		{
+			check_size(buffer_size);
+			detail::shm_ring_header& hdr = *m_pHeader;
+			lock_producer();
+			uint32_t nHead = hdr.head.load(std::memory_order_relaxed);
+			uint32_t nTail = hdr.tail.load(std::memory_order_acquire);
+			if ((hdr.capacity - (nHead - nTail)) < get_record_size(buffer_size))
+			{
+				unlock_producer();
+				return false;
+			}
+			commit(write_record(nHead, buffer, (uint32_t)buffer_size, priority));
+			unlock_producer();
+			return true;
+		}
+
+		/** blocks if the ring is empty. */
+		void receive(void *buffer, std::size_t buffer_size, std::size_t &recvd_size, unsigned int &priority)
+		{
+			while (!try_receive(buffer, buffer_size, recvd_size, priority))
+			{
+				++(m_pHeader->reader_waiting);
+				uint32_t nSeq = m_pHeader->data_seq.load();
+				if (m_pHeader->head.load() == m_pHeader->tail.load())
+					m_data_waiter.wait(&(m_pHeader->data_seq), nSeq, max_wait_interval);
+				--(m_pHeader->reader_waiting);
+			}
+		}
+
+		/** return false if the ring is empty. only one thread in one process should receive. */
+		bool try_receive(void *buffer, std::size_t buffer_size, std::size_t &recvd_size, unsigned int &priority)
+		{
+			detail::shm_ring_header& hdr = *m_pHeader;
+			uint32_t nTail = hdr.tail.load(std::memory_order_relaxed);
+			uint32_t nHead = hdr.head.load(std::memory_order_acquire);
+			if (nTail == nHead)
+				return false;
+			detail::shm_ring_record_hdr rec;
+			copy_out(nTail, &rec, sizeof(rec));
+			if (rec.len > buffer_size)
+				throw boost::interprocess::interprocess_exception(boost::interprocess::error_info(boost::interprocess::size_error));
+			copy_out(nTail + sizeof(rec), buffer, rec.len);
+			recvd_size = rec.len;
+			priority = rec.priority;
+			hdr.tail.store(nTail + (uint32_t)sizeof(rec) + rec.len, std::memory_order_release);
+
+			hdr.space_seq.fetch_add(1);
+			if (hdr.writer_waiting.load() > 0)
+				m_space_waiter.wake(&(hdr.space_seq));
+			return true;
+		}
+
+		std::size_t get_max_msg() const
+		{
+			return m_pHeader ? (m_pHeader->capacity / get_slot_size()) : 0;
+		}
+
+		std::size_t get_max_msg_size() const
+		{
+			return m_pHeader ? m_pHeader->max_msg_size : 0;
+		}
+
+		/** number of max_msg_size slots that are used. */
+		std::size_t get_num_msg()
+		{
+			if (!m_pHeader)
+				return 0;
+			uint32_t nUsed = m_pHeader->head.load() - m_pHeader->tail.load();
+			uint32_t nSlotSize = get_slot_size();
+			return (nUsed + nSlotSize - 1) / nSlotSize;
+		}
+
+		/** remove the shared memory. on windows, it is removed when the last process closes it. */
+		static bool remove(const char *name)
+		{
+#ifdef WIN32
+			return true;
+#else
+			return boost::interprocess::shared_memory_object::remove(name);
+#endif
+		}
+
+	private:
+		static uint32_t get_ring_capacity(std::size_t max_num_msg, std::size_t max_msg_size)
+		{
+			uint64_t nSize = (uint64_t)max_num_msg * (max_msg_size + sizeof(detail::shm_ring_record_hdr));
+			uint32_t nCapacity = 4096;
+			while (nCapacity < nSize && nCapacity < 0x40000000)
+				nCapacity <<= 1;
+			return nCapacity;
+		}
+
+		static std::size_t get_header_size()
+		{
+			// keep the data on its own cache line
+			return (sizeof(detail::shm_ring_header) + 63) & ~((std::size_t)63);
+		}
+
+		uint32_t get_slot_size() const
+		{
+			return m_pHeader->max_msg_size + (uint32_t)sizeof(detail::shm_ring_record_hdr);
+		}
+
+		void check_size(std::size_t buffer_size)
+		{
+			if (buffer_size > m_pHeader->max_msg_size)
+				throw boost::interprocess::interprocess_exception(boost::interprocess::error_info(boost::interprocess::size_error));
+		}
+
+		static uint32_t get_record_size(std::size_t buffer_size)
+		{
+			return (uint32_t)(buffer_size + sizeof(detail::shm_ring_record_hdr));
+		}
+
+		bool has_free_bytes(uint32_t nBytes)
+		{
+			uint32_t nUsed = m_pHeader->head.load() - m_pHeader->tail.load();
+			return (m_pHeader->capacity - nUsed) >= nBytes;
+		}
+
+		/** sleep until the consumer frees some space, or max_wait_interval passed. */
+		void wait_for_space(uint32_t nBytes)
+		{
+			++(m_pHeader->writer_waiting);
+			uint32_t nSeq = m_pHeader->space_seq.load();
+			if (!has_free_bytes(nBytes))
+				m_space_waiter.wait(&(m_pHeader->space_seq), nSeq, max_wait_interval);
+			--(m_pHeader->writer_waiting);
+		}
+
+		/** write a record at nPos without committing it. 
+		* @return the position after the record. */
+		uint32_t write_record(uint32_t nPos, const void* buffer, uint32_t nSize, unsigned int priority)
+		{
+			detail::shm_ring_record_hdr rec;
+			rec.len = nSize;
+			rec.priority = priority;
+			copy_in(nPos, &rec, sizeof(rec));
+			copy_in(nPos + sizeof(rec), buffer, nSize);
+			return nPos + get_record_size(nSize);
+		}
+
+		/** make records written before nHead visible to the consumer. only called by the producer holding the lock. */
+		void commit(uint32_t nHead)
+		{
+			detail::shm_ring_header& hdr = *m_pHeader;
+			if (hdr.head.load(std::memory_order_relaxed) == nHead)
+				return;
+			hdr.head.store(nHead, std::memory_order_release);
+			hdr.data_seq.fetch_add(1);
+			if (hdr.reader_waiting.load() > 0)
+				m_data_waiter.wake(&(hdr.data_seq));
+		}
+
+		static uint32_t get_current_process_id()
+		{
+#ifdef WIN32
+			return (uint32_t)::GetCurrentProcessId();
+#else
+			return (uint32_t)::getpid();
+#endif
+		}
+
+		static bool is_process_alive(uint32_t nProcessId)
+		{
+#ifdef WIN32
+			HANDLE hProcess = ::OpenProcess(SYNCHRONIZE, FALSE, (DWORD)nProcessId);
+			if (hProcess == NULL)
+				return ::GetLastError() != ERROR_INVALID_PARAMETER;
+			bool bAlive = ::WaitForSingleObject(hProcess, 0) != WAIT_OBJECT_0;
+			::CloseHandle(hProcess);
+			return bAlive;
+#else
+			return ::kill((pid_t)nProcessId, 0) == 0 || errno != ESRCH;
+#endif
+		}
+
+		/** the lock word is the owner process id. If the owner process died while holding it, we take it over, which is safe
+		* because records are only visible after commit(). If a live owner holds it for more than max_lock_wait, it throws. */
+		void lock_producer()
+		{
+			uint32_t nProcessId = get_current_process_id();
+			std::chrono::steady_clock::time_point startTime;
+			for (int i = 0;; ++i)
+			{
+				uint32_t nOwner = 0;
+				if (m_pHeader->producer_lock.compare_exchange_weak(nOwner, nProcessId, std::memory_order_acquire, std::memory_order_relaxed))
+					return;
+				if (i <= 64)
+					continue;
+				if (i == 65)
+					startTime = std::chrono::steady_clock::now();
+				std::this_thread::yield();
+				if ((i & 1023) == 0 && nOwner != 0)
+				{
+					if (nOwner != nProcessId && !is_process_alive(nOwner))
+					{
+						if (m_pHeader->producer_lock.compare_exchange_strong(nOwner, nProcessId, std::memory_order_acquire, std::memory_order_relaxed))
+							return;
+					}
+					else if (std::chrono::steady_clock::now() - startTime > std::chrono::milliseconds(max_lock_wait))
+						throw boost::interprocess::interprocess_exception(boost::interprocess::error_info(boost::interprocess::timeout_when_locking_error));
+				}
+			}
+		}
+
+		void unlock_producer()
+		{
+			m_pHeader->producer_lock.store(0, std::memory_order_release);
+		}
+
+		void copy_in(uint32_t nPos, const void* pData, uint32_t nLength)
+		{
+			uint32_t nOffset = nPos & (m_pHeader->capacity - 1);
+			uint32_t nFirst = (std::min)(nLength, m_pHeader->capacity - nOffset);
+			memcpy(m_pData + nOffset, pData, nFirst);
+			if (nFirst < nLength)
+				memcpy(m_pData, (const char*)pData + nFirst, nLength - nFirst);
+		}
+
+		void copy_out(uint32_t nPos, void* pData, uint32_t nLength)
+		{
+			uint32_t nOffset = nPos & (m_pHeader->capacity - 1);
+			uint32_t nFirst = (std::min)(nLength, m_pHeader->capacity - nOffset);
+			memcpy(pData, m_pData + nOffset, nFirst);
+			if (nFirst < nLength)
+				memcpy((char*)pData + nFirst, m_pData, nLength - nFirst);
+		}
+
+		void map_region(const char* name, bool bCreate, std::size_t nSize)
+		{
+			using namespace boost::interprocess;
+#ifdef WIN32
+			if (bCreate)
+				m_shmem.reset(new windows_shared_memory(create_only, name, read_write, nSize));
+			else
+				m_shmem.reset(new windows_shared_memory(open_only, name, read_write));
+#else
+			if (bCreate)
+			{
+				m_shmem.reset(new shared_memory_object(create_only, name, read_write));
+				m_shmem->truncate(nSize);
+			}
+			else
+				m_shmem.reset(new shared_memory_object(open_only, name, read_write));
+#endif
+			m_region.reset(new mapped_region(*m_shmem, read_write));
+			m_pHeader = (detail::shm_ring_header*)m_region->get_address();
+			m_pData = (char*)m_region->get_address() + get_header_size();
+		}
+
+		void open_waiters(const char* name)
+		{
+			m_data_waiter.open(std::string(name) + "_data");
+			m_space_waiter.open(std::string(name) + "_space");
+		}
+
+		void create(const char* name, std::size_t max_num_msg, std::size_t max_msg_size)
+		{
+			uint32_t nCapacity = get_ring_capacity(max_num_msg, max_msg_size);
+			map_region(name, true, get_header_size() + nCapacity);
+			detail::shm_ring_header& hdr = *m_pHeader;
+			hdr.capacity = nCapacity;
+			hdr.max_msg_size = (uint32_t)max_msg_size;
+			hdr.max_num_msg = (uint32_t)max_num_msg;
+			hdr.head.store(0);
+			hdr.tail.store(0);
+			hdr.producer_lock.store(0);
+			hdr.data_seq.store(0);
+			hdr.space_seq.store(0);
+			hdr.reader_waiting.store(0);
+			hdr.writer_waiting.store(0);
+			hdr.magic.store(ring_magic, std::memory_order_release);
+			open_waiters(name);
+		}
+
+		void open(const char* name)
+		{
+			map_region(name, false, 0);
+			// wait for the creator to finish initialization.
+			for (int i = 0; m_pHeader->magic.load(std::memory_order_acquire) != ring_magic; ++i)
+			{
+				if (i > 1000)
+					throw boost::interprocess::interprocess_exception(boost::interprocess::error_info(boost::interprocess::not_found_error));
+				std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			}
+			open_waiters(name);
+		}
+
+	private:
+#ifdef WIN32
+		boost::shared_ptr<boost::interprocess::windows_shared_memory> m_shmem;
+#else
+		boost::shared_ptr<boost::interprocess::shared_memory_object> m_shmem;
+#endif
+		boost::shared_ptr<boost::interprocess::mapped_region> m_region;
+		detail::shm_ring_header* m_pHeader;
+		char* m_pData;
+		detail::shm_ring_waiter m_data_waiter;
+		detail::shm_ring_waiter m_space_waiter;
+	};
+}}
@@ -133,6 +133,8 @@ struct Stmt
 {
 	DB * db;
 	sqlite3_stmt * stmt;
+	/* if true, stmt is owned by the connection's statement cache, and is released to it on finalize */
+	bool cached;
 };
 
 
@@ -778,7 +780,12 @@ FUNC( l_sqlite3_errmsg )
 
 FUNC( l_sqlite3_finalize )
 {
-	lua_pushnumber(L, sqlite3_finalize(checkstmt_stmt(L, 1)) );
+	Stmt * stmt = checkstmt(L, 1);
+	if (stmt->cached && stmt->db->m_pDBEntity)
+		lua_pushnumber(L, stmt->db->m_pDBEntity->ReleaseCachedStatement(stmt->stmt) );
+	else
+		lua_pushnumber(L, sqlite3_finalize(stmt->stmt) );
+	stmt->stmt = 0;
 	return 1;
 }
 
@@ -847,6 +854,7 @@ FUNC( l_sqlite3_prepare )
 	stmt = (Stmt *)lua_newuserdata(L, sizeof(Stmt));
 	stmt->db = checkdb(L, 1);
 	stmt->stmt = sqlite3_stmt;
+	stmt->cached = false;
 
 	if (leftover_size > 0)
 		lua_pushlstring(L, leftover, leftover_size);
@@ -857,6 +865,113 @@ FUNC( l_sqlite3_prepare )
 }
 
 
+/* same as prepare, except that the statement is taken from the connection's LRU statement cache. 
+* call finalize as usual, which will return the statement to the cache. 
+*/
+FUNC( l_sqlite3_prepare_cached )
+{
+	DB * db			= checkdb(L, 1);
+	const char * sql		= checkstr(L, 2);
+	int sql_size			= lua_strlen(L, 2);
+	int error = SQLITE_OK;
+	Stmt * stmt;
+
+	init_callback_usage(L, db);
+
+	sqlite3_stmt * sqlite3_stmt = db->m_pDBEntity->GetCachedStatement(sql, sql_size, &error);
+	if (sqlite3_stmt == 0 && error == SQLITE_OK)
+		error = SQLITE_ERROR;
+
+	lua_pushnumber(L, error);
+
+	stmt = (Stmt *)lua_newuserdata(L, sizeof(Stmt));
+	stmt->db = db;
+	stmt->stmt = sqlite3_stmt;
+	stmt->cached = true;
+	return 2;	/* error code, statement */
+}
+
+
+static int bind_lua_value(lua_State * L, sqlite3_stmt * stmt, int index, int narg)
+{
+	switch(lua_type(L, narg))
+	{
+	case LUA_TNUMBER:
+		{
+			lua_Number number = lua_tonumber(L, narg);
+			// integers beyond 32 bits, such as time stamps in milliseconds, are bound as 64 bits integers. 
+			if (number >= -9223372036854775808.0 && number < 9223372036854775808.0 && (lua_Number)((sqlite3_int64)number) == number)
+				return sqlite3_bind_int64(stmt, index, (sqlite3_int64)number);
+			else
+				return sqlite3_bind_double(stmt, index, (double)number);
+		}
+	case LUA_TBOOLEAN:
+		return sqlite3_bind_int(stmt, index, lua_toboolean(L, narg) ? 1 : 0);
+	case LUA_TSTRING:
+		return sqlite3_bind_text(stmt, index, lua_tostring(L, narg), lua_strlen(L, narg), SQLITE_TRANSIENT);
+	default:
+		return sqlite3_bind_null(stmt, index);
+	}
+}
+
+/* execute a parameterized write statement for an array of rows in a single transaction. 
+* exec_batch(db, sql, rows): rows is an array of arrays of parameter values, such as {{1, "a"}, {2, "b"}}
+* @return error code, number of rows done
+*/
+FUNC( l_sqlite3_exec_batch )
+{
+	DB * db			= checkdb(L, 1);
+	const char * sql		= checkstr(L, 2);
+	luaL_checktype(L, 3, LUA_TTABLE);
+	int nRowCount = (int)lua_objlen(L, 3);
+	int nRowsDone = 0;
+
+	int error = db->m_pDBEntity->ExecuteBatch(sql, nRowCount, [L](sqlite3_stmt* stmt, int nRowIndex) {
+		int result = SQLITE_OK;
+		lua_rawgeti(L, 3, nRowIndex + 1);
+		if (lua_istable(L, -1))
+		{
+			int nParamCount = sqlite3_bind_parameter_count(stmt);
+			for (int i = 1; i <= nParamCount && result == SQLITE_OK; ++i)
+			{
+				lua_rawgeti(L, -1, i);
+				result = bind_lua_value(L, stmt, i, lua_gettop(L));
+				lua_pop(L, 1);
+			}
+		}
+		else
+			result = SQLITE_MISMATCH;
+		lua_pop(L, 1);
+		return result;
+	}, &nRowsDone);
+
+	lua_pushnumber(L, error);
+	lua_pushnumber(L, nRowsDone);
+	return 2;
+}
+
+
+/* @return hit count, miss count, number of cached statements */
+FUNC( l_sqlite3_stmt_cache_stats )
+{
+	DB * db = checkdb(L, 1);
+	int nHitCount = 0, nMissCount = 0, nSize = 0;
+	db->m_pDBEntity->GetStatementCacheStats(&nHitCount, &nMissCount, &nSize);
+	lua_pushnumber(L, nHitCount);
+	lua_pushnumber(L, nMissCount);
+	lua_pushnumber(L, nSize);
+	return 3;
+}
+
+
+FUNC( l_sqlite3_stmt_cache_size )
+{
+	DB * db = checkdb(L, 1);
+	db->m_pDBEntity->SetStatementCacheCapacity(checkint(L, 2));
+	return 0;
+}
+
+
 FUNC( l_sqlite3_reset )
 {
 	lua_pushnumber(L, sqlite3_reset(checkstmt_stmt(L, 1)) );
@@ -1851,6 +1966,10 @@ f_entry api_entries[] = {
 	{ "last_insert_rowid",	l_sqlite3_last_insert_rowid },
 	{ "open",			l_sqlite3_open },
 	{ "prepare",			l_sqlite3_prepare },
+	{ "prepare_cached",		l_sqlite3_prepare_cached },
+	{ "exec_batch",		l_sqlite3_exec_batch },
+	{ "stmt_cache_stats",		l_sqlite3_stmt_cache_stats },
+	{ "stmt_cache_size",		l_sqlite3_stmt_cache_size },
 	{ "reset",			l_sqlite3_reset },
 	{ "step",			l_sqlite3_step },
 	{ "total_changes",		l_sqlite3_total_changes },
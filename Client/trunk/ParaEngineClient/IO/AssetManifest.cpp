@@ -14,9 +14,15 @@
 #include "AssetManifest.h"
 #include "AssetEntity.h"
 #include "util/MD5.h"
+#include "util/XXHash.h"
+#include "util/ParaTime.h"
 #include "util/StringHelper.h"
 #include "ParaWorldAsset.h"
 #include "util/regularexpression.h"
+#include <boost/iostreams/device/mapped_file.hpp>
+#include <sys/stat.h>
+#include <thread>
+#include <atomic>
 
 /** we will load these files as assets manifest file. such as "assets_manifest*.txt" */
 #define ASSETS_MANIFEST_FILE_PATTERN		"assets_manifest*.txt"
@@ -48,7 +54,7 @@ void MakeValidFileName(string& inout)
 //
 //////////////////////////////////////////////////////////////////////////
 
-AssetFileEntry::AssetFileEntry():m_bIsZipFile(false), m_nDownloadCount(0), m_nFileSize(0), m_file_type(AssetFileType_default),
+AssetFileEntry::AssetFileEntry():m_bIsZipFile(false), m_nDownloadCount(0), m_nFileSize(0), m_nContentHash(0), m_bHasContentHash(false), m_file_type(AssetFileType_default),
 	m_sync_callback(NULL), m_nStatus(AssetFileStatus_Unknown)
 {
 }
@@ -452,6 +458,10 @@ bool AssetFileEntry::CheckMD5AndSize(const char* buffer, int nSize)
 			return false;
 	}
 
+	// the xxHash64 of a zip file is of the unzipped file, so the download is checked with md5.
+	if (m_bHasContentHash && !m_bIsZipFile)
+		return XXHash64::Hash(buffer, nSize) == m_nContentHash;
+
 	// compare the md5 part
 	int nFrom = (int)(m_localFileName.find_last_of('/')+1);
 	nCount = nFileNameCount-nFrom-nCount;
@@ -464,6 +474,15 @@ bool AssetFileEntry::CheckMD5AndSize(const char* buffer, int nSize)
 	return (stricmp(md5_str.c_str(), sMD5String.c_str()) == 0);
 }
 
+int AssetFileEntry::CheckCachedFile(const char* buffer, int nSize)
+{
+	if (!m_bIsZipFile)
+		return CheckMD5AndSize(buffer, nSize) ? 1 : 0;
+	if (!m_bHasContentHash)
+		return -1;
+	return (XXHash64::Hash(buffer, nSize) == m_nContentHash) ? 1 : 0;
+}
+
 std::string AssetFileEntry::GetFullFilePath()
 {
 #ifdef PARAENGINE_MOBILE
@@ -768,6 +787,16 @@ void CAssetManifest::AddEntry(const char* filename)
 	{
 		string file_extension;
 
+		// the optional checksum column is not part of the url
+		string checksum;
+		string::size_type nPos = filesize.find(',');
+		if (nPos != string::npos)
+		{
+			checksum = filesize.substr(nPos + 1);
+			sFilename.resize(sFilename.size() - (filesize.size() - nPos));
+			filesize.resize(nPos);
+		}
+
 		// to lower case and replace "\\" with "/"
 		MakeValidFileName(fileKey);
 
@@ -829,7 +858,7 @@ void CAssetManifest::AddEntry(const char* filename)
 		}
 				
 		AssetFileEntry* pEntry = new AssetFileEntry();
-		pEntry->m_url = filename;
+		pEntry->m_url = sFilename;
 		pEntry->m_localFileName.reserve(pEntry->m_localFileName.size()+63);
 		pEntry->m_localFileName += "temp/cache/a/";
 		pEntry->m_localFileName[11] = md5[0];
@@ -838,6 +867,8 @@ void CAssetManifest::AddEntry(const char* filename)
 
 		pEntry->m_bIsZipFile = bIsZipfile;
 		pEntry->m_nFileSize = nFileSize;
+		if (checksum.size() > 6 && checksum.compare(0, 6, "xxh64:") == 0)
+			pEntry->m_bHasContentHash = XXHash64::FromHex(checksum.c_str() + 6, pEntry->m_nContentHash);
 		pEntry->SetFileType(file_extension); // note: this function must be called after file size is set. 
 		m_files[fileKey] = pEntry;
 		
@@ -845,6 +876,102 @@ void CAssetManifest::AddEntry(const char* filename)
 	}
 }
 
+int CAssetManifest::VerifyCachedFiles(int nThreadCount, bool bDeleteCorrupted)
+{
+	enum VerifyResult { Verify_Missing = 0, Verify_Empty, Verify_OK, Verify_Corrupted, Verify_Unchecked };
+
+	int64 nFromTime = GetTimeUS();
+	std::vector<AssetFileEntry*> entries;
+	std::vector<std::string> paths;
+	for (auto& item : m_files)
+	{
+		AssetFileEntry* pEntry = item.second;
+		// skip directory entries and files being downloaded.
+		if (pEntry->m_nFileSize > 0 && pEntry->GetStatus() != AssetFileEntry::AssetFileStatus_Downloading)
+		{
+			entries.push_back(pEntry);
+			paths.push_back(pEntry->GetFullFilePath());
+		}
+	}
+	int nCount = (int)entries.size();
+	std::vector<char> results(nCount, Verify_Missing);
+	std::atomic<int> nNextIndex(0);
+	std::atomic<int64> nVerifiedBytes(0);
+
+	auto VerifyFiles = [&]()
+	{
+		int nIndex;
+		while ((nIndex = nNextIndex++) < nCount)
+		{
+			try
+			{
+				boost::iostreams::mapped_file_source file(paths[nIndex]);
+				if (file.is_open() && file.size() > 0)
+				{
+					int nResult = entries[nIndex]->CheckCachedFile(file.data(), (int)file.size());
+					results[nIndex] = (nResult > 0) ? Verify_OK : ((nResult == 0) ? Verify_Corrupted : Verify_Unchecked);
+					if (nResult >= 0)
+						nVerifiedBytes += (int64)file.size();
+				}
+			}
+			catch (...)
+			{
+			}
+			if (results[nIndex] == Verify_Missing)
+			{
+				// an empty file is left by a failed write, which is the same as a missing file. 
+				// any other file that can not be mapped, such as one opened exclusively by another process, is left alone. 
+				struct stat st;
+				if (stat(paths[nIndex].c_str(), &st) != 0)
+					results[nIndex] = (errno == ENOENT) ? Verify_Missing : Verify_Unchecked;
+				else
+					results[nIndex] = (st.st_size == 0) ? Verify_Empty : Verify_Unchecked;
+			}
+		}
+	};
+
+	if (nThreadCount <= 0)
+		nThreadCount = (int)std::thread::hardware_concurrency();
+	nThreadCount = std::max(1, std::min(nThreadCount, nCount));
+	std::vector<std::thread> threads;
+	for (int i = 1; i < nThreadCount; ++i)
+		threads.push_back(std::thread(VerifyFiles));
+	VerifyFiles();
+	for (auto& thread : threads)
+		thread.join();
+
+	int nVerifiedCount = 0;
+	int nCorruptedCount = 0;
+	int nMissingCount = 0;
+	for (int i = 0; i < nCount; ++i)
+	{
+		if (results[i] == Verify_OK)
+		{
+			++nVerifiedCount;
+			entries[i]->SetStatus(AssetFileEntry::AssetFileStatus_Downloaded);
+		}
+		else if (results[i] == Verify_Corrupted)
+		{
+			++nCorruptedCount;
+			OUTPUT_LOG("warning: cached asset file %s is corrupted\n", entries[i]->GetUrl().c_str());
+			entries[i]->SetStatus(AssetFileEntry::AssetFileStatus_Unknown);
+			if (bDeleteCorrupted)
+				CParaFile::DeleteFile(paths[i], false);
+		}
+		else if (results[i] == Verify_Missing || results[i] == Verify_Empty)
+		{
+			// so that DoesFileExist() checks the disk again instead of trusting a file that is gone.
+			++nMissingCount;
+			entries[i]->SetStatus(AssetFileEntry::AssetFileStatus_Unknown);
+			if (bDeleteCorrupted && results[i] == Verify_Empty)
+				CParaFile::DeleteFile(paths[i], false);
+		}
+	}
+	OUTPUT_LOG("CAssetManifest verified %d cached files (%d MB) with %d threads in %d ms, %d corrupted, %d missing\n", nVerifiedCount, 
+		(int)(nVerifiedBytes.load() >> 20), nThreadCount, (int)((GetTimeUS() - nFromTime) / 1000), nCorruptedCount, nMissingCount);
+	return nCorruptedCount;
+}
+
 bool CAssetManifest::DoesFileExist(const char* filename)
 {
 	if (!filename)
@@ -44,6 +44,10 @@ namespace ParaEngine
 		int m_nDownloadCount;
 		/** the compressed file size*/
 		int m_nFileSize;
+		/** optional xxHash64 of the cached file on disk, i.e. of the unzipped bytes for zip files.
+		* It is checked instead of md5 if m_bHasContentHash is true, except for the download of a zip file. */
+		uint64 m_nContentHash;
+		bool m_bHasContentHash;
 		/** the asset file type */
 		AssetFileTypeEnum m_file_type;
 
@@ -147,9 +151,19 @@ namespace ParaEngine
 		/** return true if url file is compressed. By default, we will assume url file is a compressed file unless the file name ends with .p */
 		bool IsUrlFileCompressed();
 
-		/** check whether the MD5 of the input buffer matches. */
+		/** check whether the size and the hash of the input buffer matches. The xxHash64 checksum is used if the manifest
+		* provides one for this file, otherwise the md5 in the local file name is used.
+		* [thread safe]: it does not modify the entry.
+		*/
 		bool CheckMD5AndSize(const char* buffer, int nSize);
 
+		/** check the content of the cached file on disk. Unlike CheckMD5AndSize(), the input is the unzipped file for zip files, 
+		* which can only be checked if the manifest provides the xxHash64 checksum. 
+		* [thread safe]: it does not modify the entry.
+		* @return 1 if it matches, 0 if not, -1 if it can not be checked. 
+		*/
+		int CheckCachedFile(const char* buffer, int nSize);
+
 		/** save a give buffer to local file. */
 		bool SaveToDisk(const char* buffer, int nSize, bool bCheckMD5=true);
 
@@ -282,10 +296,24 @@ namespace ParaEngine
 		AssetFileEntry* GetFile(const string& filename, bool bUseReplaceMap = true, bool bIgnoreLocalFile = false);
 
 		/** add an entry to the list. 
-		* @param filename: string with format [relative path],md5,fileSize
+		* @param filename: string with format [relative path],md5,fileSize[,xxh64:checksum]
+		* the optional checksum is 16 hex characters of the xxHash64 of the cached file, which is much faster to verify than md5.
+		* for .z files it is the hash of the unzipped file, while md5 and fileSize are still of the compressed file.
 		*/
 		void AddEntry(const char* filename);
 
+		/** verify all cached asset files against their checksum with a group of threads. 
+		* Files are memory mapped, so that the OS reads ahead and no copy is made. Every file entry that is not being downloaded is verified.
+		* Files that are unzipped after download are only verified if the manifest provides their xxHash64 checksum, 
+		* since their md5 is of the compressed file. Entries whose file is missing or empty are reset to AssetFileStatus_Unknown.
+		* Files that exist but can not be mapped are left unchecked.
+		* This function blocks until all files are verified, and it should be called from the main thread when no file is being downloaded.
+		* @param nThreadCount: number of threads to use. if 0, it is the number of CPU cores. 
+		* @param bDeleteCorrupted: if true, files that fail the check and empty files are deleted, so that they will be downloaded again. 
+		* @return the number of corrupted files. 
+		*/
+		int VerifyCachedFiles(int nThreadCount = 0, bool bDeleteCorrupted = true);
+
 		/** clean up all loaded files. */
 		void CleanUp();
 
@@ -787,6 +787,14 @@ int ParaEngine::CAsyncLoader::AddWorkItem( IDataLoader* pDataLoader, IDataProces
 {
 	if( !pDataLoader || !pDataProcessor )
 		return E_INVALIDARG;
+	TryAddWorkItem(pDataLoader, pDataProcessor, pHResult, ppDeviceObject, nProcessorThreadID);
+	return S_OK;
+}
+
+bool ParaEngine::CAsyncLoader::TryAddWorkItem( IDataLoader* pDataLoader, IDataProcessor* pDataProcessor, HRESULT* pHResult, void** ppDeviceObject, int nProcessorThreadID)
+{
+	if( !pDataLoader || !pDataProcessor )
+		return false;
 
 	ResourceRequest_ptr msg(new ResourceRequest(ResourceRequestType_Local));
 	msg->m_nProcessorQueueID = nProcessorThreadID;
@@ -801,11 +809,16 @@ int ParaEngine::CAsyncLoader::AddWorkItem( IDataLoader* pDataLoader, IDataProces
 	if( ppDeviceObject)
 		*ppDeviceObject = NULL;
 
-	AddWorkItem(msg);
-	return S_OK;
+	return TryAddWorkItem(msg);
 }
 
 int ParaEngine::CAsyncLoader::AddWorkItem( ResourceRequest_ptr& msg)
+{
+	TryAddWorkItem(msg);
+	return S_OK;
+}
+
+bool ParaEngine::CAsyncLoader::TryAddWorkItem( ResourceRequest_ptr& msg)
 {
 	const char* name = msg->m_pDataLoader->GetFileName();
 	if(name == 0)
@@ -830,8 +843,9 @@ int ParaEngine::CAsyncLoader::AddWorkItem( ResourceRequest_ptr& msg)
 	else
 	{
 		OUTPUT_LOG("warning: there is no more room in the CAsyncLoader worker queue for asset file %s\n", name);
+		return false;
 	}
-	return S_OK;
+	return true;
 }
 
 void ParaEngine::CAsyncLoader::ProcessDeviceWorkItemImp(ResourceRequest_ptr& ResourceRequest, bool bRetryLoads)
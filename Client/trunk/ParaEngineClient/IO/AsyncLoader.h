@@ -123,6 +123,13 @@ namespace ParaEngine
 		*/
 		int AddWorkItem( ResourceRequest_ptr& request );
 
+		/** same as AddWorkItem, except that it tells whether the item is queued. 
+		* Only call this from graphics thread
+		* @return false if the queue is full, in which case the loader and processor are deleted without being processed.
+		*/
+		bool TryAddWorkItem( IDataLoader* pDataLoader, IDataProcessor* pDataProcessor, HRESULT* pHResult, void** ppDeviceObject, int nProcessorThreadID=0);
+		bool TryAddWorkItem( ResourceRequest_ptr& request );
+
 		/** this is same as AddWorkItem, except that it is a synchronous function. and will only return after everything is processed. 
 		* @note: use AddWorkItem instead if possible.
 		*/
@@ -947,7 +947,7 @@ ParaEngine::FileHandle ParaEngine::CFileUtils::OpenFile(const char* filename, bo
 #endif
 }
 
-bool ParaEngine::CFileUtils::SetFilePointer(FileHandle& fileHandle, int lDistanceToMove, int dwMoveMethod)
+bool ParaEngine::CFileUtils::SetFilePointer(FileHandle& fileHandle, int64 lDistanceToMove, int dwMoveMethod)
 {
 	if (fileHandle.IsValid())
 	{
@@ -963,11 +963,16 @@ bool ParaEngine::CFileUtils::SetFilePointer(FileHandle& fileHandle, int lDistanc
 			return false;
 		}
 #ifdef USE_COCOS_FILE_API
-		fseek(fileHandle.m_pFile, lDistanceToMove, dwMoveMethod);
+		fseek(fileHandle.m_pFile, (long)lDistanceToMove, dwMoveMethod);
 #elif defined USE_BOOST_FILE_API
-		fseek(fileHandle.m_pFile, lDistanceToMove, dwMoveMethod);
+#ifdef WIN32
+		_fseeki64(fileHandle.m_pFile, lDistanceToMove, dwMoveMethod);
+#else
+		fseeko(fileHandle.m_pFile, (off_t)lDistanceToMove, dwMoveMethod);
+#endif
 #else
-		::SetFilePointer(fileHandle.m_handle, lDistanceToMove, 0, dwMoveMethod);
+		LONG nDistanceHigh = (LONG)(lDistanceToMove >> 32);
+		::SetFilePointer(fileHandle.m_handle, (LONG)(lDistanceToMove & 0xffffffff), &nDistanceHigh, dwMoveMethod);
 #endif
 		return true;
 	}
@@ -1035,14 +1035,14 @@ bool CParaFile::SetEndOfFile()
 }
 
 
-void CParaFile::SetFilePointer(int lDistanceToMove, int dwMoveMethod)
+void CParaFile::SetFilePointer(int64 lDistanceToMove, int dwMoveMethod)
 {
 	if (m_bDiskFileOpened)
 	{
 		CFileUtils::SetFilePointer(m_handle, lDistanceToMove, dwMoveMethod);
 		if (dwMoveMethod == FILE_BEGIN)
 		{
-			m_curPos = lDistanceToMove;
+			m_curPos = (size_t)lDistanceToMove;
 		}
 		else if (dwMoveMethod == FILE_END)
 		{
@@ -1050,22 +1050,22 @@ void CParaFile::SetFilePointer(int lDistanceToMove, int dwMoveMethod)
 		}
 		else if (dwMoveMethod == FILE_CURRENT)
 		{
-			m_curPos += lDistanceToMove;
+			m_curPos += (size_t)lDistanceToMove;
 		}
 	}
 	else if (m_bMemoryFile)
 	{
 		if (dwMoveMethod == FILE_BEGIN)
 		{
-			m_curPos = lDistanceToMove;
+			m_curPos = (size_t)lDistanceToMove;
 		}
 		else if (dwMoveMethod == FILE_END)
 		{
-			m_curPos = ToStringBuilder(this)->size() - lDistanceToMove;
+			m_curPos = ToStringBuilder(this)->size() - (size_t)lDistanceToMove;
 		}
 		else if (dwMoveMethod == FILE_CURRENT)
 		{
-			m_curPos += lDistanceToMove;
+			m_curPos += (size_t)lDistanceToMove;
 		}
 	}
 }
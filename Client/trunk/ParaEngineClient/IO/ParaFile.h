@@ -405,13 +405,13 @@ namespace ParaEngine
 		* The SetFilePointer function moves the file pointer of an open file.
 		* this function only works when the ParaFile object is an actual windows file, instead of a virtual file.
 		* for virtual file, use the seek and seekRelative function.
-		* @param lDistanceToMove
+		* @param lDistanceToMove: 64 bits, so that files larger than 2GB can be sought. 
 		* @param dwMoveMethod
 		*	0: FILE_BEGIN The starting point is 0 (zero) or the beginning of the file.
 		*	1: FILE_CURRENT The starting point is the current value of the file pointer.
 		*	2: FILE_END The starting point is the current end-of-file position.
 		*/
-		void SetFilePointer(int lDistanceToMove, int dwMoveMethod);
+		void SetFilePointer(int64 lDistanceToMove, int dwMoveMethod);
 
 		/**
 		* The SetEndOfFile function moves the end-of-file (EOF) position for the specified file to
@@ -19,6 +19,18 @@
 #include "WebSocket/WebSocketFrame.h"
 #include "json/json.h"
 #include "NPLHelper.h"
+#include <sys/stat.h>
+#if (PARA_TARGET_PLATFORM == PARA_PLATFORM_LINUX)
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/sendfile.h>
+#elif defined(WIN32)
+#include <fcntl.h>
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
 /** @def if not defined, we expect all remote NPL runtime's public file list mapping to be identical
 if defined, different NPL runtime can have different local map and file id map are established dynamically.
 */
@@ -36,11 +48,39 @@ Default value is 200KB */
 /** whether to enable tcp level keep alive. Keep alive is a system socket feature*/
 // #define NPL_INCOMING_KEEPALIVE
 
+namespace NPL
+{
+	/** get the content type of a static HTTP file by its file extension. */
+	static const char* GetHttpMimeType(const std::string& sFilePath)
+	{
+		static const struct { const char* extension; const char* mime_type; } mappings[] =
+		{
+			{ "html", "text/html" }, { "htm", "text/html" }, { "css", "text/css" }, { "js", "application/javascript" },
+			{ "json", "application/json" }, { "xml", "text/xml" }, { "txt", "text/plain" }, { "lua", "text/plain" },
+			{ "png", "image/png" }, { "jpg", "image/jpeg" }, { "jpeg", "image/jpeg" }, { "gif", "image/gif" },
+			{ "svg", "image/svg+xml" }, { "ico", "image/x-icon" }, { "webp", "image/webp" }, { "wasm", "application/wasm" },
+			{ "mp3", "audio/mpeg" }, { "ogg", "audio/ogg" }, { "mp4", "video/mp4" }, { "zip", "application/zip" },
+		};
+		size_t nPos = sFilePath.find_last_of("./");
+		if (nPos != std::string::npos && sFilePath[nPos] == '.')
+		{
+			const char* sExt = sFilePath.c_str() + nPos + 1;
+			for (size_t i = 0; i < sizeof(mappings) / sizeof(mappings[0]); ++i)
+			{
+				if (stricmp(mappings[i].extension, sExt) == 0)
+					return mappings[i].mime_type;
+			}
+		}
+		return "application/octet-stream";
+	}
+}
+
 NPL::CNPLConnection::CNPLConnection(boost::asio::io_service& io_service, CNPLConnectionManager& manager, CNPLDispatcher& msg_dispatcher)
 	: m_socket(io_service), m_connection_manager(manager), m_msg_dispatcher(msg_dispatcher), m_totalBytesIn(0), m_totalBytesOut(0),
 	m_queueOutput(DEFAULT_NPL_OUTPUT_QUEUE_SIZE), m_state(ConnectionDisconnected),
 	m_bDebugConnection(false), m_nCompressionLevel(0), m_nCompressionThreshold(NPL_AUTO_COMPRESSION_THRESHOLD),
-	m_bKeepAlive(false), m_bEnableIdleTimeout(true), m_nSendCount(0), m_nFinishedCount(0), m_bCloseAfterSend(false), m_nIdleTimeoutMS(0), m_nLastActiveTime(0), m_nStopReason(0),
+	m_bKeepAlive(false), m_bEnableIdleTimeout(true), m_nSendCount(0), m_nFinishedCount(0), m_bCloseAfterSend(false), m_nIdleTimeoutMS(0), m_nLastActiveTime(0), m_bIdleTimerArmed(false), m_nStopReason(0),
+	m_nReadDelayMS(0), m_bRateLimitDisconnect(false), m_read_timer(io_service),
 	m_protocolType(NPL)
 {
 	m_queueOutput.SetUseEvent(false);
@@ -300,6 +340,8 @@ void NPL::CNPLConnection::start()
 		m_msg_dispatcher.AddNPLConnection(m_address->GetNID(), shared_from_this());
 	}
 
+	m_connection_manager.ScheduleIdleTimeout(shared_from_this());
+
 	// begin reading
 	m_socket.async_read_some(boost::asio::buffer(m_buffer),
 		boost::bind(&CNPLConnection::handle_read, shared_from_this(),
@@ -355,6 +397,7 @@ void NPL::CNPLConnection::handle_stop()
 		m_state = ConnectionDisconnected;
 
 		boost::system::error_code ec;
+		m_read_timer.cancel(ec);
 
 		m_socket.close(ec);
 		if (ec)
@@ -408,7 +451,14 @@ void NPL::CNPLConnection::handle_read(const boost::system::error_code& e, std::s
 			}
 		}
 
-		if (bRes)
+		if (bRes && m_nReadDelayMS > 0)
+		{
+			// a rate limit is exceeded, stop reading for a while, so that TCP flow control slows down the sender. 
+			m_read_timer.expires_from_now(boost::chrono::milliseconds(m_nReadDelayMS));
+			m_read_timer.async_wait(boost::bind(&CNPLConnection::handle_read_resume, shared_from_this(), boost::asio::placeholders::error));
+			m_nReadDelayMS = 0;
+		}
+		else if (bRes)
 		{
 			// Read some from the server.
 			m_socket.async_read_some(boost::asio::buffer(m_buffer),
@@ -452,6 +502,17 @@ void NPL::CNPLConnection::handle_read(const boost::system::error_code& e, std::s
 	}
 }
 
+void NPL::CNPLConnection::handle_read_resume(const boost::system::error_code& e)
+{
+	if (!e && m_socket.is_open())
+	{
+		m_socket.async_read_some(boost::asio::buffer(m_buffer),
+			boost::bind(&CNPLConnection::handle_read, shared_from_this(),
+				boost::asio::placeholders::error,
+				boost::asio::placeholders::bytes_transferred));
+	}
+}
+
 void NPL::CNPLConnection::handle_write(const boost::system::error_code& e)
 {
 	if (!e)
@@ -468,10 +529,7 @@ void NPL::CNPLConnection::handle_write(const boost::system::error_code& e)
 		NPLMsgOut_ptr* msg = NULL;
 		if (m_queueOutput.try_next(&msg) && msg != NULL)
 		{
-			boost::asio::async_write(m_socket,
-				boost::asio::buffer((*msg)->GetBuffer().c_str(), (*msg)->GetBuffer().size()),
-				boost::bind(&CNPLConnection::handle_write, shared_from_this(),
-					boost::asio::placeholders::error));
+			async_write_msg(msg->get());
 		}
 		else
 		{
@@ -502,6 +560,96 @@ void NPL::CNPLConnection::handle_write(const boost::system::error_code& e)
 	}
 }
 
+void NPL::CNPLConnection::async_write_msg(NPLMsgOut* msg)
+{
+	if (msg->HasFile())
+	{
+		boost::asio::async_write(m_socket,
+			boost::asio::buffer(msg->GetBuffer().c_str(), msg->GetBuffer().size()),
+			boost::bind(&CNPLConnection::handle_sendfile, shared_from_this(),
+				boost::asio::placeholders::error, msg));
+	}
+	else
+	{
+		boost::asio::async_write(m_socket,
+			boost::asio::buffer(msg->GetBuffer().c_str(), msg->GetBuffer().size()),
+			boost::bind(&CNPLConnection::handle_write, shared_from_this(),
+				boost::asio::placeholders::error));
+	}
+}
+
+void NPL::CNPLConnection::handle_sendfile(const boost::system::error_code& e, NPLMsgOut* msg)
+{
+	if (e)
+	{
+		handle_write(e);
+		return;
+	}
+#if (PARA_TARGET_PLATFORM == PARA_PLATFORM_LINUX)
+	// msg is still the front of m_queueOutput, it is only popped in handle_write. 
+	if (!m_socket.native_non_blocking())
+	{
+		boost::system::error_code ec;
+		m_socket.native_non_blocking(true, ec);
+	}
+	while (msg->m_nFileSize > 0)
+	{
+		off_t offset = (off_t)msg->m_nFileOffset;
+		size_t nCount = (size_t)((std::min)(msg->m_nFileSize, (int64)0x7ffff000));
+		ssize_t nSent = ::sendfile(m_socket.native_handle(), msg->m_nFileHandle, &offset, nCount);
+		if (nSent > 0)
+		{
+			msg->m_nFileOffset += nSent;
+			msg->m_nFileSize -= nSent;
+		}
+		else if (nSent < 0 && errno == EINTR)
+		{
+			continue;
+		}
+		else if (nSent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+		{
+			// wait until the socket is writable again. 
+			m_socket.async_write_some(boost::asio::null_buffers(),
+				boost::bind(&CNPLConnection::handle_sendfile, shared_from_this(),
+					boost::asio::placeholders::error, msg));
+			return;
+		}
+		else
+		{
+			// the file is truncated while sending or the socket is broken. 
+			handle_write(boost::system::error_code((nSent == 0) ? EIO : errno, boost::system::system_category()));
+			return;
+		}
+	}
+#else
+	// without sendfile(), the file is read and written one chunk at a time, so that a large file is never loaded into memory. 
+	// the file is read sequentially, since it is opened at m_nFileOffset. 
+	if (msg->m_nFileSize > 0)
+	{
+		if (m_sendfile_buffer.empty())
+			m_sendfile_buffer.resize(64 * 1024);
+		int nCount = (int)((std::min)(msg->m_nFileSize, (int64)m_sendfile_buffer.size()));
+		int nRead = ::read(msg->m_nFileHandle, &(m_sendfile_buffer[0]), nCount);
+		if (nRead <= 0)
+		{
+			// the file is truncated while sending
+			handle_write(boost::system::errc::make_error_code(boost::system::errc::io_error));
+			return;
+		}
+		msg->m_nFileOffset += nRead;
+		msg->m_nFileSize -= nRead;
+		boost::asio::async_write(m_socket,
+			boost::asio::buffer(&(m_sendfile_buffer[0]), nRead),
+			boost::bind(&CNPLConnection::handle_sendfile, shared_from_this(),
+				boost::asio::placeholders::error, msg));
+		return;
+	}
+#endif
+	// close the file as soon as it is sent. 
+	msg->SetFile(-1, 0, 0);
+	handle_write(e);
+}
+
 void NPL::CNPLConnection::handle_resolve(const boost::system::error_code& err, boost::asio::ip::tcp::resolver::iterator endpoint_iterator)
 {
 	if (!err)
@@ -603,6 +751,18 @@ NPL::NPLReturnCode NPL::CNPLConnection::SendMessage(const NPLFileName& file_name
 		if (nLength < 0)
 			nLength = strlen(code);
 		writer.Append(code, nLength);
+
+		// a raw send does not tell which request it answers or whether the response is ended, so responses 
+		// of the requests received so far are sent unordered. otherwise the ones waiting for it would never be sent. 
+		ParaEngine::mutex::ScopedLock lock_(m_http_mutex);
+		NPLReturnCode nResult = SendMessage(msg_out);
+		CNPLHttpPipeline::MsgList_Type msgs;
+		bool bClose = m_http_pipeline.AddRawResponse(msgs);
+		for (auto itMsg = msgs.begin(); itMsg != msgs.end(); ++itMsg)
+			SendMessage(*itMsg);
+		if (bClose)
+			CloseAfterSend();
+		return nResult;
 	}
 	else if (file_name.sRelativePath == "tcp")
 	{
@@ -701,10 +861,7 @@ NPL::NPLReturnCode NPL::CNPLConnection::SendMessage(NPLMsgOut_ptr& msg)
 		// LXZ: very tricky code to ensure thread-safety to the buffer.
 		// only start the sending task when the buffer is empty, otherwise we will wait for previous send task. 
 		// i.e. inside handle_write handler. 
-		boost::asio::async_write(m_socket,
-			boost::asio::buffer((*pFront)->GetBuffer().c_str(), (*pFront)->GetBuffer().size()),
-			boost::bind(&CNPLConnection::handle_write, shared_from_this(),
-				boost::asio::placeholders::error));
+		async_write_msg(pFront->get());
 	}
 	else if (bufStatus == RingBuffer_Type::BufferOverFlow)
 	{
@@ -720,6 +877,149 @@ NPL::NPLReturnCode NPL::CNPLConnection::SendMessage(NPLMsgOut_ptr& msg)
 	return NPL_OK;
 }
 
+bool NPL::CNPLConnection::BeginHttpRequest(NPLMsgIn& msg)
+{
+	// HTTP/1.1 connections are persistent by default, HTTP/1.0 ones only if the client asks for it. 
+	bool bKeepAlive = (msg.npl_version_major > 1 || (msg.npl_version_major == 1 && msg.npl_version_minor >= 1));
+	const char* sConnection = msg.GetHeader("Connection");
+	if (sConnection)
+	{
+		if (stricmp(sConnection, "close") == 0)
+			bKeepAlive = false;
+		else if (stricmp(sConnection, "keep-alive") == 0)
+			bKeepAlive = true;
+	}
+	int nMaxRequests = m_msg_dispatcher.GetHttpMaxKeepAliveRequests();
+
+	ParaEngine::mutex::ScopedLock lock_(m_http_mutex);
+	if (nMaxRequests > 0 && (m_http_pipeline.GetRequestCount() + 1) >= nMaxRequests)
+		bKeepAlive = false;
+	msg.m_nHttpSeq = m_http_pipeline.BeginRequest(!bKeepAlive);
+	if (msg.m_nHttpSeq < 0)
+	{
+		// the client should not send more requests after "Connection: close". only the first one is logged, so that a client can not flood the log. 
+		if (m_http_pipeline.GetIgnoredRequestCount() == 1 && GetLogLevel() > 0)
+		{
+			OUTPUT_LOG("warning: HTTP request %s is ignored, because it is sent after \"Connection: close\". nid %s \n", msg.m_filename.c_str(), GetNID().c_str());
+		}
+		return false;
+	}
+	msg.m_bHttpKeepAlive = bKeepAlive;
+	return true;
+}
+
+NPL::NPLReturnCode NPL::CNPLConnection::SendHttpResponse(int nSeq, const char* data, int nLength, int nFlags)
+{
+	if (nLength < 0)
+		nLength = (data != NULL) ? (int)strlen(data) : 0;
+
+	NPLMsgOut_ptr msg_out(new NPLMsgOut());
+	ParaEngine::StringBuilder& buf = msg_out->GetBuffer();
+
+	ParaEngine::mutex::ScopedLock lock_(m_http_mutex);
+	if (!m_http_pipeline.CanRespond(nSeq))
+	{
+		if (GetLogLevel() > 0) {
+			OUTPUT_LOG("warning: HTTP response %d is already ended or not requested. nid %s \n", nSeq, GetNID().c_str());
+		}
+		return NPL_Error;
+	}
+
+	if ((nFlags & HTTP_RESPONSE_CHUNK) != 0)
+	{
+		m_http_pipeline.SetChunked(nSeq);
+		// an empty chunk would terminate the body, so it is never sent until the end. 
+		if (nLength > 0)
+		{
+			char sChunkSize[16];
+			snprintf(sChunkSize, sizeof(sChunkSize), "%x\r\n", nLength);
+			buf.append(sChunkSize);
+			buf.append(data, nLength);
+			buf.append("\r\n");
+		}
+	}
+	else if (nLength > 0)
+	{
+		buf.append(data, nLength);
+	}
+	bool bEnd = (nFlags & HTTP_RESPONSE_END) != 0;
+	if (bEnd && m_http_pipeline.IsChunked(nSeq))
+		buf.append("0\r\n\r\n");
+	return SendHttpResponse_unlocked(nSeq, msg_out, bEnd);
+}
+
+NPL::NPLReturnCode NPL::CNPLConnection::SendHttpResponse_unlocked(int nSeq, NPLMsgOut_ptr& msg, bool bEnd)
+{
+	CNPLHttpPipeline::MsgList_Type msgs;
+	bool bClose = m_http_pipeline.AddResponse(nSeq, msg, bEnd, msgs);
+	NPLReturnCode nResult = NPL_OK;
+	for (auto itMsg = msgs.begin(); itMsg != msgs.end(); ++itMsg)
+	{
+		NPLReturnCode nSendResult = SendMessage(*itMsg);
+		if (nSendResult != NPL_OK)
+			nResult = nSendResult;
+	}
+	if (bClose)
+		CloseAfterSend();
+	return nResult;
+}
+
+void NPL::CNPLConnection::EndHttpRequestWithError(NPLMsgIn& msg, NPLReturnCode nResult)
+{
+	NPLMsgOut_ptr msg_out(new NPLMsgOut());
+	char sHeader[256];
+	snprintf(sHeader, sizeof(sHeader), "HTTP/1.1 %s\r\nContent-Length: 0\r\nConnection: %s\r\n\r\n",
+		(nResult == NPL_QueueIsFull) ? "503 Service Unavailable" : "500 Internal Server Error", msg.m_bHttpKeepAlive ? "keep-alive" : "close");
+	msg_out->GetBuffer().append(sHeader);
+
+	ParaEngine::mutex::ScopedLock lock_(m_http_mutex);
+	SendHttpResponse_unlocked(msg.m_nHttpSeq, msg_out, true);
+}
+
+bool NPL::CNPLConnection::SendHttpFile(NPLMsgIn& msg, const std::string& sFilePath)
+{
+	struct stat st;
+	if (stat(sFilePath.c_str(), &st) != 0 || (st.st_mode & S_IFMT) != S_IFREG)
+		return false;
+
+	// weak ETag from file size and modification time, so that it is never necessary to read the file. 
+	char sETag[64];
+	snprintf(sETag, sizeof(sETag), "W/\"%llx-%llx\"", (unsigned long long)st.st_size, (unsigned long long)st.st_mtime);
+	const char* sIfNoneMatch = msg.GetHeader("If-None-Match");
+	bool bNotModified = (sIfNoneMatch != NULL) && (strcmp(sIfNoneMatch, "*") == 0 || strstr(sIfNoneMatch, sETag + 2) != NULL);
+
+	NPLMsgOut_ptr msg_out(new NPLMsgOut());
+	ParaEngine::StringBuilder& buf = msg_out->GetBuffer();
+	const char* sConnection = msg.m_bHttpKeepAlive ? "keep-alive" : "close";
+	char sHeader[512];
+	if (bNotModified)
+	{
+		snprintf(sHeader, sizeof(sHeader), "HTTP/1.1 304 Not Modified\r\nETag: %s\r\nConnection: %s\r\n\r\n", sETag, sConnection);
+		buf.append(sHeader);
+	}
+	else
+	{
+		snprintf(sHeader, sizeof(sHeader), "HTTP/1.1 200 OK\r\nContent-Type: %s\r\nContent-Length: %llu\r\nETag: %s\r\nConnection: %s\r\n\r\n",
+			GetHttpMimeType(sFilePath), (unsigned long long)st.st_size, sETag, sConnection);
+		buf.append(sHeader);
+		if (msg.method != "HEAD" && st.st_size > 0)
+		{
+#ifdef O_BINARY
+			int nFile = ::open(sFilePath.c_str(), O_RDONLY | O_BINARY);
+#else
+			int nFile = ::open(sFilePath.c_str(), O_RDONLY);
+#endif
+			if (nFile < 0)
+				return false;
+			msg_out->SetFile(nFile, 0, (int64)st.st_size);
+		}
+	}
+
+	ParaEngine::mutex::ScopedLock lock_(m_http_mutex);
+	SendHttpResponse_unlocked(msg.m_nHttpSeq, msg_out, true);
+	return true;
+}
+
 void NPL::CNPLConnection::handleConnect()
 {
 	m_msg_dispatcher.PostNetworkEvent(NPL_ConnectionEstablished, GetNID().c_str());
@@ -834,7 +1134,8 @@ bool NPL::CNPLConnection::handleReceivedData(int bytes_transferred)
 		if (result)
 		{
 			// a complete message is read to m_input_msg.
-			handleMessageIn();
+			if (!handleMessageIn() && m_bRateLimitDisconnect)
+				return false;
 		}
 		else if (!result)
 		{
@@ -877,6 +1178,10 @@ bool NPL::CNPLConnection::handleMessageIn()
 
 	if (m_input_msg.npl_version_major == NPL_VERSION_MAJOR /*&& m_input_msg.npl_version_minor==NPL_VERSION_MINOR*/)
 	{
+		if (!CheckRateLimit())
+			return !m_bRateLimitDisconnect;
+		if (m_input_msg.IsHttpRequest() && !BeginHttpRequest(m_input_msg))
+			return true;
 		// TODO: some more check on method, uri, headers, etc, before dispatching it.  
 		NPLReturnCode nResult = m_msg_dispatcher.DispatchMsg(m_input_msg);
 
@@ -897,6 +1202,9 @@ bool NPL::CNPLConnection::handleMessageIn()
 					OUTPUT_LOG("NPL dispatcher error because incoming nid:%s NPLReturnCode %d.\n", GetNID().c_str(), nResult);
 				}
 			}
+			// otherwise the responses of later pipelined requests would wait for this one forever. 
+			if (m_input_msg.m_nHttpSeq >= 0)
+				EndHttpRequestWithError(m_input_msg, nResult);
 		}
 
 	}
@@ -910,6 +1218,52 @@ bool NPL::CNPLConnection::handleMessageIn()
 	return bRes;
 }
 
+bool NPL::CNPLConnection::CheckRateLimit()
+{
+	int nVersion = m_msg_dispatcher.GetRateLimitVersion();
+	if (m_rate_limiter.GetVersion() != nVersion)
+	{
+		m_rate_limiter.SetLimit(m_msg_dispatcher.GetConnectionRateLimit());
+		m_rate_limiter.SetVersion(nVersion);
+	}
+	int nBytes = (int)(m_input_msg.m_code.size() + m_input_msg.m_filename.size());
+	NPLRateLimitPolicy policy = m_rate_limiter.GetLimit().m_policy;
+	int nWaitMS = m_rate_limiter.Consume(nBytes, GetTickCount());
+	if (nWaitMS <= 0)
+		policy = RateLimit_Delay;
+
+	NPLRateLimitPolicy shared_policy;
+	int nSharedWaitMS = m_msg_dispatcher.CheckRateLimit(GetNID(), m_input_msg.m_filename, m_input_msg.m_n_filename, nBytes, shared_policy);
+	if (nSharedWaitMS > 0)
+	{
+		if (nSharedWaitMS > nWaitMS)
+			nWaitMS = nSharedWaitMS;
+		if (shared_policy > policy)
+			policy = shared_policy;
+	}
+	if (nWaitMS <= 0)
+		return true;
+
+	m_msg_dispatcher.AddRateLimitedCount();
+	if (policy == RateLimit_Delay)
+	{
+		// the message is accepted, but the next read is paused. 
+		if (nWaitMS > m_nReadDelayMS)
+			m_nReadDelayMS = nWaitMS;
+		return true;
+	}
+	else if (policy == RateLimit_Disconnect)
+	{
+		OUTPUT_LOG("warning: nid %s exceeded NPL rate limit, connection will be closed\n", GetNID().c_str());
+		m_bRateLimitDisconnect = true;
+	}
+	else if (GetLogLevel() > 0)
+	{
+		OUTPUT_LOG("NPL rate limit exceeded, message to %s from nid %s is dropped\n", m_input_msg.m_filename.c_str(), GetNID().c_str());
+	}
+	return false;
+}
+
 void NPL::CNPLConnection::SetAuthenticated(bool bAuthenticated)
 {
 	// no lock is needed. call this function when connection is connected. 
@@ -954,3 +1308,39 @@ void NPL::CNPLConnection::SetProtocol(ProtocolType protocolType)
 	m_protocolType = protocolType;
 }
 
+
+#ifdef _DEBUG
+/** a raw nid:http response to the first request and a static file to the second request on the same keep-alive connection. 
+* the file must be sent, nothing may stay pending, and responses of later requests must be ordered again. */
+void Test_HttpRawThenFile()
+{
+	NPL::CNPLHttpPipeline pipeline;
+	NPL::CNPLHttpPipeline::MsgList_Type msgs;
+	int nSeq1 = pipeline.BeginRequest(false);
+	int nSeq2 = pipeline.BeginRequest(false);
+
+	// the raw message itself is sent by the connection without the pipeline. 
+	pipeline.AddRawResponse(msgs);
+	bool bRawOK = msgs.empty() && pipeline.CanRespond(nSeq1);
+
+	NPL::NPLMsgOut_ptr file_msg(new NPL::NPLMsgOut());
+	file_msg->GetBuffer().append("HTTP/1.1 200 OK\r\nContent-Length: 5\r\n\r\n");
+	pipeline.AddResponse(nSeq2, file_msg, true, msgs);
+	bool bFileOK = msgs.size() == 1 && msgs[0] == file_msg && pipeline.GetPendingResponseCount() == 0;
+
+	// the third and fourth requests come after the raw send, so the fourth waits for the third. 
+	msgs.clear();
+	int nSeq3 = pipeline.BeginRequest(false);
+	int nSeq4 = pipeline.BeginRequest(true);
+	NPL::NPLMsgOut_ptr msg3(new NPL::NPLMsgOut()), msg4(new NPL::NPLMsgOut());
+	msg3->GetBuffer().append("3");
+	msg4->GetBuffer().append("4");
+	bool bClose = pipeline.AddResponse(nSeq4, msg4, true, msgs);
+	bool bOrderOK = msgs.empty() && !bClose;
+	bClose = pipeline.AddResponse(nSeq3, msg3, true, msgs);
+	bOrderOK = bOrderOK && msgs.size() == 2 && msgs[0] == msg3 && msgs[1] == msg4 && bClose && pipeline.BeginRequest(false) < 0;
+
+	OUTPUT_LOG("Test_HttpRawThenFile: raw response %s, file %s, order after raw %s\n", bRawOK ? "ok" : "failed", bFileOK ? "ok" : "failed", bOrderOK ? "ok" : "failed");
+	PE_ASSERT(bRawOK && bFileOK && bOrderOK);
+}
+#endif
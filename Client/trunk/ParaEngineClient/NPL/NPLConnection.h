@@ -5,10 +5,13 @@
 #include "NPLMsgOut.h"
 #include "NPLMsgIn_parser.h"
 #include "NPLMessageQueue.h"
+#include "NPLRateLimiter.h"
+#include "NPLHttpPipeline.h"
 #include "WebSocket/WebSocketReader.h"
 #include "WebSocket/WebSocketWriter.h"
 
 #include <boost/asio.hpp>
+#include <boost/asio/steady_timer.hpp>
 #include <boost/array.hpp>
 #include <boost/noncopyable.hpp>
 #include <boost/shared_ptr.hpp>
@@ -38,7 +41,18 @@ namespace NPL
 			WEBSOCKET = 1,
 			TCP_CUSTOM = 2, // any custom protocol, like google protocol buffer
 		};
+		/** flags of SendHttpResponse() */
+		enum HttpResponseFlag
+		{
+			/** data is sent as is, such as the status line and headers. */
+			HTTP_RESPONSE_RAW = 0,
+			/** data is framed as a chunk of "Transfer-Encoding: chunked". */
+			HTTP_RESPONSE_CHUNK = 1,
+			/** this is the last data of the response. if any chunk is sent, the terminating zero length chunk is appended. */
+			HTTP_RESPONSE_END = 2,
+		};
 		friend class CNPLDispatcher;
+		friend class CNPLConnectionManager;
 		typedef concurrent_ptr_queue<NPLMsgOut_ptr, dummy_condition_variable> RingBuffer_Type;
 		typedef std::map<std::string, int>	StringMap_Type;
 
@@ -101,6 +115,29 @@ namespace NPL
 		*/
 		NPLReturnCode SendMessage(NPLMsgOut_ptr& msg);
 
+		/**
+		* Send part of the response of a given HTTP request. 
+		* Responses of pipelined requests are sent in the order of their requests: data of a later request is buffered 
+		* until the responses of all previous requests are ended. The connection is closed once the response of the last 
+		* request that is allowed on this connection is ended. Requests received before a raw "nid:http" send are answered unordered, 
+		* see CNPLHttpPipeline. 
+		* [thread safe]
+		* @param nSeq: the request sequence number, i.e. msg.seq in the NPL HTTP handler. 
+		* @param data: the status line, headers or body data. 
+		* @param nLength: size of data. if -1, strlen() is used. 
+		* @param nFlags: bitwise fields of HttpResponseFlag. 
+		*/
+		NPLReturnCode SendHttpResponse(int nSeq, const char* data, int nLength = -1, int nFlags = HTTP_RESPONSE_END);
+
+		/**
+		* send a static file as the complete response of an HTTP GET or HEAD request. A weak ETag is generated from file size and 
+		* modification time, and "304 Not Modified" is sent if it matches the If-None-Match header. 
+		* On linux, file content is sent with sendfile() without copying it to user space. 
+		* [called in dispatcher thread]
+		* @return false if file can not be opened, in which case nothing is sent. 
+		*/
+		bool SendHttpFile(NPLMsgIn& msg, const std::string& sFilePath);
+
 		/** set the NPL runtime address that this connection connects to. */
 		void SetNPLRuntimeAddress(NPLRuntimeAddress_ptr runtime_address);
 	
@@ -215,7 +252,7 @@ namespace NPL
 		void TickReceive();
 
 		/** if any of the connection should be timed out. If so, send keep alive message or the caller should close it. 
-		* This function is called by a global service timer that periodically does the checking for all active connections. 
+		* This function is called by the connection manager when the idle timer of this connection is due. 
 		* @return 1 if not timed out. 0 if timed out,the caller should close the connection. -1 if timed out and keep alive is sent.  
 		*/
 		int CheckIdleTimeout(unsigned int nCurTime);
@@ -258,6 +295,11 @@ namespace NPL
 		*/
 		virtual bool handleMessageIn();
 
+		/** check and account the rate limits of m_input_msg. 
+		* @return false if the message should not be dispatched. 
+		*/
+		bool CheckRateLimit();
+
 	private:
 		/// try to parse websocket protocol
 		bool handle_websocket_data(int bytes_transferred);
@@ -273,6 +315,9 @@ namespace NPL
 		/// Handle completion of a write operation.
 		void handle_write(const boost::system::error_code& e);
 
+		/// resume reading after it is paused by a rate limit.
+		void handle_read_resume(const boost::system::error_code& e);
+
 		/// handle disconnection of this object
 		void handle_stop();
 
@@ -282,6 +327,24 @@ namespace NPL
 		/// handle connection init. This is only used for active connection to server. 
 		void handle_connect(const boost::system::error_code& error, boost::asio::ip::tcp::resolver::iterator endpoint_iterator);
 
+		/// start writing a message of the output queue, its file content is sent after the message buffer. 
+		void async_write_msg(NPLMsgOut* msg);
+
+		/// send file content of a message after its buffer is written. It waits until the socket is writable if sendfile() would block. 
+		/// on platforms without sendfile(), the file is sent in chunks through m_sendfile_buffer. 
+		void handle_sendfile(const boost::system::error_code& e, NPLMsgOut* msg);
+
+		/** update keep alive state of an incoming HTTP request and assign its sequence number. 
+		* @return false if the request should be ignored, because the connection is closing after a previous request. */
+		bool BeginHttpRequest(NPLMsgIn& msg);
+
+		/** end an HTTP request that can not be dispatched with a 503 or 500 response, so that the responses of later pipelined requests are not blocked by it. */
+		void EndHttpRequestWithError(NPLMsgIn& msg, NPLReturnCode nResult);
+
+		/** add a message to the response of a pipelined HTTP request and send the messages that m_http_pipeline releases. 
+		* it must be called with m_http_mutex locked. */
+		NPLReturnCode SendHttpResponse_unlocked(int nSeq, NPLMsgOut_ptr& msg, bool bEnd);
+
 		/// Socket for the connection.
 		boost::asio::ip::tcp::socket m_socket;
 
@@ -361,18 +424,37 @@ namespace NPL
 		/** Get last active time. */
 		uint32 m_nLastActiveTime;
 
+		/** whether this connection is in the idle timer wheel of the connection manager. guarded by the manager's timer mutex. */
+		bool m_bIdleTimerArmed;
+
 		/** when does this connection started */
 		uint32 m_nStartTime;
 
 		/** why is this connection stopped */
 		int32 m_nStopReason;
 
+		/** per connection rate limit of incoming messages. */
+		CNPLRateLimiter m_rate_limiter;
+		/** if not 0, the next read is paused for so many milliseconds. */
+		int m_nReadDelayMS;
+		/** the connection is closed because of a rate limit. */
+		bool m_bRateLimitDisconnect;
+		typedef boost::asio::basic_waitable_timer<boost::chrono::steady_clock> timer_type;
+		timer_type m_read_timer;
+
 		WebSocket::WebSocketReader m_websocket_reader;
 		WebSocket::WebSocketWriter m_websocket_writer;
 		std::vector<byte> m_websocket_input_data;
 		std::vector<byte> m_websocket_out_data;
+		/** chunk of the file being sent on platforms without sendfile(). only one message is written at a time. */
+		std::vector<char> m_sendfile_buffer;
 
 		ProtocolType m_protocolType;
+
+		/** orders the responses of pipelined HTTP requests. */
+		CNPLHttpPipeline m_http_pipeline;
+		/** guards HTTP response states, since responses are sent from NPL runtime states' threads. */
+		ParaEngine::mutex m_http_mutex;
 	};
 	
 
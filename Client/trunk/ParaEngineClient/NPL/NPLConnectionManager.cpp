@@ -12,7 +12,13 @@
 #include <boost/bind.hpp>
 #include "NPLConnectionManager.h"
 
+/** number of slots in the idle timer wheel. one round should be longer than the usual idle timeout period. */
+#define IDLE_TIMER_WHEEL_SIZE		256
+/** milliseconds per idle timer wheel tick. */
+#define IDLE_TIMER_WHEEL_TICK_MS	1000
+
 NPL::CNPLConnectionManager::CNPLConnectionManager()
+	:m_timer_wheel(IDLE_TIMER_WHEEL_SIZE), m_nWheelTick(0), m_nWheelTime(GetTickCount())
 {
 
 }
@@ -67,28 +73,89 @@ void NPL::CNPLConnectionManager::stop_all()
 	m_connections.clear();
 }
 
+void NPL::CNPLConnectionManager::ScheduleIdleTimeout(const NPLConnection_ptr& c, uint32 nDeadline)
+{
+	if (!c->IsIdleTimeoutEnabled() || c->GetIdleTimeoutPeriod() <= 0)
+		return;
+	if (nDeadline == 0)
+	{
+		uint32 nLastActiveTime = c->GetLastActiveTime();
+		nDeadline = ((nLastActiveTime != 0) ? nLastActiveTime : GetTickCount()) + c->GetIdleTimeoutPeriod();
+	}
+	ParaEngine::Lock lock_(m_timer_mutex);
+	if (c->m_bIdleTimerArmed)
+		return;
+	c->m_bIdleTimerArmed = true;
+	// the slot is processed after the tick containing the deadline is passed. 
+	int32 nDelay = (int32)(nDeadline - m_nWheelTime);
+	uint32 nTick = m_nWheelTick + ((nDelay > 0) ? (uint32)nDelay / IDLE_TIMER_WHEEL_TICK_MS : 0);
+	m_timer_wheel[nTick % m_timer_wheel.size()].push_back(c);
+}
+
 int NPL::CNPLConnectionManager::CheckIdleTimeout()
 {
 	std::list<NPLConnection_ptr> dead_connection_pool;
+	std::vector<NPLConnection_ptr> due_connections;
 
 	int nCount = 0;
+	unsigned int nCurTime = GetTickCount();
 	{
-		ParaEngine::Lock lock_(m_mutex);
-		unsigned int nCurTime = GetTickCount();
-
-		NPLConnectionPool_Type::iterator itCur, itEnd = m_connections.end();
-		for (itCur = m_connections.begin(); itCur!=itEnd; ++itCur)
+		ParaEngine::Lock lock_(m_timer_mutex);
+		// unsigned difference, so that the wrapping of tick count is fine. 
+		int32 nElapsed = (int32)(nCurTime - m_nWheelTime);
+		if (nElapsed < 0)
 		{
-			int nRes = (*itCur)->CheckIdleTimeout(nCurTime);
-			if(nRes != 1)
+			// the clock goes backwards, rebase the wheel to the current time. armed timers keep their remaining delays. 
+			m_nWheelTime = nCurTime;
+			nElapsed = 0;
+		}
+		uint32 nPassedTicks = (uint32)nElapsed / IDLE_TIMER_WHEEL_TICK_MS;
+		uint32 nSlotCount = (uint32)m_timer_wheel.size();
+		// if the wheel is not advanced for a whole round, each slot is visited once. 
+		uint32 nVisitCount = (std::min)(nPassedTicks, nSlotCount);
+		for (uint32 i = 0; i < nVisitCount; ++i)
+		{
+			TimerSlot_Type& slot = m_timer_wheel[(m_nWheelTick + i) % nSlotCount];
+			for (TimerSlot_Type::iterator itCur = slot.begin(); itCur != slot.end(); ++itCur)
 			{
-				 ++ nCount;
-				if(nRes == 0)
+				NPLConnection_ptr c = itCur->lock();
+				if (c)
 				{
-					// add to remove queue;
-					dead_connection_pool.push_back((*itCur));
+					c->m_bIdleTimerArmed = false;
+					due_connections.push_back(c);
 				}
 			}
+			slot.clear();
+		}
+		m_nWheelTick += nPassedTicks;
+		m_nWheelTime += nPassedTicks * IDLE_TIMER_WHEEL_TICK_MS;
+	}
+
+	for (std::vector<NPLConnection_ptr>::iterator itCur = due_connections.begin(); itCur != due_connections.end(); ++itCur)
+	{
+		NPLConnection_ptr& c = *itCur;
+		// closed connections just drop out of the wheel. 
+		if (!c->IsConnected())
+			continue;
+		int nRes = c->CheckIdleTimeout(nCurTime);
+		if (nRes == 1)
+		{
+			// active since the timer is armed. 
+			ScheduleIdleTimeout(c);
+		}
+		else
+		{
+			++nCount;
+			if (nRes == 0)
+			{
+				// add to remove queue;
+				dead_connection_pool.push_back(c);
+			}
+			else
+			{
+				// keep alive connection, check again after another period. 
+				ScheduleIdleTimeout(c, nCurTime + c->GetIdleTimeoutPeriod());
+			}
 		}
 	}
 	if(!dead_connection_pool.empty())
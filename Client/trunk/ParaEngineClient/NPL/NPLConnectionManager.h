@@ -1,6 +1,8 @@
 #pragma once
 #include "util/mutex.h"
 #include <set>
+#include <vector>
+#include <boost/weak_ptr.hpp>
 #include <boost/noncopyable.hpp>
 #include "NPLConnection.h"
 
@@ -48,17 +50,37 @@ namespace NPL
 		*/
 		int ForEachConnection(NPLConnectionCallBack* pCallback);
 
-		/** for all active connections, check if any of them should be timed out. If so, close it or send keep alive message. 
+		/** check connections whose idle timers are due, if any of them should be timed out, close it or send keep alive message. 
+		* Idle timers are kept in a hashed timing wheel, so only connections whose deadlines are reached are visited. 
+		* A connection that has been active since its timer was armed is simply re-armed at its new deadline. 
 		* This function is called by the NPLNetServer from an io service timer that periodically does the checking. 
 		* @return the number of timed out connections.
 		*/
 		int CheckIdleTimeout();
+
+		/** arm the idle timer of a connection, unless it is already armed or idle timeout is disabled on the connection. 
+		* send/receive activities never touch the timer, it is re-armed lazily when it is due. 
+		* [thread safe]
+		* @param nDeadline: GetTickCount() time when the timer is due. if 0, it is the last active time plus idle timeout period. 
+		*/
+		void ScheduleIdleTimeout(const NPLConnection_ptr& c, uint32 nDeadline = 0);
 	private:
 		typedef std::set<NPLConnection_ptr, NPLConnection_PtrOps> NPLConnectionPool_Type;
+		/** weak references, so that closed connections are released without touching the wheel. */
+		typedef std::vector< boost::weak_ptr<CNPLConnection> > TimerSlot_Type;
 		
 		/// The managed connections. It only keeps established connections, but it does not mean that the connection here is authenticated. 
 		NPLConnectionPool_Type m_connections;
 
 		ParaEngine::mutex m_mutex;
+
+		/** hashed timing wheel of idle timers. A timer due at tick t is in slot (t % size). */
+		std::vector<TimerSlot_Type> m_timer_wheel;
+		/** the next wheel tick to be processed. It only counts processed ticks, so it never goes backwards. */
+		uint32 m_nWheelTick;
+		/** GetTickCount() time when m_nWheelTick begins. */
+		uint32 m_nWheelTime;
+		/** guards the timing wheel. It is not m_mutex, so that start/stop are not blocked by timeout checking. */
+		ParaEngine::mutex m_timer_mutex;
 	};
 }
\ No newline at end of file
@@ -16,7 +16,7 @@
 
 NPL::CNPLDispatcher::CNPLDispatcher(CNPLNetServer* pServer)
 : m_pServer(pServer), m_bUseCompressionIncomingConnection(false), m_bUseCompressionOutgoingConnection(false),
-m_nCompressionLevel(-1), m_nCompressionThreshold(204800)
+m_nCompressionLevel(-1), m_nCompressionThreshold(204800), m_nHttpMaxKeepAliveRequests(0), m_nRateLimitVersion(0), m_nRateLimitedCount(0)
 {
 	PE_ASSERT(m_pServer!=0);
 }
@@ -66,6 +66,167 @@ int NPL::CNPLDispatcher::GetCompressionThreshold()
 	return m_nCompressionThreshold;
 }
 
+void NPL::CNPLDispatcher::SetHttpMaxKeepAliveRequests(int nCount)
+{
+	m_nHttpMaxKeepAliveRequests = nCount;
+}
+
+int NPL::CNPLDispatcher::GetHttpMaxKeepAliveRequests()
+{
+	return m_nHttpMaxKeepAliveRequests;
+}
+
+void NPL::CNPLDispatcher::SetRateLimit(int nScope, const NPLRateLimit& limit, const string& sFileName)
+{
+	ParaEngine::Lock lock_(m_rate_limit_mutex);
+	if (nScope == RateLimitScope_Connection)
+	{
+		m_connection_rate_limit = limit;
+		++m_nRateLimitVersion;
+	}
+	else if (nScope == RateLimitScope_NID)
+	{
+		m_nid_rate_limit = limit;
+		m_nid_rate_limiters.clear();
+	}
+	else if (nScope == RateLimitScope_File && !sFileName.empty())
+	{
+		if (limit.IsEnabled())
+			m_file_rate_limiters[sFileName].SetLimit(limit);
+		else
+			m_file_rate_limiters.erase(sFileName);
+	}
+}
+
+NPL::NPLRateLimit NPL::CNPLDispatcher::GetConnectionRateLimit()
+{
+	ParaEngine::Lock lock_(m_rate_limit_mutex);
+	return m_connection_rate_limit;
+}
+
+int NPL::CNPLDispatcher::CheckRateLimit(const string& sNID, const string& sFileName, int nFileID, int nBytes, NPLRateLimitPolicy& policy)
+{
+	policy = RateLimit_Delay;
+	ParaEngine::Lock lock_(m_rate_limit_mutex);
+	if (!m_nid_rate_limit.IsEnabled() && m_file_rate_limiters.empty())
+		return 0;
+	string sFile = sFileName;
+	if (sFile.empty() && nFileID != 0 && !m_file_rate_limiters.empty())
+		GetPubFileNameByID(sFile, nFileID);
+
+	uint32 nCurTime = GetTickCount();
+	int nWaitMS = 0;
+	if (m_nid_rate_limit.IsEnabled())
+	{
+		std::map<string, CNPLRateLimiter>::iterator it = m_nid_rate_limiters.find(sNID);
+		if (it == m_nid_rate_limiters.end())
+		{
+			if (m_nid_rate_limiters.size() >= 4096)
+			{
+				// remove all NIDs whose buckets are refilled, they have been idle for a while. 
+				for (it = m_nid_rate_limiters.begin(); it != m_nid_rate_limiters.end();)
+				{
+					if (it->second.IsFull(nCurTime))
+						it = m_nid_rate_limiters.erase(it);
+					else
+						++it;
+				}
+			}
+			it = m_nid_rate_limiters.insert(std::make_pair(sNID, CNPLRateLimiter())).first;
+			it->second.SetLimit(m_nid_rate_limit);
+		}
+		nWaitMS = it->second.Consume(nBytes, nCurTime);
+		if (nWaitMS > 0)
+			policy = m_nid_rate_limit.m_policy;
+	}
+	if (!sFile.empty())
+	{
+		std::map<string, CNPLRateLimiter>::iterator it = m_file_rate_limiters.find(sFile);
+		if (it != m_file_rate_limiters.end())
+		{
+			int nFileWaitMS = it->second.Consume(nBytes, nCurTime);
+			if (nFileWaitMS > 0)
+			{
+				if (nFileWaitMS > nWaitMS)
+					nWaitMS = nFileWaitMS;
+				if (it->second.GetLimit().m_policy > policy)
+					policy = it->second.GetLimit().m_policy;
+			}
+		}
+	}
+	return nWaitMS;
+}
+
+void NPL::CNPLDispatcher::AddHttpStaticDir(const string& sURLPrefix, const string& sDiskDir)
+{
+	ParaEngine::Lock lock_(m_mutex);
+	for (auto it = m_http_static_dirs.begin(); it != m_http_static_dirs.end(); ++it)
+	{
+		if (it->first == sURLPrefix)
+		{
+			m_http_static_dirs.erase(it);
+			break;
+		}
+	}
+	if (!sDiskDir.empty())
+	{
+		string sDir = sDiskDir;
+		char cLast = sDir[sDir.size() - 1];
+		if (cLast != '/' && cLast != '\\')
+			sDir.push_back('/');
+		// keep longer prefixes in front, so that the most specific one wins. 
+		auto it = m_http_static_dirs.begin();
+		while (it != m_http_static_dirs.end() && it->first.size() >= sURLPrefix.size())
+			++it;
+		m_http_static_dirs.insert(it, std::make_pair(sURLPrefix, sDir));
+	}
+}
+
+bool NPL::CNPLDispatcher::GetHttpStaticFile(const string& sURL, string& sFilePath)
+{
+	// remove query string and decode %XX
+	string sPath;
+	sPath.reserve(sURL.size());
+	for (size_t i = 0; i < sURL.size() && sURL[i] != '?' && sURL[i] != '#'; ++i)
+	{
+		char c = sURL[i];
+		if (c == '%' && (i + 2) < sURL.size() && isxdigit((byte)sURL[i + 1]) && isxdigit((byte)sURL[i + 2]))
+		{
+			char hex[3] = { sURL[i + 1], sURL[i + 2], '\0' };
+			c = (char)strtol(hex, NULL, 16);
+			i += 2;
+		}
+		sPath.push_back(c);
+	}
+	// never serve files outside the static directories. 
+	if (sPath.find("..") != string::npos || sPath.find('\0') != string::npos)
+		return false;
+
+	sFilePath.clear();
+	{
+		ParaEngine::Lock lock_(m_mutex);
+		for (auto it = m_http_static_dirs.begin(); it != m_http_static_dirs.end(); ++it)
+		{
+			// "/static" matches "/static" and "/static/a.html", but not "/staticfoo". 
+			size_t nPrefixSize = it->first.size();
+			if (sPath.compare(0, nPrefixSize, it->first) == 0 && 
+				(nPrefixSize == sPath.size() || sPath[nPrefixSize] == '/' || (nPrefixSize > 0 && it->first[nPrefixSize - 1] == '/')))
+			{
+				size_t nStart = it->first.size();
+				while (nStart < sPath.size() && sPath[nStart] == '/')
+					++nStart;
+				sFilePath = it->second + sPath.substr(nStart);
+				break;
+			}
+		}
+	}
+	if (sFilePath.empty())
+		return false;
+	if (sFilePath[sFilePath.size() - 1] == '/')
+		sFilePath.append("index.html");
+	return true;
+}
+
 NPL::NPLConnection_ptr NPL::CNPLDispatcher::CreateGetNPLConnectionByNID( const string& sNID )
 {
 	ParaEngine::Lock lock_(m_mutex);
@@ -294,7 +455,7 @@ bool NPL::CNPLDispatcher::CheckPubFile( string& filename, int& nID )
 	return false;
 }
 
-NPL::NPLReturnCode NPL::CNPLDispatcher::Activate_Async( const NPLFileName& file_name, const char * code /*= NULL*/, int nLength/*=0*/, int priority/*=0*/ )
+NPL::NPLReturnCode NPL::CNPLDispatcher::Activate_Async( const NPLFileName& file_name, const char * code /*= NULL*/, int nLength/*=0*/, int priority/*=0*/, int channel/*=0*/, int reliability/*=RELIABLE_ORDERED*/ )
 {
 	if(file_name.sNID.empty())
 	{
@@ -308,6 +469,11 @@ NPL::NPLReturnCode NPL::CNPLDispatcher::Activate_Async( const NPLFileName& file_
 	else
 	{
 		// this is a remote activation
+		CNPLUDPTransport& udp_transport = m_pServer->GetUDPTransport();
+		if (udp_transport.HasPeer(file_name.sNID))
+		{
+			return udp_transport.SendMessage(file_name, code, nLength, channel, reliability);
+		}
 		NPLConnection_ptr pConnection = CreateGetNPLConnectionByNID(file_name.sNID);
 		if(pConnection)
 		{
@@ -318,6 +484,50 @@ NPL::NPLReturnCode NPL::CNPLDispatcher::Activate_Async( const NPLFileName& file_
 	return NPL_Error;
 }
 
+NPL::NPLReturnCode NPL::CNPLDispatcher::DispatchUDPMsg(const string& sRtsName, string& sFileName, const char* code, int nLength, const string& sNID, bool bAuthenticated)
+{
+	NPLRuntimeState_ptr pRuntime = ParaEngine::CGlobals::GetNPLRuntime()->GetRuntimeState(sRtsName);
+	if (!pRuntime)
+		return NPL_RuntimeState_NotExist;
+	NPLRateLimitPolicy policy;
+	if (CheckRateLimit(sNID, sFileName, 0, nLength + (int)sFileName.size(), policy) > 0)
+	{
+		// UDP reads can not be delayed per peer, so that messages over limit are always dropped. 
+		AddRateLimitedCount();
+		return NPL_QueueIsFull;
+	}
+	int nFileID = 0;
+	if (!CheckPubFile(sFileName, nFileID))
+	{
+		OUTPUT_LOG("error: NPL remote file access denied: %s(udp)\n", sFileName.c_str());
+		return NPL_FileAccessDenied;
+	}
+	NPLMessage_ptr msg_(new NPLMessage());
+	msg_->m_filename = sFileName;
+	msg_->m_code.reserve(nLength + 36);
+	msg_->m_code.append("msg={");
+	if (nLength > 0)
+	{
+		msg_->m_code.append(code, nLength);
+		if (code[nLength - 1] != ',')
+			msg_->m_code.append(',');
+	}
+	// nid or tid is appended last, so that the one in the input message is overridden by the real value. 
+	if (bAuthenticated)
+	{
+		msg_->m_code.append("nid=");
+		NPLHelper::EncodeStringInQuotation(msg_->m_code, msg_->m_code.size(), sNID);
+		msg_->m_code.append("}");
+	}
+	else
+	{
+		msg_->m_code.append("tid=");
+		NPLHelper::EncodeStringInQuotation(msg_->m_code, msg_->m_code.size(), sNID);
+		msg_->m_code.append(",nid=nil}");
+	}
+	return pRuntime->Activate_async(msg_);
+}
+
 int NPL::CNPLDispatcher::PostNetworkEvent(NPLReturnCode nNPLNetworkCode, const char * sNid, const char* sMsg)
 {
 	CNPLWriter writer;
@@ -398,6 +608,9 @@ NPL::NPLReturnCode NPL::CNPLDispatcher::DispatchMsg( NPLMsgIn& msg )
 		}
 		else if(msg.method == "npl")
 		{
+			// keep alive message is only used to refresh the idle timer, which is already done on receive. 
+			if (msg.m_filename == "keepalive")
+				return NPL_OK;
 			OUTPUT_LOG("NPL network command: %s %s\n", msg.m_filename.c_str(), msg.m_code.c_str());
 			// npl low level command message
 			if(msg.m_filename == "connect_overriden")
@@ -409,6 +622,13 @@ NPL::NPLReturnCode NPL::CNPLDispatcher::DispatchMsg( NPLMsgIn& msg )
 		else
 		{
 			// http message
+			if (msg.m_nHttpSeq >= 0 && (msg.method == "GET" || msg.method == "HEAD"))
+			{
+				// static files are served without a round trip to the NPL runtime state. 
+				std::string sFilePath;
+				if (GetHttpStaticFile(msg.m_filename, sFilePath) && msg.m_pConnection->SendHttpFile(msg, sFilePath))
+					return NPL_OK;
+			}
 			std::string filename;
 			int nHTTPCode = -10;
 			if(CheckPubFile(filename, nHTTPCode))
@@ -436,6 +656,14 @@ NPL::NPLReturnCode NPL::CNPLDispatcher::DispatchMsg( NPLMsgIn& msg )
 				msg_->m_code.append(msg.m_n_filename);
 				msg_->m_code.append(",");
 
+				// seq is used to send the response with NPL.SendHttpResponse(), so that pipelined responses are in order. 
+				if (msg.m_nHttpSeq >= 0)
+				{
+					msg_->m_code.append("seq=");
+					msg_->m_code.append((int32)msg.m_nHttpSeq);
+					msg_->m_code.append(msg.m_bHttpKeepAlive ? ",keepalive=true," : ",keepalive=false,");
+				}
+
 				// add headers
 				int nCount = (int)msg.headers.size();
 				for (int i=0;i <nCount; ++i)
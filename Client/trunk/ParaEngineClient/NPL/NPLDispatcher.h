@@ -3,6 +3,7 @@
 #include <boost/bimap.hpp>
 #include <boost/thread/shared_mutex.hpp>
 #include <string>
+#include <atomic>
 
 #include "NPLCommon.h"
 #include "NPLMessageQueue.h"
@@ -95,9 +96,10 @@ namespace NPL
 		* @param code: it is a chunk of pure data table init code that would be transmitted to the destination file. 
 		* @param nLength: the code length. if this is 0, length is determined from code by finding '\0', 
 		* @param priority: if 0 it is normal priority. if 1 it will be inserted to the front of the message queue. 
+		* @param channel, reliability: only used if the NID is a UDP peer. see CNPLUDPTransport
 		* @return if failed, such as the runtime state does not exist, etc. 
 		*/
-		NPLReturnCode Activate_Async(const NPLFileName& file_name, const char * code = NULL, int nLength=0, int priority=0);
+		NPLReturnCode Activate_Async(const NPLFileName& file_name, const char * code = NULL, int nLength=0, int priority=0, int channel=0, int reliability=RELIABLE_ORDERED);
 
 		/**
 		* Dispatch a message from a given socket connection to a local NPL runtime state. This function is called by the connection object's data handler
@@ -107,6 +109,12 @@ namespace NPL
 		* @return if failed, such as the runtime state does not exist, etc. 
 		*/
 		NPLReturnCode DispatchMsg(NPLMsgIn& msg);
+
+		/**
+		* same as DispatchMsg, except that the message is received by the UDP transport. 
+		* @param sNID: nid of the UDP peer. if bAuthenticated is false, it is passed as msg.tid. 
+		*/
+		NPLReturnCode DispatchUDPMsg(const string& sRtsName, string& sFileName, const char* code, int nLength, const string& sNID, bool bAuthenticated);
 		
 
 		/**
@@ -192,6 +200,65 @@ namespace NPL
 		void SetCompressionThreshold(int nThreshold);
 		int GetCompressionThreshold();
 
+		/** serve HTTP GET/HEAD requests whose url begins with sURLPrefix from files in sDiskDir directly in the dispatcher thread, 
+		* without activating any NPL file. Files are sent with ETag and If-None-Match is answered with 304. 
+		* Requests to files that do not exist are still dispatched to the NPL HTTP handler as usual. 
+		* [thread safe]
+		* @param sURLPrefix: such as "/static/". 
+		* @param sDiskDir: such as "www/static/". if empty, the mapping of sURLPrefix is removed. 
+		*/
+		void AddHttpStaticDir(const string& sURLPrefix, const string& sDiskDir);
+
+		/** get the disk file of a given url, according to AddHttpStaticDir(). 
+		* [thread safe]
+		* @return false if the url does not match any static dir or the file does not exist. 
+		*/
+		bool GetHttpStaticFile(const string& sURL, string& sFilePath);
+
+		/** max number of HTTP requests served on a single keep-alive connection. The connection is closed after the response 
+		* of the last one is sent. default to 0, which means unlimited. 
+		*/
+		void SetHttpMaxKeepAliveRequests(int nCount);
+		int GetHttpMaxKeepAliveRequests();
+
+		/** the scope of a rate limit on incoming messages. */
+		enum RateLimitScope
+		{
+			/** each incoming connection has its own buckets. */
+			RateLimitScope_Connection = 0,
+			/** each NID (or tid) has its own buckets, which are shared by all of its connections and UDP peers. */
+			RateLimitScope_NID,
+			/** all messages to a given neuron file share the same buckets. */
+			RateLimitScope_File,
+		};
+
+		/** set token bucket limits on incoming messages. Limits are checked after a message is parsed and before it is
+		* copied to the runtime state's message queue. 
+		* [thread safe]
+		* @param nScope: one of RateLimitScope
+		* @param limit: if its rates are 0, the limit of the scope (or file) is removed. 
+		* @param sFileName: only used for RateLimitScope_File
+		*/
+		void SetRateLimit(int nScope, const NPLRateLimit& limit, const string& sFileName = "");
+
+		/** the per connection limit and its version, which is increased whenever it is changed. 
+		* [thread safe]
+		*/
+		NPLRateLimit GetConnectionRateLimit();
+		int GetRateLimitVersion() { return m_nRateLimitVersion; }
+
+		/** check and account the per NID and per file limits of an incoming message. 
+		* [thread safe]
+		* @param sFileName, nFileID: the target file name or its public file id. 
+		* @param policy: the policy of the exceeded limit, the most severe one if several limits are exceeded. 
+		* @return 0 if the message is within all limits, otherwise milliseconds to wait. 
+		*/
+		int CheckRateLimit(const string& sNID, const string& sFileName, int nFileID, int nBytes, NPLRateLimitPolicy& policy);
+
+		/** number of incoming messages that exceeded any rate limit. */
+		void AddRateLimitedCount() { ++m_nRateLimitedCount; }
+		int GetRateLimitedCount() { return m_nRateLimitedCount; }
+
 	protected:
 		/**
 		* Create a new connection with a remote server and immediately connect and start the connection. 
@@ -245,6 +312,24 @@ namespace NPL
 		*/
 		StringBimap_Type m_public_filemap;
 
+		/** url prefix to disk directory pairs for static HTTP files. longer prefixes are tested first. */
+		std::vector< std::pair<string, string> > m_http_static_dirs;
+
+		/** max number of HTTP requests served on a single keep-alive connection. */
+		int m_nHttpMaxKeepAliveRequests;
+
+		/** per connection rate limit, connections sync with it when m_nRateLimitVersion changes. */
+		NPLRateLimit m_connection_rate_limit;
+		NPLRateLimit m_nid_rate_limit;
+		std::atomic<int> m_nRateLimitVersion;
+		/** buckets of each NID. idle ones are removed when there are too many of them. */
+		std::map<string, CNPLRateLimiter> m_nid_rate_limiters;
+		/** buckets of each file that has a limit. */
+		std::map<string, CNPLRateLimiter> m_file_rate_limiters;
+		std::atomic<int> m_nRateLimitedCount;
+		/** guards rate limit settings and buckets. */
+		ParaEngine::mutex m_rate_limit_mutex;
+
 		/** the server object */
 		CNPLNetServer* m_pServer;
 	};
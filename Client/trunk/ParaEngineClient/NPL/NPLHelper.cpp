@@ -1072,6 +1072,42 @@ bool NPL::NPLHelper::StringToAnyObject(const char* input, int nLen, luabind::obj
 	return false;
 }
 
+bool NPL::NPLHelper::StatementsToLuaObject(const char* input, int nLen, luabind::object& output)
+{
+	NPLLex lex;
+	LexState* ls = lex.SetInput(input, nLen);
+	ls->nestlevel = 0;
+
+	try
+	{
+		NPLParser::next(ls);  /* read first token */
+		while (ls->t.token == NPLLex::TK_NAME)
+		{
+			std::string sName = ls->t.seminfo.ts;
+			NPLParser::next(ls);
+			if (ls->t.token != '=')
+				return false;
+			NPLParser::next(ls);
+			luabind::object_index_proxy fieldProxy = output[sName];
+			if (!DeserializePureDataBlock(ls, fieldProxy))
+				return false;
+			NPLParser::testnext(ls, ';');
+		}
+		return ls->t.token == NPLLex::TK_EOS;
+	}
+	catch (const char* err)
+	{
+		OUTPUT_LOG("error: %s in NPLHelper::StatementsToLuaObject()\n", err);
+		return false;
+	}
+	catch (...)
+	{
+		OUTPUT_LOG("error: unknown error in NPLHelper::StatementsToLuaObject()\n");
+		return false;
+	}
+	return false;
+}
+
 
 NPLObjectProxy NPL::NPLHelper::MsgStringToNPLTable(const char* input, int nLen)
 {
@@ -113,6 +113,13 @@ namespace NPL
 		*/
 		static bool MsgStringToLuaObject(const char* input,int nLen, lua_State* pState);
 
+		/** convert a sequence of pure data assignments, such as the event script code "mouse_button=\"left\";mouse_x=10;", 
+		* to fields of the output table without compiling it. 
+		* @param output: an existing table object. each name=value statement sets output[name] = value. 
+		* @return true if succeed. 
+		*/
+		static bool StatementsToLuaObject(const char* input, int nLen, luabind::object& output);
+
 		/** converting string to NPL table object 
 		* @param input: such as "{nid=10, name=\"value\", tab={name1=\"value1\"}}"
 		*/
@@ -0,0 +1,109 @@
+//-----------------------------------------------------------------------------
+// Class:	CNPLHttpPipeline
+// Company: ParaEngine
+// Desc: orders the responses of pipelined HTTP requests on a connection.
+//-----------------------------------------------------------------------------
+#include "ParaEngine.h"
+#include "NPLHttpPipeline.h"
+
+using namespace NPL;
+
+NPL::CNPLHttpPipeline::CNPLHttpPipeline()
+	:m_nRequestCount(0), m_nResponseSeq(0), m_nUnorderedSeq(0), m_nLastSeq(-1), m_nIgnoredCount(0)
+{
+}
+
+int NPL::CNPLHttpPipeline::BeginRequest(bool bLast)
+{
+	if (m_nLastSeq >= 0)
+	{
+		++m_nIgnoredCount;
+		return -1;
+	}
+	int nSeq = m_nRequestCount++;
+	if (bLast)
+		m_nLastSeq = nSeq;
+	return nSeq;
+}
+
+bool NPL::CNPLHttpPipeline::CanRespond(int nSeq)
+{
+	if (nSeq < 0 || nSeq >= m_nRequestCount)
+		return false;
+	if (nSeq >= m_nUnorderedSeq && nSeq < m_nResponseSeq)
+		return false;
+	auto it = m_responses.find(nSeq);
+	return it == m_responses.end() || !it->second.m_bEnded;
+}
+
+bool NPL::CNPLHttpPipeline::IsChunked(int nSeq)
+{
+	auto it = m_responses.find(nSeq);
+	return it != m_responses.end() && it->second.m_bChunked;
+}
+
+void NPL::CNPLHttpPipeline::SetChunked(int nSeq)
+{
+	m_responses[nSeq].m_bChunked = true;
+}
+
+bool NPL::CNPLHttpPipeline::AddResponse(int nSeq, NPLMsgOut_ptr& msg, bool bEnd, MsgList_Type& outMsgs)
+{
+	if (nSeq < m_nUnorderedSeq)
+	{
+		if (!msg->empty())
+			outMsgs.push_back(msg);
+		if (!bEnd)
+			return false;
+		m_responses.erase(nSeq);
+		return nSeq == m_nLastSeq;
+	}
+	if (nSeq != m_nResponseSeq)
+	{
+		// wait for the responses of previous requests
+		PendingResponse& response = m_responses[nSeq];
+		if (!msg->empty())
+			response.m_msgs.push_back(msg);
+		response.m_bEnded = bEnd;
+		return false;
+	}
+
+	if (!msg->empty())
+		outMsgs.push_back(msg);
+	if (!bEnd)
+		return false;
+	// send the following responses that are already waiting for this one.
+	m_responses.erase(m_nResponseSeq++);
+	auto it = m_responses.find(m_nResponseSeq);
+	while (it != m_responses.end())
+	{
+		outMsgs.insert(outMsgs.end(), it->second.m_msgs.begin(), it->second.m_msgs.end());
+		it->second.m_msgs.clear();
+		if (!it->second.m_bEnded)
+			break;
+		m_responses.erase(it);
+		it = m_responses.find(++m_nResponseSeq);
+	}
+	return m_nLastSeq >= 0 && m_nResponseSeq > m_nLastSeq;
+}
+
+bool NPL::CNPLHttpPipeline::AddRawResponse(MsgList_Type& outMsgs)
+{
+	bool bClose = false;
+	for (auto it = m_responses.begin(); it != m_responses.end();)
+	{
+		outMsgs.insert(outMsgs.end(), it->second.m_msgs.begin(), it->second.m_msgs.end());
+		it->second.m_msgs.clear();
+		if (it->second.m_bEnded)
+		{
+			if (it->first == m_nLastSeq)
+				bClose = true;
+			it = m_responses.erase(it);
+		}
+		else
+			++it;
+	}
+	m_nUnorderedSeq = m_nRequestCount;
+	m_nResponseSeq = m_nRequestCount;
+	return bClose;
+}
@@ -0,0 +1,75 @@
+#pragma once
+#include "NPLMsgOut.h"
+#include <map>
+#include <vector>
+
+namespace NPL
+{
+	/**
+	* keeps the responses of pipelined HTTP requests on a connection in the order of their requests.
+	* It only decides which messages can be sent; the connection sends them. It is not thread safe.
+	*
+	* A raw "nid:http" send does not tell which request it answers or when its response ends. So all requests received
+	* before it are answered unordered, and ordering starts again from the next request.
+	*/
+	class CNPLHttpPipeline
+	{
+	public:
+		typedef std::vector<NPLMsgOut_ptr> MsgList_Type;
+
+		CNPLHttpPipeline();
+
+		/** assign the sequence number of a new request.
+		* @param bLast: true if the connection is closed after the response of this request.
+		* @return the sequence number, or -1 if the request is ignored, because it comes after the last one. */
+		int BeginRequest(bool bLast);
+
+		/** number of requests that are assigned a sequence number. */
+		int GetRequestCount() const { return m_nRequestCount; }
+
+		/** number of requests that are ignored, because they come after the last one. */
+		int GetIgnoredRequestCount() const { return m_nIgnoredCount; }
+
+		/** whether more response data can be added to the given request. */
+		bool CanRespond(int nSeq);
+
+		/** whether the body of the response is sent with "Transfer-Encoding: chunked". */
+		bool IsChunked(int nSeq);
+		void SetChunked(int nSeq);
+
+		/** add a message to the response of a request.
+		* @param outMsgs: messages that can be sent now are appended to it in order. It may include messages of later requests.
+		* @return true if the connection should be closed after outMsgs are sent. */
+		bool AddResponse(int nSeq, NPLMsgOut_ptr& msg, bool bEnd, MsgList_Type& outMsgs);
+
+		/** called after a raw "nid:http" send. requests received so far are answered unordered from now on.
+		* @param outMsgs: buffered messages of these requests are appended to it in order.
+		* @return true if the connection should be closed after outMsgs are sent. */
+		bool AddRawResponse(MsgList_Type& outMsgs);
+
+		/** number of responses whose data is buffered or not ended. */
+		int GetPendingResponseCount() const { return (int)m_responses.size(); }
+
+	private:
+		/** a response that is not completely sent. */
+		struct PendingResponse
+		{
+			PendingResponse() :m_bChunked(false), m_bEnded(false){};
+			/** messages that are waiting for responses of previous requests. */
+			MsgList_Type m_msgs;
+			bool m_bChunked;
+			bool m_bEnded;
+		};
+		/** responses that are not ended yet, keyed by request sequence number. */
+		std::map<int, PendingResponse> m_responses;
+		/** number of requests received, it is also the sequence number of the next request. */
+		int m_nRequestCount;
+		/** the sequence number of the ordered response that is being sent. */
+		int m_nResponseSeq;
+		/** responses of requests before this sequence number are sent as they come. */
+		int m_nUnorderedSeq;
+		/** the connection is closed after the response of this request is ended. -1 to keep alive. */
+		int m_nLastSeq;
+		int m_nIgnoredCount;
+	};
+}
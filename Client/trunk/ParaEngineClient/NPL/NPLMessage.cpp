@@ -13,7 +13,7 @@
 #include "NPLMessage.h"
 
 NPL::NPLMessage::NPLMessage()
-:m_type(MSG_TYPE_FILE_ACTIVATION)
+:m_type(MSG_TYPE_FILE_ACTIVATION), m_nQueueTime(0)
 {
 
 }
@@ -44,6 +44,8 @@ namespace NPL
 		std::string m_filename;
 		/// must be secure code. 
 		ParaEngine::StringBuilder m_code;
+		/// time in microseconds when the message is queued by a worker pool, 0 if the message is not timed. 
+		int64 m_nQueueTime;
 	};
 
 
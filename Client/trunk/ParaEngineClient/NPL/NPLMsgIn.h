@@ -27,6 +27,12 @@ namespace NPL
 
 		/** the connection object from which this message is received. */
 		CNPLConnection * m_pConnection;
+
+		/** sequence number of the HTTP request on its connection, starting from 0. -1 if it is not an HTTP request. 
+		* responses sent with CNPLConnection::SendHttpResponse() are ordered by it. */
+		int m_nHttpSeq;
+		/** whether the connection is kept alive after the response of this HTTP request. */
+		bool m_bHttpKeepAlive;
 	public:
 		void reset()
 		{
@@ -39,12 +45,32 @@ namespace NPL
 
 			m_nLength = 0;
 			m_code.clear();
+
+			m_nHttpSeq = -1;
+			m_bHttpKeepAlive = false;
 		}
 
 		bool IsNPLFileActivation()
 		{
 			return (method.size() > 0 && (((byte)(method[0])) > 127 || method == "A"));
 		}
+
+		/** whether it is an incoming HTTP request, such as GET, POST, but not an HTTP response or NPL message. */
+		bool IsHttpRequest()
+		{
+			return (method.size() > 2 && !IsNPLFileActivation() && method != "npl" && method.compare(0, 5, "HTTP/") != 0);
+		}
+
+		/** get the value of the given header. The name is case insensitive. return NULL if not found. */
+		const char* GetHeader(const char* name)
+		{
+			for (size_t i = 0; i < headers.size(); ++i)
+			{
+				if (stricmp(headers[i].name.c_str(), name) == 0)
+					return headers[i].value.c_str();
+			}
+			return NULL;
+		}
 	};
 
 } // NPL
@@ -12,6 +12,11 @@
 #include "NPLCodec.h"
 #include "util/StringHelper.h"
 #include <boost/lexical_cast.hpp>
+#ifdef WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
 
 #ifdef _DEBUG
 	/** @def define this to include version string NPL/1.0 on the first line of each NPL message. */
@@ -21,6 +26,24 @@
 namespace NPL{
 	bool CNPLMsgOut_gen::g_enable_ansi_mode = true;
 
+	NPLMsgOut::~NPLMsgOut()
+	{
+		if (m_nFileHandle >= 0)
+		{
+			::close(m_nFileHandle);
+			m_nFileHandle = -1;
+		}
+	}
+
+	void NPLMsgOut::SetFile(int nFileHandle, int64 nOffset, int64 nSize)
+	{
+		if (m_nFileHandle >= 0 && m_nFileHandle != nFileHandle)
+			::close(m_nFileHandle);
+		m_nFileHandle = nFileHandle;
+		m_nFileOffset = nOffset;
+		m_nFileSize = nSize;
+	}
+
 	namespace status_strings {
 		const std::string ok =
 			"NPL/1.0 200 OK\r\n";
@@ -27,13 +27,28 @@ namespace NPL
 		private boost::noncopyable
 	{
 	public:
-		virtual ~NPLMsgOut(){};
+		NPLMsgOut() :m_nFileHandle(-1), m_nFileOffset(0), m_nFileSize(0){};
+		virtual ~NPLMsgOut();
 
 		/// The content to be sent in the reply.
 		ParaEngine::StringBuilder m_msg;
 
+		/** an optional opened file descriptor, whose content [m_nFileOffset, m_nFileOffset+m_nFileSize) is sent with sendfile() (or in chunks where it is not available) right after m_msg.
+		* it is used for static HTTP files. The file is closed when the message is destroyed. -1 if there is no file.
+		*/
+		int m_nFileHandle;
+		int64 m_nFileOffset;
+		/** number of file bytes that are not sent yet. */
+		int64 m_nFileSize;
+
 		/** if message is empty */
-		bool empty() {return m_msg.empty();}
+		bool empty() {return m_msg.empty() && !HasFile();}
+
+		/** whether there is file content to be sent after m_msg. */
+		bool HasFile() const { return m_nFileHandle >= 0; }
+
+		/** take the ownership of an opened file descriptor, whose content is sent after m_msg. */
+		void SetFile(int nFileHandle, int64 nOffset, int64 nSize);
 
 		/** get the internal string buffer */
 		ParaEngine::StringBuilder& GetBuffer() {return m_msg;};
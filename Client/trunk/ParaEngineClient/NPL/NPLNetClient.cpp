@@ -14,6 +14,10 @@
 #include "AISimulator.h"
 #include "util/HttpUtility.h"
 #include "NPLNetClient.h"
+#include <climits>
+#ifndef WIN32
+#include <poll.h>
+#endif
 
 #ifdef PARAENGINE_CLIENT
 #include "ParaWorldAsset.h"
@@ -26,13 +30,15 @@
 #define DEFAULT_REST_POOL_SIZE		5
 /**@def default web request pool size */
 #define DEFAULT_WEB_POOL_SIZE		5
+/**@def default max number of connections to a single host in a request pool */
+#define DEFAULT_MAX_HOST_CONNECTIONS		6
 
 using namespace ParaEngine;
 
 static CNPLNetClient* g_pNPLNetClient;
 
 ParaEngine::CNPLNetClient::CNPLNetClient()
-: m_dispatcher_io_service()
+: m_share_handle(NULL), m_dispatcher_io_service()
 {
 	g_pNPLNetClient = this;
 	m_work_lifetime.reset(new boost::asio::io_service::work(m_dispatcher_io_service));
@@ -89,6 +95,26 @@ void ParaEngine::CNPLNetClient::Cleanup()
 		}
 		m_request_pools.clear();
 	}
+	// the share handle can only be freed after all easy handles using it are cleaned up. 
+	if (m_share_handle)
+	{
+		curl_share_cleanup(m_share_handle);
+		m_share_handle = NULL;
+	}
+}
+
+CURLSH* ParaEngine::CNPLNetClient::GetShareHandle()
+{
+	if (m_share_handle == NULL)
+	{
+		m_share_handle = curl_share_init();
+		if (m_share_handle)
+		{
+			curl_share_setopt(m_share_handle, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+			curl_share_setopt(m_share_handle, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+		}
+	}
+	return m_share_handle;
 }
 
 INPLWebService* ParaEngine::CNPLNetClient::GetWebService( const char* sURL )
@@ -229,7 +255,7 @@ CRequestTaskPool* ParaEngine::CNPLNetClient::CreateGetRequestTaskPool( const cha
 			OUTPUT_LOG("warning: max number of pool numbers reached. %s is not created. AppendURLRequest ignored. \n", strPoolName.c_str());
 			return NULL;
 		}
-		pTaskPool = new CRequestTaskPool();
+		pTaskPool = new CRequestTaskPool(GetShareHandle());
 		if(strPoolName == "d")
 		{
 			pTaskPool->SetMaxTaskSlotsCount(DEFAULT_DOWNLOAD_POOL_SIZE);
@@ -344,6 +370,12 @@ void ParaEngine::CNPLNetClient::ReleaseInstance()
 	SAFE_DELETE(g_pNPLNetClient);
 }
 
+ParaEngine::CRequestTaskPool::CRequestTaskPool(CURLSH* share_handle)
+	:m_nMaxWorkerThreads(1), m_nMaxQueuedTask(65535), m_multi_handle(NULL), m_share_handle(share_handle), m_nRunningTaskCount(0), 
+	m_nMaxHostConnections(DEFAULT_MAX_HOST_CONNECTIONS), m_nTimerDeadline(0), m_bHasTimer(false)
+{
+}
+
 bool ParaEngine::CRequestTaskPool::AppendURLRequest( CURLRequestTask* pUrlTask )
 {
 	if(pUrlTask==NULL)
@@ -370,9 +402,11 @@ ParaEngine::CRequestTaskPool::~CRequestTaskPool()
 		}
 		m_task_pool.clear();
 	}
-	// free multi
-	if(m_multi_handle)
-		curl_multi_cleanup(m_multi_handle);
+	for (size_t i = 0; i < m_finished_tasks.size(); ++i)
+	{
+		delete m_finished_tasks[i];
+	}
+	m_finished_tasks.clear();
 
 	// free the CURL handles
 	{
@@ -380,91 +414,84 @@ ParaEngine::CRequestTaskPool::~CRequestTaskPool()
 		for(itCur = m_easy_handles.begin();itCur!=itEnd; ++itCur)
 		{
 			if(itCur->m_easy_handle != NULL)
+			{
+				if (!itCur->m_bIsCompleted && m_multi_handle)
+					curl_multi_remove_handle(m_multi_handle, itCur->m_easy_handle);
 				curl_easy_cleanup(itCur->m_easy_handle);
+			}
+			if (!itCur->m_bIsCompleted)
+				SAFE_DELETE(itCur->m_pCurrentTask);
 		}
 		m_easy_handles.clear();
+		m_free_workers.clear();
 	}
+	// free multi
+	if(m_multi_handle)
+		curl_multi_cleanup(m_multi_handle);
 }
 
 int ParaEngine::CRequestTaskPool::DoProcess()
 {
-	if(m_task_pool.size() == 0)
+	if(m_task_pool.empty() && m_nRunningTaskCount == 0 && m_finished_tasks.empty())
 		return 0;
 	int nCount = 0;
 	bool bStillNeedPerform = false;
 	// all running tasks are performed using the curl multi interface. The result of each finished request is saved to CURLRequestTask struct. 
-	int nFinishedCount = CURL_MultiPerform();
+	CURL_MultiPerform();
 	do 
 	{
 		bStillNeedPerform = false;
 
-		// the pool of CURLRequestTask is traversed  during which finished CURLRequestTask is removed from the the queue and the callback is called. 
-		if(nFinishedCount>0)
+		// finished CURLRequestTask is removed and the callback is called. 
+		if(!m_finished_tasks.empty())
 		{
-			nFinishedCount = 0;
-			// process finished
-			std::list <CURLRequestTask*>::iterator itCur, itEnd = m_task_pool.end();
-			for(itCur = m_task_pool.begin();itCur!=itEnd; )
+			std::vector <CURLRequestTask*> finished_tasks;
+			finished_tasks.swap(m_finished_tasks);
+			for (size_t i = 0; i < finished_tasks.size(); ++i)
 			{
-				CURLRequestTask* pTask = (*itCur);
-				if(pTask && pTask->m_nStatus == CURLRequestTask::URL_REQUEST_COMPLETED)
-				{
-					//ParaEngine::Lock lock_(pTask->GetMutex());
-					if(pTask->m_nStatus == CURLRequestTask::URL_REQUEST_COMPLETED)
-					{
-						//
-						// remove from worker slot
-						//
-						m_nRunningTaskCount --;
-						nCount ++;
-						// complete the task. 
-						pTask->CompleteTask();
-						// delete the task
-						SAFE_DELETE(pTask);
-						// remove it from the queue
-						itCur = m_task_pool.erase(itCur);
-						continue;
-					}
-				}
-				++itCur;
+				CURLRequestTask* pTask = finished_tasks[i];
+				nCount ++;
+				// complete the task. 
+				pTask->CompleteTask();
+				// delete the task
+				SAFE_DELETE(pTask);
 			}
 		}
 		// new tasks are added to the available task slots for further processing. 
-		if(m_nRunningTaskCount < m_nMaxWorkerThreads)
+		while (m_nRunningTaskCount < m_nMaxWorkerThreads && !m_task_pool.empty())
 		{
-			std::list <CURLRequestTask*>::iterator itCur, itEnd = m_task_pool.end();
-			for(itCur = m_task_pool.begin();itCur!=itEnd; itCur++)
+			CUrlWorkerState* pWorker = GetFreeWorkerSlot();
+			if(pWorker && pWorker->m_easy_handle)
 			{
-				CURLRequestTask* pTask = (*itCur);
-				if(pTask && pTask->m_nStatus == CURLRequestTask::URL_REQUEST_UNSTARTED)
-				{
-					CUrlWorkerState* pWorker = GetFreeWorkerSlot();
-					if(pWorker && pWorker->m_easy_handle)
-					{
-						//
-						// Add to worker slot: assign task to worker slot and make the handle busy. 
-						//
-						m_nRunningTaskCount ++;
-						pWorker->m_bIsCompleted = false;
-						pWorker->m_pCurrentTask = pTask;
-						pTask->UpdateTime();
-						pTask->SetCurlEasyOpt(pWorker->m_easy_handle);
-						pTask->m_nStatus = CURLRequestTask::URL_REQUEST_INCOMPLETE;
-						curl_multi_add_handle(m_multi_handle, pWorker->m_easy_handle);
-						bStillNeedPerform = true;
-					}
-					else
-					{
-						break;
-					}
-				}
+				CURLRequestTask* pTask = m_task_pool.front();
+				m_task_pool.pop_front();
+				//
+				// Add to worker slot: assign task to worker slot and make the handle busy. 
+				//
+				m_nRunningTaskCount ++;
+				m_free_workers.pop_back();
+				pWorker->m_bIsCompleted = false;
+				pWorker->m_pCurrentTask = pTask;
+				pTask->UpdateTime();
+				pTask->SetCurlEasyOpt(pWorker->m_easy_handle);
+				// The official doc says if multi-threaded use, this one should be set to 1. 
+				curl_easy_setopt(pWorker->m_easy_handle, CURLOPT_NOSIGNAL, 1);
+				curl_easy_setopt(pWorker->m_easy_handle, CURLOPT_PRIVATE, pWorker);
+				if (m_share_handle)
+					curl_easy_setopt(pWorker->m_easy_handle, CURLOPT_SHARE, m_share_handle);
+				pTask->m_nStatus = CURLRequestTask::URL_REQUEST_INCOMPLETE;
+				curl_multi_add_handle(m_multi_handle, pWorker->m_easy_handle);
+				bStillNeedPerform = true;
+			}
+			else
+			{
+				break;
 			}
 		}
 		if(bStillNeedPerform)
 		{
 			// immediately do some processing if there are new tasks added. 
-			nFinishedCount = CURL_MultiPerform();
-			bStillNeedPerform = (nFinishedCount>0);
+			bStillNeedPerform = (CURL_MultiPerform()>0);
 		}
 	} while (bStillNeedPerform); // the above three steps are repeated until there is no queued task to be added to any available slots. 
 	return nCount;
@@ -475,29 +502,29 @@ ParaEngine::CRequestTaskPool::CUrlWorkerState* ParaEngine::CRequestTaskPool::Get
 	if(m_nRunningTaskCount >= m_nMaxWorkerThreads)
 		return NULL;
 	if(m_multi_handle == NULL)
+	{
 		m_multi_handle = curl_multi_init();
-	if(m_multi_handle == NULL)
-		return NULL;
-	int nCount = 0;
-	std::list <CUrlWorkerState>::iterator itCur, itEnd = m_easy_handles.end();
-	for(itCur = m_easy_handles.begin();itCur!=itEnd; ++itCur, ++nCount)
+		if (m_multi_handle == NULL)
+			return NULL;
+		curl_multi_setopt(m_multi_handle, CURLMOPT_SOCKETFUNCTION, CURL_SocketCallback);
+		curl_multi_setopt(m_multi_handle, CURLMOPT_SOCKETDATA, this);
+		curl_multi_setopt(m_multi_handle, CURLMOPT_TIMERFUNCTION, CURL_TimerCallback);
+		curl_multi_setopt(m_multi_handle, CURLMOPT_TIMERDATA, this);
+		curl_multi_setopt(m_multi_handle, CURLMOPT_MAX_HOST_CONNECTIONS, (long)m_nMaxHostConnections);
+	}
+	if (!m_free_workers.empty())
 	{
-		if(itCur->m_bIsCompleted)
-		{
-			return &(*itCur);
-		}
+		return m_free_workers.back();
 	}
-	if(nCount < m_nMaxWorkerThreads)
+	if((int)m_easy_handles.size() < m_nMaxWorkerThreads)
 	{
 		// create a new one
 		m_easy_handles.push_back(CUrlWorkerState());
 
 		CUrlWorkerState* pWorker = &(m_easy_handles.back());
-		if(pWorker->m_easy_handle == NULL)
+		pWorker->m_easy_handle = curl_easy_init();
+		if(pWorker->m_easy_handle != NULL)
 		{
-			pWorker->m_easy_handle = curl_easy_init();
-			// The official doc says if multi-threaded use, this one should be set to 1. 
-			curl_easy_setopt(pWorker->m_easy_handle, CURLOPT_NOSIGNAL , 1);
 			/**
 			Pass a long. It should contain the maximum time in seconds that you allow the connection to the server to take. 
 			This only limits the connection phase, once it has connected, this option is of no more use. Set to zero to disable 
@@ -510,67 +537,184 @@ ParaEngine::CRequestTaskPool::CUrlWorkerState* ParaEngine::CRequestTaskPool::Get
 		else
 		{
 			OUTPUT_LOG("warning: failed creating curl_easy_init interface\n");
+			m_easy_handles.pop_back();
+			return NULL;
 		}
+		m_free_workers.push_back(pWorker);
 		return pWorker;
 	}
 	return NULL;
 }
 
+int ParaEngine::CRequestTaskPool::CURL_SocketCallback(CURL* easy, curl_socket_t s, int what, void* userp, void* socketp)
+{
+	CRequestTaskPool* pPool = (CRequestTaskPool*)userp;
+	if (what == CURL_POLL_REMOVE)
+		pPool->m_sockets.erase(s);
+	else
+		pPool->m_sockets[s] = what;
+	return 0;
+}
+
+int ParaEngine::CRequestTaskPool::CURL_TimerCallback(CURLM* multi, long timeout_ms, void* userp)
+{
+	CRequestTaskPool* pPool = (CRequestTaskPool*)userp;
+	if (timeout_ms < 0)
+	{
+		pPool->m_bHasTimer = false;
+	}
+	else
+	{
+		pPool->m_bHasTimer = true;
+		pPool->m_nTimerDeadline = GetTickCount() + (DWORD)timeout_ms;
+	}
+	return 0;
+}
+
+void ParaEngine::CRequestTaskPool::CURL_SocketAction()
+{
+	int still_running = 0;
+	// collect ready sockets first, since curl_multi_socket_action may modify m_sockets
+	std::vector< std::pair<curl_socket_t, int> > ready_sockets;
+	if (!m_sockets.empty())
+	{
+#ifdef WIN32
+		// windows fd_set is an array of at most FD_SETSIZE sockets, so we poll in batches. 
+		std::map <curl_socket_t, int>::iterator itCur = m_sockets.begin(), itEnd = m_sockets.end();
+		while (itCur != itEnd)
+		{
+			fd_set fdread, fdwrite, fdexcep;
+			FD_ZERO(&fdread); FD_ZERO(&fdwrite); FD_ZERO(&fdexcep);
+			std::map <curl_socket_t, int>::iterator itBatch = itCur;
+			for (int i = 0; i < FD_SETSIZE && itCur != itEnd; ++i, ++itCur)
+			{
+				if (itCur->second & CURL_POLL_IN)
+					FD_SET(itCur->first, &fdread);
+				if (itCur->second & CURL_POLL_OUT)
+					FD_SET(itCur->first, &fdwrite);
+				FD_SET(itCur->first, &fdexcep);
+			}
+			struct timeval timeout = { 0, 0 };
+			if (select(0, &fdread, &fdwrite, &fdexcep, &timeout) > 0)
+			{
+				for (; itBatch != itCur; ++itBatch)
+				{
+					int ev_bitmask = 0;
+					if (FD_ISSET(itBatch->first, &fdread))
+						ev_bitmask |= CURL_CSELECT_IN;
+					if (FD_ISSET(itBatch->first, &fdwrite))
+						ev_bitmask |= CURL_CSELECT_OUT;
+					if (FD_ISSET(itBatch->first, &fdexcep))
+						ev_bitmask |= CURL_CSELECT_ERR;
+					if (ev_bitmask != 0)
+						ready_sockets.push_back(std::make_pair(itBatch->first, ev_bitmask));
+				}
+			}
+		}
+#else
+		std::vector<struct pollfd> fds;
+		fds.reserve(m_sockets.size());
+		for (std::map <curl_socket_t, int>::iterator itCur = m_sockets.begin(); itCur != m_sockets.end(); ++itCur)
+		{
+			struct pollfd fd;
+			fd.fd = itCur->first;
+			fd.events = ((itCur->second & CURL_POLL_IN) ? POLLIN : 0) | ((itCur->second & CURL_POLL_OUT) ? POLLOUT : 0);
+			fd.revents = 0;
+			fds.push_back(fd);
+		}
+		if (poll(&fds[0], (nfds_t)fds.size(), 0) > 0)
+		{
+			for (size_t i = 0; i < fds.size(); ++i)
+			{
+				int ev_bitmask = 0;
+				if (fds[i].revents & POLLIN)
+					ev_bitmask |= CURL_CSELECT_IN;
+				if (fds[i].revents & POLLOUT)
+					ev_bitmask |= CURL_CSELECT_OUT;
+				if (fds[i].revents & (POLLERR | POLLHUP | POLLNVAL))
+					ev_bitmask |= CURL_CSELECT_ERR;
+				if (ev_bitmask != 0)
+					ready_sockets.push_back(std::make_pair((curl_socket_t)fds[i].fd, ev_bitmask));
+			}
+		}
+#endif
+	}
+	for (size_t i = 0; i < ready_sockets.size(); ++i)
+	{
+		curl_multi_socket_action(m_multi_handle, ready_sockets[i].first, ready_sockets[i].second, &still_running);
+	}
+	// m_nTimerDeadline may wrap around, so compare the difference. 
+	if (m_bHasTimer && (int)(GetTickCount() - m_nTimerDeadline) >= 0)
+	{
+		m_bHasTimer = false;
+		curl_multi_socket_action(m_multi_handle, CURL_SOCKET_TIMEOUT, 0, &still_running);
+	}
+}
+
+void ParaEngine::CRequestTaskPool::CompleteWorker(CUrlWorkerState* pWorker, CURLcode returnCode)
+{
+	// get return code. 
+	pWorker->m_returnCode = returnCode;
+	pWorker->m_bIsCompleted = true;
+	// remove the easy handle to be reused later. 
+	if (m_multi_handle)
+		curl_multi_remove_handle(m_multi_handle, pWorker->m_easy_handle);
+	m_nRunningTaskCount--;
+	m_free_workers.push_back(pWorker);
+
+	CURLRequestTask* pTask = pWorker->m_pCurrentTask;
+	pWorker->m_pCurrentTask = NULL;
+	if (pTask)
+	{
+		if (returnCode == CURLE_OPERATION_TIMEDOUT)
+		{
+			// reset data for timed out requests. 
+			pTask->m_data.clear();
+			pTask->m_header.clear();
+		}
+		else
+		{
+			curl_easy_getinfo(pWorker->m_easy_handle, CURLINFO_RESPONSE_CODE, &(pTask->m_responseCode));
+		}
+		pTask->m_nStatus = CURLRequestTask::URL_REQUEST_COMPLETED;
+		pTask->m_returnCode = returnCode;
+		m_finished_tasks.push_back(pTask);
+	}
+}
+
 int ParaEngine::CRequestTaskPool::CURL_MultiPerform()
 {
 	if(m_multi_handle == NULL)
 		return 0;
 
-	int still_running = 0; /* keep number of running handles */
-
-	/* we start some action by calling perform right away */
-	while(CURLM_CALL_MULTI_PERFORM ==
-		curl_multi_perform(m_multi_handle, &still_running));
+	CURL_SocketAction();
 
 	int nCount = 0;
 
-	if(m_nRunningTaskCount > still_running)
+	// for picking up messages with the transfer status
+	CURLMsg *msg; 
+	// how many messages are left
+	int msgs_left; 
+	/* See how the transfers went */
+	while ((msg = curl_multi_info_read(m_multi_handle, &msgs_left))) 
 	{
-		int nProcessed = m_nRunningTaskCount - still_running;
-
-		// for picking up messages with the transfer status
-		CURLMsg *msg; 
-		// how many messages are left
-		int msgs_left; 
-		/* See how the transfers went */
-		while ((msg = curl_multi_info_read(m_multi_handle, &msgs_left))) 
+		if (msg->msg == CURLMSG_DONE) 
 		{
-			if (msg->msg == CURLMSG_DONE) 
-			{
-				/* Find out which handle this message is about */
-				std::list <CUrlWorkerState>::iterator itCur, itEnd = m_easy_handles.end();
-				for(itCur = m_easy_handles.begin();itCur!=itEnd; ++itCur)
-				{
-					if(itCur->m_easy_handle == msg->easy_handle)
-					{
-						// get return code. 
-						itCur->m_returnCode = msg->data.result;
-						itCur->m_bIsCompleted = true;
-						// remove the easy handle to be reused later. 
-						if(m_multi_handle)
-							curl_multi_remove_handle(m_multi_handle, itCur->m_easy_handle);
-
-						if(itCur->m_pCurrentTask)
-						{
-							curl_easy_getinfo (itCur->m_easy_handle, CURLINFO_RESPONSE_CODE, &(itCur->m_pCurrentTask->m_responseCode));
-							itCur->m_pCurrentTask->m_nStatus = CURLRequestTask::URL_REQUEST_COMPLETED;
-							itCur->m_pCurrentTask->m_returnCode = itCur->m_returnCode;
-						}
-						nCount++;
-					}
-				}
-			}
-			else
+			/* Find out which worker this message is about */
+			CUrlWorkerState* pWorker = NULL;
+			curl_easy_getinfo(msg->easy_handle, CURLINFO_PRIVATE, (char**)&pWorker);
+			if (pWorker && !pWorker->m_bIsCompleted)
 			{
-				OUTPUT_LOG("warning: unknown message type for curl_multi_info_read \n");
+				CompleteWorker(pWorker, msg->data.result);
+				nCount++;
 			}
 		}
+		else
+		{
+			OUTPUT_LOG("warning: unknown message type for curl_multi_info_read \n");
+		}
 	}
+	if (m_nRunningTaskCount > 0)
 	{
 		/*
 		** GetTickCount() is available on _all_ Windows versions from W95 up
@@ -587,23 +731,11 @@ int ParaEngine::CRequestTaskPool::CURL_MultiPerform()
 		{
 			if( ! itCur->m_bIsCompleted && itCur->m_pCurrentTask && itCur->m_pCurrentTask->IsTimedOut(timeNow))
 			{
-				// get return code. 
-				itCur->m_returnCode = CURLE_OPERATION_TIMEDOUT;
-				itCur->m_bIsCompleted = true;
-				// remove the easy handle to be reused later. 
-				if(m_multi_handle)
-					curl_multi_remove_handle(m_multi_handle, itCur->m_easy_handle);
-
-				if(itCur->m_pCurrentTask)  
-				{
-					curl_easy_reset(itCur->m_easy_handle);
-
-					// reset data for timed out requests. 
-					itCur->m_pCurrentTask->m_data.clear();
-					itCur->m_pCurrentTask->m_header.clear();
-					itCur->m_pCurrentTask->m_nStatus = CURLRequestTask::URL_REQUEST_COMPLETED;
-					itCur->m_pCurrentTask->m_returnCode = itCur->m_returnCode;
-				}
+				// close the connection of a timed out request when it is removed from the multi handle, 
+				// instead of keeping it in the connection cache. curl_easy_reset() clears the option for the next request. 
+				curl_easy_setopt(itCur->m_easy_handle, CURLOPT_FORBID_REUSE, 1L);
+				CompleteWorker(&(*itCur), CURLE_OPERATION_TIMEDOUT);
+				curl_easy_reset(itCur->m_easy_handle);
 				nCount++;
 			}
 		}
@@ -616,11 +748,23 @@ void ParaEngine::CRequestTaskPool::SetMaxTaskSlotsCount(int nCount)
 {
 	m_nMaxWorkerThreads = nCount;
 }
+
+void ParaEngine::CRequestTaskPool::SetMaxHostConnections(int nCount)
+{
+	m_nMaxHostConnections = nCount;
+	if (m_multi_handle)
+		curl_multi_setopt(m_multi_handle, CURLMOPT_MAX_HOST_CONNECTIONS, (long)nCount);
+}
+
 void ParaEngine::CURLRequestTask::SetCurlEasyOpt( CURL* handle )
 {
 	// reset data 
 	m_data.clear();
 	m_header.clear();
+	m_nBytesReceived = 0;
+	m_nTotalBytes = 0;
+	m_bTotalBytesKnown = false;
+	m_nStreamOffset = 0;
 	curl_easy_setopt(handle, CURLOPT_URL, m_url.c_str());
 
 	/* Define our callback to get called when there's data to be written */
@@ -631,6 +775,20 @@ void ParaEngine::CURLRequestTask::SetCurlEasyOpt( CURL* handle )
 	curl_easy_setopt(handle, CURLOPT_HEADERFUNCTION, CUrl_write_header_callback);
 	curl_easy_setopt(handle, CURLOPT_HEADERDATA, this);
 
+	// resume from a partial download file if any. easy handles are reused, so always set it. 
+	m_nResumeFrom = 0;
+	if (!m_sSaveToFileName.empty())
+	{
+		SAFE_DELETE(m_pFile);
+		if (m_bResume)
+		{
+			string sDownloadFile = GetDownloadFileName();
+			if (CParaFile::DoesFileExist(sDownloadFile.c_str(), false))
+				m_nResumeFrom = (std::max)(CParaFile::GetFileSize(sDownloadFile.c_str()), 0);
+		}
+	}
+	curl_easy_setopt(handle, CURLOPT_RESUME_FROM_LARGE, (curl_off_t)m_nResumeFrom);
+
 	// form if any. 
 	if(m_pFormPost)
 	{
@@ -642,6 +800,230 @@ void ParaEngine::CURLRequestTask::SetCurlEasyOpt( CURL* handle )
 	}
 }
 
+void ParaEngine::CURLRequestTask::SetSaveToFile(const char* sFileName, bool bResume)
+{
+	m_sSaveToFileName = sFileName ? sFileName : "";
+	m_bResume = bResume;
+}
+
+void ParaEngine::CURLRequestTask::SetDataCallback(const char* sNPLCallback, int nChunkSize)
+{
+	m_sNPLDataCallback = sNPLCallback ? sNPLCallback : "";
+	m_nStreamChunkSize = (std::max)(nChunkSize, 1);
+}
+
+bool ParaEngine::CURLRequestTask::OpenSaveToFile()
+{
+	string sDownloadFile = GetDownloadFileName();
+	m_pFile = new CParaFile();
+	// the server may ignore the range request and send the whole file with 200
+	if (m_nResumeFrom > 0 && m_responseCode == 206)
+	{
+		if (m_pFile->OpenFile(sDownloadFile.c_str(), false, NULL, false, FILE_ON_DISK))
+		{
+			m_pFile->SetFilePointer(m_nResumeFrom, FILE_BEGIN);
+			m_pFile->SetEndOfFile();
+			return true;
+		}
+	}
+	m_nResumeFrom = 0;
+	if (!m_pFile->CreateNewFile(sDownloadFile.c_str(), true))
+	{
+		OUTPUT_LOG("warning: Failed create new file %s\n", sDownloadFile.c_str());
+		SAFE_DELETE(m_pFile);
+		return false;
+	}
+	if (!m_bResume && m_nTotalBytes > 0)
+	{
+		// preallocate the file, so that it is less fragmented. 
+		m_pFile->SetFilePointer(m_nTotalBytes, FILE_BEGIN);
+		m_pFile->SetEndOfFile();
+		m_pFile->SetFilePointer(0, FILE_BEGIN);
+	}
+	return true;
+}
+
+size_t ParaEngine::CURLRequestTask::write_data(const char* buffer, int nByteCount)
+{
+	if (!m_sSaveToFileName.empty())
+	{
+		// never overwrite the partial file with an error page. 
+		if (m_responseCode < 200 || m_responseCode >= 300)
+			return nByteCount;
+		if (m_pFile == 0 && !OpenSaveToFile())
+			return 0;
+		if (m_pFile->write(buffer, nByteCount) != nByteCount)
+			return 0;
+		m_nBytesReceived += nByteCount;
+		if (!m_sNPLDataCallback.empty() && (m_nBytesReceived - m_nStreamOffset) >= m_nStreamChunkSize)
+			FlushDataChunk(false);
+	}
+	else
+	{
+		int nOldSize = (int)m_data.size();
+		m_data.resize(nOldSize + nByteCount);
+		memcpy(&(m_data[nOldSize]), buffer, nByteCount);
+		m_nBytesReceived += nByteCount;
+		if (!m_sNPLDataCallback.empty() && (int)m_data.size() >= m_nStreamChunkSize)
+			FlushDataChunk(false);
+	}
+	return nByteCount;
+}
+
+void ParaEngine::CURLRequestTask::write_header(const char* buffer, int nByteCount)
+{
+	int nOldSize = (int)m_header.size();
+	m_header.resize(nOldSize + nByteCount);
+	memcpy(&(m_header[nOldSize]), buffer, nByteCount);
+
+	// curl passes one complete header line at a time. 
+	if (nByteCount > 5 && strncmp(buffer, "HTTP/", 5) == 0)
+	{
+		// a new response, such as after a redirect. 
+		const char* pCode = (const char*)memchr(buffer, ' ', nByteCount);
+		m_responseCode = pCode ? atol(pCode + 1) : 0;
+		m_nTotalBytes = 0;
+		m_bTotalBytesKnown = false;
+	}
+	else if (nByteCount > 15 && stricmp(string(buffer, 15).c_str(), "Content-Length:") == 0)
+	{
+		// the body of other responses is an error page
+		if (m_responseCode == 200 || (m_responseCode == 206 && !m_bTotalBytesKnown))
+		{
+			int64 nContentLength = (int64)atoll(string(buffer + 15, nByteCount - 15).c_str());
+			if (nContentLength >= 0)
+			{
+				m_nTotalBytes = nContentLength + ((m_responseCode == 206) ? m_nResumeFrom : 0);
+				m_bTotalBytesKnown = true;
+				// avoid geometric regrowth when the response is kept in memory
+				if (m_sSaveToFileName.empty() && m_sNPLDataCallback.empty() && nContentLength <= INT_MAX)
+					m_data.reserve((size_t)nContentLength);
+			}
+		}
+	}
+	else if (nByteCount > 14 && stricmp(string(buffer, 14).c_str(), "Content-Range:") == 0)
+	{
+		// such as "bytes 100-199/1000" for 206, or "bytes */1000" for 416. the total size is after '/'. 
+		const char* pTotal = (const char*)memchr(buffer, '/', nByteCount);
+		if (pTotal && pTotal[1] != '*' && (m_responseCode == 206 || m_responseCode == 416))
+		{
+			m_nTotalBytes = (int64)atoll(string(pTotal + 1, nByteCount - (int)(pTotal + 1 - buffer)).c_str());
+			m_bTotalBytesKnown = true;
+		}
+	}
+}
+
+void ParaEngine::CURLRequestTask::FlushDataChunk(bool bFinished)
+{
+	NPL::CNPLWriter writer;
+	writer.WriteName("msg");
+	writer.BeginTable();
+	writer.WriteName("url");
+	writer.WriteValue(m_url);
+	if (m_sSaveToFileName.empty())
+	{
+		writer.WriteName("data");
+		writer.WriteValue(m_data.empty() ? "" : (const char*)(&(m_data[0])), (int)m_data.size());
+		writer.WriteName("offset");
+		writer.WriteValue((double)m_nStreamOffset);
+		m_nStreamOffset += (int64)m_data.size();
+		m_data.clear();
+	}
+	else
+	{
+		writer.WriteName("filename");
+		writer.WriteValue(m_sSaveToFileName);
+		m_nStreamOffset = m_nBytesReceived;
+	}
+	writer.WriteName("currentsize");
+	writer.WriteValue((double)(m_nResumeFrom + m_nBytesReceived));
+	writer.WriteName("totalsize");
+	writer.WriteValue((double)m_nTotalBytes);
+	if (bFinished)
+	{
+		writer.WriteName("finished");
+		writer.WriteValue("true", false);
+	}
+	writer.EndTable();
+	writer.WriteParamDelimiter();
+	writer.Append(m_sNPLDataCallback.c_str());
+	CGlobals::GetAISim()->NPLDoString(writer.ToString().c_str(), (int)(writer.ToString().size()));
+}
+
+void ParaEngine::CURLRequestTask::FinishStreaming()
+{
+	if (!m_sNPLDataCallback.empty())
+		FlushDataChunk(true);
+	if (m_sSaveToFileName.empty())
+		return;
+
+	string sDownloadFile = GetDownloadFileName();
+	if (m_pFile)
+	{
+		m_pFile->close();
+		SAFE_DELETE(m_pFile);
+	}
+
+	bool bSucceed = false;
+	bool bKeepPartialFile = m_bResume;
+	if (m_returnCode == CURLE_OK)
+	{
+		if (m_responseCode == 200 || m_responseCode == 206)
+		{
+			// a 200 response replaces the partial file, even if it has no body. 
+			int64 nFileSize = ((m_responseCode == 206) ? m_nResumeFrom : 0) + m_nBytesReceived;
+			if (m_bTotalBytesKnown)
+				bSucceed = (nFileSize == m_nTotalBytes);
+			else
+				bSucceed = m_nBytesReceived > 0;
+			if (bSucceed && m_nBytesReceived == 0 && m_responseCode == 200)
+			{
+				// the server says that the file is empty
+				CParaFile file;
+				bSucceed = file.CreateNewFile(sDownloadFile.c_str(), true);
+			}
+			if (!bSucceed)
+			{
+				OUTPUT_LOG("warning: %s is incomplete: status code %d, %lld of %lld bytes\n", m_url.c_str(), (int)m_responseCode, (long long)nFileSize, (long long)m_nTotalBytes);
+				if (m_bTotalBytesKnown && nFileSize > m_nTotalBytes)
+					bKeepPartialFile = false;
+				m_returnCode = CURLE_PARTIAL_FILE;
+			}
+		}
+		else if (m_responseCode == 416 && m_nResumeFrom > 0)
+		{
+			// the range starts at the end of the partial file, which is only complete if the server reports the same size. 
+			bSucceed = m_bTotalBytesKnown && (m_nTotalBytes == m_nResumeFrom);
+			if (!bSucceed)
+			{
+				OUTPUT_LOG("warning: %s can not be resumed from %lld bytes, the partial file is discarded\n", m_url.c_str(), (long long)m_nResumeFrom);
+				bKeepPartialFile = false;
+				m_returnCode = CURLE_RANGE_ERROR;
+			}
+		}
+		else if (m_responseCode >= 400)
+		{
+			// the file may have been removed or changed on the server. 
+			bKeepPartialFile = false;
+		}
+	}
+
+	if (bSucceed)
+	{
+		if (CParaFile::DoesFileExist(m_sSaveToFileName.c_str(), false))
+			CParaFile::DeleteFile(m_sSaveToFileName, false);
+		if (!CParaFile::MoveFile(sDownloadFile.c_str(), m_sSaveToFileName.c_str()))
+		{
+			OUTPUT_LOG("warning: failed to rename %s to %s\n", sDownloadFile.c_str(), m_sSaveToFileName.c_str());
+			m_returnCode = CURLE_WRITE_ERROR;
+		}
+	}
+	else if (!bKeepPartialFile)
+	{
+		CParaFile::DeleteFile(sDownloadFile, false);
+	}
+}
+
 size_t ParaEngine::CURLRequestTask::CUrl_write_data_callback( void *buffer, size_t size, size_t nmemb, void *stream )
 {
 	CURLRequestTask * pTask=(CURLRequestTask *) stream;
@@ -651,12 +1033,8 @@ size_t ParaEngine::CURLRequestTask::CUrl_write_data_callback( void *buffer, size
 		int nByteCount = (int)size*(int)nmemb;
 		if(nByteCount>0)
 		{
-			int nOldSize = (int)pTask->m_data.size();
-			pTask->m_data.resize(nOldSize+nByteCount);
-			memcpy(&(pTask->m_data[nOldSize]), buffer, nByteCount);
-
-			// just for testing: remove this, dump to debug. 
-			// ParaEngine::CLogger::GetSingleton().Write((const char*)buffer, (int)nByteCount);
+			// If that amount differs from the amount passed to your function, curl aborts the transfer with CURLE_WRITE_ERROR. 
+			return pTask->write_data((const char*)buffer, nByteCount);
 		}
 		return nByteCount;
 	}
@@ -672,10 +1050,7 @@ size_t ParaEngine::CURLRequestTask::CUrl_write_header_callback( void *buffer, si
 		int nByteCount = (int)size*(int)nmemb;
 		if(nByteCount>0)
 		{
-			int nOldSize = (int)pTask->m_header.size();
-			pTask->m_header.resize(nOldSize+nByteCount);
-			memcpy(&(pTask->m_header[nOldSize]), buffer, nByteCount);
-
+			pTask->write_header((const char*)buffer, nByteCount);
 		}
 		return nByteCount;
 	}
@@ -689,6 +1064,8 @@ void ParaEngine::CURLRequestTask::CompleteTask()
 #endif
 	CNPLNetClient::GetInstance()->RemovePendingRequest(m_url.c_str());
 
+	FinishStreaming();
+
 	if(!m_sNPLCallback.empty())
 	{
 		NPL::CNPLWriter writer;
@@ -706,6 +1083,11 @@ void ParaEngine::CURLRequestTask::CompleteTask()
 			writer.WriteName("data");
 			writer.WriteValue((const char*)(&(m_data[0])), (int)m_data.size());
 		}
+		if(!m_sSaveToFileName.empty())
+		{
+			writer.WriteName("filename");
+			writer.WriteValue(m_sSaveToFileName);
+		}
 
 		writer.WriteName("code");
 		writer.WriteValue(m_returnCode);
@@ -731,6 +1113,11 @@ ParaEngine::CURLRequestTask::~CURLRequestTask()
 		/* then cleanup the form post chain */
 		curl_formfree(m_pFormPost);
 	}
+	if (m_pFile)
+	{
+		m_pFile->close();
+		SAFE_DELETE(m_pFile);
+	}
 	SafeDeleteUserData();
 }
 
@@ -800,6 +1187,9 @@ void ParaEngine::CURLRequestTask::SetAssetRequestOpt( CAssetRequestData* pReques
 		if(m_pAssetData)
 		{
 			m_pfuncCallBack = Asset_HTTP_request_callback;
+			// stream the asset to the cache file, instead of keeping the whole file in memory. 
+			if (!m_pAssetData->m_sAssetKey.empty())
+				SetSaveToFile(CNPLNetClient::GetInstance()->GetCachePath(m_pAssetData->m_sAssetKey.c_str()).c_str(), true);
 		}
 	}
 	else
@@ -824,6 +1214,21 @@ DWORD ParaEngine::CURLRequestTask::Asset_HTTP_request_callback( int nResult, CUR
 	if(!pAssetEntity)
 		return E_FAIL;
 
+	if (!pRequest->m_sSaveToFileName.empty())
+	{
+		// the response is already streamed to the cache file. 
+		// FinishStreaming() turns incomplete bodies and unresumable 416 responses into errors. 
+		if (nResult == CURLE_OK && (pRequest->m_responseCode == 200 || pRequest->m_responseCode == 206 || pRequest->m_responseCode == 416) 
+			&& CParaFile::DoesFileExist(pRequest->m_sSaveToFileName.c_str(), false))
+		{
+			pAssetEntity->SetState(AssetEntity::ASSET_STATE_SYNC_SUCCEED);
+			pAssetEntity->Refresh(pRequest->m_sSaveToFileName.c_str(), pRequestData->m_bLazyLoading);
+			return S_OK;
+		}
+		OUTPUT_LOG("warning: sync asset file %s. status code %d, return code %d\n", pRequest->m_url.c_str(), pRequest->m_responseCode, pRequest->m_returnCode);
+		pAssetEntity->SetState(AssetEntity::ASSET_STATE_SYNC_FAIL);
+		return E_FAIL;
+	}
 	// the HTTP status code must be 200 in order to proceed. 
 	if(nResult == CURLE_OK && (pRequest->m_responseCode==200) && (int)(pRequest->m_data.size())>0)
 	{
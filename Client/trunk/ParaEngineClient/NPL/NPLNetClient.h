@@ -17,6 +17,7 @@ namespace ParaEngine
 	class CNPLJabberClient;
 #endif
 	struct AssetEntity;
+	class CParaFile;
 
 	using namespace std;
 
@@ -64,8 +65,10 @@ namespace ParaEngine
 		};
 		// default time out in milliseconds
 		static const DWORD DEFAULT_TIME_OUT = 15000;
+		// default number of bytes buffered before the data callback is called. 
+		static const int DEFAULT_STREAM_CHUNK_SIZE = 64*1024;
 
-		CURLRequestTask():m_pFormPost(0), m_nTimeOutTime(DEFAULT_TIME_OUT), m_nStartTime(0),m_responseCode(0), m_pFormLast(0), m_pUserData(0), m_returnCode(CURLE_OK), m_type(URL_REQUEST_HTTP_AUTO), m_nPriority(0), m_nStatus(URL_REQUEST_UNSTARTED), m_pfuncCallBack(0), m_nBytesReceived(0), m_nTotalBytes(0), m_nUserDataType(0) {};
+		CURLRequestTask():m_pFormPost(0), m_pFormLast(0), m_nPriority(0), m_pfuncCallBack(0), m_pFile(0), m_bResume(false), m_nResumeFrom(0), m_nStreamChunkSize(DEFAULT_STREAM_CHUNK_SIZE), m_nStreamOffset(0), m_nUserDataType(0), m_pUserData(0), m_type(URL_REQUEST_HTTP_AUTO), m_nStatus(URL_REQUEST_UNSTARTED), m_nStartTime(0), m_nTimeOutTime(DEFAULT_TIME_OUT), m_nBytesReceived(0), m_nTotalBytes(0), m_bTotalBytesKnown(false), m_returnCode(CURLE_OK), m_responseCode(0) {};
 		~CURLRequestTask();
 
 	public:
@@ -89,6 +92,20 @@ namespace ParaEngine
 		static size_t CUrl_write_data_callback(void *buffer, size_t size, size_t nmemb, void *stream);
 		static size_t CUrl_write_header_callback(void *buffer, size_t size, size_t nmemb, void *stream);
 
+		/** stream the response body to a disk file instead of keeping it in memory. 
+		* data is written to sFileName+".download", which is renamed to sFileName when the request succeeds. 
+		* @param bResume: if true and a partial ".download" file exists, only the rest is requested with a HTTP Range header, 
+		*  and the partial file is kept if the request fails. If false, the file is preallocated to the content length. 
+		*/
+		void SetSaveToFile(const char* sFileName, bool bResume = true);
+
+		/** stream the response body to an NPL callback in chunks instead of keeping it in memory. 
+		* the callback is called with msg = {url, data, offset, totalsize} whenever nChunkSize bytes are received and once more 
+		* at the end with msg.finished = true. If the response is also saved to file, msg.data is omitted, so it is a progress callback. 
+		* @param sNPLCallback: the NPL code to run, just like m_sNPLCallback. 
+		*/
+		void SetDataCallback(const char* sNPLCallback, int nChunkSize = DEFAULT_STREAM_CHUNK_SIZE);
+
 		/** set the time out of the request. default is 15000 milliseconds. */
 		void SetTimeOut(int nMilliSeconds);
 		/** Get the time out of the request. default is 15000 milliseconds. */
@@ -118,6 +135,17 @@ namespace ParaEngine
 		*/
 		DWORD UpdateTime();
 
+	protected:
+		size_t write_data(const char* buffer, int nByteCount);
+		void write_header(const char* buffer, int nByteCount);
+		/** open the ".download" file for the first body bytes. */
+		bool OpenSaveToFile();
+		/** call the data callback with buffered bytes. */
+		void FlushDataChunk(bool bFinished);
+		/** close the file and flush the data callback. rename the file if the request succeeded. */
+		void FinishStreaming();
+		string GetDownloadFileName() const { return m_sSaveToFileName + ".download"; }
+
 	public:
 		/** CURLOPT_URL*/
 		string m_url;
@@ -134,6 +162,16 @@ namespace ParaEngine
 		URL_REQUEST_TASK_CALLBACK m_pfuncCallBack;
 		/** the file name to save the response data to */
 		string m_sSaveToFileName;
+		/** the file that the response is streamed to */
+		CParaFile* m_pFile;
+		bool m_bResume;
+		/** number of bytes in the partial file when the request is started. */
+		int64 m_nResumeFrom;
+		/** the NPL code to run for each chunk of the response data */
+		string m_sNPLDataCallback;
+		int m_nStreamChunkSize;
+		/** the response offset of m_data when the data callback is used. */
+		int64 m_nStreamOffset;
 
 		/** default to 0. if 0, the request will not SAFE_DELETE the user data. the caller is responsible for the task.
 		* if it is 1, the destructor will try to SAFE_DELETE(m_pAssetData)
@@ -158,8 +196,12 @@ namespace ParaEngine
 		* the libcurl can detect time out by itself. */
 		DWORD m_nTimeOutTime;
 
-		int m_nBytesReceived;
-		int m_nTotalBytes;
+		/** number of body bytes received in this request, not including m_nResumeFrom */
+		int64 m_nBytesReceived;
+		/** size of the whole file from Content-Length or Content-Range, including m_nResumeFrom. */
+		int64 m_nTotalBytes;
+		/** whether the server reported m_nTotalBytes. */
+		bool m_bTotalBytesKnown;
 		vector<char> m_data;
 		vector<char> m_header;
 		string m_sResponseData;
@@ -179,11 +221,14 @@ namespace ParaEngine
 	The main game (scripting) thread pushes any number of URL request to a pool of CURLRequestTask and returns immediately. 
 
 	On each frame move
-	- all running tasks are performed using the curl multi interface. The result of each finished request is saved to CURLRequestTask struct. 
-	- the pool of CURLRequestTask is traversed  during which finished CURLRequestTask is removed from the the queue and the callback is called. 
+	- the sockets that curl is waiting on are polled without blocking, and only the ready sockets (or an expired curl timer) are
+	  passed to curl_multi_socket_action. So an idle pool with many slow requests costs almost nothing per frame. 
+	- finished requests are found via CURLINFO_PRIVATE of the easy handle and their callbacks are called. 
 	- new tasks are added to the available task slots for further processing. 
 	- the above three steps are repeated until there is no queued task to be added to any available slots. 
 
+	Easy handles are reused by worker slots, so that connections to the same host are kept alive in the multi handle's connection cache. 
+	All pools share one CURLSH for DNS and TLS session cache, and each pool limits the number of connections per host. 
 	*/
 	class CRequestTaskPool 
 	{
@@ -201,7 +246,7 @@ namespace ParaEngine
 			CURLRequestTask* m_pCurrentTask;
 		};
 
-		CRequestTaskPool():m_nRunningTaskCount(0), m_nMaxWorkerThreads(1), m_nMaxQueuedTask(65535), m_multi_handle(NULL){}
+		CRequestTaskPool(CURLSH* share_handle = NULL);
 		~CRequestTaskPool();
 	public:
 		/** Append URL request to a pool. 
@@ -216,6 +261,12 @@ namespace ParaEngine
 
 		/** set maximum number of concurrent task being processed. default is 1.*/
 		void SetMaxTaskSlotsCount(int nCount);
+
+		/** set maximum number of connections to a single host. tasks over the limit wait in curl for a free connection. 
+		* 0 for unlimited. default is 6. */
+		void SetMaxHostConnections(int nCount);
+		int GetMaxHostConnections() const { return m_nMaxHostConnections; }
+
 	protected:
 		/** get the next free worker thread.
 		* @param: return NULL, if no worker slot is available. */
@@ -227,22 +278,45 @@ namespace ParaEngine
 		*/
 		int CURL_MultiPerform();
 
+		/** poll curl sockets without blocking and call curl_multi_socket_action for ready sockets and expired timer. */
+		void CURL_SocketAction();
+
+		/** mark the worker's task as completed and free the worker slot. */
+		void CompleteWorker(CUrlWorkerState* pWorker, CURLcode returnCode);
+
+		/** curl multi socket callback: remember which events to wait for on the socket. */
+		static int CURL_SocketCallback(CURL* easy, curl_socket_t s, int what, void* userp, void* socketp);
+		/** curl multi timer callback: remember when to call curl_multi_socket_action with CURL_SOCKET_TIMEOUT */
+		static int CURL_TimerCallback(CURLM* multi, long timeout_ms, void* userp);
+
 	private:
 
-		/** this list is usually sorted at inserting time according to task priority. */
+		/** queued tasks that are not started yet. this list is usually sorted at inserting time according to task priority. */
 		std::list <CURLRequestTask*> m_task_pool;
+		/** tasks that are finished but whose callbacks are not yet called. */
+		std::vector <CURLRequestTask*> m_finished_tasks;
 
 		/** the max number of worker threads. Default to 5 */
 		int m_nMaxWorkerThreads;
 		/** all active thread */
 		std::list <CUrlWorkerState> m_easy_handles;
+		/** worker slots whose easy handles are not added to the multi handle. */
+		std::vector <CUrlWorkerState*> m_free_workers;
 
 		/** the max number of queued tasks. Default to 65535 */
 		int m_nMaxQueuedTask;
 		/** the multi handle. */
 		CURLM * m_multi_handle;
+		/** shared DNS and TLS session cache. not owned by the pool. */
+		CURLSH * m_share_handle;
 		/** the number of still running tasks. */
 		int m_nRunningTaskCount;
+		int m_nMaxHostConnections;
+		/** socket to CURL_POLL_IN, CURL_POLL_OUT, CURL_POLL_INOUT */
+		std::map <curl_socket_t, int> m_sockets;
+		/** in GetTickCount() time. it is only valid if m_bHasTimer is true. */
+		DWORD m_nTimerDeadline;
+		bool m_bHasTimer;
 	};
 
 
@@ -387,6 +461,9 @@ namespace ParaEngine
 
 		/** just clean up everything. */
 		void Cleanup();
+
+		/** get the DNS and TLS session cache that is shared by all request pools. it is created on first call. */
+		CURLSH* GetShareHandle();
 	protected:
 
 		/** get a task pool by name. and create it if it does not exist. */
@@ -397,6 +474,8 @@ namespace ParaEngine
 		std::map <std::string, CNPLJabberClient*> m_jabberClients;
 #endif
 		std::map <std::string, CRequestTaskPool*> m_request_pools;
+		/** shared by the easy handles of all request pools. all pools are processed in the main thread, so no share lock is needed. */
+		CURLSH* m_share_handle;
 
 		std::set <std::string> m_pending_requests;
 
@@ -28,6 +28,11 @@
 /** @def the number of milliseconds that checks all connections in the system about timeout. */
 #define IDLE_TIMEOUT_TIMER_INTERVAL 2000
 
+#ifdef SO_REUSEPORT
+/** SOL_SOCKET/SO_REUSEPORT socket option, which allows multiple acceptors to listen on the same port. */
+typedef boost::asio::detail::socket_option::boolean<SOL_SOCKET, SO_REUSEPORT> reuse_port_option;
+#endif
+
 NPL::CNPLNetServer::CNPLNetServer()
 :	m_io_service_dispatcher(),
 m_acceptor(m_io_service_dispatcher),
@@ -38,7 +43,9 @@ m_msg_dispatcher(this), // TODO: this gives a warning. find a better way to pass
 m_strServer(NPL_DEFAULT_SERVER), 
 m_strPort(NPL_DEFAULT_PORT), 
 m_nMaxPendingConnections(DEFAULT_MAX_PENDING_CONNECTIONS), m_bIsServerStarted(false),
-m_bTCPKeepAlive(false),m_bKeepAlive(false), m_bEnableIdleTimeout(true), m_nIdleTimeoutMS(DEFAULT_IDLE_TIMEOUT_MS)
+m_bTCPKeepAlive(false),m_bKeepAlive(false), m_bEnableIdleTimeout(true), m_nIdleTimeoutMS(DEFAULT_IDLE_TIMEOUT_MS),
+m_nAcceptorCount(1), m_nAcceptedCount(0), m_nLastAcceptedCount(0), m_nLastAcceptRateTime(0), m_fAcceptRate(0.f), m_fMaxAcceptRate(0.f),
+m_udp_transport(this, m_io_service_dispatcher)
 {
 }
 
@@ -111,6 +118,7 @@ void NPL::CNPLNetServer::handle_idle_timeout(const boost::system::error_code& er
 		{
 			m_connection_manager.CheckIdleTimeout();
 		}
+		UpdateAcceptRate();
 
 		// continue with next activation. 
 		m_idle_timer.expires_from_now(boost::chrono::milliseconds(IDLE_TIMEOUT_TIMER_INTERVAL)); // GetIdleTimeoutPeriod()
@@ -174,6 +182,11 @@ void NPL::CNPLNetServer::start( const char* server/*=NULL*/, const char* port/*=
 	OUTPUT_LOG("CompressionLevel: %d\n", GetDispatcher().GetCompressionLevel());
 	OUTPUT_LOG("CompressionThreshold: %d\n", GetDispatcher().GetCompressionThreshold());
 	
+	if (m_udp_transport.IsEnabled())
+	{
+		m_udp_transport.Open(m_strServer, m_strPort);
+	}
+
 	m_idle_timer.expires_from_now(boost::chrono::milliseconds(GetIdleTimeoutPeriod()));
 	m_idle_timer.async_wait(boost::bind(&NPL::CNPLNetServer::handle_idle_timeout, this, boost::asio::placeholders::error));
 
@@ -198,6 +211,13 @@ void NPL::CNPLNetServer::stop()
 
 		m_dispatcherThread->join();
 		m_dispatcherThread.reset();
+
+		// connections of additional acceptors are already told to stop by handle_stop(). 
+		for (size_t i = 0; i < m_acceptors.size(); ++i)
+		{
+			m_acceptors[i]->Stop();
+		}
+		m_acceptors.clear();
 	}
 }
 
@@ -213,6 +233,16 @@ void NPL::CNPLNetServer::handle_resolve_local(const boost::system::error_code& e
 			boost::asio::ip::tcp::endpoint endpoint = *endpoint_iterator;
 			m_acceptor.open(endpoint.protocol());
 			m_acceptor.set_option(boost::asio::ip::tcp::acceptor::reuse_address(true));
+			if (m_nAcceptorCount > 1)
+			{
+#ifdef SO_REUSEPORT
+				// all sockets in a SO_REUSEPORT group must set it before bind. 
+				m_acceptor.set_option(reuse_port_option(true));
+#else
+				OUTPUT_LOG("warning: SO_REUSEPORT is not supported, only one NPL acceptor is used\n");
+				m_nAcceptorCount = 1;
+#endif
+			}
 
 			// Implements a custom socket option that determines whether or not an accept operation is permitted to fail with boost::asio::error::connection_aborted. By default the option is false. 
 			boost::asio::socket_base::enable_connection_aborted option(true);
@@ -231,6 +261,18 @@ void NPL::CNPLNetServer::handle_resolve_local(const boost::system::error_code& e
 			m_bIsServerStarted = true;
 
 			OUTPUT_LOG("NPL max pending incoming connections allowed is %d\n", m_nMaxPendingConnections);
+
+			for (int i = 1; i < m_nAcceptorCount; ++i)
+			{
+				boost::shared_ptr<CNPLAcceptor> acceptor(new CNPLAcceptor(this, i));
+				if (!acceptor->Listen(endpoint, m_nMaxPendingConnections, IsTCPKeepAliveEnabled()))
+					break;
+				m_acceptors.push_back(acceptor);
+			}
+			if (m_nAcceptorCount > 1)
+			{
+				OUTPUT_LOG("NPL server is accepting connections with %d acceptors\n", (int)m_acceptors.size() + 1);
+			}
 			// m_acceptor.listen();
 			// OUTPUT_LOG("NPL max pending incoming connections allowed is %d\n", m_acceptor.max_connections);
 		}
@@ -263,11 +305,7 @@ void NPL::CNPLNetServer::handle_accept( const boost::system::error_code& err )
 	{
 		if (m_new_connection)
 		{
-			m_new_connection->EnableIdleTimeout(IsIdleTimeoutEnabled());
-			m_new_connection->SetIdleTimeoutPeriod(GetIdleTimeoutPeriod());
-			m_new_connection->SetKeepAlive(IsKeepAliveEnabled());
-
-			m_connection_manager.start(m_new_connection);
+			StartAcceptedConnection(m_new_connection);
 			m_new_connection.reset(new CNPLConnection(m_io_service_dispatcher, m_connection_manager, m_msg_dispatcher));
 			m_acceptor.async_accept(m_new_connection->socket(),
 				boost::bind(&CNPLNetServer::handle_accept, this,
@@ -300,6 +338,30 @@ void NPL::CNPLNetServer::handle_accept( const boost::system::error_code& err )
 	}
 }
 
+void NPL::CNPLNetServer::StartAcceptedConnection(NPLConnection_ptr& connection)
+{
+	connection->EnableIdleTimeout(IsIdleTimeoutEnabled());
+	connection->SetIdleTimeoutPeriod(GetIdleTimeoutPeriod());
+	connection->SetKeepAlive(IsKeepAliveEnabled());
+	++m_nAcceptedCount;
+
+	m_connection_manager.start(connection);
+}
+
+void NPL::CNPLNetServer::UpdateAcceptRate()
+{
+	uint32 nCurTime = GetTickCount();
+	int nAcceptedCount = m_nAcceptedCount;
+	if (m_nLastAcceptRateTime != 0 && nCurTime > m_nLastAcceptRateTime)
+	{
+		m_fAcceptRate = (nAcceptedCount - m_nLastAcceptedCount) * 1000.f / (nCurTime - m_nLastAcceptRateTime);
+		if (m_fAcceptRate > m_fMaxAcceptRate)
+			m_fMaxAcceptRate = m_fAcceptRate;
+	}
+	m_nLastAcceptRateTime = nCurTime;
+	m_nLastAcceptedCount = nAcceptedCount;
+}
+
 void NPL::CNPLNetServer::handle_stop()
 {
 	// The server is stopped by canceling all outstanding asynchronous
@@ -320,6 +382,7 @@ void NPL::CNPLNetServer::handle_stop()
 	}*/
 		
 	m_connection_manager.stop_all();
+	m_udp_transport.Close();
 }
 
 std::string NPL::CNPLNetServer::GetExternalIP()
@@ -394,3 +457,126 @@ int NPL::CNPLNetServer::GetMaxPendingConnections() const
 {
 	return m_nMaxPendingConnections;
 }
+
+void NPL::CNPLNetServer::SetAcceptorCount(int nCount)
+{
+	if (m_bIsServerStarted)
+	{
+		OUTPUT_LOG("warning: AcceptorCount can only be set before the NPL server is started\n");
+		return;
+	}
+	m_nAcceptorCount = (nCount >= 1) ? nCount : 1;
+}
+
+int NPL::CNPLNetServer::GetAcceptorCount() const
+{
+	return m_nAcceptorCount;
+}
+
+int NPL::CNPLNetServer::GetAcceptedConnectionCount() const
+{
+	return m_nAcceptedCount;
+}
+
+float NPL::CNPLNetServer::GetAcceptRate() const
+{
+	return m_fAcceptRate;
+}
+
+float NPL::CNPLNetServer::GetMaxAcceptRate() const
+{
+	return m_fMaxAcceptRate;
+}
+
+//////////////////////////////////////////////////////////////////////////
+//
+// CNPLAcceptor
+//
+//////////////////////////////////////////////////////////////////////////
+
+NPL::CNPLAcceptor::CNPLAcceptor(CNPLNetServer* pServer, int nIndex)
+	: m_pServer(pServer), m_nIndex(nIndex), m_io_service(), m_acceptor(m_io_service), m_nAcceptedCount(0)
+{
+}
+
+NPL::CNPLAcceptor::~CNPLAcceptor()
+{
+	Stop();
+}
+
+bool NPL::CNPLAcceptor::Listen(const boost::asio::ip::tcp::endpoint& endpoint, int nMaxPendingConnections, bool bTCPKeepAlive)
+{
+#ifdef SO_REUSEPORT
+	try
+	{
+		m_acceptor.open(endpoint.protocol());
+		m_acceptor.set_option(boost::asio::ip::tcp::acceptor::reuse_address(true));
+		m_acceptor.set_option(reuse_port_option(true));
+		m_acceptor.set_option(boost::asio::socket_base::enable_connection_aborted(true));
+		m_acceptor.bind(endpoint);
+		if (bTCPKeepAlive)
+			m_acceptor.set_option(boost::asio::socket_base::keep_alive(true));
+		m_acceptor.listen(nMaxPendingConnections);
+	}
+	catch (std::exception& e)
+	{
+		OUTPUT_LOG1("warning: unable to start NPL acceptor %d, because %s\n", m_nIndex, e.what());
+		boost::system::error_code ec;
+		m_acceptor.close(ec);
+		return false;
+	}
+	StartAccept();
+	m_work_lifetime.reset(new boost::asio::io_service::work(m_io_service));
+	m_thread.reset(new boost::thread(boost::bind(&boost::asio::io_service::run, &m_io_service)));
+	return true;
+#else
+	return false;
+#endif
+}
+
+void NPL::CNPLAcceptor::StartAccept()
+{
+	m_new_connection.reset(new CNPLConnection(m_io_service, m_pServer->GetConnectionManager(), m_pServer->GetDispatcher()));
+	m_acceptor.async_accept(m_new_connection->socket(),
+		boost::bind(&CNPLAcceptor::handle_accept, this, boost::asio::placeholders::error));
+}
+
+void NPL::CNPLAcceptor::handle_accept(const boost::system::error_code& err)
+{
+	if (!err)
+	{
+		++m_nAcceptedCount;
+		m_pServer->StartAcceptedConnection(m_new_connection);
+		StartAccept();
+	}
+	else if (err == boost::asio::error::connection_aborted)
+	{
+		// the client gave up before the connection is accepted, keep on accepting with the same connection object. 
+		m_acceptor.async_accept(m_new_connection->socket(),
+			boost::bind(&CNPLAcceptor::handle_accept, this, boost::asio::placeholders::error));
+	}
+	else if (err != boost::asio::error::operation_aborted)
+	{
+		OUTPUT_LOG("error: NPL acceptor %d unable to accept incoming connection, because: %s\n", m_nIndex, err.message().c_str());
+	}
+}
+
+void NPL::CNPLAcceptor::handle_stop()
+{
+	boost::system::error_code ec;
+	m_acceptor.close(ec);
+	m_new_connection.reset();
+}
+
+void NPL::CNPLAcceptor::Stop()
+{
+	if (m_thread)
+	{
+		m_io_service.post(boost::bind(&CNPLAcceptor::handle_stop, this));
+		// run() returns once all connections of this thread are closed. 
+		m_work_lifetime.reset();
+		m_thread->join();
+		m_thread.reset();
+		OUTPUT_LOG("NPL acceptor %d stopped, %d connections accepted\n", m_nIndex, GetAcceptedCount());
+	}
+}
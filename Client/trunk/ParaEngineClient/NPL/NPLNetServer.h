@@ -4,11 +4,54 @@
 #include <boost/noncopyable.hpp>
 #include <boost/scoped_ptr.hpp>
 #include <boost/asio/steady_timer.hpp>
+#include <boost/shared_ptr.hpp>
+#include <atomic>
+#include <vector>
 #include "NPLConnectionManager.h"
 #include "NPLDispatcher.h"
+#include "NPLUDPTransport.h"
 
 namespace NPL
 {
+	class CNPLNetServer;
+
+	/**
+	* an additional listening socket that is bound to the server port with SO_REUSEPORT, so that the kernel load-balances
+	* new connections among all acceptors. It runs its own io_service in its own thread, and connections accepted by it
+	* are served by that thread for their whole life time. see CNPLNetServer::SetAcceptorCount()
+	*/
+	class CNPLAcceptor : private boost::noncopyable
+	{
+	public:
+		CNPLAcceptor(CNPLNetServer* pServer, int nIndex);
+		~CNPLAcceptor();
+
+		/** open, bind and listen to the given end point and start the accept thread. 
+		* @return false if the socket can not be bound, such as SO_REUSEPORT is not supported. 
+		*/
+		bool Listen(const boost::asio::ip::tcp::endpoint& endpoint, int nMaxPendingConnections, bool bTCPKeepAlive);
+
+		/** close the listening socket, wait until all connections on this thread are closed and join the thread. */
+		void Stop();
+
+		/** number of connections accepted by this acceptor. */
+		int GetAcceptedCount() const { return m_nAcceptedCount; }
+	private:
+		void StartAccept();
+		void handle_accept(const boost::system::error_code& err);
+		void handle_stop();
+
+		CNPLNetServer* m_pServer;
+		int m_nIndex;
+		boost::asio::io_service m_io_service;
+		boost::scoped_ptr<boost::asio::io_service::work> m_work_lifetime;
+		boost::scoped_ptr<boost::thread> m_thread;
+		boost::asio::ip::tcp::acceptor m_acceptor;
+		/// The next connection to be accepted.
+		NPLConnection_ptr m_new_connection;
+		std::atomic<int> m_nAcceptedCount;
+	};
+
 	/**
 	* Current NPL configuration settings. 
 	* it just load from NPL XML config file. 
@@ -41,6 +84,9 @@ namespace NPL
 		*/
 		CNPLConnectionManager& GetConnectionManager(){return m_connection_manager;};
 
+		/** the reliable UDP transport for NIDs that are added with udp=true. */
+		CNPLUDPTransport& GetUDPTransport(){return m_udp_transport;};
+
 		/**
 		* Create a new connection with a remote server and immediately connect and start the connection. 
 		* [Thread Safe]
@@ -99,6 +145,25 @@ namespace NPL
 		/** queue size of the acceptor's queue. */
 		int GetMaxPendingConnections() const;
 		void SetMaxPendingConnections(int val);
+
+		/** number of listening sockets, default to 1. If it is larger than 1, additional acceptors are bound to the same port 
+		* with SO_REUSEPORT, each with its own io_service and thread, where its connections are served. 
+		* It must be set before the server is started, and it is ignored on platforms without SO_REUSEPORT. 
+		*/
+		void SetAcceptorCount(int nCount);
+		int GetAcceptorCount() const;
+
+		/** total number of accepted incoming connections. */
+		int GetAcceptedConnectionCount() const;
+		/** accepted incoming connections per second, measured on each idle timer tick. */
+		float GetAcceptRate() const;
+		/** the highest accept rate since the server is started. */
+		float GetMaxAcceptRate() const;
+
+		/** initialize and start a newly accepted connection. It is called by all acceptors. 
+		* [thread safe]
+		*/
+		void StartAcceptedConnection(NPLConnection_ptr& connection);
 	public:
 		/** get extern IP address of this computer. */
 		std::string GetExternalIP();
@@ -122,6 +187,9 @@ namespace NPL
 		/** Handle idle timer timeout.*/
 		void handle_idle_timeout(const boost::system::error_code& err);
 
+		/** update m_fAcceptRate. it is called on each idle timer tick. */
+		void UpdateAcceptRate();
+
 		/// The io_service for dispatching (send/receive) messages from TCP stack to NPL runtime states' message queues.
 		boost::asio::io_service m_io_service_dispatcher;
 
@@ -163,6 +231,18 @@ namespace NPL
 		/** queue size of the acceptor's queue. */
 		int m_nMaxPendingConnections;
 
+		/** number of listening sockets, including m_acceptor. */
+		int m_nAcceptorCount;
+		/** additional SO_REUSEPORT acceptors. */
+		std::vector< boost::shared_ptr<CNPLAcceptor> > m_acceptors;
+
+		/** total number of accepted incoming connections. */
+		std::atomic<int> m_nAcceptedCount;
+		int m_nLastAcceptedCount;
+		uint32 m_nLastAcceptRateTime;
+		float m_fAcceptRate;
+		float m_fMaxAcceptRate;
+
 		/** a slowly ticked timer which checks if any connection should be timed out. */
 		typedef boost::asio::basic_waitable_timer<boost::chrono::steady_clock> timer_type;
 		timer_type m_idle_timer;
@@ -176,5 +256,8 @@ namespace NPL
 		* this class serves as an interface between the low level socket interface and NPL message queues.  
 		*/
 		CNPLDispatcher m_msg_dispatcher;
+
+		/** reliable UDP transport, it runs on m_io_service_dispatcher. */
+		CNPLUDPTransport m_udp_transport;
 	};
 }
\ No newline at end of file
@@ -0,0 +1,120 @@
+//-----------------------------------------------------------------------------
+// Class:	CNPLPreemptionTimer
+// Company: ParaEngine
+// Desc: time slice based preemption of neuron file coroutines.
+//-----------------------------------------------------------------------------
+#include "ParaEngine.h"
+#include "util/ParaTime.h"
+#include "NPLPreemptionTimer.h"
+#include <boost/bind.hpp>
+
+extern "C"
+{
+#include "lua.h"
+}
+
+using namespace NPL;
+
+/** installed by the timer thread when a deadline is reached. it removes itself and yields the running coroutine. */
+static void npl_timeslice_hook(lua_State* L, lua_Debug* ar)
+{
+	(void)ar;
+	lua_sethook(L, npl_timeslice_hook, 0, 0);
+	lua_yield(L, 0);
+}
+
+NPL::CNPLPreemptionTimer::CNPLPreemptionTimer()
+	: m_thread(NULL), m_bStop(false), m_nPreemptCount(0)
+{
+}
+
+NPL::CNPLPreemptionTimer::~CNPLPreemptionTimer()
+{
+	if (m_thread)
+	{
+		{
+			boost::lock_guard<boost::mutex> lock_(m_mutex);
+			m_bStop = true;
+		}
+		m_cond.notify_all();
+		m_thread->join();
+		delete m_thread;
+		m_thread = NULL;
+	}
+}
+
+CNPLPreemptionTimer& NPL::CNPLPreemptionTimer::GetInstance()
+{
+	static CNPLPreemptionTimer s_instance;
+	return s_instance;
+}
+
+void NPL::CNPLPreemptionTimer::Arm(lua_State* th, int64 nDeadlineUS)
+{
+	bool bNotify = true;
+	{
+		boost::lock_guard<boost::mutex> lock_(m_mutex);
+		if (!m_thread)
+			m_thread = new boost::thread(boost::bind(&CNPLPreemptionTimer::Run, this));
+		// only wake up the timer thread if the new deadline is the earliest one.
+		for (auto& deadline : m_deadlines)
+		{
+			if (deadline.m_nDeadlineUS <= nDeadlineUS)
+			{
+				bNotify = false;
+				break;
+			}
+		}
+		Deadline deadline = { th, nDeadlineUS };
+		m_deadlines.push_back(deadline);
+	}
+	if (bNotify)
+		m_cond.notify_one();
+}
+
+bool NPL::CNPLPreemptionTimer::Disarm(lua_State* th)
+{
+	boost::lock_guard<boost::mutex> lock_(m_mutex);
+	for (auto itCur = m_deadlines.begin(); itCur != m_deadlines.end(); ++itCur)
+	{
+		if (itCur->m_th == th)
+		{
+			m_deadlines.erase(itCur);
+			return false;
+		}
+	}
+	return true;
+}
+
+void NPL::CNPLPreemptionTimer::Run()
+{
+	boost::unique_lock<boost::mutex> lock_(m_mutex);
+	while (!m_bStop)
+	{
+		if (m_deadlines.empty())
+		{
+			m_cond.wait(lock_);
+			continue;
+		}
+		int64 nCurTime = ParaEngine::GetTimeUS();
+		int64 nNextDeadline = 0;
+		for (auto itCur = m_deadlines.begin(); itCur != m_deadlines.end();)
+		{
+			if (itCur->m_nDeadlineUS <= nCurTime)
+			{
+				// the hook is installed while holding the lock, so that Disarm() returns after it.
+				lua_sethook(itCur->m_th, npl_timeslice_hook, LUA_MASKCOUNT, 1);
+				++m_nPreemptCount;
+				itCur = m_deadlines.erase(itCur);
+			}
+			else
+			{
+				if (nNextDeadline == 0 || itCur->m_nDeadlineUS < nNextDeadline)
+					nNextDeadline = itCur->m_nDeadlineUS;
+				++itCur;
+			}
+		}
+		if (nNextDeadline != 0)
+			m_cond.wait_for(lock_, boost::chrono::microseconds(nNextDeadline - nCurTime));
+	}
+}
@@ -0,0 +1,61 @@
+#pragma once
+#include <boost/noncopyable.hpp>
+#include <boost/thread.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <vector>
+
+struct lua_State;
+
+namespace NPL
+{
+	/**
+	* a single background thread that preempts time sliced neuron file coroutines when their deadlines are reached.
+	*
+	* Instruction count based preemption installs a count hook during the whole activation, which slows down the
+	* interpreter and prevents LuaJIT from running compiled traces. Instead, a time sliced coroutine runs without any hook
+	* until its deadline, when this thread calls lua_sethook(th, hook, LUA_MASKCOUNT, 1), which is the only Lua API that
+	* is safe to call from another thread. The hook yields the coroutine at the next instruction.
+	* For LuaJIT, hooks are only checked in compiled code if it is built with LUAJIT_ENABLE_CHECKHOOK, in which case the check
+	* is a cheap flag test at loop back-edges and function calls.
+	*
+	* Deadline precision depends on the OS timer, which is usually well under a millisecond on linux.
+	* [thread safe]
+	*/
+	class CNPLPreemptionTimer : private boost::noncopyable
+	{
+	public:
+		CNPLPreemptionTimer();
+		~CNPLPreemptionTimer();
+
+		static CNPLPreemptionTimer& GetInstance();
+
+		/** preempt the coroutine th when ParaEngine::GetTimeUS() reaches nDeadlineUS.
+		* It must be disarmed before the coroutine is resumed again or collected.
+		*/
+		void Arm(lua_State* th, int64 nDeadlineUS);
+
+		/** cancel a deadline set by Arm(). The caller should remove the hook of th afterwards, since the deadline may
+		* have been reached just before this call.
+		* @return true if the deadline was reached and the hook was installed.
+		*/
+		bool Disarm(lua_State* th);
+
+		/** the number of coroutines preempted since start. */
+		int GetPreemptCount() const { return m_nPreemptCount; }
+
+	protected:
+		void Run();
+
+		struct Deadline
+		{
+			lua_State* m_th;
+			int64 m_nDeadlineUS;
+		};
+		std::vector<Deadline> m_deadlines;
+		boost::mutex m_mutex;
+		boost::condition_variable m_cond;
+		boost::thread* m_thread;
+		bool m_bStop;
+		int m_nPreemptCount;
+	};
+}
@@ -0,0 +1,101 @@
+//-----------------------------------------------------------------------------
+// Class:	CNPLRateLimiter
+// Company: ParaEngine
+// Desc: token bucket rate limiter of incoming NPL messages.
+//-----------------------------------------------------------------------------
+#include "ParaEngine.h"
+#include "NPLRateLimiter.h"
+
+using namespace NPL;
+
+void NPL::CNPLTokenBucket::SetRate(float fRate, float fBurst)
+{
+	m_fRate = fRate;
+	// a message larger than the capacity is still allowed, since the bucket can go into debt.
+	m_fCapacity = fRate * ((fBurst > 0.f) ? fBurst : 1.f);
+	if (m_fCapacity < 1.f)
+		m_fCapacity = 1.f;
+	m_fTokens = m_fCapacity;
+	m_nLastTime = 0;
+}
+
+void NPL::CNPLTokenBucket::Refill(uint32 nCurTime)
+{
+	if (m_nLastTime != 0)
+	{
+		int32 nElapsed = (int32)(nCurTime - m_nLastTime);
+		if (nElapsed > 0)
+		{
+			m_fTokens += m_fRate * nElapsed / 1000.f;
+			if (m_fTokens > m_fCapacity)
+				m_fTokens = m_fCapacity;
+		}
+	}
+	m_nLastTime = nCurTime;
+}
+
+int NPL::CNPLTokenBucket::Consume(float fCount, uint32 nCurTime, bool bAllowDebt)
+{
+	if (!IsEnabled())
+		return 0;
+	Refill(nCurTime);
+	if (m_fTokens >= fCount || (!bAllowDebt && m_fTokens >= m_fCapacity))
+	{
+		// a full bucket always admits a message, otherwise a message larger than capacity is never received.
+		m_fTokens -= fCount;
+		return 0;
+	}
+	if (bAllowDebt)
+	{
+		m_fTokens -= fCount;
+		// wait until the debt is paid off
+		return (int)(-m_fTokens * 1000.f / m_fRate) + 1;
+	}
+	return (int)((fCount - m_fTokens) * 1000.f / m_fRate) + 1;
+}
+
+bool NPL::CNPLTokenBucket::IsFull(uint32 nCurTime)
+{
+	if (!IsEnabled())
+		return true;
+	Refill(nCurTime);
+	return m_fTokens >= m_fCapacity;
+}
+
+void NPL::CNPLRateLimiter::SetLimit(const NPLRateLimit& limit)
+{
+	m_limit = limit;
+	m_msg_bucket.SetRate(limit.m_fMsgRate, limit.m_fBurst);
+	m_byte_bucket.SetRate(limit.m_fByteRate, limit.m_fBurst);
+}
+
+int NPL::CNPLRateLimiter::Consume(int nBytes, uint32 nCurTime)
+{
+	if (!IsEnabled())
+		return 0;
+	if (m_limit.m_policy == RateLimit_Delay)
+	{
+		int nWaitMsg = m_msg_bucket.Consume(1.f, nCurTime, true);
+		int nWaitBytes = m_byte_bucket.Consume((float)nBytes, nCurTime, true);
+		return (nWaitMsg > nWaitBytes) ? nWaitMsg : nWaitBytes;
+	}
+	else
+	{
+		// only take tokens from both buckets if both have enough of them.
+		int nWaitMsg = m_msg_bucket.Consume(1.f, nCurTime, false);
+		if (nWaitMsg > 0)
+			return nWaitMsg;
+		int nWaitBytes = m_byte_bucket.Consume((float)nBytes, nCurTime, false);
+		if (nWaitBytes > 0)
+		{
+			m_msg_bucket.Refund(1.f);
+			return nWaitBytes;
+		}
+		return 0;
+	}
+}
+
+bool NPL::CNPLRateLimiter::IsFull(uint32 nCurTime)
+{
+	return m_msg_bucket.IsFull(nCurTime) && m_byte_bucket.IsFull(nCurTime);
+}
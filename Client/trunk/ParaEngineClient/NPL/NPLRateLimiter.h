@@ -0,0 +1,92 @@
+#pragma once
+
+namespace NPL
+{
+	/** what to do with an incoming message when a rate limit is exceeded. */
+	enum NPLRateLimitPolicy
+	{
+		/** the message is accepted, but further reads on the connection are paused until the bucket is refilled,
+		* so that TCP flow control slows down the sender. */
+		RateLimit_Delay = 0,
+		/** the message is silently dropped. */
+		RateLimit_Drop,
+		/** the connection is closed. */
+		RateLimit_Disconnect,
+	};
+
+	/** rate limit settings of messages and bytes per second. a rate of 0 means unlimited. */
+	struct NPLRateLimit
+	{
+		NPLRateLimit() :m_fMsgRate(0.f), m_fByteRate(0.f), m_fBurst(1.f), m_policy(RateLimit_Delay){};
+		NPLRateLimit(float fMsgRate, float fByteRate, float fBurst, NPLRateLimitPolicy policy)
+			:m_fMsgRate(fMsgRate), m_fByteRate(fByteRate), m_fBurst(fBurst), m_policy(policy){};
+
+		bool IsEnabled() const { return m_fMsgRate > 0.f || m_fByteRate > 0.f; }
+
+		/** max messages per second */
+		float m_fMsgRate;
+		/** max bytes per second */
+		float m_fByteRate;
+		/** bucket capacity in seconds of rate, i.e. how many seconds of traffic can be received in a burst. */
+		float m_fBurst;
+		NPLRateLimitPolicy m_policy;
+	};
+
+	/** a token bucket that is refilled at a constant rate up to its capacity. it is not thread safe. */
+	class CNPLTokenBucket
+	{
+	public:
+		CNPLTokenBucket() :m_fRate(0.f), m_fCapacity(0.f), m_fTokens(0.f), m_nLastTime(0){};
+
+		/** set rate per second. the bucket is filled to its capacity. */
+		void SetRate(float fRate, float fBurst);
+		bool IsEnabled() const { return m_fRate > 0.f; }
+
+		/** take fCount tokens from the bucket.
+		* @param bAllowDebt: if true, tokens are always taken and the bucket may go negative.
+		* @return 0 if there are enough tokens, otherwise the number of milliseconds until the bucket is refilled.
+		*/
+		int Consume(float fCount, uint32 nCurTime, bool bAllowDebt);
+
+		/** put back tokens taken by Consume() */
+		void Refund(float fCount) { m_fTokens += fCount; }
+
+		/** whether the bucket is full, so that it is safe to be removed. */
+		bool IsFull(uint32 nCurTime);
+	protected:
+		void Refill(uint32 nCurTime);
+
+		float m_fRate;
+		float m_fCapacity;
+		float m_fTokens;
+		uint32 m_nLastTime;
+	};
+
+	/** message and byte token buckets with a policy. it is not thread safe. */
+	class CNPLRateLimiter
+	{
+	public:
+		CNPLRateLimiter() :m_nVersion(-1){};
+
+		void SetLimit(const NPLRateLimit& limit);
+		const NPLRateLimit& GetLimit() const { return m_limit; }
+		bool IsEnabled() const { return m_limit.IsEnabled(); }
+
+		/** account one message of nBytes.
+		* @return 0 if within limit, otherwise the number of milliseconds to wait before the limit is met again.
+		* For the delay policy, the message is always accounted.
+		*/
+		int Consume(int nBytes, uint32 nCurTime);
+
+		bool IsFull(uint32 nCurTime);
+
+		/** used by the owner to detect setting changes */
+		int GetVersion() const { return m_nVersion; }
+		void SetVersion(int nVersion) { m_nVersion = nVersion; }
+	protected:
+		NPLRateLimit m_limit;
+		CNPLTokenBucket m_msg_bucket;
+		CNPLTokenBucket m_byte_bucket;
+		int m_nVersion;
+	};
+}
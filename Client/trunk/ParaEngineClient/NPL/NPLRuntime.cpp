@@ -24,6 +24,7 @@
 
 #include "AsyncLoader.h"
 #include "UrlLoaders.h"
+#include "ic/AsyncDBExecutor.h"
 
 #ifdef PARAENGINE_CLIENT
 #include "memdebug.h"
@@ -102,6 +103,9 @@ void CNPLRuntime::Cleanup()
 
 	ParaEngine::CNPLNetClient::ReleaseInstance();
 
+	// finish pending async sql queries while runtime states can still receive the results.
+	ParaInfoCenter::CAsyncDBExecutorManager::GetSingleton().Cleanup();
+
 	while(true)
 	{
 		NPLRuntimeState_ptr rts;
@@ -201,16 +205,7 @@ int CNPLRuntime::Activate( INPLRuntimeState* pRuntimeState, const char * sNeuron
 			// local activation between local npl runtime state.
 			if(!FullName.sRuntimeStateName.empty())
 			{
-				NPLRuntimeState_ptr rts = GetRuntimeState(FullName.sRuntimeStateName);
-				if(rts.get() != 0)
-				{
-					return rts->Activate_async(FullName.sRelativePath, code, nLength, priority);
-				}
-				else
-				{
-					OUTPUT_LOG("warning: runtime state %s does not exist\n", FullName.sRuntimeStateName.c_str());
-					return -1;
-				}
+				return ActivateNamedState(FullName, code, nLength, priority);
 			}
 			else
 			{
@@ -220,7 +215,7 @@ int CNPLRuntime::Activate( INPLRuntimeState* pRuntimeState, const char * sNeuron
 		else
 		{
 			// send via dispatcher if a (remote) NID is found in file name.
-			return m_net_server->GetDispatcher().Activate_Async(FullName, code, nLength, priority);
+			return m_net_server->GetDispatcher().Activate_Async(FullName, code, nLength, priority, channel, reliability);
 		}
 	}
 }
@@ -230,6 +225,34 @@ int CNPLRuntime::TranslatePriorityValue(int priority)
 	return (priority >= NPL::MEDIUM_PRIORITY) ? 0 : 1;
 }
 
+int CNPLRuntime::ActivateNamedState(const NPLFileName& FullName, const char * code, int nLength, int priority)
+{
+	if (FullName.sRuntimeStateName[0] == '@')
+	{
+		// "(@poolname)file.lua" is routed to a worker pool
+		NPLWorkerPool_ptr pool = GetWorkerPool(FullName.sRuntimeStateName.substr(1));
+		if (pool)
+		{
+			return pool->Activate(FullName.sRelativePath, code, nLength, NULL, 0, priority);
+		}
+		else
+		{
+			OUTPUT_LOG("warning: worker pool %s does not exist\n", FullName.sRuntimeStateName.c_str());
+			return -1;
+		}
+	}
+	NPLRuntimeState_ptr rts = GetRuntimeState(FullName.sRuntimeStateName);
+	if(rts.get() != 0)
+	{
+		return rts->Activate_async(FullName.sRelativePath, code, nLength, priority);
+	}
+	else
+	{
+		OUTPUT_LOG("warning: runtime state %s does not exist\n", FullName.sRuntimeStateName.c_str());
+		return -1;
+	}
+}
+
 int CNPLRuntime::NPL_Activate(NPLRuntimeState_ptr runtime_state, const char * sNeuronFile, const char * code, int nLength, int channel, int priority, int reliability)
 {
 	if (sNeuronFile == NULL)
@@ -264,16 +287,7 @@ int CNPLRuntime::NPL_Activate(NPLRuntimeState_ptr runtime_state, const char * sN
 			// local activation between local npl runtime state.
 			if(!FullName.sRuntimeStateName.empty())
 			{
-				NPLRuntimeState_ptr rts = GetRuntimeState(FullName.sRuntimeStateName);
-				if(rts.get() != 0)
-				{
-					return rts->Activate_async(FullName.sRelativePath, code, nLength, priority);
-				}
-				else
-				{
-					OUTPUT_LOG("warning: runtime state %s does not exist\n", FullName.sRuntimeStateName.c_str());
-					return -1;
-				}
+				return ActivateNamedState(FullName, code, nLength, priority);
 			}
 			else
 			{
@@ -283,9 +297,141 @@ int CNPLRuntime::NPL_Activate(NPLRuntimeState_ptr runtime_state, const char * sN
 		else
 		{
 			// send via dispatcher if a (remote) NID is found in file name.
-			return m_net_server->GetDispatcher().Activate_Async(FullName, code, nLength, priority);
+			return m_net_server->GetDispatcher().Activate_Async(FullName, code, nLength, priority, channel, reliability);
+		}
+	}
+}
+
+int CNPLRuntime::NPL_CreateActivationHandle(NPLRuntimeState_ptr runtime_state, const char * sNeuronFile)
+{
+	if (sNeuronFile == NULL)
+		return -1;
+	NPLFileName FullName(sNeuronFile);
+	if (!FullName.sNID.empty())
+	{
+		OUTPUT_LOG("warning: activation handle is only supported for local files: %s\n", sNeuronFile);
+		return -1;
+	}
+	NPLRuntimeState_ptr rts;
+	if (!FullName.sRuntimeStateName.empty())
+		rts = GetRuntimeState(FullName.sRuntimeStateName);
+	else
+		rts = runtime_state ? runtime_state : m_runtime_state_main;
+	if (!rts)
+	{
+		OUTPUT_LOG("warning: runtime state %s does not exist\n", FullName.sRuntimeStateName.c_str());
+		return -1;
+	}
+
+	ParaEngine::Lock lock_(m_activation_mutex);
+	int nFreeSlot = -1;
+	for (int i = 0; i < (int)m_activation_targets.size(); ++i)
+	{
+		NPLActivationTarget& target = m_activation_targets[i];
+		NPLRuntimeState_ptr target_rts = target.m_runtime_state.lock();
+		if (!target_rts)
+		{
+			if (nFreeSlot < 0)
+				nFreeSlot = i;
 		}
+		else if (target_rts == rts && target.m_filename == FullName.sRelativePath)
+		{
+			return (target.m_nGeneration << 16) | (i + 1);
+		}
+	}
+	if (nFreeSlot < 0)
+	{
+		if (m_activation_targets.size() >= 0xffff)
+		{
+			OUTPUT_LOG("warning: too many activation handles\n");
+			return -1;
+		}
+		nFreeSlot = (int)m_activation_targets.size();
+		m_activation_targets.resize(nFreeSlot + 1);
+	}
+	NPLActivationTarget& target = m_activation_targets[nFreeSlot];
+	// the generation wraps within 15 bits, so that handles are always positive.
+	target.m_nGeneration = (target.m_nGeneration + 1) & 0x7fff;
+	target.m_runtime_state = rts;
+	target.m_filename = FullName.sRelativePath;
+	return (target.m_nGeneration << 16) | (nFreeSlot + 1);
+}
+
+NPL::NPLReturnCode CNPLRuntime::NPL_ActivateHandle(int nHandle, NPLMessage_ptr& msg, int priority)
+{
+	NPLRuntimeState_ptr rts;
+	{
+		ParaEngine::Lock lock_(m_activation_mutex);
+		int nIndex = (nHandle & 0xffff) - 1;
+		if (nHandle <= 0 || nIndex < 0 || nIndex >= (int)m_activation_targets.size())
+			return NPL_Error;
+		NPLActivationTarget& target = m_activation_targets[nIndex];
+		if (target.m_nGeneration != (nHandle >> 16))
+			return NPL_RuntimeState_NotExist;
+		rts = target.m_runtime_state.lock();
+		if (!rts)
+			return NPL_RuntimeState_NotExist;
+		msg->m_filename = target.m_filename;
+	}
+	return rts->Activate_async(msg, TranslatePriorityValue(priority));
+}
+
+NPLWorkerPool_ptr CNPLRuntime::NPL_CreateWorkerPool(const char* sPoolName, int nWorkerCount)
+{
+	if (sPoolName == NULL || sPoolName[0] == '\0')
+		return NPLWorkerPool_ptr();
+	NPLWorkerPool_ptr pool;
+	{
+		ParaEngine::Lock lock_(m_pool_mutex);
+		NPLWorkerPool_ptr& pool_ = m_worker_pools[sPoolName];
+		if (!pool_)
+			pool_.reset(new CNPLWorkerPool(sPoolName));
+		pool = pool_;
+	}
+	for (int i = 1; i <= nWorkerCount; ++i)
+	{
+		char sName[32];
+		snprintf(sName, sizeof(sName), "%d", i);
+		std::string sWorkerName = pool->GetName() + sName;
+		NPLRuntimeState_ptr rts = GetRuntimeState(sWorkerName);
+		if (!rts)
+		{
+			rts = CreateRuntimeState(sWorkerName, NPLRuntimeStateType_NPL);
+			rts->Run_Async();
+		}
+		pool->AddWorker(rts);
 	}
+	return pool;
+}
+
+bool CNPLRuntime::NPL_AddWorkerToPool(const char* sPoolName, const char* sRuntimeStateName)
+{
+	if (sRuntimeStateName == NULL)
+		return false;
+	NPLRuntimeState_ptr rts = GetRuntimeState(sRuntimeStateName);
+	NPLWorkerPool_ptr pool = NPL_CreateWorkerPool(sPoolName);
+	if (!rts || !pool)
+		return false;
+	pool->AddWorker(rts);
+	return true;
+}
+
+NPLWorkerPool_ptr CNPLRuntime::GetWorkerPool(const std::string& sPoolName)
+{
+	ParaEngine::Lock lock_(m_pool_mutex);
+	auto iter = m_worker_pools.find(sPoolName);
+	return (iter != m_worker_pools.end()) ? iter->second : NPLWorkerPool_ptr();
+}
+
+NPL::NPLReturnCode CNPLRuntime::NPL_ActivateWorkerPool(const char* sPoolName, const char * sNeuronFile, const char * code, int nLength, const char* sKey, int priority)
+{
+	if (sPoolName == NULL || sNeuronFile == NULL)
+		return NPL_Error;
+	NPLWorkerPool_ptr pool = GetWorkerPool(sPoolName);
+	if (!pool)
+		return NPL_RuntimeState_NotExist;
+	NPLFileName FullName(sNeuronFile);
+	return pool->Activate(FullName.sRelativePath, code, nLength, sKey, 0, TranslatePriorityValue(priority));
 }
 
 void CNPLRuntime::NPL_LoadFile(NPLRuntimeState_ptr runtime_state, const char* filePath, bool bReload)
@@ -681,6 +827,43 @@ void CNPLRuntime::NPL_SetProtocol(const char* nid, int protocolType /*= 0*/)
 
 }
 
+int CNPLRuntime::NPL_SendHttpResponse(const char* nid, int nSeq, const char* data, int nLength, int nFlags)
+{
+	NPLConnection_ptr pConnection = NPL::CNPLRuntime::GetInstance()->GetNetServer()->GetDispatcher().GetNPLConnectionByNID(nid);
+	if (pConnection)
+	{
+		return pConnection->SendHttpResponse(nSeq, data, nLength, nFlags);
+	}
+	return NPL_ConnectionNotEstablished;
+}
+
+void CNPLRuntime::NPL_AddHttpStaticDir(const char* sURLPrefix, const char* sDiskDir)
+{
+	if (sURLPrefix)
+		NPL::CNPLRuntime::GetInstance()->GetNetServer()->GetDispatcher().AddHttpStaticDir(sURLPrefix, sDiskDir ? sDiskDir : "");
+}
+
+void CNPLRuntime::NPL_SetRateLimit(const char* sScope, float fMsgRate, float fByteRate, float fBurst, const char* sPolicy, const char* sFileName)
+{
+	int nScope = CNPLDispatcher::RateLimitScope_Connection;
+	if (sScope != 0)
+	{
+		if (strcmp(sScope, "nid") == 0)
+			nScope = CNPLDispatcher::RateLimitScope_NID;
+		else if (strcmp(sScope, "file") == 0)
+			nScope = CNPLDispatcher::RateLimitScope_File;
+	}
+	NPLRateLimitPolicy policy = RateLimit_Delay;
+	if (sPolicy != 0)
+	{
+		if (strcmp(sPolicy, "drop") == 0)
+			policy = RateLimit_Drop;
+		else if (strcmp(sPolicy, "disconnect") == 0)
+			policy = RateLimit_Disconnect;
+	}
+	m_net_server->GetDispatcher().SetRateLimit(nScope, NPLRateLimit(fMsgRate, fByteRate, fBurst, policy), sFileName ? sFileName : "");
+}
+
 void CNPLRuntime::NPL_accept(const char* sTID, const char* sNID)
 {
 	if(sTID!=0)
@@ -767,6 +950,14 @@ void CNPLRuntime::SetHostMainStatesInFrameMove(bool bHostMainStatesInFrameMove)
 	}
 }
 
+bool CNPLRuntime::IsInMainStateThread()
+{
+	if (!m_bHostMainStatesInFrameMove)
+		return false;
+	ParaEngine::Lock lock_(m_mutex);
+	return m_main_states_thread_id == boost::this_thread::get_id();
+}
+
 void CNPLRuntime::Run(bool bToEnd)
 {
 	/** dispatch events in NPL. */
@@ -828,6 +1019,7 @@ void CNPLRuntime::Run(bool bToEnd)
 		{
 			// in case the structure is modified by other threads or during processing, we will first dump to a temp queue and then process from the queue.
 			ParaEngine::Lock lock_(m_mutex);
+			m_main_states_thread_id = boost::this_thread::get_id();
 			NPLRuntime_Pool_Type::const_iterator iter, iter_end = m_runtime_states_main_threaded.end();
 			for(iter = m_runtime_states_main_threaded.begin(); iter!=iter_end; ++iter)
 			{
@@ -937,6 +1129,11 @@ bool CNPLRuntime::DeleteRuntimeState( NPLRuntimeState_ptr runtime_state)
 {
 	if(runtime_state.get() == 0)
 		return true;
+	{
+		ParaEngine::Lock lock_(m_pool_mutex);
+		for (auto& pool : m_worker_pools)
+			pool.second->RemoveWorker(runtime_state);
+	}
 	ParaEngine::Lock lock_(m_mutex);
 	NPLRuntime_Pool_Type::iterator iter = m_runtime_states.find(runtime_state);
 	if(iter != m_runtime_states.end())
@@ -1071,6 +1268,111 @@ void CNPLRuntime::SetMaxPendingConnections(int val)
 	NPL::CNPLRuntime::GetInstance()->GetNetServer()->SetMaxPendingConnections(val);
 }
 
+int CNPLRuntime::GetHttpMaxKeepAliveRequests()
+{
+	return NPL::CNPLRuntime::GetInstance()->GetNetServer()->GetDispatcher().GetHttpMaxKeepAliveRequests();
+}
+
+void CNPLRuntime::SetHttpMaxKeepAliveRequests(int nCount)
+{
+	NPL::CNPLRuntime::GetInstance()->GetNetServer()->GetDispatcher().SetHttpMaxKeepAliveRequests(nCount);
+}
+
+int CNPLRuntime::GetAcceptorCount()
+{
+	return NPL::CNPLRuntime::GetInstance()->GetNetServer()->GetAcceptorCount();
+}
+
+void CNPLRuntime::SetAcceptorCount(int nCount)
+{
+	NPL::CNPLRuntime::GetInstance()->GetNetServer()->SetAcceptorCount(nCount);
+}
+
+int CNPLRuntime::GetAcceptedConnectionCount()
+{
+	return NPL::CNPLRuntime::GetInstance()->GetNetServer()->GetAcceptedConnectionCount();
+}
+
+float CNPLRuntime::GetAcceptRate()
+{
+	return NPL::CNPLRuntime::GetInstance()->GetNetServer()->GetAcceptRate();
+}
+
+float CNPLRuntime::GetMaxAcceptRate()
+{
+	return NPL::CNPLRuntime::GetInstance()->GetNetServer()->GetMaxAcceptRate();
+}
+
+bool CNPLRuntime::IsUDPEnabled()
+{
+	return NPL::CNPLRuntime::GetInstance()->GetNetServer()->GetUDPTransport().IsEnabled();
+}
+
+void CNPLRuntime::EnableUDP(bool bEnable)
+{
+	NPL::CNPLRuntime::GetInstance()->GetNetServer()->GetUDPTransport().SetEnabled(bEnable);
+}
+
+float CNPLRuntime::GetUDPLossRate()
+{
+	return NPL::CNPLRuntime::GetInstance()->GetNetServer()->GetUDPTransport().GetLossRate();
+}
+
+void CNPLRuntime::SetUDPLossRate(float fRate)
+{
+	NPL::CNPLRuntime::GetInstance()->GetNetServer()->GetUDPTransport().SetLossRate(fRate);
+}
+
+int CNPLRuntime::GetUDPLatency()
+{
+	return NPL::CNPLRuntime::GetInstance()->GetNetServer()->GetUDPTransport().GetLatency();
+}
+
+void CNPLRuntime::SetUDPLatency(int nMilliseconds)
+{
+	NPL::CNPLRuntime::GetInstance()->GetNetServer()->GetUDPTransport().SetLatency(nMilliseconds);
+}
+
+int CNPLRuntime::GetUDPSendWindow()
+{
+	return NPL::CNPLRuntime::GetInstance()->GetNetServer()->GetUDPTransport().GetSendWindow();
+}
+
+void CNPLRuntime::SetUDPSendWindow(int nWindow)
+{
+	NPL::CNPLRuntime::GetInstance()->GetNetServer()->GetUDPTransport().SetSendWindow(nWindow);
+}
+
+int CNPLRuntime::GetUDPMaxIncomingPeers()
+{
+	return NPL::CNPLRuntime::GetInstance()->GetNetServer()->GetUDPTransport().GetMaxIncomingPeers();
+}
+
+void CNPLRuntime::SetUDPMaxIncomingPeers(int nCount)
+{
+	NPL::CNPLRuntime::GetInstance()->GetNetServer()->GetUDPTransport().SetMaxIncomingPeers(nCount);
+}
+
+int CNPLRuntime::GetUDPPort()
+{
+	return NPL::CNPLRuntime::GetInstance()->GetNetServer()->GetUDPTransport().GetPort();
+}
+
+int CNPLRuntime::GetUDPRetransmitCount()
+{
+	return NPL::CNPLRuntime::GetInstance()->GetNetServer()->GetUDPTransport().GetRetransmitCount();
+}
+
+int CNPLRuntime::GetUDPFastRetransmitCount()
+{
+	return NPL::CNPLRuntime::GetInstance()->GetNetServer()->GetUDPTransport().GetFastRetransmitCount();
+}
+
+int CNPLRuntime::GetRateLimitedCount()
+{
+	return NPL::CNPLRuntime::GetInstance()->GetNetServer()->GetDispatcher().GetRateLimitedCount();
+}
+
 const std::string& NPL::CNPLRuntime::GetHostPort()
 {
 	return NPL::CNPLRuntime::GetInstance()->GetNetServer()->GetHostPort();
@@ -1129,6 +1431,20 @@ int CNPLRuntime::InstallFields(ParaEngine::CAttributeClass* pClass, bool bOverri
 	pClass->AddField("CompressionThreshold",FieldType_Int, (void*)SetCompressionThreshold_s, (void*)GetCompressionThreshold_s, NULL, NULL, bOverride);
 	pClass->AddField("CompressionLevel",FieldType_Int, (void*)SetCompressionLevel_s, (void*)GetCompressionLevel_s, NULL, NULL, bOverride);
 	pClass->AddField("MaxPendingConnections", FieldType_Int, (void*)SetMaxPendingConnections_s, (void*)GetMaxPendingConnections_s, NULL, NULL, bOverride);
+	pClass->AddField("HttpMaxKeepAliveRequests", FieldType_Int, (void*)SetHttpMaxKeepAliveRequests_s, (void*)GetHttpMaxKeepAliveRequests_s, NULL, NULL, bOverride);
+	pClass->AddField("AcceptorCount", FieldType_Int, (void*)SetAcceptorCount_s, (void*)GetAcceptorCount_s, NULL, NULL, bOverride);
+	pClass->AddField("AcceptedConnectionCount", FieldType_Int, (void*)0, (void*)GetAcceptedConnectionCount_s, NULL, NULL, bOverride);
+	pClass->AddField("AcceptRate", FieldType_Float, (void*)0, (void*)GetAcceptRate_s, NULL, NULL, bOverride);
+	pClass->AddField("MaxAcceptRate", FieldType_Float, (void*)0, (void*)GetMaxAcceptRate_s, NULL, NULL, bOverride);
+	pClass->AddField("EnableUDP", FieldType_Bool, (void*)EnableUDP_s, (void*)IsUDPEnabled_s, NULL, NULL, bOverride);
+	pClass->AddField("UDPLossRate", FieldType_Float, (void*)SetUDPLossRate_s, (void*)GetUDPLossRate_s, NULL, NULL, bOverride);
+	pClass->AddField("UDPLatency", FieldType_Int, (void*)SetUDPLatency_s, (void*)GetUDPLatency_s, NULL, NULL, bOverride);
+	pClass->AddField("UDPSendWindow", FieldType_Int, (void*)SetUDPSendWindow_s, (void*)GetUDPSendWindow_s, NULL, NULL, bOverride);
+	pClass->AddField("UDPMaxIncomingPeers", FieldType_Int, (void*)SetUDPMaxIncomingPeers_s, (void*)GetUDPMaxIncomingPeers_s, NULL, NULL, bOverride);
+	pClass->AddField("UDPPort", FieldType_Int, (void*)0, (void*)GetUDPPort_s, NULL, NULL, bOverride);
+	pClass->AddField("UDPRetransmitCount", FieldType_Int, (void*)0, (void*)GetUDPRetransmitCount_s, NULL, NULL, bOverride);
+	pClass->AddField("UDPFastRetransmitCount", FieldType_Int, (void*)0, (void*)GetUDPFastRetransmitCount_s, NULL, NULL, bOverride);
+	pClass->AddField("RateLimitedCount", FieldType_Int, (void*)0, (void*)GetRateLimitedCount_s, NULL, NULL, bOverride);
 	pClass->AddField("LogLevel", FieldType_Int, (void*)SetLogLevel_s, (void*)GetLogLevel_s, NULL, NULL, bOverride);
 	pClass->AddField("EnableAnsiMode",FieldType_Bool, (void*)EnableAnsiMode_s, (void*)IsAnsiMode_s, NULL, NULL, bOverride);
 	pClass->AddField("IsServerStarted", FieldType_Bool, (void*)0, (void*)IsServerStarted_s, NULL, NULL, bOverride);
@@ -8,9 +8,11 @@ struct lua_State;
 #include "INPLRuntime.h"
 /* internal data structure used by NPL runtime */
 #include "NPLCommon.h"
+#include "NPLWorkerPool.h"
 #include "IAttributeFields.h"
 
 #include <boost/scoped_ptr.hpp>
+#include <boost/weak_ptr.hpp>
 #include <boost/thread/shared_mutex.hpp>
 
 namespace ParaEngine
@@ -126,6 +128,30 @@ namespace NPL
 
 		ATTRIBUTE_METHOD1(CNPLRuntime, GetMaxPendingConnections_s, int*)	{ *p1 = cls->GetMaxPendingConnections(); return S_OK; }
 		ATTRIBUTE_METHOD1(CNPLRuntime, SetMaxPendingConnections_s, int)	{ cls->SetMaxPendingConnections(p1); return S_OK; }
+
+		ATTRIBUTE_METHOD1(CNPLRuntime, GetHttpMaxKeepAliveRequests_s, int*)	{ *p1 = cls->GetHttpMaxKeepAliveRequests(); return S_OK; }
+		ATTRIBUTE_METHOD1(CNPLRuntime, SetHttpMaxKeepAliveRequests_s, int)	{ cls->SetHttpMaxKeepAliveRequests(p1); return S_OK; }
+
+		ATTRIBUTE_METHOD1(CNPLRuntime, GetAcceptorCount_s, int*)	{ *p1 = cls->GetAcceptorCount(); return S_OK; }
+		ATTRIBUTE_METHOD1(CNPLRuntime, SetAcceptorCount_s, int)	{ cls->SetAcceptorCount(p1); return S_OK; }
+		ATTRIBUTE_METHOD1(CNPLRuntime, GetAcceptedConnectionCount_s, int*)	{ *p1 = cls->GetAcceptedConnectionCount(); return S_OK; }
+		ATTRIBUTE_METHOD1(CNPLRuntime, GetAcceptRate_s, float*)	{ *p1 = cls->GetAcceptRate(); return S_OK; }
+		ATTRIBUTE_METHOD1(CNPLRuntime, GetMaxAcceptRate_s, float*)	{ *p1 = cls->GetMaxAcceptRate(); return S_OK; }
+
+		ATTRIBUTE_METHOD1(CNPLRuntime, IsUDPEnabled_s, bool*)	{ *p1 = cls->IsUDPEnabled(); return S_OK; }
+		ATTRIBUTE_METHOD1(CNPLRuntime, EnableUDP_s, bool)	{ cls->EnableUDP(p1); return S_OK; }
+		ATTRIBUTE_METHOD1(CNPLRuntime, GetUDPLossRate_s, float*)	{ *p1 = cls->GetUDPLossRate(); return S_OK; }
+		ATTRIBUTE_METHOD1(CNPLRuntime, SetUDPLossRate_s, float)	{ cls->SetUDPLossRate(p1); return S_OK; }
+		ATTRIBUTE_METHOD1(CNPLRuntime, GetUDPLatency_s, int*)	{ *p1 = cls->GetUDPLatency(); return S_OK; }
+		ATTRIBUTE_METHOD1(CNPLRuntime, SetUDPLatency_s, int)	{ cls->SetUDPLatency(p1); return S_OK; }
+		ATTRIBUTE_METHOD1(CNPLRuntime, GetUDPSendWindow_s, int*)	{ *p1 = cls->GetUDPSendWindow(); return S_OK; }
+		ATTRIBUTE_METHOD1(CNPLRuntime, SetUDPSendWindow_s, int)	{ cls->SetUDPSendWindow(p1); return S_OK; }
+		ATTRIBUTE_METHOD1(CNPLRuntime, GetUDPMaxIncomingPeers_s, int*)	{ *p1 = cls->GetUDPMaxIncomingPeers(); return S_OK; }
+		ATTRIBUTE_METHOD1(CNPLRuntime, SetUDPMaxIncomingPeers_s, int)	{ cls->SetUDPMaxIncomingPeers(p1); return S_OK; }
+		ATTRIBUTE_METHOD1(CNPLRuntime, GetUDPPort_s, int*)	{ *p1 = cls->GetUDPPort(); return S_OK; }
+		ATTRIBUTE_METHOD1(CNPLRuntime, GetUDPRetransmitCount_s, int*)	{ *p1 = cls->GetUDPRetransmitCount(); return S_OK; }
+		ATTRIBUTE_METHOD1(CNPLRuntime, GetUDPFastRetransmitCount_s, int*)	{ *p1 = cls->GetUDPFastRetransmitCount(); return S_OK; }
+		ATTRIBUTE_METHOD1(CNPLRuntime, GetRateLimitedCount_s, int*)	{ *p1 = cls->GetRateLimitedCount(); return S_OK; }
 			
 		ATTRIBUTE_METHOD1(CNPLRuntime, GetLogLevel_s, int*) { *p1 = cls->GetLogLevel(); return S_OK; }
 		ATTRIBUTE_METHOD1(CNPLRuntime, SetLogLevel_s, int) { cls->SetLogLevel(p1); return S_OK; }
@@ -219,6 +245,42 @@ namespace NPL
 		virtual int GetMaxPendingConnections();
 		virtual void SetMaxPendingConnections(int val);
 
+		/** max number of HTTP requests served on a single keep-alive connection. default to 0, which is unlimited. */
+		int GetHttpMaxKeepAliveRequests();
+		void SetHttpMaxKeepAliveRequests(int nCount);
+
+		/** number of SO_REUSEPORT acceptors of the server, each with its own thread. it must be set before the server is started. */
+		int GetAcceptorCount();
+		void SetAcceptorCount(int nCount);
+		/** total number of accepted incoming connections. */
+		int GetAcceptedConnectionCount();
+		/** accepted incoming connections per second, and the highest one since server started. */
+		float GetAcceptRate();
+		float GetMaxAcceptRate();
+
+		/** whether the reliable UDP transport is bound to the server port when the server starts. default to false. 
+		* NIDs added by NPL.AddNPLRuntimeAddress({..., udp=true}) are always activated via UDP. */
+		bool IsUDPEnabled();
+		void EnableUDP(bool bEnable);
+		/** probability of dropping and milliseconds of delaying an outgoing UDP datagram, for testing only. */
+		float GetUDPLossRate();
+		void SetUDPLossRate(float fRate);
+		int GetUDPLatency();
+		void SetUDPLatency(int nMilliseconds);
+		/** max number of unacknowledged reliable UDP messages per peer. */
+		int GetUDPSendWindow();
+		void SetUDPSendWindow(int nWindow);
+		/** max number of incoming UDP peers that are not added by NPL.AddNPLRuntimeAddress. */
+		int GetUDPMaxIncomingPeers();
+		void SetUDPMaxIncomingPeers(int nCount);
+		/** local UDP port, 0 if not opened. */
+		int GetUDPPort();
+		/** number of RTO and fast retransmits of reliable UDP messages. */
+		int GetUDPRetransmitCount();
+		int GetUDPFastRetransmitCount();
+		/** number of incoming messages that exceeded any rate limit. */
+		int GetRateLimitedCount();
+
 
 		/** get the host port of this NPL runtime */
 		virtual const std::string& GetHostPort();
@@ -297,6 +359,50 @@ namespace NPL
 		*/
 		int NPL_Activate(NPLRuntimeState_ptr runtime_state, const char * sNeuronFile, const char * code = NULL,int nLength=0,  int channel=0, int priority=2, int reliability=3);
 
+		/** get a handle of a local (runtime state, neuron file) pair, so that high rate activations to it with NPL_ActivateHandle() 
+		* skip file name parsing and runtime state lookup. The same handle is returned for the same pair, and it is valid 
+		* until the runtime state is deleted. A stale handle never activates another target that reuses its slot. 
+		* [thread safe]
+		* @param runtime_state: the caller's runtime state, which is used if sNeuronFile does not specify a runtime state. 
+		* @param sNeuronFile: a local file name, such as "(worker1)script/consumer.lua". 
+		* @return a positive handle, or -1 if the file is remote or the runtime state does not exist. 
+		*/
+		int NPL_CreateActivationHandle(NPLRuntimeState_ptr runtime_state, const char * sNeuronFile);
+
+		/** activate a target returned by NPL_CreateActivationHandle(). 
+		* [thread safe]
+		* @param msg: a message whose m_code is already serialized. its m_filename is set by this function. 
+		* @param priority: see PacketPriority
+		*/
+		NPLReturnCode NPL_ActivateHandle(int nHandle, NPLMessage_ptr& msg, int priority = 2);
+
+		/** create or get a named worker pool, and add nWorkerCount worker runtime states to it. 
+		* Activations to "(@poolname)file.lua" are routed to the least loaded worker of the pool. 
+		* [thread safe]
+		* @param nWorkerCount: workers are named poolname1, poolname2, ... Existing runtime states with these names are reused, 
+		* and new ones are created and started in their own threads. 
+		* @return the pool
+		*/
+		NPLWorkerPool_ptr NPL_CreateWorkerPool(const char* sPoolName, int nWorkerCount = 0);
+
+		/** add an existing runtime state to a worker pool. The pool is created if not exist. 
+		* [thread safe]
+		* @return false if the runtime state does not exist. 
+		*/
+		bool NPL_AddWorkerToPool(const char* sPoolName, const char* sRuntimeStateName);
+
+		/** get a worker pool by name, null if not exist.
+		* [thread safe]
+		*/
+		NPLWorkerPool_ptr GetWorkerPool(const std::string& sPoolName);
+
+		/** activate a local file in a worker pool. 
+		* [thread safe]
+		* @param sKey: if not NULL or empty, messages with the same key are always routed to the same worker. 
+		* @param priority: see PacketPriority
+		*/
+		NPLReturnCode NPL_ActivateWorkerPool(const char* sPoolName, const char * sNeuronFile, const char * code = NULL, int nLength = 0, const char* sKey = NULL, int priority = 2);
+
 		/** same as NPL_Activate */
 		virtual int Activate(INPLRuntimeState* pRuntimeState, const char * sNeuronFile, const char * code = NULL,int nLength=0,  int channel=0, int priority=2, int reliability=3);
 		
@@ -355,6 +461,30 @@ namespace NPL
 		/** set transmission protocol, default value is 0. */
 		void NPL_SetProtocol(const char* nid, int protocolType = 0);
 
+		/** send part of the response of an HTTP request. see CNPLConnection::SendHttpResponse() 
+		* [thread safe]
+		* @param nid: nid or tid of the connection. 
+		* @param nSeq: msg.seq of the HTTP request. 
+		* @param nFlags: 0 for raw data, 1 for a chunk of chunked transfer encoding, 2 to end the response. they can be combined. 
+		*/
+		int NPL_SendHttpResponse(const char* nid, int nSeq, const char* data, int nLength, int nFlags);
+
+		/** serve HTTP GET/HEAD requests whose url begins with sURLPrefix from files in sDiskDir, without activating NPL files. 
+		* see CNPLDispatcher::AddHttpStaticDir() 
+		* [thread safe]
+		*/
+		void NPL_AddHttpStaticDir(const char* sURLPrefix, const char* sDiskDir);
+
+		/** set token bucket limits on incoming messages. see CNPLDispatcher::SetRateLimit() 
+		* [thread safe]
+		* @param sScope: "connection", "nid" or "file"
+		* @param fMsgRate, fByteRate: max messages and bytes per second, 0 for unlimited. 
+		* @param fBurst: bucket capacity in seconds of rate. 
+		* @param sPolicy: "delay", "drop" or "disconnect"
+		* @param sFileName: target neuron file for the "file" scope. 
+		*/
+		void NPL_SetRateLimit(const char* sScope, float fMsgRate, float fByteRate, float fBurst, const char* sPolicy, const char* sFileName);
+
 		/** reject and close a given connection. The connection will be closed once rejected. 
 		* [thread safe]
 		* @param nid: the temporary id or NID of the connection to be rejected. usually it is from msg.tid or msg.nid. 
@@ -515,7 +645,7 @@ namespace NPL
 
 		//////////////////////////////////////////////////////////////////////////
 		//
-		// UDP networking functions (RakNet in NPL network layer, currently obsoleted)
+		// UDP networking functions (RakNet in NPL network layer, currently obsoleted, see CNPLUDPTransport instead)
 		//
 		//////////////////////////////////////////////////////////////////////////
 
@@ -627,6 +757,12 @@ namespace NPL
 
 		/** from NPL::PacketPriority to internal priority */
 		int TranslatePriorityValue(int priority);
+
+		/** local activation to a file whose runtime state name is given. "(@poolname)file.lua" is routed to a worker pool,
+		* and "(name)file.lua" to a runtime state. It is shared by Activate() and NPL_Activate().
+		* @param priority: internal priority from TranslatePriorityValue()
+		*/
+		int ActivateNamedState(const NPLFileName& FullName, const char * code, int nLength, int priority);
 	public:
 		virtual INPLRuntimeState* CreateState(const char* name, NPLRuntimeStateType type_=NPLRuntimeStateType_NPL);
 		virtual INPLRuntimeState* GetState(const char* name);
@@ -683,6 +819,10 @@ namespace NPL
 		* @NOTE: One can only call this function once to set to false. This function is only used by the ParaEngineServer
 		*/
 		void SetHostMainStatesInFrameMove(bool bHostMainStatesInFrameMove);
+
+		/** whether the main runtime states are processed in the frame move of the calling thread, so that 
+		* the main state's lua functions can be called directly. it is false after SetHostMainStatesInFrameMove(false). */
+		bool IsInMainStateThread();
 		
 	private: 
 		/** the DNS server stack */
@@ -740,6 +880,26 @@ namespace NPL
 
 		/// protecting this data member
 		ParaEngine::mutex m_mutex;
+		/// the thread that processes the main runtime states in frame move. 
+		boost::thread::id m_main_states_thread_id;
+
+		/** a pre-resolved local activation target */
+		struct NPLActivationTarget
+		{
+			NPLActivationTarget() :m_nGeneration(0){};
+			boost::weak_ptr<CNPLRuntimeState> m_runtime_state;
+			std::string m_filename;
+			/** increased each time the slot is reused, so that stale handles of the previous target are rejected. */
+			int m_nGeneration;
+		};
+		/** the lower 16 bits of a handle is index + 1, and the higher bits is the generation of the slot. 
+		* slots are reused only when their runtime states are deleted. */
+		std::vector<NPLActivationTarget> m_activation_targets;
+		ParaEngine::mutex m_activation_mutex;
+
+		/** mapping from pool name to worker pool */
+		std::map<std::string, NPLWorkerPool_ptr> m_worker_pools;
+		ParaEngine::mutex m_pool_mutex;
 
 		static NPLRuntimeStateType m_defaultNPLStateType;
 	};
@@ -17,8 +17,11 @@
 #include "NPLCommon.h"
 #include "NPLRuntime.h"
 #include "util/ScopedLock.h"
+#include "util/ParaTime.h"
+#include "NPLPreemptionTimer.h"
 #include <boost/bind.hpp>
 #include "NPLRuntimeState.h"
+#include "EventsCenter.h"
 
 /**
 for luabind, The main drawback of this approach is that the compilation time will increase for the file
@@ -69,9 +72,9 @@ public:
 };
 
 NPL::CNPLRuntimeState::CNPLRuntimeState(const string & name, NPLRuntimeStateType type_)
-	: m_bUseMessageEvent(false), m_name(name), m_type(type_), m_nFrameMoveCount(0), m_bIsPreemptive(false), m_bPauseAllPreemptiveFunction(false),
-	m_current_msg(NULL), m_current_msg_length(0), m_pMonoScriptingState(NULL), m_processed_msg_count(0), m_bIsProcessing(false),
-	ParaScripting::CNPLScriptingState(type_ != NPLRuntimeStateType_DLL && type_ != NPLRuntimeStateType_NPL_ExternalLuaState)
+	: ParaScripting::CNPLScriptingState(type_ != NPLRuntimeStateType_DLL && type_ != NPLRuntimeStateType_NPL_ExternalLuaState),
+	m_name(name), m_type(type_), m_bUseMessageEvent(false), m_bIsProcessing(false), m_bIsPreemptive(false), m_bPauseAllPreemptiveFunction(false),
+	m_current_msg(NULL), m_current_msg_length(0), m_processed_msg_count(0), m_nAvgProcessTimeUS(0), m_nAvgQueueTimeUS(0), m_nFrameMoveCount(0), m_pMonoScriptingState(NULL)
 {
 }
 
@@ -117,6 +120,7 @@ void NPL::CNPLRuntimeState::Reset_Imp()
 {
 	if (m_type != NPLRuntimeStateType_DLL)
 	{
+		UnregisterLuaEventHandlers();
 		DestroyState();
 		CreateSetState();
 	}
@@ -135,6 +139,7 @@ void NPL::CNPLRuntimeState::Reset_Imp()
 NPL::CNPLRuntimeState::~CNPLRuntimeState()
 {
 	Stop();
+	UnregisterLuaEventHandlers();
 	SAFE_RELEASE(m_pMonoScriptingState);
 	for (auto v : m_act_files_cpp)
 	{
@@ -151,6 +156,13 @@ NPL::CNPLRuntimeState::~CNPLRuntimeState()
 	OUTPUT_LOG("NPL State %s exited\n", GetName().c_str());
 }
 
+void NPL::CNPLRuntimeState::UnregisterLuaEventHandlers()
+{
+	// only the main state can register lua function event handlers, and the events center is only used in the main thread. 
+	if (m_name == "main" && GetLuaState() != 0)
+		ParaEngine::CGlobals::GetEventsCenter()->UnregisterEventsOfLuaState(GetLuaState());
+}
+
 NPL::IMonoScriptingState* NPL::CNPLRuntimeState::GetMonoState()
 {
 	if (m_pMonoScriptingState)
@@ -305,6 +317,14 @@ int NPL::CNPLRuntimeState::ProcessMsg(NPLMessage_ptr msg)
 	++m_processed_msg_count;
 	if (msg->m_type == MSG_TYPE_FILE_ACTIVATION)
 	{
+		int64 nStartTime = 0;
+		if (msg->m_nQueueTime != 0)
+		{
+			// moving average with weight 1/8, which is the same as TCP srtt.
+			nStartTime = ParaEngine::GetTimeUS();
+			int nQueueTime = (int)(nStartTime - msg->m_nQueueTime);
+			m_nAvgQueueTimeUS = m_nAvgQueueTimeUS + (nQueueTime - m_nAvgQueueTimeUS) / 8;
+		}
 		auto pFileState = GetNeuronFileState(msg->m_filename, false);
 		if (!pFileState) {
 			LoadFile_any(msg->m_filename, false, 0, true);
@@ -328,6 +348,11 @@ int NPL::CNPLRuntimeState::ProcessMsg(NPLMessage_ptr msg)
 				pFileState->Tick(m_nFrameMoveCount);
 			}
 		}
+		if (nStartTime != 0)
+		{
+			int nProcessTime = (int)(ParaEngine::GetTimeUS() - nStartTime);
+			m_nAvgProcessTimeUS = m_nAvgProcessTimeUS + (nProcessTime - m_nAvgProcessTimeUS) / 8;
+		}
 	}
 	else if (msg->m_type == MSG_TYPE_TICK)
 	{
@@ -361,6 +386,28 @@ static void npl_preemptive_scheduler_hook(lua_State* L, lua_Debug* ar)
 	lua_yield(L, 0);
 }
 
+void NPL::CNPLRuntimeState::BeginPreemptiveSlice(lua_State* th, CNeuronFileState* pFileState)
+{
+	if (pFileState->IsTimeSliced())
+	{
+		// no hook until the deadline, so that the coroutine runs at full speed. 
+		CNPLPreemptionTimer::GetInstance().Arm(th, pFileState->GetTimeSliceDeadline(m_nFrameMoveCount));
+	}
+	else
+	{
+		lua_sethook(th, npl_preemptive_scheduler_hook, LUA_MASKCOUNT, pFileState->GetPreemptiveInstructionCount());
+	}
+}
+
+void NPL::CNPLRuntimeState::EndPreemptiveSlice(lua_State* th, CNeuronFileState* pFileState)
+{
+	if (pFileState->IsTimeSliced())
+		CNPLPreemptionTimer::GetInstance().Disarm(th);
+	// Lua 5.1 support per thread hook, while luajit hook is global to all. 
+	// so we need to unhook it for the rest of non-preemptive code.
+	lua_sethook(th, npl_preemptive_scheduler_hook, 0, 0);
+}
+
 /*
 From Mike: http://lua-users.org/lists/lua-l/2011-06/msg00513.html
 
@@ -426,7 +473,7 @@ int NPL::CNPLRuntimeState::FrameMoveTick()
 						if (status == LUA_YIELD)
 						{
 							// call activate function with preemptive hook. 
-							lua_sethook(th, npl_preemptive_scheduler_hook, LUA_MASKCOUNT, pFileState->GetPreemptiveInstructionCount());
+							BeginPreemptiveSlice(th, pFileState);
 							{
 								ParaEngine::ScopedBoolean_Lock lock(&m_bIsPreemptive);
 								int top = lua_gettop(th);
@@ -463,9 +510,7 @@ int NPL::CNPLRuntimeState::FrameMoveTick()
 								if (num_results > 0)
 									lua_pop(th, num_results);
 							}
-							// Lua 5.1 support per thread hook, while luajit hook is global to all. 
-							// so we need to unhook it for the rest of non-preemptive code.
-							lua_sethook(th, npl_preemptive_scheduler_hook, 0, pFileState->GetPreemptiveInstructionCount());
+							EndPreemptiveSlice(th, pFileState);
 						}
 					}
 					lua_pop(L, 1);
@@ -492,7 +537,7 @@ int NPL::CNPLRuntimeState::FrameMoveTick()
 		else
 		{
 			NPLMessage_ptr msg;
-			while (!pFileState->IsProcessing() && pFileState->GetMessage(msg))
+			while (!pFileState->IsProcessing() && !pFileState->IsTimeSliceUsedUp(m_nFrameMoveCount) && pFileState->GetMessage(msg))
 			{
 				pFileState->SetProcessing(false);
 				if (pFileState->IsPreemptive())
@@ -503,7 +548,7 @@ int NPL::CNPLRuntimeState::FrameMoveTick()
 					lua_State* th = lua_newthread(L);
 					{
 						// call activate function with preemptive hook. 
-						lua_sethook(th, npl_preemptive_scheduler_hook, LUA_MASKCOUNT, pFileState->GetPreemptiveInstructionCount());
+						BeginPreemptiveSlice(th, pFileState);
 
 						const char actTable[] = "__act";
 						lua_pushlstring(th, actTable, sizeof(actTable) - 1);
@@ -550,9 +595,7 @@ int NPL::CNPLRuntimeState::FrameMoveTick()
 									lua_pop(th, num_results);
 							}
 						}
-						// Lua 5.1 support per thread hook, while luajit hook is global to all. 
-						// so we need to unhook it for the rest of non-preemptive code.
-						lua_sethook(th, npl_preemptive_scheduler_hook, 0, pFileState->GetPreemptiveInstructionCount());
+						EndPreemptiveSlice(th, pFileState);
 					}
 					if (!pFileState->IsProcessing()) {
 						// pop coroutine and leave it to gc
@@ -1101,6 +1144,8 @@ int NPL::CNPLRuntimeState::InstallFields(ParaEngine::CAttributeClass* pClass, bo
 	IAttributeFields::InstallFields(pClass, bOverride);
 	pClass->AddField("ProcessedMsgCount", FieldType_Int, (void*)0, (void*)GetProcessedMsgCount_s, NULL, NULL, bOverride);
 	pClass->AddField("CurrentQueueSize", FieldType_Int, (void*)0, (void*)GetCurrentQueueSize_s, NULL, NULL, bOverride);
+	pClass->AddField("AvgProcessTime", FieldType_Int, (void*)0, (void*)GetAvgProcessTimeUS_s, NULL, NULL, bOverride);
+	pClass->AddField("AvgQueueTime", FieldType_Int, (void*)0, (void*)GetAvgQueueTimeUS_s, NULL, NULL, bOverride);
 	pClass->AddField("TimerCount", FieldType_Int, (void*)0, (void*)GetTimerCount_s, NULL, NULL, bOverride);
 	pClass->AddField("MsgQueueSize", FieldType_Int, (void*)SetMsgQueueSize_s, (void*)GetMsgQueueSize_s, NULL, NULL, bOverride);
 	pClass->AddField("HasDebugHook", FieldType_Bool, (void*)0, (void*)HasDebugHook_s, NULL, NULL, bOverride);
@@ -1111,3 +1156,44 @@ int NPL::CNPLRuntimeState::InstallFields(ParaEngine::CAttributeClass* pClass, bo
 }
 
 
+
+#ifdef _DEBUG
+/** compare a CPU heavy activation that runs non-preemptive, preempted by instruction count, and preempted by time slices. 
+* the longest tick shows how long other work in the same NPL thread is blocked. */
+void Test_NPLPreemption()
+{
+	const char* sModes[] = { "", "PreemptiveCount=1000", "PreemptiveTime=2" };
+	for (int nPass = 0; nPass < 3; ++nPass)
+	{
+		NPL::NPLRuntimeState_ptr rts = NPL::CNPLRuntime::GetInstance()->CreateRuntimeState("", NPL::NPLRuntimeStateType_NPL);
+		char sCode[512];
+		snprintf(sCode, sizeof(sCode), "test_preempt_result = nil; NPL.this(function() local sum = 0; for i = 1, 20000000 do sum = sum + i %% 7; end; test_preempt_result = sum; end, {filename=\"test/preempt.lua\", %s})", sModes[nPass]);
+		rts->DoString(sCode, (int)strlen(sCode));
+
+		int64 nFromTime = ParaEngine::GetTimeUS();
+		rts->Activate_async("test/preempt.lua", "msg={}", 0);
+		int nTickCount = 0;
+		int nMaxTickTime = 0;
+		lua_State* L = rts->GetLuaState();
+		while (true)
+		{
+			int64 nTickTime = ParaEngine::GetTimeUS();
+			rts->SendTick();
+			rts->Process();
+			++nTickCount;
+			nTickTime = ParaEngine::GetTimeUS() - nTickTime;
+			if (nTickTime > nMaxTickTime)
+				nMaxTickTime = (int)nTickTime;
+
+			lua_getglobal(L, "test_preempt_result");
+			bool bDone = !lua_isnil(L, -1);
+			lua_pop(L, 1);
+			if (bDone || nTickCount > 1000000)
+				break;
+		}
+		int nTimeUS = (int)(ParaEngine::GetTimeUS() - nFromTime);
+		OUTPUT_LOG("preemption {%s}: %d us in %d ticks, longest tick %d us\n", sModes[nPass], nTimeUS, nTickCount, nMaxTickTime);
+		NPL::CNPLRuntime::GetInstance()->DeleteRuntimeState(rts);
+	}
+}
+#endif
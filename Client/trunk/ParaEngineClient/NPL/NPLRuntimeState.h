@@ -9,6 +9,7 @@
 #include "util/mutex.h"
 #include "util/unordered_array.hpp"
 #include <set>
+#include <atomic>
 
 #include <boost/thread.hpp>
 #include <boost/noncopyable.hpp>
@@ -54,6 +55,8 @@ namespace NPL
 
 		ATTRIBUTE_METHOD1(CNPLRuntimeState, GetProcessedMsgCount_s, int*)		{ *p1 = cls->GetProcessedMsgCount(); return S_OK; }
 		ATTRIBUTE_METHOD1(CNPLRuntimeState, GetCurrentQueueSize_s, int*)		{ *p1 = cls->GetCurrentQueueSize(); return S_OK; }
+		ATTRIBUTE_METHOD1(CNPLRuntimeState, GetAvgProcessTimeUS_s, int*)		{ *p1 = cls->GetAvgProcessTimeUS(); return S_OK; }
+		ATTRIBUTE_METHOD1(CNPLRuntimeState, GetAvgQueueTimeUS_s, int*)		{ *p1 = cls->GetAvgQueueTimeUS(); return S_OK; }
 		ATTRIBUTE_METHOD1(CNPLRuntimeState, GetTimerCount_s, int*)		{ *p1 = cls->GetTimerCount(); return S_OK; }
 		ATTRIBUTE_METHOD1(CNPLRuntimeState, SetMsgQueueSize_s, int)		{ cls->SetMsgQueueSize(p1); return S_OK; }
 		ATTRIBUTE_METHOD1(CNPLRuntimeState, GetMsgQueueSize_s, int*)		{ *p1 = cls->GetMsgQueueSize(); return S_OK; }
@@ -120,6 +123,17 @@ namespace NPL
 		*/
 		int GetProcessedMsgCount();
 
+		/** recent average time in microseconds spent on a timed message, such as messages routed by a worker pool. 
+		* It is a moving average, which is used by worker pools to estimate the load of this runtime state. 
+		* [thread safe]
+		*/
+		int GetAvgProcessTimeUS() { return m_nAvgProcessTimeUS; }
+
+		/** recent average time in microseconds that a timed message waits in the message queue before it is processed.
+		* [thread safe]
+		*/
+		int GetAvgQueueTimeUS() { return m_nAvgQueueTimeUS; }
+
 		/** get the message queue size. default to 500. For busy server side, we can set this to something like 5000
 		* [thread safe]
 		*/
@@ -315,6 +329,9 @@ namespace NPL
 		/** load all NPL related functions. This function must be called for all scripting based classes. */
 		void LoadNPLState();
 
+		/** remove event handlers that hold lua functions of the main state. It must be called before the lua state is closed. */
+		void UnregisterLuaEventHandlers();
+
 		/** this function is called often enough from the NPL runtime's main thread. 
 		* [thread safe]
 		* @param nTickCount: it should be ::GetTickCount() in millisecond. if 0, we will call the system ::GetTickCount() to get the current tick count. 
@@ -346,6 +363,11 @@ namespace NPL
 		
 		void SetPreemptive(bool val);
 	private:
+		/** install the instruction count hook or arm the time slice of a preemptive coroutine before it is resumed. */
+		void BeginPreemptiveSlice(lua_State* th, CNeuronFileState* pFileState);
+		/** remove the hook of a preemptive coroutine after it yields or returns. */
+		void EndPreemptiveSlice(lua_State* th, CNeuronFileState* pFileState);
+
 		typedef map<std::string, ParaEngine::DLLPlugInEntity*>	DLL_Plugin_Map_Type;
 		typedef std::vector<NPLTimer_ptr> NPLTimer_TempPool_Type;
 		/** loaded dll plugins: mapping from file name to references of ParaEngine::DLLPlugInEntity */
@@ -397,6 +419,10 @@ namespace NPL
 		*/
 		int m_processed_msg_count;
 
+		/** moving average of processing and queuing time of timed messages in microseconds. */
+		std::atomic<int> m_nAvgProcessTimeUS;
+		std::atomic<int> m_nAvgQueueTimeUS;
+
 		/** incremented every tick. */
 		int m_nFrameMoveCount;
 		/** Mono Scripting State. this is created via the NPLMono C++ plugin DLL. This class is created on demand. 
@@ -0,0 +1,703 @@
+//-----------------------------------------------------------------------------
+// Class:	CNPLUDPTransport
+// Company: ParaEngine
+// Desc: reliable UDP transport with selective ack and fast retransmit for NPL activations.
+// Datagram layout (all integers are little endian):
+//	DATA: magic(1) cmd(1) channel|reliability<<4 (1) reserved(1) conv(4) seq(4) ord(4) payload
+//	ACK:  magic(1) cmd(1) reserved(2) conv(4) una(4) ack_bits(4) epoch(4)
+// conv is picked by the sender of DATA. epoch is the conv of the acking session, it changes when the receiver restarts.
+// payload: rts_name_len(1) rts_name file_name_len(2) file_name code
+//-----------------------------------------------------------------------------
+#include "ParaEngine.h"
+#include <vector>
+#include <boost/bind.hpp>
+#include "NPLNetServer.h"
+#include "NPLUDPTransport.h"
+
+/** first byte of all NPL UDP datagrams */
+#define NPL_UDP_MAGIC			0x4E
+#define NPL_UDP_HEADER_SIZE		16
+#define NPL_UDP_ACK_SIZE		20
+/** initial retransmission timeout in milliseconds */
+#define NPL_UDP_DEFAULT_RTO		200
+#define NPL_UDP_MAX_RTO			5000
+/** reliable messages too far ahead of the receive una are dropped and resent later. */
+#define NPL_UDP_RECV_WINDOW		4096
+/** milliseconds before an idle incoming peer is removed, if the server has no idle timeout. */
+#define NPL_UDP_TEMP_SESSION_TIMEOUT	60000
+
+using namespace NPL;
+
+namespace
+{
+	inline void WriteUInt32(char* dest, uint32 nValue)
+	{
+		dest[0] = (char)(nValue & 0xff);
+		dest[1] = (char)((nValue >> 8) & 0xff);
+		dest[2] = (char)((nValue >> 16) & 0xff);
+		dest[3] = (char)((nValue >> 24) & 0xff);
+	}
+
+	inline uint32 ReadUInt32(const char* src)
+	{
+		const unsigned char* p = (const unsigned char*)src;
+		return (uint32)p[0] | ((uint32)p[1] << 8) | ((uint32)p[2] << 16) | ((uint32)p[3] << 24);
+	}
+
+	/** signed distance between two wrapping sequence numbers or time stamps. */
+	inline int32 SeqDiff(uint32 a, uint32 b)
+	{
+		return (int32)(a - b);
+	}
+
+	inline bool IsReliable(int reliability)
+	{
+		return reliability >= RELIABLE;
+	}
+
+	inline bool IsSequenced(int reliability)
+	{
+		return reliability == UNRELIABLE_SEQUENCED || reliability == RELIABLE_SEQUENCED;
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////
+//
+// CNPLUDPSession
+//
+//////////////////////////////////////////////////////////////////////////
+
+NPL::CNPLUDPSession::CNPLUDPSession(const std::string& sNID, const boost::asio::ip::udp::endpoint& endpoint, bool bAuthenticated)
+	:m_sNID(sNID), m_endpoint(endpoint), m_bAuthenticated(bAuthenticated), m_nLastReceiveTime(GetTickCount()),
+	m_nRemoteConv(0), m_bHasRemoteConv(false), m_nPrevRemoteConv(0), m_nRemoteEpoch(0), m_bHasRemoteEpoch(false)
+{
+	ResetSend();
+	ResetReceive(0);
+	m_bHasRemoteConv = false;
+}
+
+void NPL::CNPLUDPSession::ResetSend()
+{
+	m_nConv = (((uint32)rand() & 0x7fff) << 16) ^ ((uint32)rand() & 0x7fff) ^ GetTickCount();
+	if (m_nConv == 0)
+		m_nConv = 1;
+	m_nSendSeq = 0;
+	for (int i = 0; i < NPL_UDP_CHANNEL_COUNT; ++i)
+	{
+		m_sendOrdered[i] = 0;
+		m_sendSequenced[i] = 0;
+	}
+	m_send_queue.clear();
+	m_send_buf.clear();
+	m_nSRTT = 0;
+	m_nRTTVar = 0;
+	m_nRTO = NPL_UDP_DEFAULT_RTO;
+}
+
+void NPL::CNPLUDPSession::RenumberSend()
+{
+	// keep the send order of all unacknowledged reliable messages.
+	std::list<std::string> pending;
+	for (std::list<SendSegment>::iterator it = m_send_buf.begin(); it != m_send_buf.end(); ++it)
+	{
+		pending.push_back(std::string());
+		pending.back().swap(it->data);
+	}
+	pending.splice(pending.end(), m_send_queue);
+	ResetSend();
+	for (std::list<std::string>::iterator it = pending.begin(); it != pending.end(); ++it)
+	{
+		std::string& data = *it;
+		int channel = data[2] & 0x0f;
+		int reliability = (data[2] >> 4) & 0x0f;
+		WriteUInt32(&data[4], m_nConv);
+		WriteUInt32(&data[8], m_nSendSeq++);
+		if (reliability == RELIABLE_ORDERED)
+			WriteUInt32(&data[12], m_sendOrdered[channel]++);
+		else if (IsSequenced(reliability))
+			WriteUInt32(&data[12], m_sendSequenced[channel]++);
+	}
+	m_send_queue.swap(pending);
+}
+
+void NPL::CNPLUDPSession::ResetReceive(uint32 nRemoteConv)
+{
+	if (m_bHasRemoteConv)
+		m_nPrevRemoteConv = m_nRemoteConv;
+	m_nRemoteConv = nRemoteConv;
+	m_bHasRemoteConv = true;
+	m_nRecvUna = 0;
+	m_recv_set.clear();
+	m_bAckPending = false;
+	for (int i = 0; i < NPL_UDP_CHANNEL_COUNT; ++i)
+	{
+		m_channels[i] = ChannelState();
+	}
+}
+
+void NPL::CNPLUDPSession::UpdateRTT(int32 nRTT, int nMinRTO, int nInterval)
+{
+	if (nRTT < 0)
+		nRTT = 0;
+	if (m_nSRTT == 0)
+	{
+		m_nSRTT = nRTT;
+		m_nRTTVar = nRTT / 2;
+	}
+	else
+	{
+		int32 nDelta = nRTT - m_nSRTT;
+		if (nDelta < 0)
+			nDelta = -nDelta;
+		m_nRTTVar = (3 * m_nRTTVar + nDelta) / 4;
+		m_nSRTT = (7 * m_nSRTT + nRTT) / 8;
+		if (m_nSRTT < 1)
+			m_nSRTT = 1;
+	}
+	int32 nRTO = m_nSRTT + (std::max)(nInterval, 4 * m_nRTTVar);
+	m_nRTO = (uint32)(std::min)((std::max)(nRTO, nMinRTO), NPL_UDP_MAX_RTO);
+}
+
+//////////////////////////////////////////////////////////////////////////
+//
+// CNPLUDPTransport
+//
+//////////////////////////////////////////////////////////////////////////
+
+NPL::CNPLUDPTransport::CNPLUDPTransport(CNPLNetServer* pServer, boost::asio::io_service& io_service)
+	:m_pServer(pServer), m_io_service(io_service), m_socket(io_service), m_flush_timer(io_service), m_nNextTempID(0),
+	m_nTempSessionCount(0), m_nMaxTempSessions(1024), m_bTempSessionFull(false),
+	m_bEnabled(false), m_fLossRate(0.f), m_nLatency(0), m_nSendWindow(128), m_nInterval(10), m_nMinRTO(30), m_nFastResend(2), m_nDeadLink(20),
+	m_nRetransmitCount(0), m_nFastRetransmitCount(0)
+{
+}
+
+NPL::CNPLUDPTransport::~CNPLUDPTransport()
+{
+	Close();
+}
+
+bool NPL::CNPLUDPTransport::Open(const std::string& server, const std::string& port)
+{
+	if (m_socket.is_open())
+		return true;
+	try
+	{
+		boost::asio::ip::udp::resolver resolver(m_io_service);
+		boost::asio::ip::udp::resolver::query query(server, port);
+		boost::asio::ip::udp::endpoint endpoint = *resolver.resolve(query);
+		m_socket.open(endpoint.protocol());
+		m_socket.bind(endpoint);
+		OUTPUT_LOG("NPL UDP transport is listening on %s:%d\n", server.c_str(), GetPort());
+	}
+	catch (std::exception& e)
+	{
+		OUTPUT_LOG("warning: unable to open NPL UDP transport on %s:%s, because %s\n", server.c_str(), port.c_str(), e.what());
+		boost::system::error_code ec;
+		m_socket.close(ec);
+		return false;
+	}
+	StartReceive();
+	m_flush_timer.expires_from_now(boost::chrono::milliseconds(m_nInterval));
+	m_flush_timer.async_wait(boost::bind(&CNPLUDPTransport::handle_flush_timer, this, boost::asio::placeholders::error));
+	return true;
+}
+
+void NPL::CNPLUDPTransport::Close()
+{
+	boost::system::error_code ec;
+	m_flush_timer.cancel(ec);
+	m_socket.close(ec);
+	m_sessions.clear();
+	m_endpoint_sessions.clear();
+	m_nTempSessionCount = 0;
+	ParaEngine::Lock lock_(m_mutex);
+	m_peer_nids.clear();
+}
+
+int NPL::CNPLUDPTransport::GetPort()
+{
+	boost::system::error_code ec;
+	if (m_socket.is_open())
+	{
+		boost::asio::ip::udp::endpoint endpoint = m_socket.local_endpoint(ec);
+		if (!ec)
+			return endpoint.port();
+	}
+	return 0;
+}
+
+void NPL::CNPLUDPTransport::AddPeer(const std::string& sNID, const std::string& sHost, const std::string& sPort)
+{
+	{
+		ParaEngine::Lock lock_(m_mutex);
+		m_peer_nids.insert(sNID);
+	}
+	m_io_service.post(boost::bind(&CNPLUDPTransport::handle_add_peer, this, sNID, sHost, sPort));
+}
+
+bool NPL::CNPLUDPTransport::HasPeer(const std::string& sNID)
+{
+	ParaEngine::Lock lock_(m_mutex);
+	return m_peer_nids.find(sNID) != m_peer_nids.end();
+}
+
+void NPL::CNPLUDPTransport::handle_add_peer(const std::string& sNID, const std::string& sHost, const std::string& sPort)
+{
+	if (!m_socket.is_open() && !Open("0.0.0.0", "0"))
+		return;
+	boost::asio::ip::udp::endpoint endpoint;
+	try
+	{
+		// peers are usually given by IP, so it is fine to resolve in the dispatcher thread.
+		boost::asio::ip::udp::resolver resolver(m_io_service);
+		boost::asio::ip::udp::resolver::query query(boost::asio::ip::udp::v4(), sHost, sPort);
+		endpoint = *resolver.resolve(query);
+	}
+	catch (std::exception& e)
+	{
+		OUTPUT_LOG("warning: unable to resolve NPL UDP peer %s(%s:%s), because %s\n", sNID.c_str(), sHost.c_str(), sPort.c_str(), e.what());
+		ParaEngine::Lock lock_(m_mutex);
+		m_peer_nids.erase(sNID);
+		return;
+	}
+	std::map<boost::asio::ip::udp::endpoint, NPLUDPSession_ptr>::iterator itEndpoint = m_endpoint_sessions.find(endpoint);
+	if (itEndpoint != m_endpoint_sessions.end() && !itEndpoint->second->m_bAuthenticated)
+	{
+		// the peer has already sent to us as an incoming peer.
+		RemoveSession(itEndpoint->second, "udp_peer_added");
+	}
+	NPLUDPSession_ptr pSession(new CNPLUDPSession(sNID, endpoint, true));
+	std::map<std::string, NPLUDPSession_ptr>::iterator it = m_sessions.find(sNID);
+	if (it != m_sessions.end())
+	{
+		m_endpoint_sessions.erase(it->second->m_endpoint);
+	}
+	m_sessions[sNID] = pSession;
+	m_endpoint_sessions[endpoint] = pSession;
+}
+
+NPLReturnCode NPL::CNPLUDPTransport::SendMessage(const NPLFileName& file_name, const char* code, int nLength, int channel, int reliability)
+{
+	if (code != NULL && nLength <= 0)
+		nLength = (int)strlen(code);
+	if (code == NULL)
+		nLength = 0;
+	const std::string& sRtsName = file_name.sRuntimeStateName;
+	const std::string& sFileName = file_name.sRelativePath;
+	if (sRtsName.size() > 255 || sFileName.size() > 0xffff || (int)(sRtsName.size() + sFileName.size()) + nLength + 3 > NPL_UDP_MAX_MESSAGE_SIZE)
+	{
+		OUTPUT_LOG("warning: NPL UDP message to %s:%s is too large, use TCP instead.\n", file_name.sNID.c_str(), sFileName.c_str());
+		return NPL_Error;
+	}
+	if (channel < 0 || channel >= NPL_UDP_CHANNEL_COUNT)
+		channel = 0;
+	if (reliability < UNRELIABLE || reliability > RELIABLE_SEQUENCED)
+		reliability = RELIABLE_ORDERED;
+
+	std::string payload;
+	payload.reserve(sRtsName.size() + sFileName.size() + nLength + 3);
+	payload.push_back((char)sRtsName.size());
+	payload.append(sRtsName);
+	payload.push_back((char)(sFileName.size() & 0xff));
+	payload.push_back((char)((sFileName.size() >> 8) & 0xff));
+	payload.append(sFileName);
+	if (nLength > 0)
+		payload.append(code, nLength);
+
+	m_io_service.post(boost::bind(&CNPLUDPTransport::handle_send, this, file_name.sNID, payload, channel, reliability));
+	return NPL_OK;
+}
+
+void NPL::CNPLUDPTransport::handle_send(const std::string& sNID, const std::string& payload, int channel, int reliability)
+{
+	std::map<std::string, NPLUDPSession_ptr>::iterator it = m_sessions.find(sNID);
+	if (it == m_sessions.end() || !m_socket.is_open())
+	{
+		OUTPUT_LOG("warning: NPL UDP peer %s is not found, message dropped\n", sNID.c_str());
+		return;
+	}
+	CNPLUDPSession& session = *(it->second);
+
+	uint32 nOrd = 0;
+	if (reliability == RELIABLE_ORDERED)
+		nOrd = session.m_sendOrdered[channel]++;
+	else if (IsSequenced(reliability))
+		nOrd = session.m_sendSequenced[channel]++;
+	uint32 nSeq = IsReliable(reliability) ? session.m_nSendSeq++ : 0;
+
+	std::string data;
+	data.resize(NPL_UDP_HEADER_SIZE);
+	data[0] = (char)NPL_UDP_MAGIC;
+	data[1] = (char)UDP_CMD_DATA;
+	data[2] = (char)(channel | (reliability << 4));
+	data[3] = 0;
+	WriteUInt32(&data[4], session.m_nConv);
+	WriteUInt32(&data[8], nSeq);
+	WriteUInt32(&data[12], nOrd);
+	data.append(payload);
+
+	if (IsReliable(reliability))
+	{
+		session.m_send_queue.push_back(std::string());
+		session.m_send_queue.back().swap(data);
+		FlushSendQueue(session, GetTickCount());
+	}
+	else
+	{
+		// unreliable messages bypass the send window and retransmission.
+		SendDatagram(session.m_endpoint, data);
+	}
+}
+
+void NPL::CNPLUDPTransport::FlushSendQueue(CNPLUDPSession& session, uint32 nCurTime)
+{
+	while (!session.m_send_queue.empty() && (int)session.m_send_buf.size() < m_nSendWindow)
+	{
+		session.m_send_buf.push_back(CNPLUDPSession::SendSegment());
+		CNPLUDPSession::SendSegment& seg = session.m_send_buf.back();
+		seg.data.swap(session.m_send_queue.front());
+		session.m_send_queue.pop_front();
+		seg.nSeq = ReadUInt32(&seg.data[8]);
+		seg.nXmit = 1;
+		seg.nSendTime = nCurTime;
+		seg.nRTO = session.m_nRTO;
+		seg.nResendTime = nCurTime + seg.nRTO;
+		SendDatagram(session.m_endpoint, seg.data);
+	}
+}
+
+void NPL::CNPLUDPTransport::SendDatagram(const boost::asio::ip::udp::endpoint& endpoint, const std::string& data)
+{
+	if (m_fLossRate > 0.f && ((float)rand() / (float)RAND_MAX) < m_fLossRate)
+		return;
+	if (m_nLatency > 0)
+	{
+		boost::shared_ptr<timer_type> timer(new timer_type(m_io_service));
+		boost::shared_ptr<std::string> buffer(new std::string(data));
+		timer->expires_from_now(boost::chrono::milliseconds(m_nLatency));
+		timer->async_wait(boost::bind(&CNPLUDPTransport::handle_delayed_send, this, timer, buffer, endpoint, boost::asio::placeholders::error));
+		return;
+	}
+	boost::system::error_code ec;
+	m_socket.send_to(boost::asio::buffer(data), endpoint, 0, ec);
+}
+
+void NPL::CNPLUDPTransport::handle_delayed_send(boost::shared_ptr<timer_type> timer, boost::shared_ptr<std::string> data, boost::asio::ip::udp::endpoint endpoint, const boost::system::error_code& err)
+{
+	if (!err && m_socket.is_open())
+	{
+		boost::system::error_code ec;
+		m_socket.send_to(boost::asio::buffer(*data), endpoint, 0, ec);
+	}
+}
+
+void NPL::CNPLUDPTransport::SendAck(CNPLUDPSession& session)
+{
+	uint32 nAckBits = 0;
+	for (std::set<uint32>::iterator it = session.m_recv_set.begin(); it != session.m_recv_set.end(); ++it)
+	{
+		int32 nOffset = SeqDiff(*it, session.m_nRecvUna) - 1;
+		if (nOffset >= 32)
+			break;
+		if (nOffset >= 0)
+			nAckBits |= (1u << nOffset);
+	}
+	char data[NPL_UDP_ACK_SIZE];
+	data[0] = (char)NPL_UDP_MAGIC;
+	data[1] = (char)UDP_CMD_ACK;
+	data[2] = 0;
+	data[3] = 0;
+	WriteUInt32(&data[4], session.m_nRemoteConv);
+	WriteUInt32(&data[8], session.m_nRecvUna);
+	WriteUInt32(&data[12], nAckBits);
+	WriteUInt32(&data[16], session.m_nConv);
+	SendDatagram(session.m_endpoint, std::string(data, NPL_UDP_ACK_SIZE));
+	session.m_bAckPending = false;
+}
+
+void NPL::CNPLUDPTransport::StartReceive()
+{
+	m_socket.async_receive_from(boost::asio::buffer(m_recv_buffer, sizeof(m_recv_buffer)), m_remote_endpoint,
+		boost::bind(&CNPLUDPTransport::handle_receive, this, boost::asio::placeholders::error, boost::asio::placeholders::bytes_transferred));
+}
+
+void NPL::CNPLUDPTransport::handle_receive(const boost::system::error_code& err, std::size_t bytes_transferred)
+{
+	if (err == boost::asio::error::operation_aborted || !m_socket.is_open())
+		return;
+	if (!err && bytes_transferred >= NPL_UDP_HEADER_SIZE && (unsigned char)m_recv_buffer[0] == NPL_UDP_MAGIC)
+	{
+		NPLUDPSession_ptr pSession;
+		std::map<boost::asio::ip::udp::endpoint, NPLUDPSession_ptr>::iterator it = m_endpoint_sessions.find(m_remote_endpoint);
+		if (it != m_endpoint_sessions.end())
+		{
+			pSession = it->second;
+		}
+		else if (m_recv_buffer[1] == UDP_CMD_DATA && m_nTempSessionCount >= m_nMaxTempSessions)
+		{
+			// UDP source addresses are easily spoofed, so the number of incoming peers is bounded.
+			if (!m_bTempSessionFull)
+			{
+				OUTPUT_LOG("warning: too many incoming NPL UDP peers, datagrams from new peers are dropped\n");
+				m_bTempSessionFull = true;
+			}
+		}
+		else if (m_recv_buffer[1] == UDP_CMD_DATA)
+		{
+			// an incoming peer is given a temporary id, just like incoming TCP connections.
+			char sTID[32];
+			snprintf(sTID, sizeof(sTID), "~udp%d", ++m_nNextTempID);
+			pSession.reset(new CNPLUDPSession(sTID, m_remote_endpoint, false));
+			++m_nTempSessionCount;
+			m_sessions[pSession->m_sNID] = pSession;
+			m_endpoint_sessions[m_remote_endpoint] = pSession;
+			ParaEngine::Lock lock_(m_mutex);
+			m_peer_nids.insert(pSession->m_sNID);
+		}
+		if (pSession)
+		{
+			pSession->m_nLastReceiveTime = GetTickCount();
+			if (m_recv_buffer[1] == UDP_CMD_DATA)
+				OnData(*pSession, m_recv_buffer, (int)bytes_transferred);
+			else if (m_recv_buffer[1] == UDP_CMD_ACK)
+				OnAck(*pSession, m_recv_buffer, (int)bytes_transferred);
+		}
+	}
+	StartReceive();
+}
+
+void NPL::CNPLUDPTransport::OnData(CNPLUDPSession& session, const char* data, int nSize)
+{
+	int channel = data[2] & 0x0f;
+	int reliability = (data[2] >> 4) & 0x0f;
+	uint32 nConv = ReadUInt32(data + 4);
+	uint32 nSeq = ReadUInt32(data + 8);
+	uint32 nOrd = ReadUInt32(data + 12);
+	const char* payload = data + NPL_UDP_HEADER_SIZE;
+	int nPayloadSize = nSize - NPL_UDP_HEADER_SIZE;
+	if (reliability > RELIABLE_SEQUENCED)
+		return;
+
+	if (session.m_bHasRemoteConv && session.m_nRemoteConv != nConv && nConv == session.m_nPrevRemoteConv)
+	{
+		// a late datagram of the previous conversation
+		return;
+	}
+	if (!session.m_bHasRemoteConv || session.m_nRemoteConv != nConv)
+	{
+		// the remote end is restarted or has reset its send state.
+		session.ResetReceive(nConv);
+	}
+
+	if (IsReliable(reliability))
+	{
+		// always ack, since the previous ack may be lost.
+		session.m_bAckPending = true;
+		int32 nDiff = SeqDiff(nSeq, session.m_nRecvUna);
+		if (nDiff < 0 || nDiff >= NPL_UDP_RECV_WINDOW || session.m_recv_set.find(nSeq) != session.m_recv_set.end())
+			return;
+		session.m_recv_set.insert(nSeq);
+		while (!session.m_recv_set.empty() && *session.m_recv_set.begin() == session.m_nRecvUna)
+		{
+			session.m_recv_set.erase(session.m_recv_set.begin());
+			++session.m_nRecvUna;
+		}
+	}
+
+	CNPLUDPSession::ChannelState& ch = session.m_channels[channel];
+	if (reliability == RELIABLE_ORDERED)
+	{
+		if (nOrd != ch.nOrderedNext)
+		{
+			if (SeqDiff(nOrd, ch.nOrderedNext) > 0)
+				ch.ordered[nOrd].assign(payload, nPayloadSize);
+			return;
+		}
+		Deliver(session, payload, nPayloadSize);
+		++ch.nOrderedNext;
+		std::map<uint32, std::string>::iterator it;
+		while ((it = ch.ordered.find(ch.nOrderedNext)) != ch.ordered.end())
+		{
+			std::string msg;
+			msg.swap(it->second);
+			ch.ordered.erase(it);
+			++ch.nOrderedNext;
+			Deliver(session, msg.c_str(), (int)msg.size());
+		}
+	}
+	else if (IsSequenced(reliability))
+	{
+		if (ch.bHasSequenced && SeqDiff(nOrd, ch.nLastSequenced) <= 0)
+			return;
+		ch.bHasSequenced = true;
+		ch.nLastSequenced = nOrd;
+		Deliver(session, payload, nPayloadSize);
+	}
+	else
+	{
+		Deliver(session, payload, nPayloadSize);
+	}
+}
+
+void NPL::CNPLUDPTransport::OnAck(CNPLUDPSession& session, const char* data, int nSize)
+{
+	if (nSize < NPL_UDP_ACK_SIZE)
+		return;
+	uint32 nEpoch = ReadUInt32(data + 16);
+	if (session.m_bHasRemoteEpoch && session.m_nRemoteEpoch != nEpoch)
+	{
+		// the receiver is restarted and has lost all receive state, so our sequence numbers must start from 0 again,
+		// otherwise they would never be accepted. This ack is about a previous conversation of ours, so it is ignored.
+		OUTPUT_LOG("NPL UDP peer %s is restarted, %d unacknowledged messages are resent\n", session.m_sNID.c_str(), (int)(session.m_send_buf.size() + session.m_send_queue.size()));
+		session.m_nRemoteEpoch = nEpoch;
+		session.RenumberSend();
+		FlushSendQueue(session, GetTickCount());
+		return;
+	}
+	session.m_nRemoteEpoch = nEpoch;
+	session.m_bHasRemoteEpoch = true;
+	if (ReadUInt32(data + 4) != session.m_nConv)
+		return;
+	uint32 nUna = ReadUInt32(data + 8);
+	uint32 nAckBits = ReadUInt32(data + 12);
+	uint32 nCurTime = GetTickCount();
+
+	// the largest acknowledged sequence number, segments before it are considered skipped by this ack.
+	uint32 nMaxAck = nUna - 1;
+	for (int i = 31; i >= 0; --i)
+	{
+		if (nAckBits & (1u << i))
+		{
+			nMaxAck = nUna + 1 + i;
+			break;
+		}
+	}
+
+	for (std::list<CNPLUDPSession::SendSegment>::iterator it = session.m_send_buf.begin(); it != session.m_send_buf.end();)
+	{
+		CNPLUDPSession::SendSegment& seg = *it;
+		int32 nOffset = SeqDiff(seg.nSeq, nUna);
+		bool bAcked = (nOffset < 0) || (nOffset >= 1 && nOffset <= 32 && (nAckBits & (1u << (nOffset - 1))) != 0);
+		if (bAcked)
+		{
+			// Karn's algorithm: only sample round trip time of segments that are not retransmitted.
+			if (seg.nXmit == 1)
+				session.UpdateRTT(SeqDiff(nCurTime, seg.nSendTime), m_nMinRTO, m_nInterval);
+			it = session.m_send_buf.erase(it);
+			continue;
+		}
+		if (SeqDiff(seg.nSeq, nMaxAck) < 0 && ++seg.nFastAck >= m_nFastResend)
+		{
+			// fast retransmit without waiting for RTO
+			seg.nFastAck = 0;
+			seg.nXmit++;
+			seg.nSendTime = nCurTime;
+			seg.nResendTime = nCurTime + seg.nRTO;
+			++m_nFastRetransmitCount;
+			SendDatagram(session.m_endpoint, seg.data);
+		}
+		++it;
+	}
+	FlushSendQueue(session, nCurTime);
+}
+
+void NPL::CNPLUDPTransport::Deliver(CNPLUDPSession& session, const char* payload, int nSize)
+{
+	if (nSize < 3)
+		return;
+	int nRtsSize = (unsigned char)payload[0];
+	if (nSize < nRtsSize + 3)
+		return;
+	std::string sRtsName(payload + 1, nRtsSize);
+	const char* p = payload + 1 + nRtsSize;
+	int nFileSize = (int)((unsigned char)p[0] | ((unsigned char)p[1] << 8));
+	p += 2;
+	int nCodeSize = nSize - (nRtsSize + 3) - nFileSize;
+	if (nCodeSize < 0)
+		return;
+	std::string sFileName(p, nFileSize);
+	m_pServer->GetDispatcher().DispatchUDPMsg(sRtsName, sFileName, p + nFileSize, nCodeSize, session.m_sNID, session.m_bAuthenticated);
+}
+
+bool NPL::CNPLUDPTransport::FlushSession(CNPLUDPSession& session, uint32 nCurTime)
+{
+	if (session.m_bAckPending)
+		SendAck(session);
+
+	for (std::list<CNPLUDPSession::SendSegment>::iterator it = session.m_send_buf.begin(); it != session.m_send_buf.end(); ++it)
+	{
+		CNPLUDPSession::SendSegment& seg = *it;
+		if (SeqDiff(nCurTime, seg.nResendTime) >= 0)
+		{
+			if (seg.nXmit >= m_nDeadLink)
+				return false;
+			seg.nXmit++;
+			// back off by 1.5 like KCP's nodelay mode, instead of doubling.
+			seg.nRTO += (std::max)(seg.nRTO / 2, (uint32)1);
+			if (seg.nRTO > NPL_UDP_MAX_RTO)
+				seg.nRTO = NPL_UDP_MAX_RTO;
+			seg.nSendTime = nCurTime;
+			seg.nResendTime = nCurTime + seg.nRTO;
+			seg.nFastAck = 0;
+			++m_nRetransmitCount;
+			SendDatagram(session.m_endpoint, seg.data);
+		}
+	}
+	FlushSendQueue(session, nCurTime);
+	return true;
+}
+
+void NPL::CNPLUDPTransport::handle_flush_timer(const boost::system::error_code& err)
+{
+	if (err || !m_socket.is_open())
+		return;
+	uint32 nCurTime = GetTickCount();
+	int nIdleTimeout = m_pServer->GetIdleTimeoutPeriod();
+	if (nIdleTimeout <= 0)
+		nIdleTimeout = NPL_UDP_TEMP_SESSION_TIMEOUT;
+	std::vector<NPLUDPSession_ptr> dead_sessions;
+	for (std::map<std::string, NPLUDPSession_ptr>::iterator it = m_sessions.begin(); it != m_sessions.end(); ++it)
+	{
+		CNPLUDPSession& session = *(it->second);
+		if (!FlushSession(session, nCurTime))
+		{
+			if (session.m_bAuthenticated)
+			{
+				// keep added peers, but drop all pending messages.
+				OUTPUT_LOG("warning: NPL UDP peer %s does not respond, pending messages are dropped\n", session.m_sNID.c_str());
+				session.ResetSend();
+				m_pServer->GetDispatcher().PostNetworkEvent(NPL_ConnectionDisconnected, session.m_sNID.c_str(), "udp_dead_link");
+			}
+			else
+				dead_sessions.push_back(it->second);
+		}
+		else if (!session.m_bAuthenticated && SeqDiff(nCurTime, session.m_nLastReceiveTime) > nIdleTimeout && session.m_send_buf.empty())
+		{
+			dead_sessions.push_back(it->second);
+		}
+	}
+	for (size_t i = 0; i < dead_sessions.size(); ++i)
+	{
+		RemoveSession(dead_sessions[i], "udp_timeout");
+	}
+
+	m_flush_timer.expires_from_now(boost::chrono::milliseconds(m_nInterval));
+	m_flush_timer.async_wait(boost::bind(&CNPLUDPTransport::handle_flush_timer, this, boost::asio::placeholders::error));
+}
+
+void NPL::CNPLUDPTransport::RemoveSession(NPLUDPSession_ptr pSession, const char* sReason)
+{
+	m_sessions.erase(pSession->m_sNID);
+	m_endpoint_sessions.erase(pSession->m_endpoint);
+	if (!pSession->m_bAuthenticated)
+	{
+		--m_nTempSessionCount;
+		m_bTempSessionFull = false;
+	}
+	{
+		ParaEngine::Lock lock_(m_mutex);
+		m_peer_nids.erase(pSession->m_sNID);
+	}
+	m_pServer->GetDispatcher().PostNetworkEvent(NPL_ConnectionDisconnected, pSession->m_sNID.c_str(), sReason);
+}
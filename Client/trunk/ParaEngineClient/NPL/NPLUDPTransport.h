@@ -0,0 +1,245 @@
+#pragma once
+#include <boost/asio.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <boost/chrono.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+#include <string>
+#include <map>
+#include <set>
+#include <list>
+#include <atomic>
+#include "NPLCommon.h"
+
+namespace NPL
+{
+	class CNPLNetServer;
+
+	/** max size of rts name + file name + code of a single UDP activation. Larger messages should be sent via TCP. */
+	#define NPL_UDP_MAX_MESSAGE_SIZE	60000
+	/** number of independent channels, same as NPL.activate channel [0,15] */
+	#define NPL_UDP_CHANNEL_COUNT		16
+
+	/**
+	* one peer of the reliable UDP transport. It is only accessed in the dispatcher thread.
+	*
+	* Reliable messages carry a per session sequence number, which is acknowledged by a cumulative ack (una) plus a
+	* 32 bits selective ack bit field. Unacknowledged messages are retransmitted when their RTO expires or immediately
+	* when later messages have been acknowledged twice (fast retransmit), which is the same idea as KCP and ENet.
+	* Ordering is independent per channel: each channel has its own ordered and sequenced index.
+	* Acks carry the conversation id of the acking session, so that a restarted receiver is detected and unacknowledged
+	* messages are renumbered from 0.
+	*/
+	class CNPLUDPSession : private boost::noncopyable
+	{
+	public:
+		CNPLUDPSession(const std::string& sNID, const boost::asio::ip::udp::endpoint& endpoint, bool bAuthenticated);
+
+		/** a reliable message that is sent but not yet acknowledged. */
+		struct SendSegment
+		{
+			SendSegment() :nSeq(0), nResendTime(0), nSendTime(0), nRTO(0), nFastAck(0), nXmit(0){};
+			uint32 nSeq;
+			uint32 nResendTime;
+			uint32 nSendTime;
+			uint32 nRTO;
+			int nFastAck;
+			int nXmit;
+			/** the whole datagram including header. */
+			std::string data;
+		};
+
+		/** per channel receive state */
+		struct ChannelState
+		{
+			ChannelState() :nOrderedNext(0), nLastSequenced(0), bHasSequenced(false){};
+			uint32 nOrderedNext;
+			/** out of order reliable ordered messages waiting for earlier ones. */
+			std::map<uint32, std::string> ordered;
+			uint32 nLastSequenced;
+			bool bHasSequenced;
+		};
+
+		/** reset all send state, and pick a new conversation id so that the remote end resets its receive state. */
+		void ResetSend();
+		/** the remote end is restarted: resend all unacknowledged reliable messages with a new conversation id and sequence numbers from 0. */
+		void RenumberSend();
+		/** reset all receive state for a new remote conversation id. */
+		void ResetReceive(uint32 nRemoteConv);
+
+		/** update srtt, rttvar and RTO with a new round trip time sample. */
+		void UpdateRTT(int32 nRTT, int nMinRTO, int nInterval);
+	public:
+		std::string m_sNID;
+		boost::asio::ip::udp::endpoint m_endpoint;
+		bool m_bAuthenticated;
+		uint32 m_nLastReceiveTime;
+
+		// send state
+		uint32 m_nConv;
+		uint32 m_nSendSeq;
+		uint32 m_sendOrdered[NPL_UDP_CHANNEL_COUNT];
+		uint32 m_sendSequenced[NPL_UDP_CHANNEL_COUNT];
+		/** reliable datagrams waiting for the send window. */
+		std::list<std::string> m_send_queue;
+		/** reliable segments in flight, ordered by sequence number. */
+		std::list<SendSegment> m_send_buf;
+		int32 m_nSRTT;
+		int32 m_nRTTVar;
+		uint32 m_nRTO;
+
+		// receive state
+		uint32 m_nRemoteConv;
+		bool m_bHasRemoteConv;
+		/** datagrams of the replaced conversation that arrive late are ignored. */
+		uint32 m_nPrevRemoteConv;
+		/** conversation id of the remote session, which is sent in its acks. It changes when the remote end is restarted. */
+		uint32 m_nRemoteEpoch;
+		bool m_bHasRemoteEpoch;
+		/** all reliable sequence numbers smaller than this are received. */
+		uint32 m_nRecvUna;
+		/** received sequence numbers that are larger than m_nRecvUna */
+		std::set<uint32> m_recv_set;
+		bool m_bAckPending;
+		ChannelState m_channels[NPL_UDP_CHANNEL_COUNT];
+	};
+	typedef boost::shared_ptr<CNPLUDPSession> NPLUDPSession_ptr;
+
+	/**
+	* Reliable UDP transport for NPL activations to NIDs that are added with NPL.AddNPLRuntimeAddress({..., udp=true}).
+	* It honors the reliability parameter of NPL.activate, so that frequent state updates (such as positions) sent as
+	* UNRELIABLE_SEQUENCED do not suffer from TCP head-of-line blocking.
+	*	- UNRELIABLE(0): sent once, delivered on arrival.
+	*	- UNRELIABLE_SEQUENCED(1): sent once, older messages of the same channel are dropped.
+	*	- RELIABLE(2): retransmitted until acknowledged, delivered on arrival.
+	*	- RELIABLE_ORDERED(3): retransmitted until acknowledged, delivered in send order of the same channel.
+	*	- RELIABLE_SEQUENCED(4): retransmitted until acknowledged, older messages of the same channel are dropped.
+	*
+	* The socket is bound to the server port (port numbers of TCP and UDP are independent) if the UDP transport is enabled before
+	* the server starts, otherwise an ephemeral port is used when the first UDP peer is added.
+	* All socket operations are done in the dispatcher thread of CNPLNetServer.
+	* For testing, outgoing datagrams can be dropped or delayed with SetLossRate() and SetLatency().
+	*/
+	class CNPLUDPTransport : private boost::noncopyable
+	{
+	public:
+		enum UDPCommand{
+			UDP_CMD_DATA = 1,
+			UDP_CMD_ACK = 2,
+		};
+
+		CNPLUDPTransport(CNPLNetServer* pServer, boost::asio::io_service& io_service);
+		~CNPLUDPTransport();
+
+		/** bind the socket and start receiving. It is called by CNPLNetServer::start().
+		* @param port: "0" for an ephemeral port.
+		*/
+		bool Open(const std::string& server, const std::string& port);
+
+		/** close the socket and remove all sessions. It must be called in the dispatcher thread or after it is stopped. */
+		void Close();
+
+		/** whether UDP is bound to the server port when the server starts. default to false. */
+		void SetEnabled(bool bEnable) { m_bEnabled = bEnable; }
+		bool IsEnabled() const { return m_bEnabled; }
+
+		/** add a peer that should be activated via UDP.
+		* [thread safe]
+		*/
+		void AddPeer(const std::string& sNID, const std::string& sHost, const std::string& sPort);
+
+		/** whether the nid should be activated via UDP. It is true for added peers and for incoming UDP peers.
+		* [thread safe]
+		*/
+		bool HasPeer(const std::string& sNID);
+
+		/** send an activation to a UDP peer.
+		* [thread safe]
+		* @param channel: [0,15]
+		* @param reliability: see PacketReliability
+		*/
+		NPLReturnCode SendMessage(const NPLFileName& file_name, const char* code, int nLength, int channel, int reliability);
+
+		/** [0,1) probability of dropping an outgoing datagram, for testing only. default to 0. */
+		void SetLossRate(float fRate) { m_fLossRate = fRate; }
+		float GetLossRate() const { return m_fLossRate; }
+
+		/** milliseconds of delay added to each outgoing datagram, for testing only. default to 0. */
+		void SetLatency(int nMilliseconds) { m_nLatency = nMilliseconds; }
+		int GetLatency() const { return m_nLatency; }
+
+		/** max number of unacknowledged reliable messages per peer. default to 128. */
+		void SetSendWindow(int nWindow) { m_nSendWindow = nWindow > 0 ? nWindow : 1; }
+		int GetSendWindow() const { return m_nSendWindow; }
+
+		/** max number of incoming peers (~udpN), datagrams from new peers are dropped above it. default to 1024.
+		* idle incoming peers are removed after the server idle timeout, or 60 seconds if there is no idle timeout. */
+		void SetMaxIncomingPeers(int nCount) { m_nMaxTempSessions = nCount > 0 ? nCount : 0; }
+		int GetMaxIncomingPeers() const { return m_nMaxTempSessions; }
+
+		/** number of RTO timeouts and fast retransmits since start. */
+		int GetRetransmitCount() const { return m_nRetransmitCount; }
+		int GetFastRetransmitCount() const { return m_nFastRetransmitCount; }
+
+		/** local UDP port, 0 if not opened. */
+		int GetPort();
+	protected:
+		typedef boost::asio::basic_waitable_timer<boost::chrono::steady_clock> timer_type;
+
+		void StartReceive();
+		void handle_receive(const boost::system::error_code& err, std::size_t bytes_transferred);
+		void handle_add_peer(const std::string& sNID, const std::string& sHost, const std::string& sPort);
+		void handle_send(const std::string& sNID, const std::string& payload, int channel, int reliability);
+		void handle_flush_timer(const boost::system::error_code& err);
+
+		/** send a datagram, with injected loss and latency if any. */
+		void SendDatagram(const boost::asio::ip::udp::endpoint& endpoint, const std::string& data);
+		void handle_delayed_send(boost::shared_ptr<timer_type> timer, boost::shared_ptr<std::string> data, boost::asio::ip::udp::endpoint endpoint, const boost::system::error_code& err);
+		void SendAck(CNPLUDPSession& session);
+		/** move queued messages to the send window. */
+		void FlushSendQueue(CNPLUDPSession& session, uint32 nCurTime);
+		/** retransmit timed out segments and send pending acks. return false if the session is dead. */
+		bool FlushSession(CNPLUDPSession& session, uint32 nCurTime);
+
+		void OnData(CNPLUDPSession& session, const char* data, int nSize);
+		void OnAck(CNPLUDPSession& session, const char* data, int nSize);
+		/** deliver a message to the local runtime state. */
+		void Deliver(CNPLUDPSession& session, const char* payload, int nSize);
+
+		/** remove a session from all maps, and post a disconnect network event. */
+		void RemoveSession(NPLUDPSession_ptr pSession, const char* sReason);
+
+	protected:
+		CNPLNetServer* m_pServer;
+		boost::asio::io_service& m_io_service;
+		boost::asio::ip::udp::socket m_socket;
+		timer_type m_flush_timer;
+		boost::asio::ip::udp::endpoint m_remote_endpoint;
+		char m_recv_buffer[65536];
+
+		std::map<std::string, NPLUDPSession_ptr> m_sessions;
+		std::map<boost::asio::ip::udp::endpoint, NPLUDPSession_ptr> m_endpoint_sessions;
+		/** nid of all sessions and added peers, it is used by HasPeer() from other threads. */
+		std::set<std::string> m_peer_nids;
+		ParaEngine::mutex m_mutex;
+		int m_nNextTempID;
+		/** number of sessions of incoming peers */
+		int m_nTempSessionCount;
+		int m_nMaxTempSessions;
+		bool m_bTempSessionFull;
+
+		bool m_bEnabled;
+		float m_fLossRate;
+		int m_nLatency;
+		int m_nSendWindow;
+		/** flush interval in milliseconds */
+		int m_nInterval;
+		int m_nMinRTO;
+		/** number of duplicated acks to trigger fast retransmit */
+		int m_nFastResend;
+		/** a session is dead if a message is sent so many times without an ack. */
+		int m_nDeadLink;
+		std::atomic<int> m_nRetransmitCount;
+		std::atomic<int> m_nFastRetransmitCount;
+	};
+}
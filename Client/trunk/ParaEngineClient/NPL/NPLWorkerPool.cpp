@@ -0,0 +1,153 @@
+//-----------------------------------------------------------------------------
+// Class:	CNPLWorkerPool
+// Company: ParaEngine
+// Desc: load balanced group of NPL runtime states.
+//-----------------------------------------------------------------------------
+#include "ParaEngine.h"
+#include "NPLRuntimeState.h"
+#include "NPLMessage.h"
+#include "util/ParaTime.h"
+#include "NPLWorkerPool.h"
+
+using namespace NPL;
+
+NPL::CNPLWorkerPool::CNPLWorkerPool(const std::string& name)
+	: m_name(name), m_nNextIndex(0), m_nRoutedCount(0), m_nLastStatTime(0), m_nLastProcessedCount(0)
+{
+}
+
+bool NPL::CNPLWorkerPool::AddWorker(NPLRuntimeState_ptr runtime_state)
+{
+	if (!runtime_state)
+		return false;
+	ParaEngine::Lock lock_(m_mutex);
+	for (auto& worker : m_workers)
+	{
+		if (worker == runtime_state)
+			return false;
+	}
+	m_workers.push_back(runtime_state);
+	return true;
+}
+
+bool NPL::CNPLWorkerPool::RemoveWorker(NPLRuntimeState_ptr runtime_state)
+{
+	ParaEngine::Lock lock_(m_mutex);
+	for (auto itCur = m_workers.begin(); itCur != m_workers.end(); ++itCur)
+	{
+		if (*itCur == runtime_state)
+		{
+			m_workers.erase(itCur);
+			return true;
+		}
+	}
+	return false;
+}
+
+bool NPL::CNPLWorkerPool::HasWorker(NPLRuntimeState_ptr runtime_state)
+{
+	ParaEngine::Lock lock_(m_mutex);
+	for (auto& worker : m_workers)
+	{
+		if (worker == runtime_state)
+			return true;
+	}
+	return false;
+}
+
+int NPL::CNPLWorkerPool::GetWorkerCount()
+{
+	ParaEngine::Lock lock_(m_mutex);
+	return (int)m_workers.size();
+}
+
+NPLRuntimeState_ptr NPL::CNPLWorkerPool::SelectWorker(const char* sKey, int nKeyLength)
+{
+	ParaEngine::Lock lock_(m_mutex);
+	int nCount = (int)m_workers.size();
+	if (nCount == 0)
+		return NPLRuntimeState_ptr();
+	if (nCount == 1)
+		return m_workers[0];
+
+	if (sKey != NULL && (nKeyLength > 0 || sKey[0] != '\0'))
+	{
+		if (nKeyLength <= 0)
+			nKeyLength = (int)strlen(sKey);
+		// FNV-1a
+		uint32 nHash = 2166136261u;
+		for (int i = 0; i < nKeyLength; ++i)
+		{
+			nHash ^= (unsigned char)sKey[i];
+			nHash *= 16777619u;
+		}
+		return m_workers[nHash % nCount];
+	}
+
+	// expected wait time of a new message is the number of messages ahead of it times the average processing time.
+	int nBest = -1;
+	int64 nBestCost = 0;
+	for (int i = 0; i < nCount; ++i)
+	{
+		int nIndex = (m_nNextIndex + i) % nCount;
+		CNPLRuntimeState* pWorker = m_workers[nIndex].get();
+		int nProcessTime = pWorker->GetAvgProcessTimeUS();
+		int64 nCost = (int64)(pWorker->GetCurrentQueueSize() + 1) * (nProcessTime > 0 ? nProcessTime : 1);
+		if (nBest < 0 || nCost < nBestCost)
+		{
+			nBest = nIndex;
+			nBestCost = nCost;
+		}
+	}
+	m_nNextIndex = (nBest + 1) % nCount;
+	return m_workers[nBest];
+}
+
+NPLReturnCode NPL::CNPLWorkerPool::Activate(const std::string& sRelativePath, const char* code, int nLength, const char* sKey, int nKeyLength, int priority)
+{
+	NPLRuntimeState_ptr rts = SelectWorker(sKey, nKeyLength);
+	if (!rts)
+		return NPL_RuntimeState_NotExist;
+
+	NPLMessage_ptr msg(new NPLMessage());
+	msg->m_filename = sRelativePath;
+	if (code)
+	{
+		if (nLength <= 0)
+			nLength = (int)strlen(code);
+		msg->m_code.append(code, nLength);
+	}
+	msg->m_nQueueTime = ParaEngine::GetTimeUS();
+	++m_nRoutedCount;
+	return rts->Activate_async(msg, priority);
+}
+
+void NPL::CNPLWorkerPool::GetStats(NPLWorkerPoolStats& stats)
+{
+	ParaEngine::Lock lock_(m_mutex);
+	stats.m_nWorkerCount = (int)m_workers.size();
+	stats.m_nRoutedCount = m_nRoutedCount;
+	stats.m_nQueueSize = 0;
+	int nProcessedCount = 0;
+	int64 nQueueTime = 0;
+	int64 nProcessTime = 0;
+	for (auto& worker : m_workers)
+	{
+		stats.m_nQueueSize += worker->GetCurrentQueueSize();
+		nProcessedCount += worker->GetProcessedMsgCount();
+		nQueueTime += worker->GetAvgQueueTimeUS();
+		nProcessTime += worker->GetAvgProcessTimeUS();
+	}
+	if (stats.m_nWorkerCount > 0)
+	{
+		stats.m_nAvgQueueTimeUS = (int)(nQueueTime / stats.m_nWorkerCount);
+		stats.m_nAvgProcessTimeUS = (int)(nProcessTime / stats.m_nWorkerCount);
+	}
+	int64 nCurTime = ParaEngine::GetTimeUS();
+	if (m_nLastStatTime != 0 && nCurTime > m_nLastStatTime && nProcessedCount >= m_nLastProcessedCount)
+		stats.m_fThroughput = (float)((nProcessedCount - m_nLastProcessedCount) * 1000000.0 / (nCurTime - m_nLastStatTime));
+	else
+		stats.m_fThroughput = 0.f;
+	m_nLastStatTime = nCurTime;
+	m_nLastProcessedCount = nProcessedCount;
+}
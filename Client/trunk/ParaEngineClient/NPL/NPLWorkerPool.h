@@ -0,0 +1,78 @@
+#pragma once
+#include "NPLCommon.h"
+#include "util/mutex.h"
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+#include <vector>
+#include <string>
+#include <atomic>
+
+namespace NPL
+{
+	/** statistics of a worker pool, see CNPLWorkerPool::GetStats() */
+	struct NPLWorkerPoolStats
+	{
+		NPLWorkerPoolStats() :m_nWorkerCount(0), m_nRoutedCount(0), m_nQueueSize(0), m_fThroughput(0.f), m_nAvgQueueTimeUS(0), m_nAvgProcessTimeUS(0){};
+		int m_nWorkerCount;
+		/** total number of messages routed by the pool */
+		int m_nRoutedCount;
+		/** number of messages waiting in all worker queues */
+		int m_nQueueSize;
+		/** messages processed per second by all workers since the last call of GetStats() */
+		float m_fThroughput;
+		/** average time in microseconds that a pool message waits in a worker queue */
+		int m_nAvgQueueTimeUS;
+		/** average time in microseconds that a worker spends on a pool message */
+		int m_nAvgProcessTimeUS;
+	};
+
+	/**
+	* a named group of NPL runtime states that share the same kind of work.
+	* An activation to the pool is routed to the member with the smallest expected wait, which is
+	* (queue length + 1) * recent average processing time. If a key is given, the member is chosen by the hash of the key instead,
+	* so that all messages of the same key (such as a user id) are processed in order by the same worker.
+	* Key affinity is only stable while the members of the pool do not change.
+	* [thread safe]
+	*/
+	class CNPLWorkerPool : private boost::noncopyable
+	{
+	public:
+		CNPLWorkerPool(const std::string& name);
+
+		const std::string& GetName() const { return m_name; }
+
+		/** add a worker. return false if it is already a member. */
+		bool AddWorker(NPLRuntimeState_ptr runtime_state);
+		/** remove a worker. return false if it is not a member. */
+		bool RemoveWorker(NPLRuntimeState_ptr runtime_state);
+		bool HasWorker(NPLRuntimeState_ptr runtime_state);
+		int GetWorkerCount();
+
+		/** select a worker for the next message.
+		* @param sKey: if not NULL or empty, the worker is selected by key hash. otherwise the least loaded worker is selected.
+		* @return null if the pool is empty.
+		*/
+		NPLRuntimeState_ptr SelectWorker(const char* sKey = NULL, int nKeyLength = 0);
+
+		/** activate a file in a selected worker.
+		* @param sRelativePath: the neuron file name without runtime state or nid.
+		* @param priority: 0 for high priority, 1 for normal. see CNPLRuntime::TranslatePriorityValue()
+		*/
+		NPLReturnCode Activate(const std::string& sRelativePath, const char* code, int nLength, const char* sKey = NULL, int nKeyLength = 0, int priority = 0);
+
+		/** get statistics. throughput is computed from the processed message count since the last call. */
+		void GetStats(NPLWorkerPoolStats& stats);
+
+	protected:
+		std::string m_name;
+		std::vector<NPLRuntimeState_ptr> m_workers;
+		/** members with the same load are selected in turn from this index. */
+		int m_nNextIndex;
+		std::atomic<int> m_nRoutedCount;
+		/** for throughput */
+		int64 m_nLastStatTime;
+		int m_nLastProcessedCount;
+		ParaEngine::mutex m_mutex;
+	};
+	typedef boost::shared_ptr<CNPLWorkerPool> NPLWorkerPool_ptr;
+}
@@ -6,13 +6,14 @@
 //-----------------------------------------------------------------------------
 #include "ParaEngine.h"
 #include "NeuronFileState.h"
+#include "util/ParaTime.h"
 
 using namespace NPL;
 using namespace ParaEngine;
 
 #define ACTIONSTATE_CLEARMESSAGE  0x1
 
-NPL::CNeuronFileState::CNeuronFileState(const std::string& filename) : m_filename(filename), m_isProcessing(false), m_nMaxQueueSize(1000), m_nActivationThisTick(0), m_nFrameMoveId(0), m_nTotalActivations(0), m_nPreemptiveInstructionCount(0), m_nActionState(0)
+NPL::CNeuronFileState::CNeuronFileState(const std::string& filename) : m_filename(filename), m_isProcessing(false), m_nMaxQueueSize(1000), m_nActivationThisTick(0), m_nFrameMoveId(0), m_nTotalActivations(0), m_nPreemptiveInstructionCount(0), m_nPreemptiveTimeSlice(0), m_nTimeSliceFrameId(-1), m_nTimeSliceDeadline(0), m_nActionState(0)
 {
 
 }
@@ -92,7 +93,7 @@ void NPL::CNeuronFileState::SetMaxQueueSize(int32 val)
 
 bool NPL::CNeuronFileState::IsPreemptive()
 {
-	return m_nPreemptiveInstructionCount > 0;
+	return m_nPreemptiveInstructionCount > 0 || m_nPreemptiveTimeSlice > 0;
 }
 
 int32 NPL::CNeuronFileState::GetPreemptiveInstructionCount() const
@@ -105,6 +106,21 @@ void NPL::CNeuronFileState::SetPreemptiveInstructionCount(int32 val)
 	m_nPreemptiveInstructionCount = val;
 }
 
+int64 NPL::CNeuronFileState::GetTimeSliceDeadline(int nFrameMoveId)
+{
+	if (m_nTimeSliceFrameId != nFrameMoveId)
+	{
+		m_nTimeSliceFrameId = nFrameMoveId;
+		m_nTimeSliceDeadline = ParaEngine::GetTimeUS() + m_nPreemptiveTimeSlice;
+	}
+	return m_nTimeSliceDeadline;
+}
+
+bool NPL::CNeuronFileState::IsTimeSliceUsedUp(int nFrameMoveId)
+{
+	return IsTimeSliced() && m_nTimeSliceFrameId == nFrameMoveId && ParaEngine::GetTimeUS() >= m_nTimeSliceDeadline;
+}
+
 void NPL::CNeuronFileState::ClearMessageImp()
 {
 	m_queue.clear();
@@ -61,12 +61,26 @@ namespace NPL
 		/** neuron file name */
 		const std::string& GetFilename() const { return m_filename; }
 		
-		/** Preemptive multi-tasking is simulated by counting instructions. */
+		/** Preemptive multi-tasking is simulated by counting instructions or by time slices. */
 		bool IsPreemptive();
 		/** if not 0, we will use coroutine and debug hook to simulate preemptive scheduling in user mode. */
 		int32 GetPreemptiveInstructionCount() const;
 		void SetPreemptiveInstructionCount(int32 val);
 
+		/** if not 0, the activation function runs in a coroutine which is preempted when it has used this many 
+		* microseconds in the current tick. It is shared by all messages processed in the same tick, so it is also the CPU budget 
+		* of this file per tick. No debug hook is installed until the time slice is used up, see CNPLPreemptionTimer. 
+		* It takes precedence over the preemptive instruction count. 
+		*/
+		int32 GetPreemptiveTimeSlice() const { return m_nPreemptiveTimeSlice; }
+		void SetPreemptiveTimeSlice(int32 val) { m_nPreemptiveTimeSlice = val; }
+		bool IsTimeSliced() const { return m_nPreemptiveTimeSlice > 0; }
+
+		/** get the deadline in microseconds of the time slice of the given tick. The time slice begins at the first call in a tick. */
+		int64 GetTimeSliceDeadline(int nFrameMoveId);
+		/** whether the time slice of the given tick is used up. */
+		bool IsTimeSliceUsedUp(int nFrameMoveId);
+
 	protected:
 		/* clear all messages and shrink message queue (releasing memory).*/
 		void ClearMessageImp();
@@ -80,6 +94,11 @@ namespace NPL
 		int32 m_nTotalActivations;
 		/** if not 0, we will use coroutine and debug hook to simulate preemptive scheduling in user mode. */
 		int32 m_nPreemptiveInstructionCount;
+		/** microseconds of time slice per tick, 0 to disable. */
+		int32 m_nPreemptiveTimeSlice;
+		/** the tick and deadline of the current time slice */
+		int32 m_nTimeSliceFrameId;
+		int64 m_nTimeSliceDeadline;
 		/** action state */
 		DWORD m_nActionState;
 		/** whether the message is still being processed in the activation function.
@@ -454,6 +454,10 @@ void CNPLScriptingState::LoadParaScene()
 			def("RegisterEvent", & ParaScene::RegisterEvent1),
 			def("UnregisterEvent", & ParaScene::UnregisterEvent),
 			def("UnregisterAllEvent", & ParaScene::UnregisterAllEvent),
+			def("RegisterEventFunction", & ParaScene::RegisterEventFunction),
+			def("UnregisterEventByID", & ParaScene::UnregisterEventByID),
+			def("SetEventCoalescePolicy", & ParaScene::SetEventCoalescePolicy),
+			def("GetEventStats", & ParaScene::GetEventStats),
 			def("EnableLighting", & ParaScene::EnableLighting),
 			def("IsLightingEnabled", & ParaScene::IsLightingEnabled),
 			def("SetTimeOfDay", & ParaScene::SetTimeOfDay),
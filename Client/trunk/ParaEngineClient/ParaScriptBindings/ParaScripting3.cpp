@@ -327,6 +327,11 @@ void CNPLScriptingState::LoadHAPI_NPL()
 				def("activate", &CNPL::activate3),
 				def("activate", &CNPL::activate5),
 				def("activate", &CNPL::activate1),
+				def("GetActivationHandle", &CNPL::GetActivationHandle),
+				def("ActivateHandle", &CNPL::ActivateHandle),
+				def("CreateWorkerPool", &CNPL::CreateWorkerPool),
+				def("ActivateWorkerPool", &CNPL::ActivateWorkerPool),
+				def("GetWorkerPoolStats", &CNPL::GetWorkerPoolStats),
 				def("call",&CNPL::call),
 				def("load", &CNPL::load1),
 				def("load", &CNPL::load),
@@ -338,6 +343,9 @@ void CNPLScriptingState::LoadHAPI_NPL()
 				def("GetIP", &CNPL::GetIP),
 				def("accept", &CNPL::accept),
 				def("SetProtocol", &CNPL::SetProtocol),
+				def("SendHttpResponse", &CNPL::SendHttpResponse),
+				def("AddHttpStaticDir", &CNPL::AddHttpStaticDir),
+				def("SetRateLimit", &CNPL::SetRateLimit),
 				def("reject", &CNPL::reject),
 				def("SetUseCompression", &CNPL::SetUseCompression),
 				def("SetCompressionKey", &CNPL::SetCompressionKey),
@@ -379,6 +387,9 @@ void CNPLScriptingState::LoadHAPI_NPL()
 				def("AppendURLRequest",&CNPL::AppendURLRequest1),
 				def("EncodeURLQuery",&CNPL::EncodeURLQuery),
 				def("ChangeRequestPoolSize",&CNPL::ChangeRequestPoolSize),
+				def("AsyncSQL",&CNPL::AsyncSQL),
+				def("AsyncSQLOpen",&CNPL::AsyncSQLOpen),
+				def("AsyncSQLClose",&CNPL::AsyncSQLClose),
 				def("RegisterEvent",&CNPL::RegisterEvent),
 				def("UnregisterEvent",&CNPL::UnregisterEvent),
 				def("GetStats",&CNPL::GetStats),
@@ -432,6 +443,7 @@ void CNPLScriptingState::LoadHAPI_NPL()
 
 				// function declarations
 				def("CreateGetQueue", &ParaIPC::CreateGetQueue),
+				def("CreateGetRingQueue", &ParaIPC::CreateGetRingQueue),
 				def("RemoveQueue", &ParaIPC::RemoveQueue),
 				def("Clear", &ParaIPC::Clear)
 			]
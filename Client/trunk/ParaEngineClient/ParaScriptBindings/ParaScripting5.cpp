@@ -286,6 +286,10 @@ void CNPLScriptingState::LoadHAPI_Globals()
 			.def("SetAppendMode", &ParaServiceLogger::SetAppendMode)
 			.def("SetForceFlush", &ParaServiceLogger::SetForceFlush)
 			.def("SetLogFile", &ParaServiceLogger::SetLogFile)
+			.def("SetAsyncMode", &ParaServiceLogger::SetAsyncMode)
+			.def("SetMaxLogFileSize", &ParaServiceLogger::SetMaxLogFileSize)
+			.def("SetLogRotateInterval", &ParaServiceLogger::SetLogRotateInterval)
+			.def("GetDroppedLogCount", &ParaServiceLogger::GetDroppedLogCount)
 			.def("log", &ParaServiceLogger::log),
 
 			// declarations
@@ -112,6 +112,38 @@ void ParaServiceLogger::SetForceFlush(bool bForceFlush)
 		CLogger::GetSingleton().SetForceFlush(bForceFlush);
 }
 
+void ParaServiceLogger::SetAsyncMode(bool bAsync)
+{
+	if (m_logger_ptr.get() != 0)
+		m_logger_ptr->SetAsyncMode(bAsync);
+	else
+		CLogger::GetSingleton().SetAsyncMode(bAsync);
+}
+
+void ParaServiceLogger::SetMaxLogFileSize(int nBytes)
+{
+	if (m_logger_ptr.get() != 0)
+		m_logger_ptr->SetMaxLogFileSize(nBytes);
+	else
+		CLogger::GetSingleton().SetMaxLogFileSize(nBytes);
+}
+
+void ParaServiceLogger::SetLogRotateInterval(int nSeconds)
+{
+	if (m_logger_ptr.get() != 0)
+		m_logger_ptr->SetLogRotateInterval(nSeconds);
+	else
+		CLogger::GetSingleton().SetLogRotateInterval(nSeconds);
+}
+
+double ParaServiceLogger::GetDroppedLogCount()
+{
+	if (m_logger_ptr.get() != 0)
+		return (double)m_logger_ptr->GetDroppedLogCount();
+	else
+		return (double)CLogger::GetSingleton().GetDroppedLogCount();
+}
+
 void ParaServiceLogger::SetAppendMode(bool bAppendToExistingFile)
 {
 	if (m_logger_ptr.get() != 0)
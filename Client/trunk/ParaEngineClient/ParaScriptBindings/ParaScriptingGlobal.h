@@ -175,6 +175,20 @@ namespace ParaScripting
 		* @note: only call this function when no log is written before using the logger. 
 		*/
 		void SetForceFlush(bool bForceFlush);
+
+		/** in async mode, log messages are queued to per thread lock-free buffers and written to file in batches by a background thread. 
+		* @note: only call this function when no log is written before using the logger. 
+		*/
+		void SetAsyncMode(bool bAsync);
+
+		/** in async mode, rotate log file when its size exceeds the given bytes. 0 to disable. */
+		void SetMaxLogFileSize(int nBytes);
+
+		/** in async mode, rotate log file every given seconds. 0 to disable. */
+		void SetLogRotateInterval(int nSeconds);
+
+		/** number of messages dropped in async mode because the buffer is full. */
+		double GetDroppedLogCount();
 	};
 
 	/**
@@ -29,7 +29,7 @@ ParaScripting::ParaIPCQueue::ParaIPCQueue( const char* sQueueName, int nUsage )
 	m_pQueue.reset(new CInterprocessQueue(sQueueName, (IPQueueUsageEnum)nUsage));
 }
 
-ParaScripting::ParaIPCQueue::ParaIPCQueue( boost::shared_ptr<CInterprocessQueue>& pQueue ) :m_pQueue(pQueue)
+ParaScripting::ParaIPCQueue::ParaIPCQueue( boost::shared_ptr<IInterprocessQueue>& pQueue ) :m_pQueue(pQueue)
 {
 }
 
@@ -237,6 +237,12 @@ ParaScripting::ParaIPCQueue ParaScripting::ParaIPC::CreateGetQueue( const char*
 	return ParaIPCQueue(pQueue);
 }
 
+ParaScripting::ParaIPCQueue ParaScripting::ParaIPC::CreateGetRingQueue( const char* filename, int nCreationFlag )
+{
+	CInterprocessQueuePtr pQueue = CIPCManager::GetInstance()->CreateGetQueue(filename, (IPQueueUsageEnum) nCreationFlag, true);
+	return ParaIPCQueue(pQueue);
+}
+
 void ParaScripting::ParaIPC::Clear()
 {
 	CIPCManager::GetInstance()->Clear();
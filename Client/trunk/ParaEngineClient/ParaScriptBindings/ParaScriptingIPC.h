@@ -33,7 +33,7 @@ namespace ParaScripting
 		* @param	nUsage		The usage. 
 		*/
 		ParaIPCQueue(const char* sQueueName, int nUsage);
-		ParaIPCQueue(boost::shared_ptr<CInterprocessQueue>& pQueue);
+		ParaIPCQueue(boost::shared_ptr<IInterprocessQueue>& pQueue);
 
 		bool IsValid();
 
@@ -91,7 +91,7 @@ namespace ParaScripting
 		static bool ConvertObjectToMsg(const object& msg, InterProcessMessage& outMsg, int & nPriority);
 		static bool ConvertMsgToObject(InterProcessMessage& inMsg, const object& msg, int nPriority);
 	public:
-		boost::shared_ptr<CInterprocessQueue> m_pQueue;
+		boost::shared_ptr<IInterprocessQueue> m_pQueue;
 	};
 
 	/** for interprocess message communication. */
@@ -105,6 +105,12 @@ namespace ParaScripting
 		*/
 		static ParaIPCQueue CreateGetQueue(const char* filename, int nCreationFlag);
 
+		/** same as CreateGetQueue, except that the queue uses the shared memory ring transport. 
+		* Messages up to 64KB are sent as a single record and sending or receiving does not enter the kernel unless the other side is waiting. 
+		* Both processes must use this function for the same queue name, and there should only be one receiver. 
+		*/
+		static ParaIPCQueue CreateGetRingQueue(const char* filename, int nCreationFlag);
+
 		/** clear all system watcher references that is created by GetQueue() */
 		static void Clear();
 
@@ -40,6 +40,7 @@ using namespace luabind;
 #endif
 #include "UrlLoaders.h"
 #include "AsyncLoader.h"
+#include "ic/AsyncDBExecutor.h"
 #include "EventsCenter.h"
 #include "NPLHelper.h"
 #include "ParaScriptingIO.h"
@@ -189,6 +190,104 @@ namespace ParaScripting
 			sNPLFileName, sCode.c_str(), (int)sCode.size(), channel, priority, reliability);
 	}
 
+	int CNPL::GetActivationHandle(const object& strNPLFileName)
+	{
+		if (type(strNPLFileName) != LUA_TSTRING)
+			return -1;
+		return NPL::CNPLRuntime::GetInstance()->NPL_CreateActivationHandle(NPL::CNPLRuntimeState::GetRuntimeStateFromLuaObject(strNPLFileName),
+			object_cast<const char*>(strNPLFileName));
+	}
+
+	int CNPL::ActivateHandle(int nHandle, const object& input)
+	{
+		NPL::NPLMessage_ptr msg(new NPL::NPLMessage());
+		if (type(input) == LUA_TSTRING)
+		{
+			int nSize = 0;
+			const char* pStr = NPL::NPLHelper::LuaObjectToString(input, &nSize);
+			msg->m_code.append(pStr, nSize);
+		}
+		else
+		{
+			// serialize directly to the message to be queued, without an intermediate string. 
+			msg->m_code.reserve(100);
+			NPL::NPLHelper::SerializeToSCode("msg", input, msg->m_code);
+		}
+		return NPL::CNPLRuntime::GetInstance()->NPL_ActivateHandle(nHandle, msg);
+	}
+
+	int CNPL::CreateWorkerPool(const char* sPoolName, const object& workers)
+	{
+		NPL::NPLWorkerPool_ptr pool;
+		if (type(workers) == LUA_TTABLE)
+		{
+			pool = NPL::CNPLRuntime::GetInstance()->NPL_CreateWorkerPool(sPoolName);
+			for (luabind::iterator itCur(workers), itEnd; itCur != itEnd; ++itCur)
+			{
+				const char* sName = NPL::NPLHelper::LuaObjectToString(*itCur);
+				if (sName && !NPL::CNPLRuntime::GetInstance()->NPL_AddWorkerToPool(sPoolName, sName))
+				{
+					OUTPUT_LOG("warning: runtime state %s does not exist when adding to worker pool %s\n", sName, sPoolName);
+				}
+			}
+		}
+		else
+		{
+			pool = NPL::CNPLRuntime::GetInstance()->NPL_CreateWorkerPool(sPoolName, NPL::NPLHelper::LuaObjectToInt(workers));
+		}
+		return pool ? pool->GetWorkerCount() : 0;
+	}
+
+	int CNPL::ActivateWorkerPool(const char* sPoolName, const object& strNPLFileName, const object& input, const object& key)
+	{
+		if (type(strNPLFileName) != LUA_TSTRING)
+			return NPL::NPL_Error;
+		string sCode;
+		if (type(input) == LUA_TSTRING)
+		{
+			int nSize = 0;
+			const char* pStr = NPL::NPLHelper::LuaObjectToString(input, &nSize);
+			sCode.assign(pStr, nSize);
+		}
+		else
+		{
+			NPL::NPLHelper::SerializeToSCode("msg", input, sCode);
+		}
+		string sKey;
+		if (type(key) == LUA_TSTRING)
+		{
+			int nSize = 0;
+			const char* pStr = NPL::NPLHelper::LuaObjectToString(key, &nSize);
+			sKey.assign(pStr, nSize);
+		}
+		else if (type(key) == LUA_TNUMBER)
+		{
+			char sNumber[32];
+			snprintf(sNumber, sizeof(sNumber), "%.17g", object_cast<double>(key));
+			sKey = sNumber;
+		}
+		return NPL::CNPLRuntime::GetInstance()->NPL_ActivateWorkerPool(sPoolName, object_cast<const char*>(strNPLFileName),
+			sCode.c_str(), (int)sCode.size(), sKey.c_str());
+	}
+
+	object CNPL::GetWorkerPoolStats(const object& sPoolName)
+	{
+		const char* sName = NPL::NPLHelper::LuaObjectToString(sPoolName);
+		NPL::NPLWorkerPool_ptr pool = sName ? NPL::CNPLRuntime::GetInstance()->GetWorkerPool(sName) : NPL::NPLWorkerPool_ptr();
+		if (!pool)
+			return object();
+		NPL::NPLWorkerPoolStats stats;
+		pool->GetStats(stats);
+		object output = luabind::newtable(sPoolName.interpreter());
+		output["workers"] = stats.m_nWorkerCount;
+		output["routed"] = stats.m_nRoutedCount;
+		output["queue_size"] = stats.m_nQueueSize;
+		output["throughput"] = stats.m_fThroughput;
+		output["avg_queue_time"] = stats.m_nAvgQueueTimeUS / 1000.0;
+		output["avg_process_time"] = stats.m_nAvgProcessTimeUS / 1000.0;
+		return output;
+	}
+
 	void CNPL::call(const object& strNPLFileName, const object& input )
 	{
 		string sCode;
@@ -250,6 +349,7 @@ namespace ParaScripting
 			if (type(params) == LUA_TTABLE)
 			{
 				int nPreemptiveCount = 0;
+				int nPreemptiveTimeSlice = 0;
 				int nMsgQueueSize = -1;
 				bool bClearMessage = false;
 				for (luabind::iterator itCur(params), itEnd; itCur != itEnd; ++itCur)
@@ -268,6 +368,10 @@ namespace ParaScripting
 							{
 								nPreemptiveCount = value;
 							}
+							else if (sKey == "PreemptiveTime")
+							{
+								nPreemptiveTimeSlice = (int)(object_cast<double>(input) * 1000);
+							}
 							else if (sKey == "MsgQueueSize")
 							{
 								nMsgQueueSize = value;
@@ -293,6 +397,8 @@ namespace ParaScripting
 				{
 					if(nPreemptiveCount>0)
 						pFileState->SetPreemptiveInstructionCount(nPreemptiveCount);
+					if (nPreemptiveTimeSlice > 0)
+						pFileState->SetPreemptiveTimeSlice(nPreemptiveTimeSlice);
 					if (nMsgQueueSize > 0)
 						pFileState->SetMaxQueueSize(nMsgQueueSize);
 					if (bClearMessage)
@@ -555,6 +661,117 @@ namespace ParaScripting
 		return NPL::CNPLRuntime::GetInstance()->ChangeRequestPoolSize(sPoolName, nCount);
 	}
 
+	bool CNPL::AsyncSQL(const object& params)
+	{
+		using namespace ParaInfoCenter;
+		if (type(params) != LUA_TTABLE || type(params["db"]) != LUA_TSTRING || type(params["sql"]) != LUA_TSTRING)
+			return false;
+
+		AsyncDBQuery_ptr query(new AsyncDBQuery());
+		query->m_sql = object_cast<std::string>(params["sql"]);
+		if (type(params["callback"]) == LUA_TSTRING)
+			query->SetScriptCallback(object_cast<const char*>(params["callback"]));
+		if (type(params["readonly"]) == LUA_TBOOLEAN)
+			query->m_bReadOnly = object_cast<bool>(params["readonly"]);
+
+		object id = params["id"];
+		if (type(id) == LUA_TNUMBER)
+			query->m_id = AsyncDBValue(object_cast<double>(id));
+		else if (type(id) == LUA_TSTRING)
+			query->m_id = AsyncDBValue(object_cast<std::string>(id));
+
+		object values = params["params"];
+		if (type(values) == LUA_TTABLE)
+		{
+			for (int i = 1; true; ++i)
+			{
+				object value = values[i];
+				int nType = type(value);
+				if (nType == LUA_TNUMBER)
+					query->m_params.push_back(AsyncDBValue(object_cast<double>(value)));
+				else if (nType == LUA_TSTRING)
+					query->m_params.push_back(AsyncDBValue(object_cast<std::string>(value)));
+				else if (nType == LUA_TBOOLEAN)
+					query->m_params.push_back(AsyncDBValue(object_cast<bool>(value)));
+				else
+					break;
+			}
+		}
+		std::shared_ptr<CAsyncDBExecutor> pExecutor = CAsyncDBExecutorManager::GetSingleton().GetExecutor(object_cast<std::string>(params["db"]));
+		pExecutor->Execute(query);
+		return true;
+	}
+
+	bool CNPL::AsyncSQLOpen(const char* sDBFile, int nReaderCount)
+	{
+		if (sDBFile == NULL)
+			return false;
+		return !!ParaInfoCenter::CAsyncDBExecutorManager::GetSingleton().GetExecutor(sDBFile, nReaderCount);
+	}
+
+	bool CNPL::AsyncSQLClose(const char* sDBFile)
+	{
+		if (sDBFile == NULL)
+			return false;
+		return ParaInfoCenter::CAsyncDBExecutorManager::GetSingleton().CloseExecutor(sDBFile);
+	}
+
+	/** a request whose response is streamed to a file or to a data callback is served by CURLRequestTask of the web service client. 
+	* only string and number form fields and request_timeout are supported. */
+	static bool AppendStreamingURLRequest(const object& urlParams, const char* url, const char* sCallback, const object& sForm, const char* sPoolName)
+	{
+		ParaEngine::CURLRequestTask* pTask = new ParaEngine::CURLRequestTask();
+		pTask->m_url = url;
+		pTask->m_sNPLCallback = sCallback;
+
+		object saveToFile = urlParams["savetofile"];
+		if (type(saveToFile) == LUA_TSTRING)
+		{
+			object resume = urlParams["resume"];
+			pTask->SetSaveToFile(object_cast<const char*>(saveToFile), (type(resume) == LUA_TBOOLEAN) ? object_cast<bool>(resume) : true);
+		}
+		object dataCallback = urlParams["datacallback"];
+		if (type(dataCallback) == LUA_TSTRING)
+		{
+			object chunkSize = urlParams["chunksize"];
+			pTask->SetDataCallback(object_cast<const char*>(dataCallback), 
+				(type(chunkSize) == LUA_TNUMBER) ? (int)object_cast<double>(chunkSize) : ParaEngine::CURLRequestTask::DEFAULT_STREAM_CHUNK_SIZE);
+		}
+
+		if (type(sForm) == LUA_TTABLE)
+		{
+			for (luabind::iterator itCur(sForm), itEnd; itCur != itEnd; ++itCur)
+			{
+				const object& key = itCur.key();
+				const object& input = *itCur;
+				if (type(key) != LUA_TSTRING)
+					continue;
+				const char* sKey = object_cast<const char*>(key);
+				if (type(input) == LUA_TNUMBER)
+				{
+					double value = object_cast<double>(input);
+					if (strcmp(sKey, "request_timeout") == 0)
+						pTask->SetTimeOut((int)value);
+					else
+					{
+						char buff[40];
+						ParaEngine::StringHelper::fast_dtoa(value, buff, 40, 5);
+						pTask->AppendFormParam(sKey, buff);
+					}
+				}
+				else if (type(input) == LUA_TSTRING)
+					pTask->AppendFormParam(sKey, object_cast<const char*>(input));
+			}
+		}
+
+		if (!CGlobals::GetNPLRuntime()->AppendURLRequest(pTask, sPoolName))
+		{
+			delete pTask;
+			return false;
+		}
+		return true;
+	}
+
 	bool CNPL::AppendURLRequest1(const object&  urlParams, const char* sCallback, const object& sForm_, const char* sPoolName)
 	{
 		bool bSyncMode = sPoolName && strcmp(sPoolName, "self") == 0;
@@ -571,6 +788,14 @@ namespace ParaScripting
 		if (url==NULL || sCallback == NULL)
 			return false;
 
+		if (type(urlParams) == LUA_TTABLE && (type(urlParams["savetofile"]) == LUA_TSTRING || type(urlParams["datacallback"]) == LUA_TSTRING))
+		{
+			object sForm(sForm_);
+			if (type(urlParams["form"]) == LUA_TTABLE)
+				sForm = urlParams["form"];
+			return AppendStreamingURLRequest(urlParams, url, sCallback, sForm, sPoolName);
+		}
+
 		CAsyncLoader* pAsyncLoader = &(CAsyncLoader::GetSingleton());
 		CUrlLoader* pLoader = new CUrlLoader();
 		CUrlProcessor* pProcessor = new CUrlProcessor();
@@ -1567,6 +1792,11 @@ namespace ParaScripting
 			if(nid == 0)
 				nid = "localhost";
 			NPL::NPLRuntimeAddress_ptr address(new NPL::NPLRuntimeAddress(host, port, nid));
+			if (type(npl_address["udp"]) == LUA_TBOOLEAN && object_cast<bool>(npl_address["udp"]))
+			{
+				// activations to this nid are sent via the reliable UDP transport. 
+				NPL::CNPLRuntime::GetInstance()->GetNetServer()->GetUDPTransport().AddPeer(nid, host, port);
+			}
 			return NPL::CNPLRuntime::GetInstance()->GetNetServer()->GetDispatcher().AddNPLRuntimeAddress(address);
 		}
 		return false;
@@ -1620,6 +1850,35 @@ namespace ParaScripting
 
 	}
 
+	int CNPL::SendHttpResponse(const object& nid, int seq, const object& data, const object& flags)
+	{
+		const char* sNID = NPL::NPLHelper::LuaObjectToString(nid);
+		if (sNID == NULL)
+			return NPL::NPL_Error;
+		int nSize = 0;
+		const char* sData = NPL::NPLHelper::LuaObjectToString(data, &nSize);
+		int nFlags = NPL::NPLHelper::LuaObjectToInt(flags, NPL::CNPLConnection::HTTP_RESPONSE_END);
+		return NPL::CNPLRuntime::GetInstance()->NPL_SendHttpResponse(sNID, seq, sData, (sData != NULL) ? nSize : 0, nFlags);
+	}
+
+	void CNPL::AddHttpStaticDir(const char* sURLPrefix, const char* sDiskDir)
+	{
+		NPL::CNPLRuntime::GetInstance()->NPL_AddHttpStaticDir(sURLPrefix, sDiskDir);
+	}
+
+	void CNPL::SetRateLimit(const object& params)
+	{
+		if (type(params) != LUA_TTABLE)
+			return;
+		const char* sScope = NPL::NPLHelper::LuaObjectToString(params["scope"]);
+		const char* sPolicy = NPL::NPLHelper::LuaObjectToString(params["policy"]);
+		const char* sFileName = NPL::NPLHelper::LuaObjectToString(params["file"]);
+		float fMsgRate = (float)NPL::NPLHelper::LuaObjectToDouble(params["msgs"]);
+		float fByteRate = (float)NPL::NPLHelper::LuaObjectToDouble(params["bytes"]);
+		float fBurst = (float)NPL::NPLHelper::LuaObjectToDouble(params["burst"], 1.0);
+		NPL::CNPLRuntime::GetInstance()->NPL_SetRateLimit(sScope, fMsgRate, fByteRate, fBurst, sPolicy, sFileName);
+	}
+
 	void CNPL::reject(const object& nid)
 	{
 		const char * sNID = NULL;
@@ -187,6 +187,48 @@ namespace ParaScripting
 		static int activate1(const object& sNPLFilename);
 		static int activate3(const object& sNPLFilename, const object& sCode, int channel);
 		static int activate5(const object& sNPLFilename, const object& sCode, int channel, int priority, int reliability);
+		/**
+		* get a handle of a local neuron file in a given runtime state, which can be cached and used by NPL.ActivateHandle()
+		* to activate the file without parsing the file name and looking up the runtime state each time. 
+		* e.g. local h = NPL.GetActivationHandle("(worker1)script/consumer.lua"); NPL.ActivateHandle(h, {data=1});
+		* @param sNPLFilename: a local file name. If no runtime state is specified, the calling state is used. 
+		* @return a positive handle or -1 if the file is remote or the runtime state does not exist. The handle is valid until the runtime state is deleted.
+		*/
+		static int GetActivationHandle(const object& sNPLFilename);
+
+		/**
+		* same as activate(), except that the target is given by a handle from NPL.GetActivationHandle(). 
+		* @param msg: a pure data table, which is serialized directly to the message, or a string that is already 
+		* serialized with NPL.SerializeToSCode("msg", data), so that the same message can be sent many times without serialization.
+		* @return: NPLReturnCode. 0 means succeed. 
+		*/
+		static int ActivateHandle(int nHandle, const object& msg);
+
+		/**
+		* create a named pool of worker runtime states. Activations to "(@poolname)file.lua" are routed to the worker with 
+		* the smallest expected wait, i.e. (queue length + 1) * recent average processing time. 
+		* e.g. NPL.CreateWorkerPool("db", 4); NPL.activate("(@db)script/db_worker.lua", {query=...});
+		* @param workers: number of workers, which are created and started as "db1", "db2", ... if not exist. 
+		* or an array of existing runtime state names, such as {"worker1", "worker2"}. 
+		* @return the number of workers in the pool. 
+		*/
+		static int CreateWorkerPool(const char* sPoolName, const object& workers);
+
+		/**
+		* activate a file in a worker pool. 
+		* @param key: nil for the least loaded worker. otherwise a string or number, and all messages with the same key 
+		* are processed by the same worker in order, as long as workers of the pool do not change. 
+		* @return: NPLReturnCode. 0 means succeed. 
+		*/
+		static int ActivateWorkerPool(const char* sPoolName, const object& sNPLFilename, const object& msg, const object& key);
+
+		/**
+		* get stats of a worker pool, nil if the pool does not exist. 
+		* @return {workers, routed, queue_size, throughput, avg_queue_time, avg_process_time}, where throughput is messages 
+		* processed by all workers per second since the last call, and times are moving averages in milliseconds. 
+		*/
+		static object GetWorkerPoolStats(const object& sPoolName);
+
 		/** this function is only called by .Net API.*/
 		static int activate2_(const char * sNPLFilename, const char* sCode);
 		/** this function is only called by .Net API.*/
@@ -206,12 +248,15 @@ namespace ParaScripting
 		* add the current file name to the __act table.
 		* create the activate table, if it does not exist.
 		* @param funcActivate: the function pointer to the activation function. It can either be local or global.
-		* @param params: nil or a table {[PreemptiveCount=number,] [MsgQueueSize=number,] [filename|name=string,]}
+		* @param params: nil or a table {[PreemptiveCount=number,] [PreemptiveTime=number,] [MsgQueueSize=number,] [filename|name=string,]}
 		* - PreemptiveCount: if PreemptiveCount is omitted (default), the activate function will 
 		* run non-preemptive (it is the programmer's job to let the function finish in short time). 
 		* If PreemptiveCount > 0, the activate function will be preemptive (yield) after this number of virtual instructions.
 		* which allows us to run tens of thousands of jobs concurrently. Each job has its own stack and but the programmer 
 		* should pay attention when making changes to shared data.
+		* - PreemptiveTime: if > 0, the activate function will be preemptive (yield) after running this number of milliseconds 
+		* (can be fractional) in a tick. Unlike PreemptiveCount, no debug hook is installed until the time is used up, so 
+		* the function runs at full speed. It is also the CPU budget of all messages of this file in a tick. 
 		* - MsgQueueSize: Max message queue size of this file, if not specified it is same as the NPL thread's message queue size. 
 		* - filename|name: virtual filename, if not specified, the current file being loaded is used. 
 		* - clear: clear all memory used by the file, including its message queue. Normally one never needs to clear. 
@@ -403,6 +448,7 @@ namespace ParaScripting
 		host = "127.0.0.1",
 		port = "60001",
 		nid = "MyServer",
+		udp = true, -- optional, if true, activations to nid are sent via reliable UDP, which honors the channel and reliability of NPL.activate
 		}
 		* [thread safe]
 		* @return: true if successfully added. 
@@ -428,6 +474,40 @@ namespace ParaScripting
 
 		/** set transmission protocol, default value is 0. */
 		static void SetProtocol(const char* nid, int protocolType);
+
+		/** send part of the response of an HTTP request received by the NPL server. Responses of pipelined requests are 
+		* always sent in request order, and the connection is kept alive according to msg.keepalive. 
+		* e.g. 
+		*	NPL.SendHttpResponse(msg.tid or msg.nid, msg.seq, "HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n\r\n", 0);
+		*	NPL.SendHttpResponse(msg.tid or msg.nid, msg.seq, "hello ", 1);
+		*	NPL.SendHttpResponse(msg.tid or msg.nid, msg.seq, "world", 3);
+		* @param nid: msg.tid or msg.nid of the HTTP request. 
+		* @param seq: msg.seq of the HTTP request. 
+		* @param data: string data. 
+		* @param flags: 0 for raw data, such as status line and headers. 1 for a chunk of chunked transfer encoding. 
+		* 2 to end the response, which is the default. 3 to send the last chunk and end the response. 
+		* @return 0 if succeed. 
+		*/
+		static int SendHttpResponse(const object& nid, int seq, const object& data, const object& flags);
+
+		/** serve HTTP GET/HEAD requests whose url begins with sURLPrefix from files in sDiskDir directly by the NPL server, 
+		* with ETag and If-None-Match support. Requests to missing files are still passed to the NPL HTTP handler. 
+		* e.g. NPL.AddHttpStaticDir("/static/", "www/static/")
+		* @param sDiskDir: if empty, the mapping is removed. 
+		*/
+		static void AddHttpStaticDir(const char* sURLPrefix, const char* sDiskDir);
+
+		/** set token bucket limits on incoming messages, which are checked before messages are queued to runtime states. 
+		* e.g. NPL.SetRateLimit({scope="connection", msgs=200, bytes=1024000, burst=2, policy="delay"})
+		* @param params: a table of 
+		*  - scope: "connection"(default), "nid" or "file". limits of "nid" are shared by all connections of the same nid or tid. 
+		*  - file: the target neuron file, only for the "file" scope. 
+		*  - msgs, bytes: max messages and bytes per second. both 0 or nil to remove the limit. 
+		*  - burst: how many seconds of traffic can be received in a burst. default to 1. 
+		*  - policy: "delay"(default) to pause reading from the connection, "drop" to discard messages, or "disconnect". 
+		*    UDP messages over limit are always dropped. 
+		*/
+		static void SetRateLimit(const object& params);
 		
 
 		/** reject and close a given connection. The connection will be closed once rejected. 
@@ -698,6 +778,14 @@ namespace ParaScripting
 		*		{name = {file="dummy.html",	data="<html><bold>bold</bold></html>, type="text/html"}}
 		*  some predefined field name in sForm is 
 		*		request_timeout: milliseconds of request timeout e.g. {request_timeout=50000,}
+		*  if url is a table, the response can be streamed instead of being kept in memory: 
+		*		savetofile: the response body is written to this file. It is downloaded to savetofile..".download" first, and renamed on success. 
+		*		resume: default to true. continue a partial ".download" file with a HTTP Range request.
+		*		datacallback: NPL code called with msg={url, data, offset, currentsize, totalsize} for every chunksize bytes, and once more with msg.finished=true. 
+		*			if savetofile is also given, msg.data is omitted, so that it is a progress callback. 
+		*		chunksize: bytes per datacallback, default to 65536.
+		*	e.g. NPL.AppendURLRequest({url="http://paraengine.com/a.zip", savetofile="temp/a.zip", datacallback="OnProgress()"}, "OnDone()", nil, "d")
+		*	streaming requests only support string and number form fields, and do not support headers or the "self" pool. 
 		* @param sPoolName: the request pool name. If the pool does not exist, it will be created. If null, the default pool is used. 
 		*  there are some reserved pool names used by ParaEngine. They are: 
 		*    - "d": download pool. default size is 2, for downloading files. 
@@ -724,6 +812,33 @@ namespace ParaScripting
 		*/
 		static bool ChangeRequestPoolSize(const char* sPoolName, int nCount);
 
+		/** execute a sql query in the async db executor of the given database file, so that the calling state is never blocked.
+		* Queries of the same database are executed in a dedicated worker thread one after another, unless readonly is true and
+		* the database is opened with a read connection pool by NPL.AsyncSQLOpen().
+		* e.g. NPL.AsyncSQL({db="Database/test.db", sql="SELECT * FROM t WHERE id=?", params={1}, id=1, callback="(main)MyApp.OnResult()", readonly=true})
+		* [thread safe]
+		* @param params: a table of {db, sql, params, callback, id, readonly}
+		*	- db: the database disk file name. the executor is created on first use if not opened by NPL.AsyncSQLOpen().
+		*	- sql: a single sql statement.
+		*	- params: an array of values(number, string or boolean) bound to ?1, ?2, ... in order.
+		*	- callback: a string callback function. it may begin with (runtime_state_name) such as "(main)my_function()",
+		*	  if no runtime state is provided, it is the main state. a global msg={id, err, errmsg, rows, changes, lastrowid} contains the result,
+		*	  where msg.rows is an array of {colname=value}, msg.err is sqlite error code (0 is ok).
+		*	- id: any number or string returned as msg.id.
+		*	- readonly: true to allow the query to run in the read connection pool concurrently with other reads.
+		* @return false if params are invalid.
+		*/
+		static bool AsyncSQL(const object& params);
+
+		/** create the async db executor of the given database with a read connection pool.
+		* if the pool is used, the database is switched to WAL journal mode. It has no effect if the executor already exists.
+		* @param nReaderCount: number of read only connections, each in its own thread. 0 to run all queries in the writer thread.
+		*/
+		static bool AsyncSQLOpen(const char* sDBFile, int nReaderCount);
+
+		/** block until all queued queries of the database are executed and close its async db executor. */
+		static bool AsyncSQLClose(const char* sDBFile);
+
 		/** convert json string to NPL object. Internally TinyJson is used.  
 		* @param sJson: the json code to parse. the first level must be array or table. otherwise, false is returned. 
 		* @param output: [in|out] it must be a table. and usually empty table. the output is written to this table. 
@@ -48,6 +48,9 @@
 #include "PortalNode.h"
 #include "SelectionManager.h"
 #include "ParaXAnimInstance.h"
+#include "EventHandler.h"
+#include "NPLRuntime.h"
+#include "NPLHelper.h"
 #include <time.h>
 
 extern "C"
@@ -2322,6 +2325,147 @@ void ParaScene::UnregisterEvent(const char* sID)
 	CGlobals::GetEventsCenter()->UnregisterEvent(sID);
 }
 
+/** an event handler that calls a lua function in the main runtime state with the event message table, 
+* instead of activating a file or compiling the event script code. 
+* The message table is parsed once per dispatched event and shared by all lua function handlers of that event. 
+* If the event is fired in a thread other than the one that runs the main state, the call is queued to the main state 
+* by activating EVENT_FUNCTION_FILE, which looks up the function by handler id in the EVENT_FUNCTION_TABLE global. 
+* Handlers are removed by CEventsCenter::UnregisterEventsOfLuaState() before the main state is closed. */
+#define EVENT_FUNCTION_TABLE "__event_functions"
+#define EVENT_FUNCTION_FILE "__event_function__"
+class CLuaFunctionEventHandler : public CEventHandler
+{
+public:
+	CLuaFunctionEventHandler(DWORD nType, const string& sID, const object& func)
+		:CEventHandler(nType, sID, ""), m_func(func){};
+
+	virtual ~CLuaFunctionEventHandler()
+	{
+		// release the shared message table while its lua state is still alive. 
+		if (s_msg.is_valid() && s_msg.interpreter() == m_func.interpreter())
+		{
+			s_msg = object();
+			s_nMsgSerial = -1;
+		}
+		lua_State* L = m_func.interpreter();
+		if (L != 0)
+		{
+			object functions = globals(L)[EVENT_FUNCTION_TABLE];
+			if (type(functions) == LUA_TTABLE)
+				functions[GetHandlerID()] = luabind::nil;
+		}
+	}
+
+	/** keep the function in the EVENT_FUNCTION_TABLE of its lua state, so that queued calls can find it by handler id. 
+	* it must be called in the main state's thread after the handler is added to the events center. */
+	void PublishFunction()
+	{
+		lua_State* L = m_func.interpreter();
+		object functions = globals(L)[EVENT_FUNCTION_TABLE];
+		if (type(functions) != LUA_TTABLE)
+		{
+			functions = newtable(L);
+			globals(L)[EVENT_FUNCTION_TABLE] = functions;
+			const char* sCode = "NPL.this(function() local func = " EVENT_FUNCTION_TABLE "[msg.handler_id]; if(func) then local event = msg.event; "
+				"if(type(event.msg) == \"table\") then event = event.msg; end; func(event); end end, {filename=\"" EVENT_FUNCTION_FILE "\"})";
+			CGlobals::GetNPLRuntime()->GetMainRuntimeState()->DoString(sCode, (int)strlen(sCode));
+		}
+		functions[GetHandlerID()] = m_func;
+	}
+
+	virtual bool UsesLuaState(lua_State* L) const
+	{
+		return m_func.interpreter() == L;
+	}
+
+	virtual int OnEvent(const IEvent* event, const string& sScriptCode)
+	{
+		lua_State* L = m_func.interpreter();
+		if (L == 0)
+			return 0;
+		if (!CGlobals::GetNPLRuntime()->IsInMainStateThread())
+		{
+			// the main state runs in another thread, so the call is queued like CEventHandler does. 
+			char sHeader[64];
+			snprintf(sHeader, sizeof(sHeader), "msg={handler_id=%d, event={", GetHandlerID());
+			string sCode = sHeader;
+			sCode += sScriptCode;
+			sCode += "}}";
+			NPL::CNPLRuntime* pRuntime = CGlobals::GetNPLRuntime();
+			return pRuntime->NPL_Activate(pRuntime->GetMainRuntimeState(), EVENT_FUNCTION_FILE, sCode.c_str(), (int)sCode.size());
+		}
+		int64 nSerial = CGlobals::GetEventsCenter()->GetDispatchSerial();
+		if (nSerial != s_nMsgSerial || (s_msg.is_valid() && s_msg.interpreter() != L))
+		{
+			object msg = newtable(L);
+			s_nMsgSerial = nSerial;
+			if (!NPL::NPLHelper::StatementsToLuaObject(sScriptCode.c_str(), (int)sScriptCode.size(), msg))
+			{
+				OUTPUT_LOG("warn: event handler %s can not parse event code: %s\n", GetID().c_str(), sScriptCode.c_str());
+				s_msg = object();
+				return 0;
+			}
+			// some events such as touch events already contain a msg table
+			if (type(msg["msg"]) == LUA_TTABLE)
+				msg = msg["msg"];
+			s_msg = msg;
+		}
+		if (!s_msg.is_valid())
+			return 0;
+		m_func.push(L);
+		s_msg.push(L);
+		if (lua_pcall(L, 1, 0, 0) != 0)
+		{
+			OUTPUT_LOG("error: event handler %s: %s\n", GetID().c_str(), lua_tostring(L, -1));
+			lua_pop(L, 1);
+		}
+		return 0;
+	}
+protected:
+	object m_func;
+	/** the message table of the last dispatched event, and the dispatch serial it is parsed for. */
+	static object s_msg;
+	static int64 s_nMsgSerial;
+};
+object CLuaFunctionEventHandler::s_msg;
+int64 CLuaFunctionEventHandler::s_nMsgSerial = -1;
+
+int ParaScene::RegisterEventFunction(DWORD nEventType, const char* sID, const object& func)
+{
+	if (type(func) != LUA_TFUNCTION || sID == 0)
+		return -1;
+	if (ParaScripting::CNPLScriptingState::GetRuntimeStateFromLuaState(func.interpreter()) != CGlobals::GetNPLRuntime()->GetMainRuntimeState())
+	{
+		OUTPUT_LOG("warn: ParaScene.RegisterEventFunction only accepts functions in the main runtime state: %s\n", sID);
+		return -1;
+	}
+	CLuaFunctionEventHandler* pHandler = new CLuaFunctionEventHandler(nEventType, sID, func);
+	int nHandlerID = CGlobals::GetEventsCenter()->AddEventHandler(pHandler);
+	pHandler->PublishFunction();
+	return nHandlerID;
+}
+
+void ParaScene::UnregisterEventByID(int nHandlerID)
+{
+	CGlobals::GetEventsCenter()->UnregisterEvent(nHandlerID);
+}
+
+void ParaScene::SetEventCoalescePolicy(int nEventType, int nPolicy)
+{
+	CGlobals::GetEventsCenter()->SetCoalescePolicy(nEventType, nPolicy);
+}
+
+object ParaScene::GetEventStats(int nEventType, const object& output)
+{
+	CEventsCenter* pEvents = CGlobals::GetEventsCenter();
+	object stats = (type(output) == LUA_TTABLE) ? output : newtable(output.interpreter());
+	stats["posted"] = (double)pEvents->GetPostedEventCount(nEventType);
+	stats["dispatched"] = (double)pEvents->GetDispatchedEventCount(nEventType);
+	stats["coalesced"] = (double)pEvents->GetCoalescedEventCount(nEventType);
+	stats["policy"] = pEvents->GetCoalescePolicy(nEventType);
+	return stats;
+}
+
 void ParaScene::UnregisterAllEvent()
 {
 	// CGlobals::GetEventsCenter()->UnregisterAllEvent();
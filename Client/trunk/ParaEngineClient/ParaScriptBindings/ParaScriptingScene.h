@@ -1816,6 +1816,26 @@ namespace ParaScripting
 		static void RegisterEvent1(DWORD nEventType, const char* sID, const char* sScript);
 		/** unregister a mouse or key event handler */
 		static void UnregisterEvent(const char* sID);
+
+		/** register a lua function as the event handler. the function is called with the event message table, such as 
+		* function(msg) log(msg.mouse_button) end, so that the event script code is not compiled for every event. 
+		* @param nEventType any bit combination of EventHandler_type
+		* @param sID any unique string identifier. an existing handler with the same id is replaced. 
+		* @param func: a function in the main runtime state. 
+		* @return the integer handler id, which can be used in UnregisterEventByID(). -1 if failed. 
+		*/
+		static int RegisterEventFunction(DWORD nEventType, const char* sID, const object& func);
+		/** unregister an event handler by the integer id returned from RegisterEventFunction() */
+		static void UnregisterEventByID(int nHandlerID);
+		/** set how pending events of the given type are merged when they are fired faster than frame move.
+		* @param nEventType: such as 5 for mouse move events. 
+		* @param nPolicy: 0 dispatch every event(default), 1 keep only the latest event, 2 accumulate, such as adding up mouse move deltas. 
+		*/
+		static void SetEventCoalescePolicy(int nEventType, int nPolicy);
+		/** get event statistics of the given type as a table of {posted, dispatched, coalesced, policy}
+		* @param output: a table to receive the result, or nil to create a new one. 
+		*/
+		static object GetEventStats(int nEventType, const object& output);
 		/** unregister all mouse or key event handler */
 		static void UnregisterAllEvent();
 
@@ -69,6 +69,15 @@ void PerfTest(lua_State* pState)
 }
 extern void Test_NPLTable();
 extern void Test_ServiceLog();
+extern void Test_AsyncLog();
+extern void Test_SQLiteBatch();
+extern void Test_NPLPreemption();
+extern void Test_TerrainQueries();
+extern void Test_MathSIMD();
+extern void Test_HttpRawThenFile();
+#ifdef PARAENGINE_CLIENT
+extern void Test_IPCQueue(const char* sRole, bool bUseSharedMemoryRing);
+#endif
 #endif
 
 namespace ParaScripting
@@ -83,6 +92,13 @@ namespace ParaScripting
 		}
 		Test_ServiceLog();
 		// Test_NPLTable();
+		// Test_AsyncLog();
+		// Test_SQLiteBatch();
+		// Test_NPLPreemption();
+		// Test_TerrainQueries();
+		// Test_MathSIMD();
+		// Test_HttpRawThenFile();
+		// Test_IPCQueue("client", true);
 #endif
 	}
 }// namespace ParaScripting
\ No newline at end of file
@@ -13,7 +13,7 @@ using namespace ParaEngine;
 
 DataGrid::DataGrid()
   : mValues(0), mVertices(0), mGradient(0), mColours(0), mMetaWorldFragments(0),
-    mPosition(0,0,0)
+    mPosition(0,0,0), mAllDirty(true), lastHostObject(0)
 {
 }
 
@@ -61,6 +61,10 @@ void DataGrid::initialize(int numCellsX, int numCellsY, int numCellsZ, float gri
 
 	// Initialize the position of grid points and the bounding box
 	initializeVertices();
+
+	resetClipRegion();
+	clearDirty();
+	markAllDirty();
 }
 
 
@@ -152,7 +156,11 @@ bool DataGrid::mapAABB(const CShapeAABB& aabb, int &x0, int &y0, int &z0, int &x
 	else
 		z1 = (int)::floor((aabb.GetMax().z - mBoundingBox.GetMin().z) / mGridScale);
 
-	return true;
+	// Restrict to the clip region
+	x0 = Math::Max(x0, mClipMin[0]); y0 = Math::Max(y0, mClipMin[1]); z0 = Math::Max(z0, mClipMin[2]);
+	x1 = Math::Min(x1, mClipMax[0]); y1 = Math::Min(y1, mClipMax[1]); z1 = Math::Min(z1, mClipMax[2]);
+
+	return (x0 <= x1 && y0 <= y1 && z0 <= z1);
 }
 
 void DataGrid::clear()
@@ -180,4 +188,96 @@ void DataGrid::clear()
 			frags++;
 		}
 	}
+
+	resetClipRegion();
+	markAllDirty();
+}
+
+bool DataGrid::clearRegion(const CShapeAABB& aabb)
+{
+	resetClipRegion();
+
+	int x0, y0, z0, x1, y1, z1;
+	if (!mapAABB(aabb, x0, y0, z0, x1, y1, z1))
+		return false;
+
+	for (int z = z0; z <= z1; ++z)
+	{
+		for (int y = y0; y <= y1; ++y)
+		{
+			int index = getGridIndex(x0, y, z);
+			for (int x = x0; x <= x1; ++x, ++index)
+			{
+				mValues[index] = 0.0;
+
+				if (hasGradient())
+					mGradient[index] = Vector3(0,0,0);
+
+				if (hasColours())
+					mColours[index] = 0x0;
+
+				if (hasMetaWorldFragments())
+				{
+					mMetaWorldFragments[index].first = 0.0;
+					mMetaWorldFragments[index].second = 0;
+				}
+			}
+		}
+	}
+
+	mClipMin[0] = x0; mClipMin[1] = y0; mClipMin[2] = z0;
+	mClipMax[0] = x1; mClipMax[1] = y1; mClipMax[2] = z1;
+
+	markDirty(x0, y0, z0, x1, y1, z1);
+	return true;
+}
+
+void DataGrid::resetClipRegion()
+{
+	mClipMin[0] = mClipMin[1] = mClipMin[2] = 0;
+	mClipMax[0] = mNumCellsX;
+	mClipMax[1] = mNumCellsY;
+	mClipMax[2] = mNumCellsZ;
+}
+
+void DataGrid::getClipRegion(int &x0, int &y0, int &z0, int &x1, int &y1, int &z1) const
+{
+	x0 = mClipMin[0]; y0 = mClipMin[1]; z0 = mClipMin[2];
+	x1 = mClipMax[0]; y1 = mClipMax[1]; z1 = mClipMax[2];
+}
+
+void DataGrid::markDirty(int x0, int y0, int z0, int x1, int y1, int z1)
+{
+	if (mDirtyMin[0] > mDirtyMax[0])
+	{
+		mDirtyMin[0] = x0; mDirtyMin[1] = y0; mDirtyMin[2] = z0;
+		mDirtyMax[0] = x1; mDirtyMax[1] = y1; mDirtyMax[2] = z1;
+	}
+	else
+	{
+		mDirtyMin[0] = Math::Min(mDirtyMin[0], x0); mDirtyMin[1] = Math::Min(mDirtyMin[1], y0); mDirtyMin[2] = Math::Min(mDirtyMin[2], z0);
+		mDirtyMax[0] = Math::Max(mDirtyMax[0], x1); mDirtyMax[1] = Math::Max(mDirtyMax[1], y1); mDirtyMax[2] = Math::Max(mDirtyMax[2], z1);
+	}
+}
+
+void DataGrid::markAllDirty()
+{
+	mAllDirty = true;
+	markDirty(0, 0, 0, mNumCellsX, mNumCellsY, mNumCellsZ);
+}
+
+bool DataGrid::getDirtyRegion(int &x0, int &y0, int &z0, int &x1, int &y1, int &z1) const
+{
+	if (mDirtyMin[0] > mDirtyMax[0])
+		return false;
+	x0 = mDirtyMin[0]; y0 = mDirtyMin[1]; z0 = mDirtyMin[2];
+	x1 = mDirtyMax[0]; y1 = mDirtyMax[1]; z1 = mDirtyMax[2];
+	return true;
+}
+
+void DataGrid::clearDirty()
+{
+	mAllDirty = false;
+	mDirtyMin[0] = mDirtyMin[1] = mDirtyMin[2] = 0;
+	mDirtyMax[0] = mDirtyMax[1] = mDirtyMax[2] = -1;
 }
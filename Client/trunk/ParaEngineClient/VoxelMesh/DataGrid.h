@@ -110,6 +110,38 @@ namespace ParaEngine
 		bool mapAABB(const CShapeAABB& aabb, int &x0, int &y0, int &z0, int &x1, int &y1, int &z1) const;
 		/// Clears the data grid.
 		void clear();
+		/** Clears the grid points inside an axis aligned box, and restricts mapAABB() to these points until resetClipRegion() is called.
+			@remarks
+				This allows a MetaWorldFragment to re-add only the meta objects overlapping a modified region,
+				instead of clearing and refilling the whole grid. The cleared grid points are marked dirty.
+			@returns
+				false if the box is completely outside the grid. */
+		bool clearRegion(const CShapeAABB& aabb);
+		/// Removes the clip region set by clearRegion().
+		void resetClipRegion();
+		/// Returns the range of grid points that mapAABB() is restricted to. It is the whole grid unless clearRegion() is called.
+		void getClipRegion(int &x0, int &y0, int &z0, int &x1, int &y1, int &z1) const;
+
+		/// Marks a range of grid points as modified since the last iso surface build.
+		void markDirty(int x0, int y0, int z0, int x1, int y1, int z1);
+		/// Marks all grid points as modified, so that the iso surface is fully rebuilt.
+		void markAllDirty();
+		/// Returns true if the whole grid is modified since the last iso surface build.
+		bool isAllDirty() const {return mAllDirty; }
+		/** Returns the range of grid points modified since the last iso surface build.
+			@returns
+				false if no grid point is modified. */
+		bool getDirtyRegion(int &x0, int &y0, int &z0, int &x1, int &y1, int &z1) const;
+		/// Called by IsoSurfaceBuilder::update() when the iso surface is up to date with the grid.
+		void clearDirty();
+
+		/** Returns the object whose data is currently in the grid.
+			@remarks
+				The data grid is shared by all MetaWorldFragments, so a fragment can only update a region of the grid
+				if it is still the host object, i.e. no other fragment has used the grid since its last update. */
+		void* getHostObject() const {return lastHostObject; }
+		/// Sets the object whose data is currently in the grid.
+		void setHostObject(void* pHost) {lastHostObject = pHost; }
 
 	protected:
 		/// The number of grid cells along the x axis of the grid.
@@ -146,6 +178,13 @@ namespace ParaEngine
 		/// Bounding box of the grid.
 		CShapeAABB mBoundingBox, mBoxSize;
 
+		/// Range of grid points modified since the last iso surface build. it is empty if min > max.
+		int mDirtyMin[3], mDirtyMax[3];
+		/// Whether the whole grid is modified since the last iso surface build.
+		bool mAllDirty;
+		/// Range of grid points that mapAABB() is restricted to.
+		int mClipMin[3], mClipMax[3];
+
 		/** Initializes the position of grid points and the bounding box.
 			@remarks
 				In the default implementation, the grid points form a regular grid centered around (0, 0, 0).
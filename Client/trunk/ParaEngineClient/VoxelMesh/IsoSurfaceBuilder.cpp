@@ -11,15 +11,24 @@
 #include "IsoSurfaceBuilder.h"
 #include "TextureEntity.h"
 #include "IsoSurfaceBuilderTables.h"
+#include <thread>
+#include <atomic>
 #include "memdebug.h"
 
 using namespace ParaEngine;
 
+/** a slab is only polygonised in another thread if the region has at least this number of cells per thread.
+* smaller edits are faster in the calling thread than starting threads. */
+#define MIN_CELLS_PER_THREAD	2048
+
 
 IsoSurfaceBuilder::IsoSurfaceBuilder()
   : mIsoVertexIndices(0), mIsoVertexPositions(0), mIsoVertexNormals(0),
-	mIsoVertexColours(0), mIsoVertexTexCoords(0), mNumIsoVertices(0)//, mSurfaceFlags(0)
+	mIsoVertexColours(0), mIsoVertexTexCoords(0), mNumIsoVertices(0), mGridCells(0), mCellCases(0)//, mSurfaceFlags(0)
 {
+	mMaxThreads = (int)std::thread::hardware_concurrency();
+	if (mMaxThreads < 1)
+		mMaxThreads = 1;
 }
 
 IsoSurfaceBuilder::~IsoSurfaceBuilder()
@@ -60,15 +69,13 @@ void IsoSurfaceBuilder::initialize(DataGrid* dataGridPtr, int flags)
 
 void IsoSurfaceBuilder::update(IsoSurfaceRenderable *surf)
 {
-	int count = getNumIsoVertices();
+	int x0, y0, z0, x1, y1, z1;
+	if (!mDataGrid->getDirtyRegion(x0, y0, z0, x1, y1, z1))
+		return;
 
-	// Clear vertex and triangle vectors before building new iso surface
-	mIsoVertices.clear();
-	mIsoTriangles.clear();
-
-	// Mark all iso vertices as not being used
-	for (int i = 0; i < count; ++i)
-		mIsoVertexIndices[i] = ~0;
+	// Polygonise the cells affected by the modified grid points
+	polygoniseRegion(x0, y0, z0, x1, y1, z1);
+	mDataGrid->clearDirty();
 
 	// Build the iso surface
 	buildIsoSurface();
@@ -105,6 +112,10 @@ void IsoSurfaceBuilder::createIsoVertices()
 	mIsoVertexIndices = new int[size];
 	mIsoVertexPositions = new Vector3[size];
 
+	// Mark all iso vertices as not being used
+	for (int i = 0; i < size; ++i)
+		mIsoVertexIndices[i] = ~0;
+
 	if (mSurfaceFlags & GEN_NORMALS)
 	{
 		// Create optional normal array
@@ -134,6 +145,10 @@ void IsoSurfaceBuilder::createGridCells()
 	mGridCells = new GridCell[x*y*z];
 	GridCell* gridCell = mGridCells;
 
+	// No cell generates triangles until it is polygonised
+	mCellCases = new unsigned char[x*y*z];
+	memset(mCellCases, 0, x*y*z);
+
 	// Initialize the corner index arrays of the grid cells.
 	for (int k = 0; k < z; ++k)
 	{
@@ -175,6 +190,13 @@ void IsoSurfaceBuilder::destroyGridCells()
 		// Delete the grid cell array
 		SAFE_DELETE_ARRAY(mGridCells);
 	}
+	SAFE_DELETE_ARRAY(mCellCases);
+}
+
+void IsoSurfaceBuilder::invalidateAll()
+{
+	if (mDataGrid != 0)
+		mDataGrid->markAllDirty();
 }
 
 
@@ -218,70 +240,155 @@ void IsoSurfaceBuilder::createGridCellIsoVertices()
 	}
 }
 
-// Oh my god, I'm using a macro! But it does make this easier to read.
-#define USE_ISO_VERTEX(i, a, b) useIsoVertex( \
-			gridCell->isoVertices[i], \
-			gridCell->cornerIndices[a], \
-			gridCell->cornerIndices[b])
+
+void IsoSurfaceBuilder::polygoniseRegion(int x0, int y0, int z0, int x1, int y1, int z1)
+{
+	int x = mDataGrid->getNumCellsX();
+	int y = mDataGrid->getNumCellsY();
+	int z = mDataGrid->getNumCellsZ();
+
+	// The cells touching the grid points (x0, y0, z0) - (x1, y1, z1)
+	int cx0 = Math::Max(x0 - 1, 0), cx1 = Math::Min(x1, x - 1);
+	int cy0 = Math::Max(y0 - 1, 0), cy1 = Math::Min(y1, y - 1);
+	int cz0 = Math::Max(z0 - 1, 0), cz1 = Math::Min(z1, z - 1);
+	if (cx0 > cx1 || cy0 > cy1 || cz0 > cz1)
+		return;
+
+	int nSlabs = cz1 - cz0 + 1;
+	int nCells = (cx1 - cx0 + 1) * (cy1 - cy0 + 1) * nSlabs;
+	int nThreads = Math::Min(Math::Min(mMaxThreads, nSlabs), nCells / MIN_CELLS_PER_THREAD);
+
+	// Each slab writes to its own cells and the iso vertices starting at its bottom plane, so slabs can be processed in any order.
+	std::atomic<int> nextSlab(cz0);
+	auto worker = [&]()
+	{
+		int k;
+		while ((k = nextSlab++) <= cz1)
+			polygoniseSlab(k, cx0, cy0, cx1, cy1, k == cz1);
+	};
+
+	std::vector<std::thread> threads;
+	for (int i = 1; i < nThreads; ++i)
+		threads.push_back(std::thread(worker));
+	worker();
+	for (size_t i = 0; i < threads.size(); ++i)
+		threads[i].join();
+}
+
+void IsoSurfaceBuilder::polygoniseSlab(int k, int x0, int y0, int x1, int y1, bool bTopPlane)
+{
+	int x = mDataGrid->getNumCellsX();
+	int y = mDataGrid->getNumCellsY();
+	const float* values = mDataGrid->getValues();
+	const float isoValue = mIsoValue;
+	// Optionally flip normals
+	const unsigned char flipMask = mFlipNormals ? 0 : 0xFF;
+
+	// Flags of the grid points on the four edges of a row of cells, which are
+	// (j, k), (j, k+1), (j+1, k) and (j+1, k+1) in the corner order of GridCell.
+	int nPoints = x1 - x0 + 2;
+	std::vector<unsigned char> flags(nPoints * 4);
+	unsigned char* f0 = &(flags[0]);
+	unsigned char* f3 = f0 + nPoints;
+	unsigned char* f4 = f3 + nPoints;
+	unsigned char* f7 = f4 + nPoints;
+
+	for (int j = y0; j <= y1; ++j)
+	{
+		const float* v0 = values + mDataGrid->getGridIndex(x0, j, k);
+		const float* v3 = values + mDataGrid->getGridIndex(x0, j, k + 1);
+		const float* v4 = values + mDataGrid->getGridIndex(x0, j + 1, k);
+		const float* v7 = values + mDataGrid->getGridIndex(x0, j + 1, k + 1);
+
+		// Flag the grid points that are outside the iso surface. Neither loop below has branches,
+		// so that the compiler can vectorize them.
+		for (int i = 0; i < nPoints; ++i)
+		{
+			f0[i] = (unsigned char)(v0[i] < isoValue);
+			f3[i] = (unsigned char)(v3[i] < isoValue);
+			f4[i] = (unsigned char)(v4[i] < isoValue);
+			f7[i] = (unsigned char)(v7[i] < isoValue);
+		}
+
+		// Combine the flags of the eight corners to the case index of each cell
+		unsigned char* cases = mCellCases + (k*y + j)*x + x0;
+		for (int i = 0; i < nPoints - 1; ++i)
+		{
+			cases[i] = (unsigned char)((f0[i] | (f0[i + 1] << 1) | (f3[i + 1] << 2) | (f3[i] << 3) |
+				(f4[i] << 4) | (f4[i + 1] << 5) | (f7[i + 1] << 6) | (f7[i] << 7)) ^ flipMask);
+		}
+	}
+
+	// Calculate the iso vertices on the edges starting at plane k, where the surface intersects the edge.
+	int strideY = x + 1;
+	int strideZ = (x + 1)*(y + 1);
+	int lastPlane = bTopPlane ? k + 1 : k;
+	for (int plane = k; plane <= lastPlane; ++plane)
+	{
+		for (int j = y0; j <= y1 + 1; ++j)
+		{
+			int corner = mDataGrid->getGridIndex(x0, j, plane);
+			for (int i = x0; i <= x1 + 1; ++i, ++corner)
+			{
+				bool bOutside = values[corner] < isoValue;
+
+				// edge along the x axis
+				if (i <= x1 && (values[corner + 1] < isoValue) != bOutside)
+					computeIsoVertex(isoVertexGroupOffsets[0] + plane*x*(y + 1) + j*x + i, corner, corner + 1);
+
+				// edge along the y axis
+				if (j <= y1 && (values[corner + strideY] < isoValue) != bOutside)
+					computeIsoVertex(isoVertexGroupOffsets[1] + plane*(x + 1)*y + j*(x + 1) + i, corner, corner + strideY);
+
+				// edge along the z axis, there is none above the top plane of the slab
+				if (plane == k && (values[corner + strideZ] < isoValue) != bOutside)
+					computeIsoVertex(isoVertexGroupOffsets[2] + k*(x + 1)*(y + 1) + j*(x + 1) + i, corner, corner + strideZ);
+			}
+		}
+	}
+}
 
 void IsoSurfaceBuilder::buildIsoSurface()
 {
+	// Mark the iso vertices of the last iso surface as not being used
+	for (IsoVertexVector::iterator itCur = mIsoVertices.begin(); itCur != mIsoVertices.end(); ++itCur)
+		mIsoVertexIndices[*itCur] = ~0;
+
+	// Clear vertex and triangle vectors before building new iso surface
+	mIsoVertices.clear();
+	mIsoTriangles.clear();
+
 	int count =
 		mDataGrid->getNumCellsX() *
 		mDataGrid->getNumCellsY() *
 		mDataGrid->getNumCellsZ();
-	float* values = mDataGrid->getValues();
 	GridCell* gridCell = mGridCells;
 
 	// Loop through all grid cells
-	for (int i = 0; i < count; ++i)
+	for (int i = 0; i < count; ++i, ++gridCell)
 	{
-		IsoTriangle isoTriangle;
-		int flags = 0;
-
-		// Flag the corners that are outside the iso surface
-		if (values[gridCell->cornerIndices[0]] < mIsoValue) flags |= 1;
-		if (values[gridCell->cornerIndices[1]] < mIsoValue) flags |= 2;
-		if (values[gridCell->cornerIndices[2]] < mIsoValue) flags |= 4;
-		if (values[gridCell->cornerIndices[3]] < mIsoValue) flags |= 8;
-		if (values[gridCell->cornerIndices[4]] < mIsoValue) flags |= 16;
-		if (values[gridCell->cornerIndices[5]] < mIsoValue) flags |= 32;
-		if (values[gridCell->cornerIndices[6]] < mIsoValue) flags |= 64;
-		if (values[gridCell->cornerIndices[7]] < mIsoValue) flags |= 128;
-
-		// Optionally flip normals
-		if (!mFlipNormals)
-			flags = 0xFF - flags;
-
-		// Find the vertices where the surface intersects the cube
-		if (msEdgeTable[flags] &    1) USE_ISO_VERTEX( 0, 0, 1);
-		if (msEdgeTable[flags] &    2) USE_ISO_VERTEX( 1, 1, 2);
-		if (msEdgeTable[flags] &    4) USE_ISO_VERTEX( 2, 2, 3);
-		if (msEdgeTable[flags] &    8) USE_ISO_VERTEX( 3, 3, 0);
-		if (msEdgeTable[flags] &   16) USE_ISO_VERTEX( 4, 4, 5);
-		if (msEdgeTable[flags] &   32) USE_ISO_VERTEX( 5, 5, 6);
-		if (msEdgeTable[flags] &   64) USE_ISO_VERTEX( 6, 6, 7);
-		if (msEdgeTable[flags] &  128) USE_ISO_VERTEX( 7, 7, 4);
-		if (msEdgeTable[flags] &  256) USE_ISO_VERTEX( 8, 0, 4);
-		if (msEdgeTable[flags] &  512) USE_ISO_VERTEX( 9, 1, 5);
-		if (msEdgeTable[flags] & 1024) USE_ISO_VERTEX(10, 2, 6);
-		if (msEdgeTable[flags] & 2048) USE_ISO_VERTEX(11, 3, 7);
+		int flags = mCellCases[i];
+		if (msEdgeTable[flags] == 0)
+			continue;
 
 		// Generate triangles for this cube
-		for (int i = 0; msTriangleTable[flags][i] != -1; i += 3)
+		IsoTriangle isoTriangle;
+		for (int n = 0; msTriangleTable[flags][n] != -1; n += 3)
 		{
-			isoTriangle.vertices[0] = gridCell->isoVertices[msTriangleTable[flags][i]];
-			isoTriangle.vertices[1] = gridCell->isoVertices[msTriangleTable[flags][i+1]];
-			isoTriangle.vertices[2] = gridCell->isoVertices[msTriangleTable[flags][i+2]];
+			isoTriangle.vertices[0] = gridCell->isoVertices[msTriangleTable[flags][n]];
+			isoTriangle.vertices[1] = gridCell->isoVertices[msTriangleTable[flags][n+1]];
+			isoTriangle.vertices[2] = gridCell->isoVertices[msTriangleTable[flags][n+2]];
 			addIsoTriangle(isoTriangle);
 		}
-
-		++gridCell;
 	}
 }
 
 void ParaEngine::IsoSurfaceBuilder::addIsoTriangle(const IsoTriangle& isoTriangle)
 {
+	useIsoVertex(isoTriangle.vertices[0]);
+	useIsoVertex(isoTriangle.vertices[1]);
+	useIsoVertex(isoTriangle.vertices[2]);
+
 	if ((mSurfaceFlags & GEN_NORMALS) && (mNormalType != NORMAL_GRADIENT))
 	{
 		Vector3 normal;
@@ -310,12 +417,25 @@ void ParaEngine::IsoSurfaceBuilder::addIsoTriangle(const IsoTriangle& isoTriangl
 	mIsoTriangles.push_back(isoTriangle);
 }
 
-int ParaEngine::IsoSurfaceBuilder::useIsoVertex(int isoVertex, int corner0, int corner1)
+int ParaEngine::IsoSurfaceBuilder::useIsoVertex(int isoVertex)
 {
 	// Return the assigned hardware vertex buffer index if the iso vertex has already been used
 	if (mIsoVertexIndices[isoVertex] != ~0)
 		return isoVertex;
 
+	// Face normals are accumulated from zero
+	if ((mSurfaceFlags & GEN_NORMALS) && (mNormalType != NORMAL_GRADIENT))
+		mIsoVertexNormals[isoVertex] = Vector3(0, 0, 0);
+
+	// Assign the next index in the hardware vertex buffer to this iso vertex
+	mIsoVertexIndices[isoVertex] = (int)mIsoVertices.size();
+	mIsoVertices.push_back(isoVertex);
+
+	return isoVertex;
+}
+
+void ParaEngine::IsoSurfaceBuilder::computeIsoVertex(int isoVertex, int corner0, int corner1)
+{
 	// Calculate the transition of the iso vertex between the two corners
 	float* values = mDataGrid->getValues();
 	float t = (mIsoValue - values[corner0]) / (values[corner1] - values[corner0]);
@@ -324,25 +444,14 @@ int ParaEngine::IsoSurfaceBuilder::useIsoVertex(int isoVertex, int corner0, int
 	const Vector3* vertices = mDataGrid->getVertices();
 	mIsoVertexPositions[isoVertex] = vertices[corner0] + t*(vertices[corner1] - vertices[corner0]);
 
-	if (mSurfaceFlags & GEN_NORMALS)
+	if ((mSurfaceFlags & GEN_NORMALS) && mNormalType == NORMAL_GRADIENT)
 	{
-		// Generate optional normal
-		switch (mNormalType)
-		{
-		case NORMAL_WEIGHTED_AVERAGE:
-		case NORMAL_AVERAGE:
-			mIsoVertexNormals[isoVertex] = Vector3(0, 0, 0);
-			break;
-
-		case NORMAL_GRADIENT:
-		{
-								Vector3* gradient = mDataGrid->getGradient();
-								if (mFlipNormals)
-									mIsoVertexNormals[isoVertex] = gradient[corner0] + t*(gradient[corner1] - gradient[corner0]);
-								else
-									mIsoVertexNormals[isoVertex] = t*(gradient[corner0] - gradient[corner1]) - gradient[corner0];
-		}
-		}
+		// Generate optional normal by interpolating the gradient
+		Vector3* gradient = mDataGrid->getGradient();
+		if (mFlipNormals)
+			mIsoVertexNormals[isoVertex] = gradient[corner0] + t*(gradient[corner1] - gradient[corner0]);
+		else
+			mIsoVertexNormals[isoVertex] = t*(gradient[corner0] - gradient[corner1]) - gradient[corner0];
 	}
 
 	if (mSurfaceFlags & GEN_VERTEX_COLOURS)
@@ -360,15 +469,5 @@ int ParaEngine::IsoSurfaceBuilder::useIsoVertex(int isoVertex, int corner0, int
 		// use texture according to position in x,z plane, so it is like texture projection effect. 
 		mIsoVertexTexCoords[isoVertex].x = mIsoVertexPositions[isoVertex].x;
 		mIsoVertexTexCoords[isoVertex].y = mIsoVertexPositions[isoVertex].z;
-
-		//mIsoVertexTexCoords[isoVertex][0] = mIsoVertexPositions[isoVertex].x;
-		//mIsoVertexTexCoords[isoVertex][1] = mIsoVertexPositions[isoVertex].y;
-		//mIsoVertexTexCoords[isoVertex][2] = mIsoVertexPositions[isoVertex].z;
 	}
-
-	// Assign the next index in the hardware vertex buffer to this iso vertex
-	mIsoVertexIndices[isoVertex] = (int)mIsoVertices.size(); // TODO: Inefficient?
-	mIsoVertices.push_back(isoVertex);
-
-	return isoVertex;
 }
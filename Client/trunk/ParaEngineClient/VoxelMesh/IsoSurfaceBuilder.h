@@ -43,25 +43,33 @@ namespace ParaEngine
 			@param dataGridPtr Pointer to the data grid to use for iso surface generation.
 			@param flags Flags describing what data is generated for rendering the iso surface (see IsoSurface::SurfaceFlags). */
 		virtual void initialize(DataGrid* dg, int flags);
-		/// Rebuilds the iso surface, and updates the IsoSurfaceRenderable.
+		/** Rebuilds the iso surface, and updates the IsoSurfaceRenderable.
+			@remarks
+				Only grid cells touching the dirty region of the data grid (see DataGrid::markDirty()) are polygonised again,
+				so the cost of a small edit scales with the edited region instead of the whole grid. Slabs of cells along
+				the z axis are polygonised in parallel. The function does nothing if the data grid is not dirty. */
 		void update(IsoSurfaceRenderable * isr);
 		/// Returns the pointer to the data grid.
 		DataGrid* getDataGrid() {return mDataGrid.get(); }
 		/// Returns the iso value of the surface.
 		float getIsoValue() const {return mIsoValue; }
 		/// Sets the iso value of the surface.
-		void setIsoValue(float isoValue) {mIsoValue = isoValue; }
+		void setIsoValue(float isoValue) {mIsoValue = isoValue; invalidateAll(); }
 		/// Returns whether normals are flipped.
 		bool getFlipNormals() const {return mFlipNormals; }
 		/** Sets whether to flip normals.
 			@remarks
 				When flip normals is false (the default), the outside of the surface is where the values of the data
 				grid are lower than the iso value. */
-		void setFlipNormals(bool flipNormals) {mFlipNormals = flipNormals; }
+		void setFlipNormals(bool flipNormals) {mFlipNormals = flipNormals; invalidateAll(); }
 		/// Gets the method used for normal generation.
 		NormalType getNormalType() const {return mNormalType; }
 		/// Sets the method used for normal generation.
-		void setNormalType(NormalType normalType) {mNormalType = normalType; }
+		void setNormalType(NormalType normalType) {mNormalType = normalType; invalidateAll(); }
+		/// Returns the max number of threads used to polygonise the grid.
+		int getMaxThreads() const {return mMaxThreads; }
+		/// Sets the max number of threads used to polygonise the grid. 1 to polygonise in the calling thread only.
+		void setMaxThreads(int nThreads) {mMaxThreads = (nThreads > 1) ? nThreads : 1; }
 
 		/// The number of iso vertices, calculated on first call of getNumIsoVertices().
 		int mNumIsoVertices;	
@@ -72,8 +80,15 @@ namespace ParaEngine
 		virtual int getNumIsoVertices();
 		/// Creates and initializes the iso vertex index arrays of all grid cells.
 		virtual void createGridCellIsoVertices();
-		/// Builds the iso surface by looping through all grid cells generating triangles.
+		/** Builds the iso surface by looping through all grid cells generating triangles.
+			@remarks
+				Triangles are generated from the cached case index of each cell, so the grid cells must be polygonised first. */
 		virtual void buildIsoSurface();
+		/** Polygonises all grid cells touching a range of grid points.
+			@remarks
+				The case index of the cells and the iso vertices on their edges are recomputed. Slabs of cells are
+				processed in parallel, since they write to disjoint cells and iso vertices. */
+		void polygoniseRegion(int x0, int y0, int z0, int x1, int y1, int z1);
 
 	protected:
 
@@ -145,6 +160,12 @@ namespace ParaEngine
 		Vector2* mIsoVertexTexCoords;
 		/// Array of grid cells.
 		GridCell* mGridCells;
+		/** Marching cubes case index of all grid cells, i.e. flags of the corners inside the iso surface.
+			@remarks
+				It is only recomputed for cells in the dirty region of the data grid. */
+		unsigned char* mCellCases;
+		/// The max number of threads used to polygonise the grid.
+		int mMaxThreads;
 		/** Vector to which the indices of all used iso vertices are added.
 			@remarks
 				The iso vertex indices in this vector are iterated when filling the hardware vertex buffer. */
@@ -174,18 +195,24 @@ namespace ParaEngine
 		void createGridCells();
 		/// Destroys the grid cells, including their iso vertex index arrays.
 		void destroyGridCells();
+		/// Marks the whole data grid as dirty, so that the iso surface is fully rebuilt in the next update.
+		void invalidateAll();
+		/** Polygonises the cells [x0, x1]*[y0, y1] of the slab k.
+			@remarks
+				It computes the case index of the cells, and the iso vertices on all edges starting at plane k.
+				Iso vertices on plane k+1 are only computed if bTopPlane is true, otherwise they belong to the slab k+1. */
+		void polygoniseSlab(int k, int x0, int y0, int x1, int y1, bool bTopPlane);
 		/** Calculates properties of the iso vertex.
 			@remarks
-				If the properties of the iso vertex has already been calculated, the function
-				returns immediately. Otherwise the iso vertex is initialized by calculating
-				the necessary properties. Then it is assigned the next index in the hardware
-				vertex buffer.
-			@param isoVertex Index of the iso vertex to use.
+				It is a pure function of the two data grid values, so the result does not depend on the order of the corners.
+			@param isoVertex Index of the iso vertex to calculate.
 			@param corner0 Index of the first data grid value associated with the iso vertex.
-			@param corner1 Index of the second data grid value associated with the iso vertex.
+			@param corner1 Index of the second data grid value associated with the iso vertex. */
+		void computeIsoVertex(int isoVertex, int corner0, int corner1);
+		/** Assigns the next index in the hardware vertex buffer to the iso vertex, if it is not used yet.
 			@returns
 				The index passed in the isoVertex parameter. */
-		int useIsoVertex(int isoVertex, int corner0, int corner1);
+		int useIsoVertex(int isoVertex);
 		/// ...
 		void addIsoTriangle(const IsoTriangle& isoTriangle);
 	};
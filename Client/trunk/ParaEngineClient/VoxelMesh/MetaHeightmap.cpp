@@ -34,14 +34,17 @@ void MetaHeightmap::updateDataGrid(DataGrid* dataGrid)
 	}
 	Vector3 gridMin = dataGrid->getBoundingBox().GetMin();
 	Vector3 gridCenter = dataGrid->getPosition();
-	for (int z = 0; z <= dataGrid->getNumCellsZ(); ++z)
+	// only write to the grid points being rebuilt, see DataGrid::clearRegion()
+	int x0, y0, z0, x1, y1, z1;
+	dataGrid->getClipRegion(x0, y0, z0, x1, y1, z1);
+	for (int z = z0; z <= z1; ++z)
 	{
-		for (int x = 0; x <= dataGrid->getNumCellsX(); ++x)
+		for (int x = x0; x <= x1; ++x)
 		{
 				
 			Vector3 v = vertices[dataGrid->getGridIndex(x, dataGrid->getNumCellsY(), z)] + gridCenter;
 			float h = mTerrainTile.getHeightAt(v.x, v.z);
-			for (int y = 0; y <= dataGrid->getNumCellsY(); ++y)
+			for (int y = y0; y <= y1; ++y)
 			{
 				int index = dataGrid->getGridIndex(x, y, z);
 				Vector3 v2 = vertices[index]+gridCenter;
@@ -27,7 +27,7 @@ std::string MetaWorldFragment::mMaterialName = "";
 
 
 MetaWorldFragment::MetaWorldFragment(const Vector3 &position, int ylevel)
-: 	mSurf(NULL), mPosition(position), mYLevel(ylevel),m_bNeedUpdate(false)
+: 	mSurf(NULL), mPosition(position), mYLevel(ylevel),m_bNeedUpdate(false), m_bRebuildAll(true), m_bHasDirtyRegion(false)
 {
 }
 
@@ -43,7 +43,36 @@ void MetaWorldFragment::addMetaObject(MetaObjectPtr mo)
 	if(mo->getMetaWorldFragment() != this && mo->getMetaWorldFragment() != 0)
 		addToWfList(mo->getMetaWorldFragment());
 	mObjs.push_back(mo);
-	SetNeedUpdate(true);
+	invalidateRegion(mo->getAABB());
+}
+
+bool MetaWorldFragment::removeMetaObject(MetaObject* mo)
+{
+	for(std::vector<MetaObjectPtr>::iterator it = mObjs.begin(); it != mObjs.end(); ++it)
+	{
+		if((*it).get() == mo)
+		{
+			invalidateRegion(mo->getAABB());
+			mObjs.erase(it);
+			return true;
+		}
+	}
+	return false;
+}
+
+void MetaWorldFragment::invalidateRegion(const CShapeAABB& aabb)
+{
+	if(m_bHasDirtyRegion)
+	{
+		m_dirtyRegion.Extend(aabb.GetMin());
+		m_dirtyRegion.Extend(aabb.GetMax());
+	}
+	else
+	{
+		m_dirtyRegion = aabb;
+		m_bHasDirtyRegion = true;
+	}
+	m_bNeedUpdate = true;
 }
 
 ///Updates IsoSurface
@@ -58,14 +87,40 @@ void MetaWorldFragment::update(IsoSurfaceBuilder *builder)
 	{
 		mSurf = new IsoSurfaceRenderable();
 		mSurf->initialize(builder);
+		m_bRebuildAll = true;
 	}
-	/// Zero data grid, then add the fields of objects to it.
 	DataGrid * dg = builder->getDataGrid();
-	dg->clear();
-	for(std::vector<MetaObjectPtr>::iterator it = mObjs.begin(); it != mObjs.end(); ++it)
+	if(m_bRebuildAll || dg->getHostObject() != this)
+	{
+		/// Zero data grid, then add the fields of objects to it.
+		dg->clear();
+		for(std::vector<MetaObjectPtr>::iterator it = mObjs.begin(); it != mObjs.end(); ++it)
+		{
+			(*it)->updateDataGrid(dg);
+		}
+	}
+	else if(m_bHasDirtyRegion && dg->clearRegion(m_dirtyRegion))
 	{
-		(*it)->updateDataGrid(dg);
+		/// the grid still contains our data, so only zero the modified region and add the fields of objects overlapping it.
+		Vector3 vMin = m_dirtyRegion.GetMin();
+		Vector3 vMax = m_dirtyRegion.GetMax();
+		for(std::vector<MetaObjectPtr>::iterator it = mObjs.begin(); it != mObjs.end(); ++it)
+		{
+			CShapeAABB aabb = (*it)->getAABB();
+			if(aabb.GetMin().x <= vMax.x && aabb.GetMax().x >= vMin.x &&
+				aabb.GetMin().y <= vMax.y && aabb.GetMax().y >= vMin.y &&
+				aabb.GetMin().z <= vMax.z && aabb.GetMax().z >= vMin.z)
+			{
+				(*it)->updateDataGrid(dg);
+			}
+		}
+		dg->resetClipRegion();
 	}
+	dg->setHostObject(this);
+	m_bRebuildAll = false;
+	m_bHasDirtyRegion = false;
+
+	// only cells in the dirty region of the grid are polygonised again.
 	builder->update(mSurf);
 	mAabb = dg->getBoundingBox();
 }
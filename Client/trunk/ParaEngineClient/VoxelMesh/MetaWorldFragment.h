@@ -28,6 +28,12 @@ namespace ParaEngine
 
 		///Adds MetaObject to mObjs, and to mMoDataGrid
 		void addMetaObject(MetaObjectPtr mo);
+		///Removes MetaObject from mObjs. return false if it is not found.
+		bool removeMetaObject(MetaObject* mo);
+		/** Marks a region as modified, so that only the iso surface inside it is rebuilt in the next update.
+		* When a meta object is moved or resized, call this function with both its old and new bounding box.
+		*/
+		void invalidateRegion(const CShapeAABB& aabb);
 		///Updates IsoSurface
 		void update(IsoSurfaceBuilder *builder);
 		int getNumMetaObjects() {return (int)mObjs.size();} const
@@ -50,7 +56,8 @@ namespace ParaEngine
 		*/
 		bool IsNeedUpdate(){ return m_bNeedUpdate; }
 
-		void SetNeedUpdate(bool bNeedUpdate = true){ m_bNeedUpdate = bNeedUpdate; }
+		/** the whole iso surface will be rebuilt in the next update. use invalidateRegion() if only a small region is modified. */
+		void SetNeedUpdate(bool bNeedUpdate = true){ m_bNeedUpdate = bNeedUpdate; m_bRebuildAll = m_bRebuildAll || bNeedUpdate; }
 	protected:
 		void addToWfList(MetaWorldFragment* wf);
 
@@ -74,6 +81,11 @@ namespace ParaEngine
 
 		/** whether the grid is modified and needs update in the next draw call. */
 		bool m_bNeedUpdate;
+		/** whether the whole grid needs to be rebuilt in the next update. otherwise only m_dirtyRegion is rebuilt. */
+		bool m_bRebuildAll;
+		/** union of all regions modified since the last update. only valid if m_bHasDirtyRegion is true. */
+		CShapeAABB m_dirtyRegion;
+		bool m_bHasDirtyRegion;
 
 		// TODO: use TextureEntity share ptr here. 
 		static std::string mMaterialName;
@@ -0,0 +1,390 @@
+//-----------------------------------------------------------------------------
+// Class:	CAsyncDBExecutor
+// Desc: per database worker threads that execute sql queries from NPL runtime states and post results back as activations.
+//-----------------------------------------------------------------------------
+#include "ParaEngine.h"
+#include <sqlite3.h>
+#include "NPLHelper.h"
+#include "NPLRuntime.h"
+#include "SQLStatementCache.h"
+#include "ICDBManager.h"
+#include "AsyncDBExecutor.h"
+
+using namespace ParaInfoCenter;
+
+/** how long a connection waits for a lock held by another connection before returning SQLITE_BUSY. */
+#define ASYNC_DB_BUSY_TIMEOUT	5000
+
+//////////////////////////////////////////////////////////////////////////
+//
+// AsyncDBQuery and CAsyncDBQueryQueue
+//
+//////////////////////////////////////////////////////////////////////////
+
+void AsyncDBQuery::SetScriptCallback(const char* sCallback)
+{
+	m_sNPLStateName.clear();
+	m_sNPLCallback.clear();
+	if (sCallback == NULL)
+		return;
+	if (sCallback[0] == '(')
+	{
+		int i = 1;
+		while ((sCallback[i] != ')') && (sCallback[i] != '\0'))
+		{
+			i++;
+		}
+		i++;
+		if (sCallback[i - 1] != '\0')
+		{
+			m_sNPLCallback = sCallback + i;
+		}
+		if (i > 2 && !(i == 4 && (sCallback[1] == 'g') && (sCallback[2] == 'l')))
+			m_sNPLStateName.assign(sCallback + 1, i - 2);
+	}
+	else
+	{
+		m_sNPLCallback = sCallback;
+	}
+}
+
+void CAsyncDBQueryQueue::Push(const AsyncDBQuery_ptr& query)
+{
+	{
+		std::lock_guard<std::mutex> lock_(m_mutex);
+		m_queries.push_back(query);
+	}
+	m_signal.notify_one();
+}
+
+bool CAsyncDBQueryQueue::Pop(AsyncDBQuery_ptr& query)
+{
+	std::unique_lock<std::mutex> lock_(m_mutex);
+	while (m_queries.empty())
+	{
+		if (m_bStop)
+			return false;
+		m_signal.wait(lock_);
+	}
+	query = m_queries.front();
+	m_queries.pop_front();
+	return true;
+}
+
+void CAsyncDBQueryQueue::Stop()
+{
+	{
+		std::lock_guard<std::mutex> lock_(m_mutex);
+		m_bStop = true;
+	}
+	m_signal.notify_all();
+}
+
+int CAsyncDBQueryQueue::GetSize()
+{
+	std::lock_guard<std::mutex> lock_(m_mutex);
+	return (int)m_queries.size();
+}
+
+//////////////////////////////////////////////////////////////////////////
+//
+// CAsyncDBExecutor
+//
+//////////////////////////////////////////////////////////////////////////
+
+CAsyncDBExecutor::CAsyncDBExecutor(const std::string& sFileName, int nReaderCount)
+	:m_sFileName(sFileName), m_nOpenFlags(SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE), m_nReaderCount((std::max)(nReaderCount, 0)), m_bWriterReady(false), m_nExecutedCount(0)
+{
+	// resolve the file in the calling thread before any worker starts, the same way as the synchronous db API. 
+	m_sDiskFileName = DBEntity::ResolveDatabaseFile(m_sFileName, &m_nOpenFlags);
+	m_readers.reserve(m_nReaderCount);
+	m_writer = std::thread(std::bind(&CAsyncDBExecutor::ThreadProc, this, &m_writeQueue, false));
+	for (int i = 0; i < m_nReaderCount; ++i)
+	{
+		m_readers.push_back(std::thread(std::bind(&CAsyncDBExecutor::ThreadProc, this, &m_readQueue, true)));
+	}
+}
+
+CAsyncDBExecutor::~CAsyncDBExecutor()
+{
+	Close();
+}
+
+void CAsyncDBExecutor::Execute(const AsyncDBQuery_ptr& query)
+{
+	if (query->m_bReadOnly && m_nReaderCount > 0)
+		m_readQueue.Push(query);
+	else
+		m_writeQueue.Push(query);
+}
+
+void CAsyncDBExecutor::Close()
+{
+	m_writeQueue.Stop();
+	m_readQueue.Stop();
+	if (m_writer.joinable())
+		m_writer.join();
+	for (auto& reader : m_readers)
+	{
+		if (reader.joinable())
+			reader.join();
+	}
+}
+
+int CAsyncDBExecutor::GetPendingCount()
+{
+	return m_writeQueue.GetSize() + m_readQueue.GetSize();
+}
+
+sqlite3* CAsyncDBExecutor::OpenConnection(bool bReadOnly)
+{
+	sqlite3* db = NULL;
+	// each connection is only used by its own worker thread.
+	int nFlags = (bReadOnly ? SQLITE_OPEN_READONLY : m_nOpenFlags) | SQLITE_OPEN_NOMUTEX;
+	if (sqlite3_open_v2(m_sDiskFileName.c_str(), &db, nFlags, NULL) != SQLITE_OK)
+	{
+		OUTPUT_LOG("warning: async db executor can not open %s (%s): %s\n", m_sFileName.c_str(), m_sDiskFileName.c_str(), db ? sqlite3_errmsg(db) : "");
+		if (db)
+			sqlite3_close(db);
+		return NULL;
+	}
+	sqlite3_busy_timeout(db, ASYNC_DB_BUSY_TIMEOUT);
+	if (!bReadOnly && m_nReaderCount > 0 && (m_nOpenFlags & SQLITE_OPEN_READWRITE))
+	{
+		// so that readers and the writer do not block each other.
+		sqlite3_exec(db, "PRAGMA journal_mode=WAL;", NULL, NULL, NULL);
+	}
+	return db;
+}
+
+void CAsyncDBExecutor::ThreadProc(CAsyncDBQueryQueue* pQueue, bool bReadOnly)
+{
+	sqlite3* db = NULL;
+	if (bReadOnly)
+	{
+		std::unique_lock<std::mutex> lock_(m_ready_mutex);
+		while (!m_bWriterReady)
+			m_ready_signal.wait(lock_);
+		db = OpenConnection(true);
+	}
+	else
+	{
+		db = OpenConnection(false);
+		{
+			std::lock_guard<std::mutex> lock_(m_ready_mutex);
+			m_bWriterReady = true;
+		}
+		m_ready_signal.notify_all();
+	}
+
+	CSQLStatementCache stmtCache;
+	stmtCache.SetDB(db);
+
+	AsyncDBQuery_ptr query;
+	while (pQueue->Pop(query))
+	{
+		ExecuteQuery(db, stmtCache, *query);
+		query.reset();
+		++m_nExecutedCount;
+	}
+	stmtCache.Clear();
+	if (db)
+		sqlite3_close(db);
+}
+
+/** write a value that has no precision loss for 64 bits integers, such as rowid. */
+static void WriteInt64Value(NPL::CNPLWriter& writer, sqlite3_int64 nValue)
+{
+	char tmp[32];
+	int nLen = snprintf(tmp, sizeof(tmp), "%lld", (long long)nValue);
+	writer.WriteValue(tmp, nLen, false);
+}
+
+static void WriteQueryId(NPL::CNPLWriter& writer, const AsyncDBValue& id)
+{
+	if (id.m_type == AsyncDBValue::Type_Number)
+	{
+		writer.WriteName("id");
+		writer.WriteValue(id.m_fValue);
+	}
+	else if (id.m_type == AsyncDBValue::Type_Text)
+	{
+		writer.WriteName("id");
+		writer.WriteValue(id.m_sValue);
+	}
+}
+
+static int BindAsyncDBValue(sqlite3_stmt* stmt, int nIndex, const AsyncDBValue& value)
+{
+	switch (value.m_type)
+	{
+	case AsyncDBValue::Type_Number:
+	{
+		sqlite3_int64 nValue = (sqlite3_int64)value.m_fValue;
+		if ((double)nValue == value.m_fValue)
+			return sqlite3_bind_int64(stmt, nIndex, nValue);
+		else
+			return sqlite3_bind_double(stmt, nIndex, value.m_fValue);
+	}
+	case AsyncDBValue::Type_Boolean:
+		return sqlite3_bind_int(stmt, nIndex, value.m_fValue != 0 ? 1 : 0);
+	case AsyncDBValue::Type_Text:
+		return sqlite3_bind_text(stmt, nIndex, value.m_sValue.c_str(), (int)value.m_sValue.size(), SQLITE_STATIC);
+	default:
+		return sqlite3_bind_null(stmt, nIndex);
+	}
+}
+
+void CAsyncDBExecutor::ExecuteQuery(sqlite3* db, CSQLStatementCache& stmtCache, AsyncDBQuery& query)
+{
+	NPL::CNPLWriter writer;
+	writer.WriteName("msg");
+	writer.BeginTable();
+	WriteQueryId(writer, query.m_id);
+
+	int nError = SQLITE_CANTOPEN;
+	std::string sErrorMsg = "can not open database";
+	if (db)
+	{
+		sqlite3_stmt* stmt = stmtCache.Acquire(query.m_sql.c_str(), (int)query.m_sql.size(), &nError);
+		if (stmt)
+		{
+			for (int i = 0; i < (int)query.m_params.size() && nError == SQLITE_OK; ++i)
+				nError = BindAsyncDBValue(stmt, i + 1, query.m_params[i]);
+
+			if (nError == SQLITE_OK)
+			{
+				int nColCount = sqlite3_column_count(stmt);
+				bool bHasRows = false;
+				while ((nError = sqlite3_step(stmt)) == SQLITE_ROW)
+				{
+					if (!bHasRows)
+					{
+						bHasRows = true;
+						writer.WriteName("rows");
+						writer.BeginTable();
+					}
+					writer.BeginTable();
+					for (int i = 0; i < nColCount; ++i)
+					{
+						int nType = sqlite3_column_type(stmt, i);
+						if (nType == SQLITE_NULL)
+							continue;
+						writer.WriteName(sqlite3_column_name(stmt, i), true);
+						if (nType == SQLITE_INTEGER)
+							WriteInt64Value(writer, sqlite3_column_int64(stmt, i));
+						else if (nType == SQLITE_FLOAT)
+							writer.WriteValue(sqlite3_column_double(stmt, i));
+						else
+						{
+							const char* pData = (const char*)sqlite3_column_blob(stmt, i);
+							writer.WriteValue(pData ? pData : "", sqlite3_column_bytes(stmt, i));
+						}
+					}
+					writer.EndTable();
+				}
+				if (bHasRows)
+					writer.EndTable();
+				if (nError == SQLITE_DONE)
+					nError = SQLITE_OK;
+			}
+			if (nError != SQLITE_OK)
+				sErrorMsg = sqlite3_errmsg(db);
+			if (nError == SQLITE_OK && !sqlite3_stmt_readonly(stmt))
+			{
+				writer.WriteName("changes");
+				writer.WriteValue((double)sqlite3_changes(db));
+				writer.WriteName("lastrowid");
+				WriteInt64Value(writer, sqlite3_last_insert_rowid(db));
+			}
+			stmtCache.Release(stmt);
+		}
+		else
+		{
+			if (nError == SQLITE_OK)
+				nError = SQLITE_MISUSE;
+			sErrorMsg = sqlite3_errmsg(db);
+		}
+	}
+	writer.WriteName("err");
+	writer.WriteValue((double)nError);
+	if (nError != SQLITE_OK)
+	{
+		writer.WriteName("errmsg");
+		writer.WriteValue(sErrorMsg);
+	}
+	writer.EndTable();
+	writer.WriteParamDelimiter();
+
+	if (query.m_sNPLCallback.empty())
+	{
+		if (nError != SQLITE_OK)
+			OUTPUT_LOG("warning: async sql failed %s: %s\n", query.m_sql.c_str(), sErrorMsg.c_str());
+		return;
+	}
+	writer.Append(query.m_sNPLCallback);
+
+	NPL::NPLRuntimeState_ptr pState = ParaEngine::CGlobals::GetNPLRuntime()->GetRuntimeState(query.m_sNPLStateName);
+	if (pState)
+	{
+		// thread safe
+		pState->activate(NULL, writer.ToString().c_str(), (int)writer.ToString().size());
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////
+//
+// CAsyncDBExecutorManager
+//
+//////////////////////////////////////////////////////////////////////////
+
+CAsyncDBExecutorManager& CAsyncDBExecutorManager::GetSingleton()
+{
+	static CAsyncDBExecutorManager g_singleton;
+	return g_singleton;
+}
+
+CAsyncDBExecutorManager::~CAsyncDBExecutorManager()
+{
+	Cleanup();
+}
+
+std::shared_ptr<CAsyncDBExecutor> CAsyncDBExecutorManager::GetExecutor(const std::string& sFileName, int nReaderCount, bool bCreateIfNotExist)
+{
+	std::lock_guard<std::mutex> lock_(m_mutex);
+	auto it = m_executors.find(sFileName);
+	if (it != m_executors.end())
+		return it->second;
+	if (!bCreateIfNotExist)
+		return std::shared_ptr<CAsyncDBExecutor>();
+	std::shared_ptr<CAsyncDBExecutor> pExecutor(new CAsyncDBExecutor(sFileName, (std::max)(nReaderCount, 0)));
+	m_executors[sFileName] = pExecutor;
+	return pExecutor;
+}
+
+bool CAsyncDBExecutorManager::CloseExecutor(const std::string& sFileName)
+{
+	std::shared_ptr<CAsyncDBExecutor> pExecutor;
+	{
+		std::lock_guard<std::mutex> lock_(m_mutex);
+		auto it = m_executors.find(sFileName);
+		if (it == m_executors.end())
+			return false;
+		pExecutor = it->second;
+		m_executors.erase(it);
+	}
+	// do not hold the lock while waiting for pending queries.
+	pExecutor->Close();
+	return true;
+}
+
+void CAsyncDBExecutorManager::Cleanup()
+{
+	std::map<std::string, std::shared_ptr<CAsyncDBExecutor> > executors;
+	{
+		std::lock_guard<std::mutex> lock_(m_mutex);
+		executors.swap(m_executors);
+	}
+	for (auto& item : executors)
+		item.second->Close();
+}
@@ -0,0 +1,166 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <deque>
+#include <map>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+
+struct sqlite3;
+
+namespace ParaInfoCenter
+{
+	/** a sql parameter or query id value passed from NPL to the async executor. */
+	struct AsyncDBValue
+	{
+		enum ValueType{
+			Type_Nil = 0,
+			Type_Number,
+			Type_Boolean,
+			Type_Text,
+		};
+		AsyncDBValue() :m_type(Type_Nil), m_fValue(0){};
+		explicit AsyncDBValue(double fValue) :m_type(Type_Number), m_fValue(fValue){};
+		explicit AsyncDBValue(bool bValue) :m_type(Type_Boolean), m_fValue(bValue ? 1 : 0){};
+		explicit AsyncDBValue(const std::string& sValue) :m_type(Type_Text), m_fValue(0), m_sValue(sValue){};
+
+		ValueType m_type;
+		double m_fValue;
+		std::string m_sValue;
+	};
+
+	/** one query to be executed by CAsyncDBExecutor. */
+	struct AsyncDBQuery
+	{
+		AsyncDBQuery() :m_bReadOnly(false){};
+
+		/** a single sql statement. trailing text after the first statement is ignored. */
+		std::string m_sql;
+		/** values bound to ?1, ?2, ... in order. */
+		std::vector<AsyncDBValue> m_params;
+		/** it is returned as msg.id, so that the caller can match results with queries. */
+		AsyncDBValue m_id;
+		/** the runtime state name that the callback is invoked in, empty for the main state. */
+		std::string m_sNPLStateName;
+		/** script code that is invoked with a global msg variable, such as "MyApp.OnQueryResult()". */
+		std::string m_sNPLCallback;
+		/** read only queries may be executed by the read connection pool. */
+		bool m_bReadOnly;
+
+		/** parse a callback string that may begin with (runtime_state_name), such as "(main)MyApp.OnQueryResult()".
+		* It uses the same convention as NPL.AppendURLRequest.
+		*/
+		void SetScriptCallback(const char* sCallback);
+	};
+	typedef std::shared_ptr<AsyncDBQuery> AsyncDBQuery_ptr;
+
+	/** a blocking FIFO of queries shared by one or more worker threads. */
+	class CAsyncDBQueryQueue
+	{
+	public:
+		CAsyncDBQueryQueue() :m_bStop(false){};
+
+		void Push(const AsyncDBQuery_ptr& query);
+		/** block until a query is available. return false if the queue is stopped and empty. */
+		bool Pop(AsyncDBQuery_ptr& query);
+		/** wake up all waiting threads. pending queries are still executed before Pop() returns false. */
+		void Stop();
+		int GetSize();
+
+	protected:
+		std::deque<AsyncDBQuery_ptr> m_queries;
+		std::mutex m_mutex;
+		std::condition_variable m_signal;
+		bool m_bStop;
+	};
+
+	/**
+	* a per database executor that runs sql queries from NPL runtime states in dedicated worker threads, so that
+	* slow queries never block the calling state's frame loop or message processing.
+	*
+	* - The writer thread owns a read/write connection, all queries that are not marked as read only are executed in it
+	*   one after another in the order they are queued. Hence "BEGIN", "INSERT..", "COMMIT" sent from the same state work as expected.
+	* - An optional pool of reader threads, each with its own read only connection, executes read only queries concurrently.
+	*   When the pool is used, the database is switched to WAL journal mode so that readers do not block the writer.
+	*   Read only queries are not ordered with respect to writes, use the writer (the default) if read-your-writes is needed.
+	* - Each worker thread reuses prepared statements with its own CSQLStatementCache.
+	* - Results are posted back as an NPL activation in the callback's runtime state with a global variable
+	*   msg = {id, err, errmsg, rows={{colname=value, ...}, ...}, changes, lastrowid}, where err is the sqlite error code(0 is ok).
+	*/
+	class CAsyncDBExecutor
+	{
+	public:
+		/**
+		* @param sFileName: the database file name, which is resolved to a disk file the same way as DBEntity.
+		* @param nReaderCount: number of read only connections. 0 to execute everything in the writer thread.
+		*/
+		CAsyncDBExecutor(const std::string& sFileName, int nReaderCount = 0);
+		~CAsyncDBExecutor();
+
+		/** [thread safe] queue a query. it is executed in one of the worker threads. */
+		void Execute(const AsyncDBQuery_ptr& query);
+
+		/** block until all queued queries are executed and close all connections. */
+		void Close();
+
+		const std::string& GetFileName() const { return m_sFileName; }
+		int GetReaderCount() const { return m_nReaderCount; }
+
+		/** number of queries that are queued but not yet started. */
+		int GetPendingCount();
+		/** total number of executed queries. */
+		int64_t GetExecutedCount() const { return m_nExecutedCount; }
+
+	protected:
+		/** worker thread procedure. if bReadOnly, it opens a read only connection and serves the read queue. */
+		void ThreadProc(CAsyncDBQueryQueue* pQueue, bool bReadOnly);
+		/** execute the query and post the result back to its runtime state. */
+		void ExecuteQuery(sqlite3* db, class CSQLStatementCache& stmtCache, AsyncDBQuery& query);
+		/** open a connection for the worker thread. */
+		sqlite3* OpenConnection(bool bReadOnly);
+
+	protected:
+		std::string m_sFileName;
+		/** the resolved disk file and its sqlite3_open_v2() flags, see DBEntity::ResolveDatabaseFile(). */
+		std::string m_sDiskFileName;
+		int m_nOpenFlags;
+		/** set before any worker thread starts, so that workers never read m_readers while it is being filled. */
+		const int m_nReaderCount;
+		CAsyncDBQueryQueue m_writeQueue;
+		CAsyncDBQueryQueue m_readQueue;
+		std::thread m_writer;
+		std::vector<std::thread> m_readers;
+		/** readers wait until the writer has set up the journal mode, so that they never see a half created database. */
+		std::mutex m_ready_mutex;
+		std::condition_variable m_ready_signal;
+		bool m_bWriterReady;
+		std::atomic<int64_t> m_nExecutedCount;
+	};
+
+	/** all async executors keyed by database file name. [thread safe] */
+	class CAsyncDBExecutorManager
+	{
+	public:
+		static CAsyncDBExecutorManager& GetSingleton();
+		~CAsyncDBExecutorManager();
+
+		/** get the executor of the given database file.
+		* @param nReaderCount: only used when a new executor is created.
+		* @param bCreateIfNotExist: create the executor if it does not exist.
+		*/
+		std::shared_ptr<CAsyncDBExecutor> GetExecutor(const std::string& sFileName, int nReaderCount = 0, bool bCreateIfNotExist = true);
+
+		/** block until all queued queries are executed and remove the executor. return false if not found. */
+		bool CloseExecutor(const std::string& sFileName);
+
+		/** close all executors. */
+		void Cleanup();
+
+	protected:
+		std::map<std::string, std::shared_ptr<CAsyncDBExecutor> > m_executors;
+		std::mutex m_mutex;
+	};
+}
@@ -25,6 +25,7 @@
 #include "FileManager.h"
 #include "AsyncLoader.h"
 #include "util/StringHelper.h"
+#include "util/ParaTime.h"
 
 using namespace ParaInfoCenter;
 
@@ -386,6 +387,25 @@ string DBEntity::PrepareDatabaseFile(const string& filename)
 	}
 #endif
 }
+string DBEntity::ResolveDatabaseFile(const string& filename, int* pOpenFlags)
+{
+	DBEntity entity;
+	string diskfileName = entity.PrepareDatabaseFile(filename);
+	if (diskfileName == "")
+	{
+		// the same as OpenDB(), the database file will be created. 
+#ifdef PARAENGINE_MOBILE
+		diskfileName = ParaEngine::CParaFile::GetWritablePath() + filename;
+#else
+		diskfileName = filename;
+#endif
+		ParaEngine::CParaFile::CreateDirectory(diskfileName.c_str());
+	}
+	if (pOpenFlags)
+		*pOpenFlags = entity.m_nSQLite_OpenFlags;
+	return ParaEngine::StringHelper::AnsiToUTF8(diskfileName.c_str());
+}
+
 void DBEntity::OpenDB(const char* dbname)
 {
 	if (dbname==NULL) {
@@ -502,6 +522,8 @@ void DBEntity::CloseDB()
 				return;
 			}
 #endif
+			// cached statements must be finalized before closing
+			m_stmtCache.Clear();
 			if (SQLITE_BUSY==sqlite3_close(m_db)) {
 				OUTPUT_LOG("warning: Can't close database %s because it is busy. \r\nThis is usually caused by unclosed database object in the scripts.\r\n", m_filepath.c_str());
 			}else{
@@ -696,6 +718,100 @@ int DBEntity::sql_finalize()
 	return errcode;
 }
 
+sqlite3_stmt* DBEntity::GetCachedStatement(const char* sql, int nSQLSize, int* pErrorCode)
+{
+	ParaEngine::Lock lock_(m_mutex);
+	if (!m_isValid || m_db == NULL)
+	{
+		if (pErrorCode)
+			*pErrorCode = SQLITE_ERROR;
+		return NULL;
+	}
+	m_stmtCache.SetDB(m_db);
+	return m_stmtCache.Acquire(sql, nSQLSize, pErrorCode);
+}
+
+int DBEntity::ReleaseCachedStatement(sqlite3_stmt* stmt)
+{
+	ParaEngine::Lock lock_(m_mutex);
+	return m_stmtCache.Release(stmt);
+}
+
+void DBEntity::GetStatementCacheStats(int* pHitCount, int* pMissCount, int* pSize)
+{
+	ParaEngine::Lock lock_(m_mutex);
+	if (pHitCount)
+		*pHitCount = m_stmtCache.GetHitCount();
+	if (pMissCount)
+		*pMissCount = m_stmtCache.GetMissCount();
+	if (pSize)
+		*pSize = m_stmtCache.GetSize();
+}
+
+void DBEntity::SetStatementCacheCapacity(int nCapacity)
+{
+	ParaEngine::Lock lock_(m_mutex);
+	m_stmtCache.SetCapacity(nCapacity);
+}
+
+int DBEntity::ExecuteBatch(const char* sql, int nRowCount, const BindRowCallback_t& bindRow, int* pRowsDone)
+{
+	ParaEngine::Lock lock_(m_mutex);
+	if (pRowsDone)
+		*pRowsDone = 0;
+	if (!m_isValid || m_db == NULL)
+		return SQLITE_ERROR;
+
+	int errcode = SQLITE_OK;
+	sqlite3_stmt* stmt = GetCachedStatement(sql, -1, &errcode);
+	if (stmt == NULL)
+	{
+		OUTPUT_LOG("warning: ExecuteBatch can not prepare sql: %s, because %s\n", sql, sqlite3_errmsg(m_db));
+		return (errcode != SQLITE_OK) ? errcode : SQLITE_ERROR;
+	}
+
+	// a savepoint starts a transaction in auto commit mode, and nests inside an outer transaction otherwise. 
+	errcode = sqlite3_exec(m_db, "SAVEPOINT exec_batch", NULL, NULL, NULL);
+	if (errcode != SQLITE_OK)
+	{
+		ReleaseCachedStatement(stmt);
+		return errcode;
+	}
+
+	int nRowsDone = 0;
+	for (int i = 0; i < nRowCount; ++i)
+	{
+		errcode = bindRow ? bindRow(stmt, i) : SQLITE_OK;
+		if (errcode != SQLITE_OK)
+			break;
+		errcode = sqlite3_step(stmt);
+		if (errcode == SQLITE_DONE || errcode == SQLITE_ROW)
+			errcode = SQLITE_OK;
+		else
+		{
+			OUTPUT_LOG("warning: ExecuteBatch failed at row %d: %s\n", i, sqlite3_errmsg(m_db));
+			break;
+		}
+		sqlite3_reset(stmt);
+		sqlite3_clear_bindings(stmt);
+		++nRowsDone;
+	}
+	ReleaseCachedStatement(stmt);
+
+	if (errcode == SQLITE_OK)
+		errcode = sqlite3_exec(m_db, "RELEASE exec_batch", NULL, NULL, NULL);
+	if (errcode != SQLITE_OK)
+	{
+		// rollback to the savepoint keeps it on the transaction stack, so it must be released afterwards. 
+		sqlite3_exec(m_db, "ROLLBACK TO exec_batch", NULL, NULL, NULL);
+		sqlite3_exec(m_db, "RELEASE exec_batch", NULL, NULL, NULL);
+		nRowsDone = 0;
+	}
+	if (pRowsDone)
+		*pRowsDone = nRowsDone;
+	return errcode;
+}
+
 
 void DBEntity::exec_sql()
 {
@@ -936,6 +1052,7 @@ CICRecordSet* DBEntity::CreateRecordSet()
 	m_RSpool[a].second=true;
 	m_RSpool[a].first->m_db=this->m_db;
 	m_RSpool[a].first->m_db=m_db;
+	m_RSpool[a].first->m_pDBEntity=this;
 	return	m_RSpool[oldsize].first;
 }
 
@@ -953,3 +1070,49 @@ void DBEntity::DeleteRecordSet(CICRecordSet* recordset)
 		}
 	}
 }
+
+#ifdef _DEBUG
+/** compare autocommit writes with re-prepared sql against batched writes with cached statements. */
+void Test_SQLiteBatch()
+{
+	using namespace ParaEngine;
+	const int nRowCount = 5000;
+	DBEntity* pDB = CDBManager::OpenDBEntity("temp/sqlite_batch_test.db");
+	if (pDB == 0 || !pDB->IsValid())
+		return;
+	pDB->ExecuteSqlScript("DROP TABLE IF EXISTS BatchTest; CREATE TABLE BatchTest (id INTEGER PRIMARY KEY, name TEXT, value REAL);");
+	sqlite3* db = pDB->GetDBHandle();
+	const char* sql = "INSERT INTO BatchTest (name, value) VALUES (?, ?)";
+
+	// one row per transaction, prepare each time
+	int64 nFromTime = GetTimeUS();
+	for (int i = 0; i < nRowCount; ++i)
+	{
+		sqlite3_stmt* stmt = NULL;
+		if (sqlite3_prepare_v2(db, sql, -1, &stmt, NULL) == SQLITE_OK)
+		{
+			sqlite3_bind_text(stmt, 1, "name", -1, SQLITE_STATIC);
+			sqlite3_bind_double(stmt, 2, (double)i);
+			sqlite3_step(stmt);
+		}
+		sqlite3_finalize(stmt);
+	}
+	int nTimeUS = (int)(GetTimeUS() - nFromTime);
+	OUTPUT_LOG("sqlite autocommit: %d rows in %d us, %.0f rows/sec\n", nRowCount, nTimeUS, nRowCount * 1000000.0 / (std::max)(nTimeUS, 1));
+
+	// batched in one transaction with a cached statement
+	pDB->GetStatementCache().ResetStats();
+	nFromTime = GetTimeUS();
+	const int nBatchSize = 500;
+	for (int nFrom = 0; nFrom < nRowCount; nFrom += nBatchSize)
+	{
+		pDB->ExecuteBatch(sql, nBatchSize, [nFrom](sqlite3_stmt* stmt, int nRow) {
+			sqlite3_bind_text(stmt, 1, "name", -1, SQLITE_STATIC);
+			return sqlite3_bind_double(stmt, 2, (double)(nFrom + nRow));
+		});
+	}
+	nTimeUS = (int)(GetTimeUS() - nFromTime);
+	OUTPUT_LOG("sqlite batched: %d rows in %d us, %.0f rows/sec, statement cache hit rate %.2f\n", nRowCount, nTimeUS, nRowCount * 1000000.0 / (std::max)(nTimeUS, 1), pDB->GetStatementCache().GetHitRate());
+	pDB->ExecuteSqlScript("DROP TABLE IF EXISTS BatchTest;");
+}
+#endif
@@ -1,7 +1,9 @@
 #pragma once
 #include "ParaDatabase.h"
+#include "SQLStatementCache.h"
 #include <map>
 #include <vector>
+#include <functional>
 #include <util/mutex.h>
 
 struct sqlite3_stmt;
@@ -108,6 +110,43 @@ namespace ParaInfoCenter
 		/** get the current statement*/
 		sqlite3_stmt* GetStatement(){return m_stmt;}
 
+		/** get a prepared statement from the per connection LRU statement cache. It is prepared only if not cached.
+		* the returned statement is reset and has no bindings. Call ReleaseCachedStatement() instead of sqlite3_finalize() when done. 
+		* @param sql: a single sql statement, usually with ? or :name parameters. 
+		* @param nSQLSize: size in bytes, or -1 if null terminated. 
+		* @param pErrorCode: if not NULL, it receives the sqlite error code. 
+		* @return NULL if failed. 
+		*/
+		PE_CORE_DECL sqlite3_stmt* GetCachedStatement(const char* sql, int nSQLSize = -1, int* pErrorCode = NULL);
+
+		/** return a statement acquired from GetCachedStatement() to the cache. 
+		* @return the error code of sqlite3_reset. */
+		PE_CORE_DECL int ReleaseCachedStatement(sqlite3_stmt* stmt);
+
+		/** the prepared statement cache of this connection. It is not locked, use GetStatementCacheStats() and SetStatementCacheCapacity() from other threads. */
+		CSQLStatementCache& GetStatementCache() { return m_stmtCache; }
+
+		/** get statistics of the statement cache under the lock of this connection. any output can be NULL. */
+		PE_CORE_DECL void GetStatementCacheStats(int* pHitCount, int* pMissCount, int* pSize);
+
+		/** set the max number of cached statements under the lock of this connection. */
+		PE_CORE_DECL void SetStatementCacheCapacity(int nCapacity);
+
+		/** callback to bind parameters of the nRowIndex-th row to the statement. return SQLITE_OK to execute the row. */
+		typedef std::function<int(sqlite3_stmt* stmt, int nRowIndex)> BindRowCallback_t;
+
+		/** execute the same parameterized write statement for a batch of rows in a single transaction. 
+		* the statement is taken from the statement cache. If any row fails, all rows of the batch are rolled back. 
+		* The batch is wrapped in a SAVEPOINT, so that if there is already a transaction in progress, only the rows of 
+		* this batch are rolled back on failure, and the outer transaction is left open for the caller to commit or roll back. 
+		* @param sql: a single parameterized sql statement, such as "INSERT INTO t VALUES(?,?)"
+		* @param nRowCount: number of rows
+		* @param bindRow: called to bind parameters for each row. 
+		* @param pRowsDone: if not NULL, it receives the number of rows successfully executed. 
+		* @return SQLITE_OK or the error code of the first failing row. 
+		*/
+		PE_CORE_DECL int ExecuteBatch(const char* sql, int nRowCount, const BindRowCallback_t& bindRow, int* pRowsDone = NULL);
+
 		/** ensure that the database is opened. */
 		PE_CORE_DECL void OpenDB();
 
@@ -160,6 +199,13 @@ namespace ParaInfoCenter
 		*/
 		PE_CORE_DECL void SetCreateFile(bool bCreateFile);
 
+		/** resolve the disk file of a database the same way as OpenDB() does, but do not open it. 
+		* connections that are not opened by DBEntity, such as the async db executor, use it so that the same name opens the same file.
+		* @param pOpenFlags: if not NULL, it receives the flags for sqlite3_open_v2(), which are read only for files extracted from archives. 
+		* @return the UTF8 disk file path or ":memory:". 
+		*/
+		PE_CORE_DECL static string ResolveDatabaseFile(const string& filename, int* pOpenFlags = NULL);
+
 	protected:
 		/* @obsolete the following exec_sql* function are not used. Maybe obsolete soon
 		* These functions do not guarantee the ' in text field are properly replaced by ''
@@ -233,6 +279,9 @@ namespace ParaInfoCenter
 		/** this makes all db query thread-safe */
 		ParaEngine::mutex	m_mutex;
 
+		/** prepared statements cache of this connection. */
+		CSQLStatementCache m_stmtCache;
+
 		/** reference count of the asset.
 		* Asset may be referenced by scene objects. 
 		* Once the reference count drops to 0, the asset may be unloaded, due to asset garbage collection.
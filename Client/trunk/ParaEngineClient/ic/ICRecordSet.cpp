@@ -320,6 +320,7 @@ CICRecordSet::CICRecordSet()
 {
 	m_empty=0;
 	m_columnNum=0;
+	m_pDBEntity=NULL;
 }
 /*
 CICRecordSet::CICRecordSet(sqlite3_stmt *stmt)
@@ -356,7 +357,11 @@ CICDBManager::DeleteRecordSet((CICRecordSet*)p);
 void CICRecordSet::Release()
 {
 	if (m_stmt) {
-		sqlite3_finalize(m_stmt);
+		// statements not owned by the cache are finalized by it. 
+		if (m_pDBEntity)
+			m_pDBEntity->ReleaseCachedStatement(m_stmt);
+		else
+			sqlite3_finalize(m_stmt);
 		m_stmt=NULL;
 	}
 	SAFE_DELETE(m_empty);
@@ -430,7 +435,12 @@ void CICRecordSet::Initialize(const char *sql)
 	const char *trail;
 	try
 	{
-		int errcode=sqlite3_prepare(m_db,sql,-1,&stmt,&trail);
+		int errcode=SQLITE_OK;
+		// record sets are usually created again and again with the same sql, so reuse the prepared statement. 
+		if (m_pDBEntity)
+			stmt=m_pDBEntity->GetCachedStatement(sql, -1, &errcode);
+		else
+			errcode=sqlite3_prepare(m_db,sql,-1,&stmt,&trail);
 		const char *errmsg;
 		if (SQLITE_OK!=errcode) {
 			errmsg=sqlite3_errmsg(m_db);
@@ -482,7 +492,8 @@ int CICRecordSet::NextRow()
 		}else if (errcode==SQLITE_DONE) {
 			m_eof=true;
 			errcode=CICRecordSet::SEOF;
-		}else if (SQLITE_ERROR==errcode) {
+		}else if (errcode!=SQLITE_BUSY && errcode!=SQLITE_MISUSE) {
+			// cached statements are prepared with sqlite3_prepare_v2(), which returns the error code instead of SQLITE_ERROR. 
 			errmsg=sqlite3_errmsg(m_db);
 			throw CICSQLException(errcode,errmsg);
 		}
@@ -121,6 +121,8 @@ namespace ParaInfoCenter
 		CICRecordSetItem* m_empty;
 		bool m_bUpdatable;
 		int m_columnNum;//number of columns in a row
+		/** the database that created this record set. UTF-8 sql is prepared from its statement cache. */
+		DBEntity* m_pDBEntity;
 
 	};
 }
\ No newline at end of file
@@ -51,7 +51,9 @@ int CSQLStatement::Execute()
 	try
 	{
 		errcode=sqlite3_step(m_stmt);
-		if (SQLITE_ERROR==errcode) {
+		// cached statements are prepared with sqlite3_prepare_v2(), which returns the error code instead of SQLITE_ERROR. 
+		if (errcode!=SQLITE_ROW && errcode!=SQLITE_DONE && errcode!=SQLITE_BUSY && errcode!=SQLITE_MISUSE) {
+			errcode=SQLITE_ERROR;
 			errmsg=sqlite3_errmsg(m_db);
 			throw CICSQLException(errcode,errmsg);
 		}
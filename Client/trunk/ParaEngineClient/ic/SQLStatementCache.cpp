@@ -0,0 +1,143 @@
+//-----------------------------------------------------------------------------
+// Class:	CSQLStatementCache
+// Desc: per connection LRU cache of prepared statements keyed by sql text.
+//-----------------------------------------------------------------------------
+#include "ParaEngine.h"
+#include <sqlite3.h>
+#include "SQLStatementCache.h"
+
+using namespace ParaInfoCenter;
+
+CSQLStatementCache::CSQLStatementCache(int nCapacity)
+	:m_db(NULL), m_nCapacity(nCapacity), m_nHitCount(0), m_nMissCount(0)
+{
+}
+
+CSQLStatementCache::~CSQLStatementCache()
+{
+	Clear();
+}
+
+void CSQLStatementCache::SetDB(sqlite3* db)
+{
+	if (m_db != db)
+	{
+		Clear();
+		m_db = db;
+	}
+}
+
+sqlite3_stmt* CSQLStatementCache::Acquire(const char* sql, int nSize, int* pErrorCode)
+{
+	if (pErrorCode)
+		*pErrorCode = SQLITE_OK;
+	if (m_db == NULL || sql == NULL)
+	{
+		if (pErrorCode)
+			*pErrorCode = SQLITE_MISUSE;
+		return NULL;
+	}
+	std::string sSQL = (nSize < 0) ? std::string(sql) : std::string(sql, nSize);
+
+	auto it = m_sql_map.find(sSQL);
+	if (it != m_sql_map.end())
+	{
+		StatementList_t::iterator itStmt = it->second;
+		if (!itStmt->bInUse)
+		{
+			++m_nHitCount;
+			itStmt->bInUse = true;
+			// move to front
+			m_lru.splice(m_lru.begin(), m_lru, itStmt);
+			return itStmt->stmt;
+		}
+	}
+	++m_nMissCount;
+
+	sqlite3_stmt* stmt = NULL;
+	int nError = sqlite3_prepare_v2(m_db, sSQL.c_str(), (int)sSQL.size(), &stmt, NULL);
+	if (pErrorCode)
+		*pErrorCode = nError;
+	if (nError != SQLITE_OK || stmt == NULL)
+	{
+		if (stmt)
+			sqlite3_finalize(stmt);
+		return NULL;
+	}
+	// if the cached one is in use, return an uncached statement that is finalized on release.
+	if (it != m_sql_map.end() || m_nCapacity <= 0)
+		return stmt;
+
+	m_lru.push_front(CachedStatement(sSQL, stmt));
+	m_sql_map[sSQL] = m_lru.begin();
+	m_stmt_map[stmt] = m_lru.begin();
+	Evict();
+	return stmt;
+}
+
+int CSQLStatementCache::Release(sqlite3_stmt* stmt)
+{
+	if (stmt == NULL)
+		return SQLITE_OK;
+	auto it = m_stmt_map.find(stmt);
+	if (it != m_stmt_map.end())
+	{
+		int nError = sqlite3_reset(stmt);
+		sqlite3_clear_bindings(stmt);
+		it->second->bInUse = false;
+		Evict();
+		return nError;
+	}
+	else
+	{
+		return sqlite3_finalize(stmt);
+	}
+}
+
+void CSQLStatementCache::Evict()
+{
+	if ((int)m_lru.size() <= m_nCapacity)
+		return;
+	for (auto it = m_lru.end(); it != m_lru.begin() && (int)m_lru.size() > m_nCapacity;)
+	{
+		--it;
+		if (!it->bInUse)
+		{
+			m_sql_map.erase(it->sql);
+			m_stmt_map.erase(it->stmt);
+			sqlite3_finalize(it->stmt);
+			it = m_lru.erase(it);
+		}
+	}
+}
+
+void CSQLStatementCache::Clear()
+{
+	for (auto it = m_lru.begin(); it != m_lru.end(); ++it)
+	{
+		// statements in use are no longer tracked, so that Release() will finalize them. 
+		if (!it->bInUse)
+			sqlite3_finalize(it->stmt);
+	}
+	m_lru.clear();
+	m_sql_map.clear();
+	m_stmt_map.clear();
+}
+
+void CSQLStatementCache::SetCapacity(int nCapacity)
+{
+	m_nCapacity = nCapacity;
+	Evict();
+}
+
+float CSQLStatementCache::GetHitRate() const
+{
+	int nTotal = m_nHitCount + m_nMissCount;
+	return (nTotal > 0) ? ((float)m_nHitCount / nTotal) : 0.f;
+}
+
+void CSQLStatementCache::ResetStats()
+{
+	m_nHitCount = 0;
+	m_nMissCount = 0;
+}
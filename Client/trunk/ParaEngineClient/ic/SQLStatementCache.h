@@ -0,0 +1,82 @@
+#pragma once
+#include <string>
+#include <list>
+#include <map>
+#include <unordered_map>
+
+struct sqlite3_stmt;
+struct sqlite3;
+
+namespace ParaInfoCenter
+{
+	/**
+	* a per connection LRU cache of prepared sql statements keyed by sql text.
+	* Acquire() returns a statement that is reset and has no bindings. Call Release() when done, instead of sqlite3_finalize().
+	* If the same sql is acquired again before it is released (such as nested queries), an uncached statement is prepared,
+	* which will be finalized when it is released.
+	* Statements are prepared with sqlite3_prepare_v2(), so that they are automatically re-prepared on schema changes.
+	* @note: this class is not thread safe, DBEntity guards it with its own mutex.
+	*/
+	class CSQLStatementCache
+	{
+	public:
+		CSQLStatementCache(int nCapacity = 64);
+		~CSQLStatementCache();
+
+		/** set the database connection. all cached statements of the previous connection are finalized. */
+		void SetDB(sqlite3* db);
+
+		/** get a ready to use statement for the given sql.
+		* @param sql: one sql statement. trailing sql text after the first statement is ignored.
+		* @param nSize: size of sql in bytes, -1 if null terminated.
+		* @param pErrorCode: if not NULL, it receives the sqlite error code.
+		* @return NULL if sql can not be prepared.
+		*/
+		sqlite3_stmt* Acquire(const char* sql, int nSize = -1, int* pErrorCode = NULL);
+
+		/** return a statement acquired by Acquire(). It is reset and bindings are cleared.
+		* if the statement is not owned by the cache, it is finalized.
+		* @return the error code of sqlite3_reset, which is the error of the last step if any.
+		*/
+		int Release(sqlite3_stmt* stmt);
+
+		/** finalize all cached statements. Statements that are in use are finalized when released. */
+		void Clear();
+
+		/** max number of cached statements. */
+		void SetCapacity(int nCapacity);
+		int GetCapacity() const { return m_nCapacity; }
+
+		/** number of cached statements. */
+		int GetSize() const { return (int)m_lru.size(); }
+
+		int GetHitCount() const { return m_nHitCount; }
+		int GetMissCount() const { return m_nMissCount; }
+		/** hit count / (hit count + miss count) */
+		float GetHitRate() const;
+		void ResetStats();
+
+	protected:
+		struct CachedStatement
+		{
+			CachedStatement(const std::string& sql_, sqlite3_stmt* stmt_) :sql(sql_), stmt(stmt_), bInUse(true){};
+			std::string sql;
+			sqlite3_stmt* stmt;
+			bool bInUse;
+		};
+		typedef std::list<CachedStatement> StatementList_t;
+
+		/** remove least recently used statements that are not in use until we are under capacity. */
+		void Evict();
+
+	protected:
+		sqlite3* m_db;
+		int m_nCapacity;
+		/** most recently used at the front. */
+		StatementList_t m_lru;
+		std::unordered_map<std::string, StatementList_t::iterator> m_sql_map;
+		std::map<sqlite3_stmt*, StatementList_t::iterator> m_stmt_map;
+		int m_nHitCount;
+		int m_nMissCount;
+	};
+}
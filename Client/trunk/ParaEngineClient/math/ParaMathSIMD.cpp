@@ -0,0 +1,639 @@
+//-----------------------------------------------------------------------------
+// Class:	ParaMathSIMD
+// Company: ParaEngine
+// Desc: batch transforms and frustum tests with AVX2, SSE2 or NEON.
+// Each kernel is written once against a small wrapper of the instruction set, and processes 4 or 8 objects at a time.
+// Array of structures are transposed to one register per component on load and back on store.
+// The remaining objects are processed by the scalar functions, which are also the reference of bit-exactness.
+//-----------------------------------------------------------------------------
+#include "ParaEngine.h"
+#include "util/ParaTime.h"
+#include "ParaQuaternion.h"
+#include "ParaMathMatrix.h"
+#include "ShapeAABB.h"
+#include "ShapeSphere.h"
+#include "ShapeFrustum.h"
+#include "ParaMathSIMD.h"
+
+// NOTE: a fused multiply add rounds only once, which breaks bit-exactness with the scalar code.
+// so all math files are compiled with -ffp-contract=off, see the math files in CMakeLists.txt.
+
+#if defined(PARAENGINE_NO_SIMD)
+	// scalar only
+#elif defined(__AVX2__)
+	#include <immintrin.h>
+	#define PARA_SIMD_AVX2
+	#define PARA_SIMD_SSE2
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+	#include <emmintrin.h>
+	#define PARA_SIMD_SSE2
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+	#include <arm_neon.h>
+	#define PARA_SIMD_NEON
+#endif
+
+using namespace ParaEngine;
+
+namespace ParaEngine
+{
+#ifdef PARA_SIMD_SSE2
+	struct SimdSSE2
+	{
+		typedef __m128 vec;
+		typedef __m128 mask;
+		static const int Width = 4;
+
+		static inline vec Set1(float f) { return _mm_set1_ps(f); }
+		static inline vec Add(vec a, vec b) { return _mm_add_ps(a, b); }
+		static inline vec Sub(vec a, vec b) { return _mm_sub_ps(a, b); }
+		static inline vec Mul(vec a, vec b) { return _mm_mul_ps(a, b); }
+		/** clear the sign bit */
+		static inline vec Abs(vec a) { return _mm_and_ps(a, _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff))); }
+		static inline mask CmpGE(vec a, vec b) { return _mm_cmpge_ps(a, b); }
+		static inline mask CmpLT(vec a, vec b) { return _mm_cmplt_ps(a, b); }
+		static inline mask And(mask a, mask b) { return _mm_and_ps(a, b); }
+		static inline mask Or(mask a, mask b) { return _mm_or_ps(a, b); }
+		static inline int MoveMask(mask a) { return _mm_movemask_ps(a); }
+
+		/** load 4 packed Vector3 to x, y, z */
+		static inline void Load3(const float* p, vec& x, vec& y, vec& z)
+		{
+			vec a = _mm_loadu_ps(p);		// x0 y0 z0 x1
+			vec b = _mm_loadu_ps(p + 4);	// y1 z1 x2 y2
+			vec c = _mm_loadu_ps(p + 8);	// z2 x3 y3 z3
+			x = _mm_shuffle_ps(a, _mm_shuffle_ps(b, c, _MM_SHUFFLE(0, 1, 0, 2)), _MM_SHUFFLE(2, 0, 3, 0));
+			y = _mm_shuffle_ps(_mm_shuffle_ps(a, b, _MM_SHUFFLE(0, 0, 0, 1)), _mm_shuffle_ps(b, c, _MM_SHUFFLE(2, 0, 0, 3)), _MM_SHUFFLE(3, 0, 2, 0));
+			z = _mm_shuffle_ps(_mm_shuffle_ps(a, b, _MM_SHUFFLE(0, 1, 0, 2)), _mm_shuffle_ps(c, c, _MM_SHUFFLE(3, 0, 3, 0)), _MM_SHUFFLE(1, 0, 2, 0));
+		}
+		/** store x, y, z to 4 packed Vector3 */
+		static inline void Store3(float* p, vec x, vec y, vec z)
+		{
+			vec a = _mm_shuffle_ps(_mm_unpacklo_ps(x, y), _mm_shuffle_ps(z, x, _MM_SHUFFLE(1, 0, 0, 0)), _MM_SHUFFLE(3, 0, 1, 0));
+			vec b = _mm_shuffle_ps(_mm_shuffle_ps(y, z, _MM_SHUFFLE(1, 1, 1, 1)), _mm_shuffle_ps(x, y, _MM_SHUFFLE(2, 2, 2, 2)), _MM_SHUFFLE(2, 0, 2, 0));
+			vec c = _mm_shuffle_ps(_mm_shuffle_ps(z, x, _MM_SHUFFLE(3, 3, 2, 2)), _mm_shuffle_ps(y, z, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(2, 0, 2, 0));
+			_mm_storeu_ps(p, a);
+			_mm_storeu_ps(p + 4, b);
+			_mm_storeu_ps(p + 8, c);
+		}
+		/** load the first 4 floats of 4 structures of nStride floats to a, b, c, d */
+		static inline void Load4(const float* p, int nStride, vec& a, vec& b, vec& c, vec& d)
+		{
+			a = _mm_loadu_ps(p);
+			b = _mm_loadu_ps(p + nStride);
+			c = _mm_loadu_ps(p + nStride * 2);
+			d = _mm_loadu_ps(p + nStride * 3);
+			_MM_TRANSPOSE4_PS(a, b, c, d);
+		}
+		/** store a, b, c, d to the first 4 floats of 4 structures of nStride floats */
+		static inline void Store4(float* p, int nStride, vec a, vec b, vec c, vec d)
+		{
+			_MM_TRANSPOSE4_PS(a, b, c, d);
+			_mm_storeu_ps(p, a);
+			_mm_storeu_ps(p + nStride, b);
+			_mm_storeu_ps(p + nStride * 2, c);
+			_mm_storeu_ps(p + nStride * 3, d);
+		}
+	};
+#endif
+
+#ifdef PARA_SIMD_AVX2
+	/** 8 objects at a time. loads and stores are done by two SSE2 transposes. */
+	struct SimdAVX2
+	{
+		typedef __m256 vec;
+		typedef __m256 mask;
+		static const int Width = 8;
+
+		static inline vec Combine(__m128 lo, __m128 hi) { return _mm256_insertf128_ps(_mm256_castps128_ps256(lo), hi, 1); }
+		static inline __m128 Low(vec a) { return _mm256_castps256_ps128(a); }
+		static inline __m128 High(vec a) { return _mm256_extractf128_ps(a, 1); }
+
+		static inline vec Set1(float f) { return _mm256_set1_ps(f); }
+		static inline vec Add(vec a, vec b) { return _mm256_add_ps(a, b); }
+		static inline vec Sub(vec a, vec b) { return _mm256_sub_ps(a, b); }
+		static inline vec Mul(vec a, vec b) { return _mm256_mul_ps(a, b); }
+		static inline vec Abs(vec a) { return _mm256_and_ps(a, _mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff))); }
+		static inline mask CmpGE(vec a, vec b) { return _mm256_cmp_ps(a, b, _CMP_GE_OQ); }
+		static inline mask CmpLT(vec a, vec b) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+		static inline mask And(mask a, mask b) { return _mm256_and_ps(a, b); }
+		static inline mask Or(mask a, mask b) { return _mm256_or_ps(a, b); }
+		static inline int MoveMask(mask a) { return _mm256_movemask_ps(a); }
+
+		static inline void Load3(const float* p, vec& x, vec& y, vec& z)
+		{
+			__m128 x0, y0, z0, x1, y1, z1;
+			SimdSSE2::Load3(p, x0, y0, z0);
+			SimdSSE2::Load3(p + 12, x1, y1, z1);
+			x = Combine(x0, x1); y = Combine(y0, y1); z = Combine(z0, z1);
+		}
+		static inline void Store3(float* p, vec x, vec y, vec z)
+		{
+			SimdSSE2::Store3(p, Low(x), Low(y), Low(z));
+			SimdSSE2::Store3(p + 12, High(x), High(y), High(z));
+		}
+		static inline void Load4(const float* p, int nStride, vec& a, vec& b, vec& c, vec& d)
+		{
+			__m128 a0, b0, c0, d0, a1, b1, c1, d1;
+			SimdSSE2::Load4(p, nStride, a0, b0, c0, d0);
+			SimdSSE2::Load4(p + nStride * 4, nStride, a1, b1, c1, d1);
+			a = Combine(a0, a1); b = Combine(b0, b1); c = Combine(c0, c1); d = Combine(d0, d1);
+		}
+		static inline void Store4(float* p, int nStride, vec a, vec b, vec c, vec d)
+		{
+			SimdSSE2::Store4(p, nStride, Low(a), Low(b), Low(c), Low(d));
+			SimdSSE2::Store4(p + nStride * 4, nStride, High(a), High(b), High(c), High(d));
+		}
+	};
+	typedef SimdAVX2 SimdImpl;
+#elif defined(PARA_SIMD_SSE2)
+	typedef SimdSSE2 SimdImpl;
+#endif
+
+#ifdef PARA_SIMD_NEON
+	struct SimdNEON
+	{
+		typedef float32x4_t vec;
+		typedef uint32x4_t mask;
+		static const int Width = 4;
+
+		static inline vec Set1(float f) { return vdupq_n_f32(f); }
+		static inline vec Add(vec a, vec b) { return vaddq_f32(a, b); }
+		static inline vec Sub(vec a, vec b) { return vsubq_f32(a, b); }
+		// vmlaq_f32 is not used, since it may be compiled to a fused multiply add.
+		static inline vec Mul(vec a, vec b) { return vmulq_f32(a, b); }
+		static inline vec Abs(vec a) { return vabsq_f32(a); }
+		static inline mask CmpGE(vec a, vec b) { return vcgeq_f32(a, b); }
+		static inline mask CmpLT(vec a, vec b) { return vcltq_f32(a, b); }
+		static inline mask And(mask a, mask b) { return vandq_u32(a, b); }
+		static inline mask Or(mask a, mask b) { return vorrq_u32(a, b); }
+		static inline int MoveMask(mask a)
+		{
+			uint32x4_t bits = vshrq_n_u32(a, 31);
+			return (int)(vgetq_lane_u32(bits, 0) | (vgetq_lane_u32(bits, 1) << 1) | (vgetq_lane_u32(bits, 2) << 2) | (vgetq_lane_u32(bits, 3) << 3));
+		}
+
+		static inline void Load3(const float* p, vec& x, vec& y, vec& z)
+		{
+			float32x4x3_t v = vld3q_f32(p);
+			x = v.val[0]; y = v.val[1]; z = v.val[2];
+		}
+		static inline void Store3(float* p, vec x, vec y, vec z)
+		{
+			float32x4x3_t v;
+			v.val[0] = x; v.val[1] = y; v.val[2] = z;
+			vst3q_f32(p, v);
+		}
+		static inline void Transpose4(vec& a, vec& b, vec& c, vec& d)
+		{
+			float32x4x2_t ab = vtrnq_f32(a, b);
+			float32x4x2_t cd = vtrnq_f32(c, d);
+			a = vcombine_f32(vget_low_f32(ab.val[0]), vget_low_f32(cd.val[0]));
+			b = vcombine_f32(vget_low_f32(ab.val[1]), vget_low_f32(cd.val[1]));
+			c = vcombine_f32(vget_high_f32(ab.val[0]), vget_high_f32(cd.val[0]));
+			d = vcombine_f32(vget_high_f32(ab.val[1]), vget_high_f32(cd.val[1]));
+		}
+		static inline void Load4(const float* p, int nStride, vec& a, vec& b, vec& c, vec& d)
+		{
+			a = vld1q_f32(p);
+			b = vld1q_f32(p + nStride);
+			c = vld1q_f32(p + nStride * 2);
+			d = vld1q_f32(p + nStride * 3);
+			Transpose4(a, b, c, d);
+		}
+		static inline void Store4(float* p, int nStride, vec a, vec b, vec c, vec d)
+		{
+			Transpose4(a, b, c, d);
+			vst1q_f32(p, a);
+			vst1q_f32(p + nStride, b);
+			vst1q_f32(p + nStride * 2, c);
+			vst1q_f32(p + nStride * 3, d);
+		}
+	};
+	typedef SimdNEON SimdImpl;
+#endif
+
+#if defined(PARA_SIMD_SSE2) || defined(PARA_SIMD_NEON)
+	#define PARA_MATH_SIMD
+	static_assert(sizeof(Vector3) == 3 * sizeof(float) && sizeof(Quaternion) == 4 * sizeof(float) && sizeof(Matrix4) == 16 * sizeof(float), "unexpected math type size");
+	static_assert(sizeof(CShapeAABB) == 6 * sizeof(float) && sizeof(CShapeSphere) == 4 * sizeof(float), "unexpected shape type size");
+
+	/** @return the number of points processed. */
+	template <class S>
+	static int TransformPointsSIMD(Vector3* pOut, const Vector3* pIn, int nCount, const Matrix4& mat)
+	{
+		typedef typename S::vec vec;
+		vec m00 = S::Set1(mat.m[0][0]), m01 = S::Set1(mat.m[0][1]), m02 = S::Set1(mat.m[0][2]);
+		vec m10 = S::Set1(mat.m[1][0]), m11 = S::Set1(mat.m[1][1]), m12 = S::Set1(mat.m[1][2]);
+		vec m20 = S::Set1(mat.m[2][0]), m21 = S::Set1(mat.m[2][1]), m22 = S::Set1(mat.m[2][2]);
+		vec m30 = S::Set1(mat.m[3][0]), m31 = S::Set1(mat.m[3][1]), m32 = S::Set1(mat.m[3][2]);
+		int i = 0;
+		for (; i + S::Width <= nCount; i += S::Width)
+		{
+			vec x, y, z;
+			S::Load3((const float*)(pIn + i), x, y, z);
+			vec rx = S::Add(S::Add(S::Add(S::Mul(x, m00), S::Mul(y, m10)), S::Mul(z, m20)), m30);
+			vec ry = S::Add(S::Add(S::Add(S::Mul(x, m01), S::Mul(y, m11)), S::Mul(z, m21)), m31);
+			vec rz = S::Add(S::Add(S::Add(S::Mul(x, m02), S::Mul(y, m12)), S::Mul(z, m22)), m32);
+			S::Store3((float*)(pOut + i), rx, ry, rz);
+		}
+		return i;
+	}
+
+	template <class S>
+	static int TransformAABBsSIMD(CShapeAABB* pOut, const CShapeAABB* pIn, int nCount, const Matrix4& mat)
+	{
+		typedef typename S::vec vec;
+		vec m00 = S::Set1(mat.m[0][0]), m01 = S::Set1(mat.m[0][1]), m02 = S::Set1(mat.m[0][2]);
+		vec m10 = S::Set1(mat.m[1][0]), m11 = S::Set1(mat.m[1][1]), m12 = S::Set1(mat.m[1][2]);
+		vec m20 = S::Set1(mat.m[2][0]), m21 = S::Set1(mat.m[2][1]), m22 = S::Set1(mat.m[2][2]);
+		vec m30 = S::Set1(mat.m[3][0]), m31 = S::Set1(mat.m[3][1]), m32 = S::Set1(mat.m[3][2]);
+		int i = 0;
+		for (; i + S::Width <= nCount; i += S::Width)
+		{
+			const float* pSrc = (const float*)(pIn + i);
+			vec cx, cy, cz, ex, ey, ez, cz2, ex2;
+			S::Load4(pSrc, 6, cx, cy, cz, ex);
+			S::Load4(pSrc + 2, 6, cz2, ex2, ey, ez);
+
+			vec rcx = S::Add(S::Add(S::Add(S::Mul(cx, m00), S::Mul(cy, m10)), S::Mul(cz, m20)), m30);
+			vec rcy = S::Add(S::Add(S::Add(S::Mul(cx, m01), S::Mul(cy, m11)), S::Mul(cz, m21)), m31);
+			vec rcz = S::Add(S::Add(S::Add(S::Mul(cx, m02), S::Mul(cy, m12)), S::Mul(cz, m22)), m32);
+
+			vec rex = S::Add(S::Add(S::Abs(S::Mul(m00, ex)), S::Abs(S::Mul(m10, ey))), S::Abs(S::Mul(m20, ez)));
+			vec rey = S::Add(S::Add(S::Abs(S::Mul(m01, ex)), S::Abs(S::Mul(m11, ey))), S::Abs(S::Mul(m21, ez)));
+			vec rez = S::Add(S::Add(S::Abs(S::Mul(m02, ex)), S::Abs(S::Mul(m12, ey))), S::Abs(S::Mul(m22, ez)));
+
+			float* pDest = (float*)(pOut + i);
+			S::Store4(pDest, 6, rcx, rcy, rcz, rex);
+			S::Store4(pDest + 2, 6, rcz, rex, rey, rez);
+		}
+		return i;
+	}
+
+	template <class S>
+	static int MakeTransformsSIMD(Matrix4* pOut, const Vector3* pPositions, const Quaternion* pRotations, const Vector3* pScales, int nCount)
+	{
+		typedef typename S::vec vec;
+		vec one = S::Set1(1.f), two = S::Set1(2.f), zero = S::Set1(0.f);
+		int i = 0;
+		for (; i + S::Width <= nCount; i += S::Width)
+		{
+			vec x, y, z, w, px, py, pz, sx, sy, sz;
+			S::Load4((const float*)(pRotations + i), 4, x, y, z, w);
+			S::Load3((const float*)(pPositions + i), px, py, pz);
+			if (pScales)
+				S::Load3((const float*)(pScales + i), sx, sy, sz);
+			else
+				sx = sy = sz = one;
+
+			vec xx = S::Mul(x, x), yy = S::Mul(y, y), zz = S::Mul(z, z);
+			vec xy = S::Mul(x, y), xz = S::Mul(x, z), yz = S::Mul(y, z);
+			vec xw = S::Mul(x, w), yw = S::Mul(y, w), zw = S::Mul(z, w);
+
+			vec r00 = S::Sub(one, S::Mul(two, S::Add(yy, zz)));
+			vec r01 = S::Mul(two, S::Add(xy, zw));
+			vec r02 = S::Mul(two, S::Sub(xz, yw));
+			vec r10 = S::Mul(two, S::Sub(xy, zw));
+			vec r11 = S::Sub(one, S::Mul(two, S::Add(xx, zz)));
+			vec r12 = S::Mul(two, S::Add(yz, xw));
+			vec r20 = S::Mul(two, S::Add(xz, yw));
+			vec r21 = S::Mul(two, S::Sub(yz, xw));
+			vec r22 = S::Sub(one, S::Mul(two, S::Add(xx, yy)));
+
+			float* pDest = (float*)(pOut + i);
+			S::Store4(pDest, 16, S::Mul(sx, r00), S::Mul(sx, r01), S::Mul(sx, r02), zero);
+			S::Store4(pDest + 4, 16, S::Mul(sy, r10), S::Mul(sy, r11), S::Mul(sy, r12), zero);
+			S::Store4(pDest + 8, 16, S::Mul(sz, r20), S::Mul(sz, r21), S::Mul(sz, r22), zero);
+			S::Store4(pDest + 12, 16, px, py, pz, one);
+		}
+		return i;
+	}
+
+	template <class S>
+	static int TestSpheresSIMD(const CShapeFrustum& frustum, const CShapeSphere* pSpheres, int nCount, uint8* pResults, int& nVisibleCount)
+	{
+		typedef typename S::vec vec;
+		typedef typename S::mask mask;
+		vec a[6], b[6], c[6], d[6];
+		for (int k = 0; k < 6; ++k)
+		{
+			const Plane& plane = frustum.planeFrustum[k];
+			a[k] = S::Set1(plane.normal.x); b[k] = S::Set1(plane.normal.y); c[k] = S::Set1(plane.normal.z); d[k] = S::Set1(plane.d);
+		}
+		vec zero = S::Set1(0.f);
+		int i = 0;
+		for (; i + S::Width <= nCount; i += S::Width)
+		{
+			vec x, y, z, r;
+			S::Load4((const float*)(pSpheres + i), 4, x, y, z, r);
+			mask inside = S::CmpGE(S::Add(S::Add(S::Add(S::Add(S::Mul(a[0], x), S::Mul(b[0], y)), S::Mul(c[0], z)), d[0]), r), zero);
+			for (int k = 1; k < 6; ++k)
+				inside = S::And(inside, S::CmpGE(S::Add(S::Add(S::Add(S::Add(S::Mul(a[k], x), S::Mul(b[k], y)), S::Mul(c[k], z)), d[k]), r), zero));
+			int nBits = S::MoveMask(inside);
+			for (int j = 0; j < S::Width; ++j)
+			{
+				uint8 bInside = (uint8)((nBits >> j) & 1);
+				pResults[i + j] = bInside;
+				nVisibleCount += bInside;
+			}
+		}
+		return i;
+	}
+
+	template <class S>
+	static int TestBoxesSIMD(const CShapeFrustum& frustum, const CShapeAABB* pBoxes, int nCount, uint8* pResults, int& nVisibleCount)
+	{
+		typedef typename S::vec vec;
+		typedef typename S::mask mask;
+		vec a[6], b[6], c[6], d[6];
+		for (int k = 0; k < 6; ++k)
+		{
+			const Plane& plane = frustum.planeFrustum[k];
+			a[k] = S::Set1(plane.normal.x); b[k] = S::Set1(plane.normal.y); c[k] = S::Set1(plane.normal.z); d[k] = S::Set1(plane.d);
+		}
+		vec zero = S::Set1(0.f);
+		int i = 0;
+		for (; i + S::Width <= nCount; i += S::Width)
+		{
+			vec cx, cy, cz, ex, ey, ez, cz2, ex2;
+			const float* pSrc = (const float*)(pBoxes + i);
+			S::Load4(pSrc, 6, cx, cy, cz, ex);
+			S::Load4(pSrc + 2, 6, cz2, ex2, ey, ez);
+			vec minX = S::Sub(cx, ex), minY = S::Sub(cy, ey), minZ = S::Sub(cz, ez);
+			vec maxX = S::Add(cx, ex), maxY = S::Add(cy, ey), maxZ = S::Add(cz, ez);
+
+			mask outside, intersect;
+			for (int k = 0; k < 6; ++k)
+			{
+				// the same vertex lookup table as CShapeFrustum::TestBox()
+				int nV = frustum.nVertexLUT[k];
+				vec nDist = S::Add(S::Add(S::Add(S::Mul(a[k], (nV & 1) ? minX : maxX), S::Mul(b[k], (nV & 2) ? minY : maxY)), S::Mul(c[k], (nV & 4) ? minZ : maxZ)), d[k]);
+				vec pDist = S::Add(S::Add(S::Add(S::Mul(a[k], (nV & 1) ? maxX : minX), S::Mul(b[k], (nV & 2) ? maxY : minY)), S::Mul(c[k], (nV & 4) ? maxZ : minZ)), d[k]);
+				if (k == 0)
+				{
+					outside = S::CmpLT(nDist, zero);
+					intersect = S::CmpLT(pDist, zero);
+				}
+				else
+				{
+					outside = S::Or(outside, S::CmpLT(nDist, zero));
+					intersect = S::Or(intersect, S::CmpLT(pDist, zero));
+				}
+			}
+			int nOutsideBits = S::MoveMask(outside);
+			int nIntersectBits = S::MoveMask(intersect);
+			for (int j = 0; j < S::Width; ++j)
+			{
+				uint8 nResult = ((nOutsideBits >> j) & 1) ? 0 : (((nIntersectBits >> j) & 1) ? 2 : 1);
+				pResults[i + j] = nResult;
+				if (nResult != 0)
+					++nVisibleCount;
+			}
+		}
+		return i;
+	}
+#endif
+}
+
+const char* ParaEngine::ParaGetSIMDInstructionSet()
+{
+#if defined(PARA_SIMD_AVX2)
+	return "AVX2";
+#elif defined(PARA_SIMD_SSE2)
+	return "SSE2";
+#elif defined(PARA_SIMD_NEON)
+	return "NEON";
+#else
+	return "none";
+#endif
+}
+
+void ParaEngine::ParaVec3TransformArray(Vector3* pOut, const Vector3* pIn, int nCount, const Matrix4* pMat)
+{
+#ifdef PARA_MATH_SIMD
+	int i = TransformPointsSIMD<SimdImpl>(pOut, pIn, nCount, *pMat);
+#else
+	int i = 0;
+#endif
+	for (; i < nCount; ++i)
+		pOut[i] = pIn[i] * (*pMat);
+}
+
+void ParaEngine::ParaAABBTransformArray(CShapeAABB* pOut, const CShapeAABB* pIn, int nCount, const Matrix4* pMat)
+{
+#ifdef PARA_MATH_SIMD
+	int i = TransformAABBsSIMD<SimdImpl>(pOut, pIn, nCount, *pMat);
+#else
+	int i = 0;
+#endif
+	for (; i < nCount; ++i)
+	{
+		CShapeAABB aabb;
+		pIn[i].Rotate(*pMat, aabb);
+		pOut[i] = aabb;
+	}
+}
+
+void ParaEngine::ParaMatrixTransformationArray(Matrix4* pOut, const Vector3* pPositions, const Quaternion* pRotations, const Vector3* pScales, int nCount)
+{
+#ifdef PARA_MATH_SIMD
+	int i = MakeTransformsSIMD<SimdImpl>(pOut, pPositions, pRotations, pScales, nCount);
+#else
+	int i = 0;
+#endif
+	for (; i < nCount; ++i)
+	{
+		const Quaternion& q = pRotations[i];
+		float sx = 1.f, sy = 1.f, sz = 1.f;
+		if (pScales)
+		{
+			sx = pScales[i].x; sy = pScales[i].y; sz = pScales[i].z;
+		}
+		Matrix4& out = pOut[i];
+		// the same as ParaMatrixAffineTransformation()
+		out.m[0][0] = sx * (1.0f - 2.0f * (q.y * q.y + q.z * q.z));
+		out.m[0][1] = sx * (2.0f * (q.x * q.y + q.z * q.w));
+		out.m[0][2] = sx * (2.0f * (q.x * q.z - q.y * q.w));
+		out.m[0][3] = 0.f;
+		out.m[1][0] = sy * (2.0f * (q.x * q.y - q.z * q.w));
+		out.m[1][1] = sy * (1.0f - 2.0f * (q.x * q.x + q.z * q.z));
+		out.m[1][2] = sy * (2.0f * (q.y * q.z + q.x * q.w));
+		out.m[1][3] = 0.f;
+		out.m[2][0] = sz * (2.0f * (q.x * q.z + q.y * q.w));
+		out.m[2][1] = sz * (2.0f * (q.y * q.z - q.x * q.w));
+		out.m[2][2] = sz * (1.0f - 2.0f * (q.x * q.x + q.y * q.y));
+		out.m[2][3] = 0.f;
+		out.m[3][0] = pPositions[i].x;
+		out.m[3][1] = pPositions[i].y;
+		out.m[3][2] = pPositions[i].z;
+		out.m[3][3] = 1.f;
+	}
+}
+
+int ParaEngine::ParaFrustumTestSphereArray(const CShapeFrustum* pFrustum, const CShapeSphere* pSpheres, int nCount, uint8* pResults)
+{
+	int nVisibleCount = 0;
+#ifdef PARA_MATH_SIMD
+	int i = TestSpheresSIMD<SimdImpl>(*pFrustum, pSpheres, nCount, pResults, nVisibleCount);
+#else
+	int i = 0;
+#endif
+	for (; i < nCount; ++i)
+	{
+		pResults[i] = pFrustum->TestSphere(&(pSpheres[i])) ? 1 : 0;
+		nVisibleCount += pResults[i];
+	}
+	return nVisibleCount;
+}
+
+int ParaEngine::ParaFrustumTestBoxArray(const CShapeFrustum* pFrustum, const CShapeAABB* pBoxes, int nCount, uint8* pResults)
+{
+	int nVisibleCount = 0;
+#ifdef PARA_MATH_SIMD
+	int i = TestBoxesSIMD<SimdImpl>(*pFrustum, pBoxes, nCount, pResults, nVisibleCount);
+#else
+	int i = 0;
+#endif
+	for (; i < nCount; ++i)
+	{
+		pResults[i] = (uint8)pFrustum->TestBox(&(pBoxes[i]));
+		if (pResults[i] != 0)
+			++nVisibleCount;
+	}
+	return nVisibleCount;
+}
+
+#ifdef _DEBUG
+/** compare the batch kernels with the single object functions bit by bit, and print the time of both. */
+void Test_MathSIMD()
+{
+	const int nCount = 100003;
+	srand(1234);
+	std::vector<Vector3> points(nCount), positions(nCount), scales(nCount);
+	std::vector<Quaternion> rotations(nCount);
+	for (int i = 0; i < nCount; ++i)
+	{
+		points[i] = Vector3(200.f * rand() / RAND_MAX - 100.f, 200.f * rand() / RAND_MAX - 100.f, 200.f * rand() / RAND_MAX - 100.f);
+		positions[i] = Vector3(200.f * rand() / RAND_MAX - 100.f, 20.f * rand() / RAND_MAX, 200.f * rand() / RAND_MAX - 100.f);
+		scales[i] = Vector3(0.5f + 2.f * rand() / RAND_MAX, 0.5f + 2.f * rand() / RAND_MAX, 0.5f + 2.f * rand() / RAND_MAX);
+		rotations[i] = Quaternion(Vector3(0.3f, 1.f, 0.2f).normalisedCopy(), 6.28f * rand() / RAND_MAX);
+	}
+	Matrix4 mat;
+	ParaMatrixAffineTransformation(&mat, 1.5f, NULL, &(rotations[0]), &(positions[0]));
+
+	// the frustum is not axis aligned. the projection matrix depends on the renderer, so objects are placed by the frustum corners.
+	Matrix4 matView, matProj;
+	Vector3 vEye(0.f, 10.f, -50.f), vAt(10.f, 0.f, 50.f), vUp(0.f, 1.f, 0.f);
+	ParaMatrixLookAtLH(&matView, &vEye, &vAt, &vUp);
+	ParaMatrixPerspectiveFovLH(&matProj, 1.f, 1.3f, 1.f, 150.f);
+	Matrix4 matViewProj = matView * matProj;
+	CShapeFrustum frustum(&matViewProj);
+	const Vector3* corners = frustum.vecFrustum;
+	Vector3 vMin = corners[0], vMax = corners[0];
+	for (int i = 1; i < 8; ++i)
+	{
+		vMin.makeFloor(corners[i]);
+		vMax.makeCeil(corners[i]);
+	}
+	float fSize = (vMax - vMin).length() * 0.02f;
+	// corners of the near, far, left, right, bottom and top faces
+	static const int faces[6][4] = { { 0, 1, 2, 3 }, { 4, 5, 6, 7 }, { 0, 2, 4, 6 }, { 1, 3, 5, 7 }, { 0, 1, 4, 5 }, { 2, 3, 6, 7 } };
+	std::vector<CShapeAABB> boxes(nCount);
+	std::vector<CShapeSphere> spheres(nCount);
+	for (int i = 0; i < nCount; ++i)
+	{
+		float u = (float)rand() / RAND_MAX, v = (float)rand() / RAND_MAX, w = (float)rand() / RAND_MAX;
+		Vector3 vCenter;
+		switch (i % 3)
+		{
+		case 0:
+		{
+			// inside the frustum
+			Vector3 vNear = (corners[0] * (1.f - u) + corners[1] * u) * (1.f - v) + (corners[2] * (1.f - u) + corners[3] * u) * v;
+			Vector3 vFar = (corners[4] * (1.f - u) + corners[5] * u) * (1.f - v) + (corners[6] * (1.f - u) + corners[7] * u) * v;
+			vCenter = vNear * (1.f - w) + vFar * w;
+			break;
+		}
+		case 1:
+		{
+			// on one of the frustum planes, so that it straddles the plane
+			const int* face = faces[rand() % 6];
+			vCenter = (corners[face[0]] * (1.f - u) + corners[face[1]] * u) * (1.f - v) + (corners[face[2]] * (1.f - u) + corners[face[3]] * u) * v;
+			break;
+		}
+		default:
+			// anywhere around the frustum, mostly outside
+			vCenter = vMin + (vMax - vMin) * Vector3(2.f * u - 0.5f, 2.f * v - 0.5f, 2.f * w - 0.5f);
+			break;
+		}
+		boxes[i] = CShapeAABB(vCenter, Vector3(fSize * rand() / RAND_MAX, fSize * rand() / RAND_MAX, fSize * rand() / RAND_MAX));
+		spheres[i] = CShapeSphere(vCenter, fSize * rand() / RAND_MAX);
+	}
+
+	int nMismatch = 0;
+	int64 nFromTime = ParaEngine::GetTimeUS();
+	std::vector<Vector3> points_ref(nCount);
+	for (int i = 0; i < nCount; ++i)
+		points_ref[i] = points[i] * mat;
+	int nScalarTime = (int)(ParaEngine::GetTimeUS() - nFromTime);
+	std::vector<Vector3> points_out(nCount);
+	nFromTime = ParaEngine::GetTimeUS();
+	ParaVec3TransformArray(&(points_out[0]), &(points[0]), nCount, &mat);
+	int nBatchTime = (int)(ParaEngine::GetTimeUS() - nFromTime);
+	nMismatch = memcmp(&(points_ref[0]), &(points_out[0]), sizeof(Vector3) * nCount) != 0 ? 1 : 0;
+	OUTPUT_LOG("%s transform points: scalar %d us, batch %d us, mismatch %d\n", ParaGetSIMDInstructionSet(), nScalarTime, nBatchTime, nMismatch);
+
+	std::vector<CShapeAABB> boxes_ref(nCount), boxes_out(nCount);
+	nFromTime = ParaEngine::GetTimeUS();
+	for (int i = 0; i < nCount; ++i)
+		boxes[i].Rotate(mat, boxes_ref[i]);
+	nScalarTime = (int)(ParaEngine::GetTimeUS() - nFromTime);
+	nFromTime = ParaEngine::GetTimeUS();
+	ParaAABBTransformArray(&(boxes_out[0]), &(boxes[0]), nCount, &mat);
+	nBatchTime = (int)(ParaEngine::GetTimeUS() - nFromTime);
+	nMismatch = memcmp(&(boxes_ref[0]), &(boxes_out[0]), sizeof(CShapeAABB) * nCount) != 0 ? 1 : 0;
+	OUTPUT_LOG("%s transform boxes: scalar %d us, batch %d us, mismatch %d\n", ParaGetSIMDInstructionSet(), nScalarTime, nBatchTime, nMismatch);
+
+	std::vector<Matrix4> mats_ref(nCount), mats_out(nCount);
+	nFromTime = ParaEngine::GetTimeUS();
+	for (int i = 0; i < nCount; ++i)
+	{
+		Matrix4& out = mats_ref[i];
+		ParaMatrixAffineTransformation(&out, 1.f, NULL, &(rotations[i]), &(positions[i]));
+		// non-uniform scale of each axis
+		for (int j = 0; j < 3; ++j)
+		{
+			out.m[0][j] *= scales[i].x;
+			out.m[1][j] *= scales[i].y;
+			out.m[2][j] *= scales[i].z;
+		}
+	}
+	nScalarTime = (int)(ParaEngine::GetTimeUS() - nFromTime);
+	nFromTime = ParaEngine::GetTimeUS();
+	ParaMatrixTransformationArray(&(mats_out[0]), &(positions[0]), &(rotations[0]), &(scales[0]), nCount);
+	nBatchTime = (int)(ParaEngine::GetTimeUS() - nFromTime);
+	nMismatch = memcmp(&(mats_ref[0]), &(mats_out[0]), sizeof(Matrix4) * nCount) != 0 ? 1 : 0;
+	OUTPUT_LOG("%s world matrices: scalar %d us, batch %d us, mismatch %d\n", ParaGetSIMDInstructionSet(), nScalarTime, nBatchTime, nMismatch);
+
+	std::vector<uint8> results_ref(nCount), results_out(nCount);
+	nFromTime = ParaEngine::GetTimeUS();
+	for (int i = 0; i < nCount; ++i)
+		results_ref[i] = frustum.TestSphere(&(spheres[i])) ? 1 : 0;
+	nScalarTime = (int)(ParaEngine::GetTimeUS() - nFromTime);
+	nFromTime = ParaEngine::GetTimeUS();
+	int nVisible = ParaFrustumTestSphereArray(&frustum, &(spheres[0]), nCount, &(results_out[0]));
+	nBatchTime = (int)(ParaEngine::GetTimeUS() - nFromTime);
+	nMismatch = memcmp(&(results_ref[0]), &(results_out[0]), nCount) != 0 ? 1 : 0;
+	OUTPUT_LOG("%s frustum test spheres: scalar %d us, batch %d us, visible %d, mismatch %d\n", ParaGetSIMDInstructionSet(), nScalarTime, nBatchTime, nVisible, nMismatch);
+
+	nFromTime = ParaEngine::GetTimeUS();
+	for (int i = 0; i < nCount; ++i)
+		results_ref[i] = (uint8)frustum.TestBox(&(boxes[i]));
+	nScalarTime = (int)(ParaEngine::GetTimeUS() - nFromTime);
+	nFromTime = ParaEngine::GetTimeUS();
+	nVisible = ParaFrustumTestBoxArray(&frustum, &(boxes[0]), nCount, &(results_out[0]));
+	nBatchTime = (int)(ParaEngine::GetTimeUS() - nFromTime);
+	nMismatch = memcmp(&(results_ref[0]), &(results_out[0]), nCount) != 0 ? 1 : 0;
+	OUTPUT_LOG("%s frustum test boxes: scalar %d us, batch %d us, visible %d, mismatch %d\n", ParaGetSIMDInstructionSet(), nScalarTime, nBatchTime, nVisible, nMismatch);
+}
+#endif
@@ -0,0 +1,44 @@
+#pragma once
+namespace ParaEngine
+{
+	class Vector3;
+	class Matrix4;
+	class Quaternion;
+	class CShapeAABB;
+	class CShapeSphere;
+	class CShapeFrustum;
+
+	/**
+	* Batch math kernels used by culling, picking, skinning and physics sync.
+	* They use AVX2, SSE2 or NEON depending on the compiler target, and a scalar fallback otherwise.
+	* Results are bit-exact with the single object functions mentioned below, since the SIMD code uses the same
+	* operations in the same order without fused multiply add. Input and output arrays may be the same array.
+	*/
+
+	/** name of the instruction set used by the batch kernels: "AVX2", "SSE2", "NEON" or "none" */
+	const char* ParaGetSIMDInstructionSet();
+
+	/** pOut[i] = pIn[i] * (*pMat), assuming an affine matrix. Same as Vector3::operator*(const Matrix4&) */
+	void ParaVec3TransformArray(Vector3* pOut, const Vector3* pIn, int nCount, const Matrix4* pMat);
+
+	/** transform boxes by an affine matrix. Same as CShapeAABB::Rotate() */
+	void ParaAABBTransformArray(CShapeAABB* pOut, const CShapeAABB* pIn, int nCount, const Matrix4* pMat);
+
+	/** build world matrices from position, rotation and scale, in the order of scale, rotation and then translation.
+	* For uniform scaling, this is the same as ParaMatrixAffineTransformation() without rotation center.
+	* @param pScales: if NULL, no scaling is applied.
+	*/
+	void ParaMatrixTransformationArray(Matrix4* pOut, const Vector3* pPositions, const Quaternion* pRotations, const Vector3* pScales, int nCount);
+
+	/** test spheres against a frustum. Same as CShapeFrustum::TestSphere()
+	* @param pResults: [out] 1 if the sphere is inside or intersecting the frustum, 0 otherwise.
+	* @return the number of spheres inside or intersecting the frustum.
+	*/
+	int ParaFrustumTestSphereArray(const CShapeFrustum* pFrustum, const CShapeSphere* pSpheres, int nCount, uint8* pResults);
+
+	/** test boxes against a frustum. Same as CShapeFrustum::TestBox()
+	* @param pResults: [out] 0 is outside, 1 is fully inside and 2 is intersecting the frustum.
+	* @return the number of boxes inside or intersecting the frustum.
+	*/
+	int ParaFrustumTestBoxArray(const CShapeFrustum* pFrustum, const CShapeAABB* pBoxes, int nCount, uint8* pResults);
+}
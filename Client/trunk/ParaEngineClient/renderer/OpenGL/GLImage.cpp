@@ -147,7 +147,16 @@ _width(0)
     
 }
 
-bool Image::initWithRawData(const unsigned char * data, size_t dataLen, int width, int height, int bitsPerComponent, bool preMulti)
+Image::~Image()
+{
+	if (_data)
+	{
+		free(_data);
+		_data = nullptr;
+	}
+}
+
+bool Image::initWithRawData(const unsigned char * data, size_t dataLen, int width, int height, int bitsPerComponent, bool preMulti, Texture2D::PixelFormat pixelFormat)
 {
 	bool ret = false;
 	do
@@ -155,13 +164,23 @@ bool Image::initWithRawData(const unsigned char * data, size_t dataLen, int widt
 		if(0 == width || 0 == height) 
 			break;
 
+		int bytesPerComponent = 0;
+		switch (pixelFormat)
+		{
+		case Texture2D::PixelFormat::RGBA8888: bytesPerComponent = 4; break;
+		case Texture2D::PixelFormat::RGB888: bytesPerComponent = 3; break;
+		case Texture2D::PixelFormat::AI88: bytesPerComponent = 2; break;
+		case Texture2D::PixelFormat::I8: bytesPerComponent = 1; break;
+		default: break;
+		}
+		if (bytesPerComponent == 0 || dataLen < (size_t)(height * width * bytesPerComponent))
+			break;
+
 		_height = height;
 		_width = width;
 		_hasPremultipliedAlpha = preMulti;
-		_renderFormat = Texture2D::PixelFormat::RGBA8888;
+		_renderFormat = pixelFormat;
 
-		// only RGBA8888 supported
-		int bytesPerComponent = 4;
 		_dataLen = height * width * bytesPerComponent;
 		_data = static_cast<unsigned char*>(malloc(_dataLen * sizeof(unsigned char)));
 		if(!_data)
@@ -18,6 +18,7 @@ namespace ParaEngine
 	public:
         
         Image();
+		virtual ~Image();
         
 		// config
 		static bool supportsS3TC;
@@ -55,7 +56,8 @@ namespace ParaEngine
 	public:
 
 		bool initWithImageData(const unsigned char * data, size_t dataLen);
-		bool initWithRawData(const unsigned char * data, size_t dataLen, int width, int height, int bitsPerComponent, bool preMulti = false);
+		/** @param pixelFormat: one of RGBA8888, RGB888, AI88 and I8. */
+		bool initWithRawData(const unsigned char * data, size_t dataLen, int width, int height, int bitsPerComponent, bool preMulti = false, Texture2D::PixelFormat pixelFormat = Texture2D::PixelFormat::RGBA8888);
 		bool saveToFile(const std::string &filename, bool isToRGB = true);
 
 
@@ -72,7 +74,7 @@ namespace ParaEngine
 		int	getDataLen() const { return _dataLen; }
 		MipmapInfo* getMipmaps() { return _mipmaps; }
 		bool	isCompressed() const { return false; }
-		bool	hasPremultipliedAlpha() const { return Texture2D::getPixelFormatInfoMap().at(_renderFormat).compressed; }
+		bool	hasPremultipliedAlpha() const { return _hasPremultipliedAlpha; }
 
 	protected:
 		static const int MIPMAP_MAX = 16;
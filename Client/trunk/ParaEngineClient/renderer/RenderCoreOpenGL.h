@@ -84,6 +84,8 @@ namespace ParaEngine
 		D3DFMT_A8 = 28,
 		D3DFMT_A8B8G8R8 = 32,
 		D3DFMT_X8B8G8R8 = 33,
+		D3DFMT_L8 = 50,
+		D3DFMT_A8L8 = 51,
 
 		D3DFMT_DXT1 = MAKEFOURCC('D', 'X', 'T', '1'),
 		D3DFMT_DXT2 = MAKEFOURCC('D', 'X', 'T', '2'),
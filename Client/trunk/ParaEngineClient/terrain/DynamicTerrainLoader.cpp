@@ -130,6 +130,7 @@ void CDynamicTerrainLoader::LoadFromFile(const char* sConfigFile)
 bool CDynamicTerrainLoader::UpdateTileConfigFile(int x, int y, const string& sTileConfigFile)
 {
 	int nID = TerrainLattice::GetTileIDFromXY(x, y);
+	ParaEngine::Lock lock_(m_mutex);
 	if(!sTileConfigFile.empty())
 	{
 		map<int, TerrainTileInfo>::iterator iter = m_TerrainTiles.find(nID);
@@ -155,6 +156,7 @@ bool CDynamicTerrainLoader::SaveWorldConfigFile()
 	
 	if(cFile.CreateNewFile(m_sConfigFilePath.c_str(), true) == false)
 		return false;
+	ParaEngine::Lock lock_(m_mutex);
 	char line[MAX_LINE+1];
 	memset(line, 0, sizeof(line));
 	cFile.WriteString("-- Auto generated by ParaEngine \n");
@@ -303,6 +305,7 @@ Terrain * CDynamicTerrainLoader::LoadTerrainAt(Terrain *pTerrain, int latticeX,
 	pTerrain->SetLatticePosition(latticeX, latticeY);
 	pTerrain->SetOffset(latticeX * GetTerrainWidth(), latticeY * GetTerrainHeight());
 	
+	ParaEngine::Lock lock_(m_mutex);
 	map<int, TerrainTileInfo>::iterator iter = m_TerrainTiles.find(TerrainLattice::GetTileIDFromXY(latticeX, latticeY));
 	if(iter != m_TerrainTiles.end())
 	{
@@ -313,4 +316,30 @@ Terrain * CDynamicTerrainLoader::LoadTerrainAt(Terrain *pTerrain, int latticeX,
 		}
 	}
 	return pTerrain;
+}
+
+Terrain * CDynamicTerrainLoader::PrepareTerrainAt(int latticeX, int latticeY, bool useGeoMipmap)
+{
+	Terrain* pTerrain = new Terrain();
+	pTerrain->m_useGeoMipmap = useGeoMipmap;
+	pTerrain->SetLatticePosition(latticeX, latticeY);
+	pTerrain->SetOffset(latticeX * GetTerrainWidth(), latticeY * GetTerrainHeight());
+
+	int nTileID = TerrainLattice::GetTileIDFromXY(latticeX, latticeY);
+	string sConfigFileName;
+	{
+		ParaEngine::Lock lock_(m_mutex);
+		map<int, TerrainTileInfo>::iterator iter = m_TerrainTiles.find(nTileID);
+		if(iter != m_TerrainTiles.end() && (*iter).second.m_bIsValid)
+			sConfigFileName = (*iter).second.m_sConfigFileName;
+	}
+	// do not hold the lock while loading, so that the main thread is never blocked by file IO. 
+	if(!sConfigFileName.empty() && !pTerrain->LoadFromConfigFile(sConfigFileName.c_str(), m_fTileSize, m_sConfigFilePath.c_str(), true))
+	{
+		ParaEngine::Lock lock_(m_mutex);
+		map<int, TerrainTileInfo>::iterator iter = m_TerrainTiles.find(nTileID);
+		if(iter != m_TerrainTiles.end() && (*iter).second.m_sConfigFileName == sConfigFileName)
+			(*iter).second.m_bIsValid = false;
+	}
+	return pTerrain;
 }
\ No newline at end of file
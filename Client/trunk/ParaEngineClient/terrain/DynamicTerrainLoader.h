@@ -1,5 +1,6 @@
 #pragma once
 #include "TerrainLattice.h"
+#include "util/mutex.h"
 
 #include <map>
 #include <string>
@@ -29,6 +30,8 @@ namespace ParaTerrain
 		map <int, TerrainTileInfo> m_TerrainTiles;
 		float m_fTileSize;
 		string m_sConfigFilePath;
+		/** guard m_TerrainTiles, since PrepareTerrainAt() is called from a background thread. */
+		ParaEngine::mutex m_mutex;
 
 		void Cleanup();
 		void LoadFromFile(const char* sConfigFile);
@@ -39,6 +42,10 @@ namespace ParaTerrain
 		* @return: the loaded terrain object is returned.
 		*/
 		virtual Terrain * LoadTerrainAt(Terrain *pTerrain, int latticeX, int latticeY ,bool useGeoMipmap = false);
+		/** create a terrain tile in a background thread with its textures and regions deferred. see Terrain::LoadFromConfigFile()
+		* this function will always return a valid terrain. 
+		*/
+		virtual Terrain * PrepareTerrainAt(int latticeX, int latticeY, bool useGeoMipmap = false);
 		/** \brief Called by the TerrainLattice when a Terrain object in the lattice is no longer within the visible region and can, therefore, be disposed of, freeing RAM for other visible Terrain objects.
 		* @param pTerrain: the terrain object will be reduced a blank terrain after calling this function.
 		*/
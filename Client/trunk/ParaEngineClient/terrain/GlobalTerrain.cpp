@@ -554,6 +554,26 @@ float CGlobalTerrain::GetElevation(float x, float y)
 	return m_fDefaultHeight;
 }
 
+void CGlobalTerrain::GetElevations(int nCount, const Vector3* pPoints, float* pOutElevations)
+{
+	if (nCount <= 0)
+		return;
+	if (m_nTerrainType == LATTICED_TERRAIN && m_pTerrainLattice)
+	{
+		m_pTerrainLattice->GetElevations(nCount, &(pPoints[0].x), &(pPoints[0].z), 3, pOutElevations);
+	}
+	else if (m_nTerrainType == SINGLE_TERRAIN && m_pTerrainSingle)
+	{
+		for (int i = 0; i < nCount; ++i)
+			pOutElevations[i] = m_pTerrainSingle->GetElevationW(pPoints[i].x, pPoints[i].z);
+	}
+	else
+	{
+		for (int i = 0; i < nCount; ++i)
+			pOutElevations[i] = m_fDefaultHeight;
+	}
+}
+
 // TODO: untested
 void CGlobalTerrain::SetVertexElevation(float x, float y, float fHeight)
 {
@@ -629,6 +649,19 @@ float CGlobalTerrain::IntersectRay(float startX, float startY, float startZ, flo
 	return fDist;
 }
 
+void CGlobalTerrain::IntersectRays(int nCount, const Vector3* pOrigins, const Vector3* pDirs, float* pOutDistances, Vector3* pOutHits, float fMaxDistance)
+{
+	Vector3 vHit;
+	for (int i = 0; i < nCount; ++i)
+	{
+		const Vector3& vOrig = pOrigins[i];
+		const Vector3& vDir = pDirs[i];
+		pOutDistances[i] = IntersectRay(vOrig.x, vOrig.y, vOrig.z, vDir.x, vDir.y, vDir.z, vHit.x, vHit.y, vHit.z, fMaxDistance);
+		if (pOutHits)
+			pOutHits[i] = vHit;
+	}
+}
+
 void CGlobalTerrain::InitDeviceObjects()
 {
 	if (m_nTerrainType == LATTICED_TERRAIN)
@@ -700,6 +733,29 @@ void CGlobalTerrain::GetNormal(float x, float y, float &normalX, float &normalY,
 	normalZ = 0;
 }
 
+void CGlobalTerrain::GetNormals(int nCount, const Vector3* pPoints, Vector3* pOutNormals)
+{
+	if (nCount <= 0)
+		return;
+	// secretly swap y,z, since the terrain use z as the terrain height.
+	if (m_nTerrainType == LATTICED_TERRAIN && m_pTerrainLattice)
+	{
+		m_pTerrainLattice->GetNormals(nCount, &(pPoints[0].x), &(pPoints[0].z), 3, &(pOutNormals[0].x));
+		for (int i = 0; i < nCount; ++i)
+			std::swap(pOutNormals[i].y, pOutNormals[i].z);
+	}
+	else if (m_nTerrainType == SINGLE_TERRAIN && m_pTerrainSingle)
+	{
+		for (int i = 0; i < nCount; ++i)
+			m_pTerrainSingle->GetNormalW(pPoints[i].x, pPoints[i].z, pOutNormals[i].x, pOutNormals[i].z, pOutNormals[i].y);
+	}
+	else
+	{
+		for (int i = 0; i < nCount; ++i)
+			pOutNormals[i] = Vector3(0, 1.f, 0);
+	}
+}
+
 void CGlobalTerrain::Paint(TextureEntity* detailTexture, float brushRadius, float brushIntensity, float maxIntensity, bool erase, float x, float y)
 {
 	if (brushRadius <= 0)
@@ -1110,6 +1166,52 @@ void CGlobalTerrain::SetMaxTileCacheSize(int nNum)
 	}
 }
 
+void CGlobalTerrain::SetAsyncTileLoading(bool bEnable)
+{
+	if (m_nTerrainType == LATTICED_TERRAIN && m_pTerrainLattice)
+		m_pTerrainLattice->SetAsyncLoading(bEnable);
+}
+
+bool CGlobalTerrain::IsAsyncTileLoading()
+{
+	if (m_nTerrainType == LATTICED_TERRAIN && m_pTerrainLattice)
+		return m_pTerrainLattice->IsAsyncLoading();
+	return false;
+}
+
+void CGlobalTerrain::SetTilePrefetchRadius(int nRadius)
+{
+	if (m_nTerrainType == LATTICED_TERRAIN && m_pTerrainLattice)
+		m_pTerrainLattice->SetPrefetchRadius(nRadius);
+}
+
+int CGlobalTerrain::GetTilePrefetchRadius()
+{
+	if (m_nTerrainType == LATTICED_TERRAIN && m_pTerrainLattice)
+		return m_pTerrainLattice->GetPrefetchRadius();
+	return 0;
+}
+
+void CGlobalTerrain::SetTileMemoryBudget(int nMB)
+{
+	if (m_nTerrainType == LATTICED_TERRAIN && m_pTerrainLattice)
+		m_pTerrainLattice->SetTileMemoryBudget(nMB);
+}
+
+int CGlobalTerrain::GetTileMemoryBudget()
+{
+	if (m_nTerrainType == LATTICED_TERRAIN && m_pTerrainLattice)
+		return m_pTerrainLattice->GetTileMemoryBudget();
+	return 0;
+}
+
+int CGlobalTerrain::GetPendingTileCount()
+{
+	if (m_nTerrainType == LATTICED_TERRAIN && m_pTerrainLattice)
+		return m_pTerrainLattice->GetPendingTileCount();
+	return 0;
+}
+
 #pragma region settings
 bool CGlobalTerrain::IsVerbose()
 {
@@ -1235,6 +1337,11 @@ int CGlobalTerrain::InstallFields(CAttributeClass* pClass, bool bOverride)
 	pClass->AddField("BlockSelectionTexture", FieldType_String, (void*)SetBlockSelectionTexture_s, NULL, NULL, "", bOverride);
 
 	pClass->AddField("DefaultHeight", FieldType_Float, (void*)SetDefaultHeight_s, (void*)GetDefaultHeight_s, NULL, NULL, bOverride);
+
+	pClass->AddField("AsyncTileLoading", FieldType_Bool, (void*)SetAsyncTileLoading_s, (void*)IsAsyncTileLoading_s, NULL, NULL, bOverride);
+	pClass->AddField("TilePrefetchRadius", FieldType_Int, (void*)SetTilePrefetchRadius_s, (void*)GetTilePrefetchRadius_s, NULL, NULL, bOverride);
+	pClass->AddField("TileMemoryBudget", FieldType_Int, (void*)SetTileMemoryBudget_s, (void*)GetTileMemoryBudget_s, NULL, NULL, bOverride);
+	pClass->AddField("PendingTileCount", FieldType_Int, NULL, (void*)GetPendingTileCount_s, NULL, NULL, bOverride);
 	return S_OK;
 }
 
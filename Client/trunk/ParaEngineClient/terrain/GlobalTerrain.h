@@ -85,6 +85,17 @@ namespace ParaTerrain
 		ATTRIBUTE_METHOD1(CGlobalTerrain, GetDefaultHeight_s, float*)	{ *p1 = cls->GetDefaultHeight(); return S_OK; }
 		ATTRIBUTE_METHOD1(CGlobalTerrain, SetDefaultHeight_s, float)	{ cls->SetDefaultHeight(p1); return S_OK; }
 
+		ATTRIBUTE_METHOD1(CGlobalTerrain, IsAsyncTileLoading_s, bool*)	{ *p1 = cls->IsAsyncTileLoading(); return S_OK; }
+		ATTRIBUTE_METHOD1(CGlobalTerrain, SetAsyncTileLoading_s, bool)	{ cls->SetAsyncTileLoading(p1); return S_OK; }
+
+		ATTRIBUTE_METHOD1(CGlobalTerrain, GetTilePrefetchRadius_s, int*)	{ *p1 = cls->GetTilePrefetchRadius(); return S_OK; }
+		ATTRIBUTE_METHOD1(CGlobalTerrain, SetTilePrefetchRadius_s, int)	{ cls->SetTilePrefetchRadius(p1); return S_OK; }
+
+		ATTRIBUTE_METHOD1(CGlobalTerrain, GetTileMemoryBudget_s, int*)	{ *p1 = cls->GetTileMemoryBudget(); return S_OK; }
+		ATTRIBUTE_METHOD1(CGlobalTerrain, SetTileMemoryBudget_s, int)	{ cls->SetTileMemoryBudget(p1); return S_OK; }
+
+		ATTRIBUTE_METHOD1(CGlobalTerrain, GetPendingTileCount_s, int*)	{ *p1 = cls->GetPendingTileCount(); return S_OK; }
+
 		ATTRIBUTE_METHOD1(CGlobalTerrain, IsGeoMipmapTerrain_s, bool*)	{*p1 =cls->IsGeoMipmapTerrain(); return S_OK;}
 		ATTRIBUTE_METHOD1(CGlobalTerrain, SetGeoMipmapTerrain_s, bool)	{cls->SetGeoMipmapTerrain(p1); return S_OK;}
 		 
@@ -185,6 +196,13 @@ namespace ParaTerrain
 		/** get elevation at the world position. */
 		float GetElevation(float x, float y);
 
+		/** get elevations of many world positions in one call, which is much faster than calling GetElevation() for each 
+		* position, since the terrain tile is only looked up when it changes between consecutive positions. 
+		* @param pPoints: array of nCount world positions, whose x and z are used. 
+		* @param pOutElevations: array of nCount elevations. 
+		*/
+		void GetElevations(int nCount, const Vector3* pPoints, float* pOutElevations);
+
 		/** get value of a given terrain region layer 
 		* @param x The x location of the point on the Terrain's surface in world units.
 		* @param y The y location of the point on the Terrain's surface in world units.
@@ -226,6 +244,13 @@ namespace ParaTerrain
 		*/
 		float IntersectRay(float startX, float startY, float startZ, float dirX, float dirY, float dirZ, float &intersectX, float &intersectY, float &intersectZ, float fMaxDistance = 999999999.0f);
 
+		/** same as IntersectRay() for many rays in one call. 
+		* @param pOrigins, pDirs: array of nCount rays in world coordinates. directions should be normalized.
+		* @param pOutDistances: array of nCount distances, negative if the ray misses the terrain. 
+		* @param pOutHits: NULL or array of nCount intersection points. 
+		*/
+		void IntersectRays(int nCount, const Vector3* pOrigins, const Vector3* pDirs, float* pOutDistances, Vector3* pOutHits = NULL, float fMaxDistance = 999999999.0f);
+
 		/// \brief Returns the surface normal of the terrain at the specified point.
 		/// \param x The x location of the point on the Terrain's surface in world units.
 		/// \param y The y location of the point on the Terrain's surface in world units.
@@ -234,6 +259,12 @@ namespace ParaTerrain
 		/// \param normalZ Gets filled with the surface normal z component
 		void GetNormal(float x, float y, float &normalX, float &normalY, float &normalZ);
 
+		/** get surface normals of many world positions in one call. see GetElevations() 
+		* @param pPoints: array of nCount world positions, whose x and z are used. 
+		* @param pOutNormals: array of nCount normals, where y is up. 
+		*/
+		void GetNormals(int nCount, const Vector3* pPoints, Vector3* pOutNormals);
+
 		/**
 		* Create and set the single tile based global terrain from height map and texture files.
 		* this function can be called multiple times, in which cases previously loaded single terrain will be discarded.
@@ -571,6 +602,21 @@ namespace ParaTerrain
 		*/
 		void SetMaxTileCacheSize(int nNum);
 
+		/** whether latticed terrain tiles are loaded in a background thread. default to false. see TerrainLattice::SetAsyncLoading() */
+		void SetAsyncTileLoading(bool bEnable);
+		bool IsAsyncTileLoading();
+
+		/** the number of tiles around the camera tile to load, default to 1. see TerrainLattice::SetPrefetchRadius() */
+		void SetTilePrefetchRadius(int nRadius);
+		int GetTilePrefetchRadius();
+
+		/** the system memory budget of cached tiles in MB, 0 (default) for no budget. see TerrainLattice::SetTileMemoryBudget() */
+		void SetTileMemoryBudget(int nMB);
+		int GetTileMemoryBudget();
+
+		/** get the number of tiles being loaded in the background. */
+		int GetPendingTileCount();
+
 		/** set whether we will encode terrain related files. default to true.
 		* By enabling path encoding, terrain related files like "worlddir/worldfile.txt" will be saved as "%WORLD%/worldfile.txt", thus 
 		* even the entire world directory changes, the world files can still be found using path variables. Path encoding needs to be disabled when you are creating a template world.
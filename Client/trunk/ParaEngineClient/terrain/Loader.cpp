@@ -44,11 +44,11 @@ HRESULT Loader::LoadHoleFile(Terrain * pTerrain, const char * szFilename, short
 	return S_OK;
 }
 
-HRESULT Loader::LoadElevations( float **ppImageData, int* nSize, const char * szFilename, bool swapVertical /*= true*/)
+HRESULT Loader::LoadElevations( float **ppImageData, int* nSize, const char * szFilename, bool swapVertical /*= true*/, const char* sMediaPath)
 {
 	float* pImageData = NULL;
 	CParaFile cFile;
-	cFile.OpenAssetFile(szFilename, true, ParaTerrain::Settings::GetInstance()->GetMediaPath());
+	cFile.OpenAssetFile(szFilename, true, sMediaPath ? sMediaPath : ParaTerrain::Settings::GetInstance()->GetMediaPath());
 	if(cFile.isEof())
 		return E_FAIL;
 	
@@ -194,14 +194,14 @@ HRESULT Loader::LoadElevations( float **ppImageData, int* nSize, const char * sz
 	return S_OK;
 }
 
-HRESULT Loader::LoadElevations( Terrain * pTerrain, const char * szFilename, float fTerrainSize, float elevationScale, bool swapVertical /*= true*/ )
+HRESULT Loader::LoadElevations( Terrain * pTerrain, const char * szFilename, float fTerrainSize, float elevationScale, bool swapVertical /*= true*/, const char* sMediaPath)
 {
     HRESULT hr;
 
 	float *pImageData = NULL;
 
 	int elevWidth = 0, elevHeight = 0;
-	if(SUCCEEDED(hr = LoadElevations(&pImageData, &elevWidth, szFilename, swapVertical)))
+	if(SUCCEEDED(hr = LoadElevations(&pImageData, &elevWidth, szFilename, swapVertical, sMediaPath)))
 	{
 		if(pImageData != NULL)
 		{
@@ -220,10 +220,10 @@ HRESULT Loader::LoadElevations( Terrain * pTerrain, const char * szFilename, flo
     return hr;
 }
 
-HRESULT Loader::LoadTerrainInfo(Terrain *pTerrain,const char* szFilename)
+HRESULT Loader::LoadTerrainInfo(Terrain *pTerrain,const char* szFilename, const char* sMediaPath)
 {
 	CParaFile cFile;
-	cFile.OpenAssetFile(szFilename,true,ParaTerrain::Settings::GetInstance()->GetMediaPath());
+	cFile.OpenAssetFile(szFilename,true,sMediaPath ? sMediaPath : ParaTerrain::Settings::GetInstance()->GetMediaPath());
 	if(cFile.isEof())
 		return E_FAIL;
 
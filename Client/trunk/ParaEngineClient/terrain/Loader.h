@@ -24,9 +24,11 @@ namespace ParaTerrain
 		* @param fTerrainSize size of the terrain
 		* @param elevationScale 
 		* @param swapVertical whether swap vertically of the loaded height map
+		* @param sMediaPath: relative path to search the file in. If NULL, Settings::GetMediaPath() is used. 
+		*  Pass it explicitly when loading from a background thread, since the media path in Settings is shared. 
 		* @return S_OK if succeeded.
 		*/
-		HRESULT LoadElevations( Terrain * pTerrain, const char * szFilename, float fTerrainSize, float elevationScale, bool swapVertical=TRUE );
+		HRESULT LoadElevations( Terrain * pTerrain, const char * szFilename, float fTerrainSize, float elevationScale, bool swapVertical=TRUE, const char* sMediaPath = NULL);
 
 		/**
 		* load elevation to a buffer. 
@@ -34,9 +36,10 @@ namespace ParaTerrain
 		* @param nSize [out]: the output size of the terrain.
 		* @param szFilename : file name to extract the data. it can either be a gray scale image or a raw elevation file containing just float value arrays. 
 		* @param swapVertical whether swap vertically of the loaded height map
+		* @param sMediaPath: relative path to search the file in. If NULL, Settings::GetMediaPath() is used.
 		* @return S_OK if succeeded.
 		*/
-		HRESULT LoadElevations( float **ppImageData, int* nSize, const char * szFilename, bool swapVertical=TRUE);
+		HRESULT LoadElevations( float **ppImageData, int* nSize, const char * szFilename, bool swapVertical=TRUE, const char* sMediaPath = NULL);
 
 		/// [absoleted: holes are specified in terrain config file]
 		/// Load the terrain hole file. Terrain hole file is currently encoded the same with RAW elevation file. 
@@ -52,7 +55,8 @@ namespace ParaTerrain
 		void LoadCommonTerrainTexture(Terrain * pTerrain, const char * fileName);
 
 
-		HRESULT LoadTerrainInfo(Terrain *pTerrain,const char* szFilename);
+		/** @param sMediaPath: relative path to search the file in. If NULL, Settings::GetMediaPath() is used. */
+		HRESULT LoadTerrainInfo(Terrain *pTerrain,const char* szFilename, const char* sMediaPath = NULL);
 	private:
 		  Loader();
 		 ~Loader();
@@ -30,6 +30,7 @@
 #include "AsyncLoader.h"
 #include "AssetManifest.h"
 #include "util/regularexpression.h"
+#include "util/ParaTime.h"
 
 #include "memdebug.h"
 
@@ -143,6 +144,7 @@ void Terrain::Cleanup()
 	SAFE_DELETE(m_pTerrainInfoData);
 
 	SAFE_DELETE(m_pMaskFileCallbackData);
+	SAFE_DELETE(m_pDeferredLoad);
 
 	for (uint32 i = 0; i < m_TextureCells.size(); i++)
 	{
@@ -176,6 +178,7 @@ void Terrain::Init(int maxNumTriangles, float offsetX, float offsetY)
 	m_dwModified = MODIFIED_NONE;
 	m_NumberOfTextureTilesWidth = m_NumberOfTextureTilesHeight = m_NumberOfTextureTiles = 0;
 	m_WidthVertices = m_HeightVertices = 0;
+	m_bHeightPyramidDirty = true;
 	m_refCount = 0;
 	m_NumberOfVertices = 0;
 	m_pCommonTexture = NULL;
@@ -200,6 +203,7 @@ void Terrain::Init(int maxNumTriangles, float offsetX, float offsetY)
 
 	m_pRegions = NULL;
 	m_pMaskFileCallbackData = NULL;
+	m_pDeferredLoad = NULL;
 	m_bMaskFileInited = true;
 
 	m_useGeoMipmap = false;
@@ -980,13 +984,17 @@ void Terrain::SetVertexElevation(int index, float newElevation, bool recalculate
 	if(m_pRootBlock==NULL)
 		return;
 	if (0 <= index && index < m_NumberOfVertices)
+	{
 		m_pVertices[index].z = newElevation;
+		m_bHeightPyramidDirty = true;
+	}
 	if (recalculate_geometry)
 		m_pRootBlock->VertexChanged(this, index);
 }
 
 void Terrain::RecalcGeometry()
 {
+	m_bHeightPyramidDirty = true;
 	if(m_pRootBlock==NULL)
 		return;
 	m_pRootBlock->VertexChanged(this);
@@ -1000,6 +1008,7 @@ void Terrain::RecalcGeometry()
 
 void Terrain::RecalcGeometry(int index1, int index2)
 {
+	m_bHeightPyramidDirty = true;
 	if(m_pRootBlock==NULL)
 		return;
 	m_pRootBlock->VertexChanged(this, index1, index2);
@@ -1019,6 +1028,7 @@ float Terrain::GetVertexSpacing() const
 
 void Terrain::BuildBlocks()
 {
+	m_bHeightPyramidDirty = true;
 #if _USE_RAYTRACING_SUPPORT_ == 0
 	if (Settings::GetInstance()->IsHeadless())
 		return;
@@ -2976,7 +2986,195 @@ float Terrain::IntersectRayW(float startX, float startY, float startZ, float dir
 	return fDist;
 }
 
+/** two sided ray triangle intersection. 
+* @param fDistance: [out] distance along the ray in units of vDir */
+static bool RayIntersectTriangle(const Vector3& vOrig, const Vector3& vDir, const Vector3& v0, const Vector3& v1, const Vector3& v2, float& fDistance)
+{
+	Vector3 vEdge1 = v1 - v0;
+	Vector3 vEdge2 = v2 - v0;
+	Vector3 vP = vDir.crossProduct(vEdge2);
+	float fDet = vEdge1.dotProduct(vP);
+	if (fabs(fDet) < 1e-8f)
+		return false;
+	float fInvDet = 1.f / fDet;
+	Vector3 vT = vOrig - v0;
+	float u = vT.dotProduct(vP) * fInvDet;
+	if (u < 0.f || u > 1.f)
+		return false;
+	Vector3 vQ = vT.crossProduct(vEdge1);
+	float v = vDir.dotProduct(vQ) * fInvDet;
+	if (v < 0.f || (u + v) > 1.f)
+		return false;
+	fDistance = vEdge2.dotProduct(vQ) * fInvDet;
+	return fDistance >= 0.f;
+}
+
+void Terrain::BuildHeightPyramid()
+{
+	m_bHeightPyramidDirty = false;
+	m_heightPyramid.clear();
+	m_heightPyramidLevels.clear();
+	if (m_pVertices == NULL || m_WidthVertices < 2 || m_HeightVertices < 2)
+		return;
+
+	HeightPyramidLevel level = { 0, m_WidthVertices - 1, m_HeightVertices - 1 };
+	m_heightPyramid.resize(level.m_nCols * level.m_nRows);
+	for (int nRow = 0; nRow < level.m_nRows; ++nRow)
+	{
+		for (int nCol = 0; nCol < level.m_nCols; ++nCol)
+		{
+			int nIndex = nRow * m_WidthVertices + nCol;
+			float z0 = m_pVertices[nIndex].z;
+			float z1 = m_pVertices[nIndex + 1].z;
+			float z2 = m_pVertices[nIndex + m_WidthVertices].z;
+			float z3 = m_pVertices[nIndex + m_WidthVertices + 1].z;
+			HeightRange& range = m_heightPyramid[nRow * level.m_nCols + nCol];
+			range.m_fMin = min(min(z0, z1), min(z2, z3));
+			range.m_fMax = max(max(z0, z1), max(z2, z3));
+		}
+	}
+	m_heightPyramidLevels.push_back(level);
+
+	while (level.m_nCols > 1 || level.m_nRows > 1)
+	{
+		HeightPyramidLevel parent = { (int)m_heightPyramid.size(), (level.m_nCols + 1) / 2, (level.m_nRows + 1) / 2 };
+		m_heightPyramid.resize(parent.m_nOffset + parent.m_nCols * parent.m_nRows);
+		for (int nRow = 0; nRow < parent.m_nRows; ++nRow)
+		{
+			for (int nCol = 0; nCol < parent.m_nCols; ++nCol)
+			{
+				HeightRange range = m_heightPyramid[level.m_nOffset + (nRow * 2) * level.m_nCols + nCol * 2];
+				for (int i = 1; i < 4; ++i)
+				{
+					int nChildCol = nCol * 2 + (i & 1);
+					int nChildRow = nRow * 2 + (i >> 1);
+					if (nChildCol < level.m_nCols && nChildRow < level.m_nRows)
+					{
+						const HeightRange& child = m_heightPyramid[level.m_nOffset + nChildRow * level.m_nCols + nChildCol];
+						range.m_fMin = min(range.m_fMin, child.m_fMin);
+						range.m_fMax = max(range.m_fMax, child.m_fMax);
+					}
+				}
+				m_heightPyramid[parent.m_nOffset + nRow * parent.m_nCols + nCol] = range;
+			}
+		}
+		m_heightPyramidLevels.push_back(parent);
+		level = parent;
+	}
+}
+
+void Terrain::IntersectRayHeightCell(int nLevel, int nCol, int nRow, const Vector3& vOrig, const Vector3& vDir, float& fLowestDistance, Vector3& vHit)
+{
+	const HeightPyramidLevel& level = m_heightPyramidLevels[nLevel];
+	const HeightRange& range = m_heightPyramid[level.m_nOffset + nRow * level.m_nCols + nCol];
+
+	// clip the ray with the cell's bounding box, which is slightly enlarged to be conservative. 
+	const float fEpsilon = 0.001f;
+	float fCellSize = m_VertexSpacing * (1 << nLevel);
+	float vMin[3] = { nCol * fCellSize - fEpsilon, nRow * fCellSize - fEpsilon, range.m_fMin - fEpsilon };
+	float vMax[3] = { min((nCol + 1) * fCellSize, (m_WidthVertices - 1) * m_VertexSpacing) + fEpsilon,
+		min((nRow + 1) * fCellSize, (m_HeightVertices - 1) * m_VertexSpacing) + fEpsilon, range.m_fMax + fEpsilon };
+	float fNear = 0.f;
+	float fFar = fLowestDistance;
+	for (int i = 0; i < 3; ++i)
+	{
+		if (fabs(vDir[i]) < 1e-8f)
+		{
+			if (vOrig[i] < vMin[i] || vOrig[i] > vMax[i])
+				return;
+		}
+		else
+		{
+			float fInvDir = 1.f / vDir[i];
+			float t0 = (vMin[i] - vOrig[i]) * fInvDir;
+			float t1 = (vMax[i] - vOrig[i]) * fInvDir;
+			if (t0 > t1)
+				std::swap(t0, t1);
+			if (t0 > fNear)
+				fNear = t0;
+			if (t1 < fFar)
+				fFar = t1;
+			if (fNear > fFar)
+				return;
+		}
+	}
+
+	if (nLevel == 0)
+	{
+		// use the same triangulation as GetElevation()
+		int nIndex = nRow * m_WidthVertices + nCol;
+		const Vector3& v00 = m_pVertices[nIndex];
+		const Vector3& v10 = m_pVertices[nIndex + 1];
+		const Vector3& v01 = m_pVertices[nIndex + m_WidthVertices];
+		const Vector3& v11 = m_pVertices[nIndex + m_WidthVertices + 1];
+		float fDistance;
+		if (m_useGeoMipmap)
+		{
+			if (RayIntersectTriangle(vOrig, vDir, v00, v10, v11, fDistance) && fDistance < fLowestDistance)
+			{
+				fLowestDistance = fDistance;
+				vHit = vOrig + vDir * fDistance;
+			}
+			if (RayIntersectTriangle(vOrig, vDir, v00, v11, v01, fDistance) && fDistance < fLowestDistance)
+			{
+				fLowestDistance = fDistance;
+				vHit = vOrig + vDir * fDistance;
+			}
+		}
+		else
+		{
+			if (RayIntersectTriangle(vOrig, vDir, v00, v01, v10, fDistance) && fDistance < fLowestDistance)
+			{
+				fLowestDistance = fDistance;
+				vHit = vOrig + vDir * fDistance;
+			}
+			if (RayIntersectTriangle(vOrig, vDir, v10, v01, v11, fDistance) && fDistance < fLowestDistance)
+			{
+				fLowestDistance = fDistance;
+				vHit = vOrig + vDir * fDistance;
+			}
+		}
+		return;
+	}
+
+	// visit children front to back along the ray, so that farther children are mostly rejected by fLowestDistance. 
+	const HeightPyramidLevel& child = m_heightPyramidLevels[nLevel - 1];
+	int nFlipX = (vDir.x < 0.f) ? 1 : 0;
+	int nFlipY = (vDir.y < 0.f) ? 1 : 0;
+	for (int i = 0; i < 4; ++i)
+	{
+		int nChildCol = nCol * 2 + ((i & 1) ^ nFlipX);
+		int nChildRow = nRow * 2 + ((i >> 1) ^ nFlipY);
+		if (nChildCol < child.m_nCols && nChildRow < child.m_nRows)
+			IntersectRayHeightCell(nLevel - 1, nChildCol, nChildRow, vOrig, vDir, fLowestDistance, vHit);
+	}
+}
+
 float Terrain::IntersectRay(float startX, float startY, float startZ, float dirX, float dirY, float dirZ, float &intersectX, float &intersectY, float &intersectZ, float fMaxDistance)
+{
+	if (m_pVertices == NULL)
+		return IntersectRayBlocks(startX, startY, startZ, dirX, dirY, dirZ, intersectX, intersectY, intersectZ, fMaxDistance);
+
+	if (m_bHeightPyramidDirty)
+		BuildHeightPyramid();
+
+	float distance = fMaxDistance;
+	Vector3 point(-1.f, -1.f, -1.f);
+	if (!m_heightPyramidLevels.empty())
+		IntersectRayHeightCell((int)m_heightPyramidLevels.size() - 1, 0, 0, Vector3(startX, startY, startZ), Vector3(dirX, dirY, dirZ), distance, point);
+	intersectX = point.x;
+	intersectY = point.y;
+	intersectZ = point.z;
+
+	/// if the ray intersect with holes in the terrain, a negative value will be returned.
+	if (IsHole(intersectX, intersectY))
+	{
+		distance = -1.f;
+	}
+	return (distance >= fMaxDistance) ? -1.f : distance;
+}
+
+float Terrain::IntersectRayBlocks(float startX, float startY, float startZ, float dirX, float dirY, float dirZ, float &intersectX, float &intersectY, float &intersectZ, float fMaxDistance)
 {
 	if(m_pRootBlock == NULL)
 	{
@@ -3244,7 +3442,7 @@ DetailTexture* Terrain::GetDefaultBaseLayerMask()
 	}
 };
 
-bool Terrain::LoadFromConfigFile(const char* pFileName, float fSize, const char* pRelativePath)
+bool Terrain::LoadFromConfigFile(const char* pFileName, float fSize, const char* pRelativePath, bool bDeferResources)
 {
 	string sFileName;
 	CPathReplaceables::GetSingleton().DecodePath(sFileName, pFileName);
@@ -3310,11 +3508,34 @@ bool Terrain::LoadFromConfigFile(const char* pFileName, float fSize, const char*
 	this->SetMaximumVisibleBlockSize(MaxBlockSize);
 	this->SetDetailThreshold(DetailThreshold);
 	this->SetHighResTextureRadius(HighResRadius);
-	ParaTerrain::Settings::GetInstance()->SetMediaPath(relativePath.c_str());
-	ParaTerrain::Loader::GetInstance()->LoadElevations(this, m_sElevFile.c_str(),Size*OBJ_UNIT,ElevScale*OBJ_UNIT, Swapvertical>0);
 
-	SetBaseTexture(MainTextureFile.c_str());
-	SetCommonTexture(CommonTextureFile.c_str());
+	SAFE_DELETE(m_pDeferredLoad);
+	if(bDeferResources)
+	{
+		m_pDeferredLoad = new TerrainDeferredLoad();
+		m_pDeferredLoad->m_sFileName = pFileName;
+		m_pDeferredLoad->m_sRelativePath = relativePath;
+		m_pDeferredLoad->m_fSize = Size;
+		if(m_sElevFile.size() < 4 || m_sElevFile.compare(m_sElevFile.size()-4, 4, ".raw") != 0)
+		{
+			// image height maps are decoded with the render device
+			m_pDeferredLoad->m_bReloadAll = true;
+			m_pDeferredLoad->m_fSize = fSize;
+			return true;
+		}
+		// the media path in settings is shared by all threads, so pass it explicitly. 
+		ParaTerrain::Loader::GetInstance()->LoadElevations(this, m_sElevFile.c_str(),Size*OBJ_UNIT,ElevScale*OBJ_UNIT, Swapvertical>0, relativePath.c_str());
+		m_pDeferredLoad->m_sMainTextureFile = MainTextureFile;
+		m_pDeferredLoad->m_sCommonTextureFile = CommonTextureFile;
+	}
+	else
+	{
+		ParaTerrain::Settings::GetInstance()->SetMediaPath(relativePath.c_str());
+		ParaTerrain::Loader::GetInstance()->LoadElevations(this, m_sElevFile.c_str(),Size*OBJ_UNIT,ElevScale*OBJ_UNIT, Swapvertical>0);
+
+		SetBaseTexture(MainTextureFile.c_str());
+		SetCommonTexture(CommonTextureFile.c_str());
+	}
 	
 
 	/// add terrain holes
@@ -3336,7 +3557,10 @@ bool Terrain::LoadFromConfigFile(const char* pFileName, float fSize, const char*
 	if(NumOfDetailTextures>0)
 	{
 		// read data from the mask file.
-		LoadMaskFromDisk(true);
+		if(m_pDeferredLoad)
+			m_pDeferredLoad->m_bLoadMask = true;
+		else
+			LoadMaskFromDisk(true);
 	}
 
 	/// get regions layers
@@ -3344,13 +3568,16 @@ bool Terrain::LoadFromConfigFile(const char* pFileName, float fSize, const char*
 	bLineProcessed = cFile.GetNextAttribute("NumOfRegions", NumOfRegions);
 	if(NumOfDetailTextures>0)
 	{
-		CTerrainRegions* pRegions = CreateGetRegions();
+		CTerrainRegions* pRegions = NULL;
+		if(m_pDeferredLoad == 0)
+		{
+			pRegions = CreateGetRegions();
+			pRegions->SetSize(Size, Size);
+		}
 		
 		string regionName;
 		string regionFilePath;
 
-		pRegions->SetSize(Size, Size);
-
 		regex re("\\((\\w+), ([^\\)]+)\\)");
 
 		char line[MAX_LINE+1];
@@ -3364,7 +3591,10 @@ bool Terrain::LoadFromConfigFile(const char* pFileName, float fSize, const char*
 				{
 					regionName = match.str(1);
 					regionFilePath = match.str(2);
-					pRegions->LoadRegion(regionName, regionFilePath.c_str());
+					if(pRegions)
+						pRegions->LoadRegion(regionName, regionFilePath.c_str());
+					else
+						m_pDeferredLoad->m_regions.push_back(std::make_pair(regionName, regionFilePath));
 				}
 			}
 		}
@@ -3404,6 +3634,11 @@ bool Terrain::LoadFromConfigFile(const char* pFileName, float fSize, const char*
 #endif
 	SetModified(false);
 
+	if(m_pDeferredLoad)
+	{
+		ParaTerrain::Loader::GetInstance()->LoadTerrainInfo(this,m_terrInfoFile.c_str(), relativePath.c_str());
+		return true;
+	}
 	ParaTerrain::Loader::GetInstance()->LoadTerrainInfo(this,m_terrInfoFile.c_str());
 	
 	if(m_useGeoMipmap)
@@ -3412,6 +3647,57 @@ bool Terrain::LoadFromConfigFile(const char* pFileName, float fSize, const char*
 	return true;
 }
 
+void Terrain::LoadDeferredResources()
+{
+	if(m_pDeferredLoad == 0)
+		return;
+	TerrainDeferredLoad* pLoad = m_pDeferredLoad;
+	m_pDeferredLoad = NULL;
+	if(pLoad->m_bReloadAll)
+	{
+		LoadFromConfigFile(pLoad->m_sFileName.c_str(), pLoad->m_fSize, pLoad->m_sRelativePath.c_str());
+	}
+	else
+	{
+		ParaTerrain::Settings::GetInstance()->SetMediaPath(pLoad->m_sRelativePath.c_str());
+		SetBaseTexture(pLoad->m_sMainTextureFile.c_str());
+		SetCommonTexture(pLoad->m_sCommonTextureFile.c_str());
+		if(pLoad->m_bLoadMask)
+			LoadMaskFromDisk(true);
+		if(!pLoad->m_regions.empty())
+		{
+			CTerrainRegions* pRegions = CreateGetRegions();
+			pRegions->SetSize(pLoad->m_fSize, pLoad->m_fSize);
+			for (size_t i = 0; i < pLoad->m_regions.size(); ++i)
+			{
+				pRegions->LoadRegion(pLoad->m_regions[i].first, pLoad->m_regions[i].second.c_str());
+			}
+		}
+		SetModified(false);
+		if(m_useGeoMipmap)
+			BuildGeoMipmapBuffer();
+	}
+	delete pLoad;
+}
+
+int Terrain::GetMemorySize() const
+{
+	int nSize = sizeof(Terrain);
+	if(m_pVertices)
+		nSize += m_NumberOfVertices * sizeof(Vector3);
+	if(m_pNormals)
+		nSize += m_NumberOfVertices * sizeof(Vector3);
+	if(m_pTerrainInfoData)
+		nSize += m_NumberOfVertices * sizeof(uint32);
+	if(m_pHolemap)
+		nSize += m_nNumOfHoleVertices * sizeof(bool);
+	// a block tree has about as many blocks as vertices divided by the smallest block size of 2x2.
+	if(m_pRootBlock)
+		nSize += (m_NumberOfVertices / 4) * sizeof(TerrainBlock);
+	nSize += (int)m_heightPyramid.size() * sizeof(HeightRange);
+	return nSize;
+}
+
 void Terrain::LoadMaskFromDisk(bool bForceReload)
 {
 	
@@ -3971,3 +4257,74 @@ void Terrain::SetEditorMode(bool enable)
 	m_pEditorMeshVB.ReleaseBuffer();
 
 }
+
+#ifdef _DEBUG
+/** compare ray casts with the terrain block tree and with the min/max height pyramid on a synthetic height map, 
+* and per call and batched elevation queries on the current global terrain. */
+void Test_TerrainQueries()
+{
+	const int nSize = 257;
+	const float fTerrainSize = 533.3333f;
+	std::vector<float> elevations(nSize * nSize);
+	for (int i = 0; i < nSize; ++i)
+	{
+		for (int j = 0; j < nSize; ++j)
+			elevations[i * nSize + j] = 20.f * sinf(i * 0.05f) * cosf(j * 0.07f) + 5.f * sinf(i * 0.31f + j * 0.17f);
+	}
+	Terrain* pTerrain = new Terrain();
+	pTerrain->SetAllElevations(&(elevations[0]), nSize, nSize, fTerrainSize, 1.f);
+
+	// rays from above the terrain to random ground points, like camera and picking rays. 
+	const int nRayCount = 10000;
+	std::vector<Vector3> origins(nRayCount), dirs(nRayCount);
+	srand(1234);
+	for (int i = 0; i < nRayCount; ++i)
+	{
+		origins[i] = Vector3(fTerrainSize * rand() / RAND_MAX, fTerrainSize * rand() / RAND_MAX, 60.f);
+		Vector3 vTarget(fTerrainSize * rand() / RAND_MAX, fTerrainSize * rand() / RAND_MAX, 0.f);
+		dirs[i] = (vTarget - origins[i]).normalisedCopy();
+	}
+	std::vector<float> distances(nRayCount);
+	float x, y, z;
+	int64 nFromTime = ParaEngine::GetTimeUS();
+	for (int i = 0; i < nRayCount; ++i)
+		distances[i] = pTerrain->IntersectRayBlocks(origins[i].x, origins[i].y, origins[i].z, dirs[i].x, dirs[i].y, dirs[i].z, x, y, z);
+	int nBlocksTime = (int)(ParaEngine::GetTimeUS() - nFromTime);
+
+	// the first call builds the pyramid
+	pTerrain->IntersectRay(origins[0].x, origins[0].y, origins[0].z, dirs[0].x, dirs[0].y, dirs[0].z, x, y, z);
+	int nMismatch = 0;
+	nFromTime = ParaEngine::GetTimeUS();
+	for (int i = 0; i < nRayCount; ++i)
+	{
+		float fDist = pTerrain->IntersectRay(origins[i].x, origins[i].y, origins[i].z, dirs[i].x, dirs[i].y, dirs[i].z, x, y, z);
+		if (fabs(fDist - distances[i]) > 0.01f)
+			++nMismatch;
+	}
+	int nPyramidTime = (int)(ParaEngine::GetTimeUS() - nFromTime);
+	OUTPUT_LOG("terrain ray cast: %d rays, block tree %d us, height pyramid %d us, %d mismatches\n", nRayCount, nBlocksTime, nPyramidTime, nMismatch);
+	delete pTerrain;
+
+	// elevation queries of many agents on the current world
+	CGlobalTerrain* pGlobalTerrain = CGlobals::GetGlobalTerrain();
+	const int nPointCount = 100000;
+	std::vector<Vector3> points(nPointCount);
+	for (int i = 0; i < nPointCount; ++i)
+		points[i] = Vector3(20000.f + 500.f * rand() / RAND_MAX, 0.f, 20000.f + 500.f * rand() / RAND_MAX);
+	std::vector<float> heights(nPointCount), batchHeights(nPointCount);
+	nFromTime = ParaEngine::GetTimeUS();
+	for (int i = 0; i < nPointCount; ++i)
+		heights[i] = pGlobalTerrain->GetElevation(points[i].x, points[i].z);
+	int nPerCallTime = (int)(ParaEngine::GetTimeUS() - nFromTime);
+	nFromTime = ParaEngine::GetTimeUS();
+	pGlobalTerrain->GetElevations(nPointCount, &(points[0]), &(batchHeights[0]));
+	int nBatchTime = (int)(ParaEngine::GetTimeUS() - nFromTime);
+	nMismatch = 0;
+	for (int i = 0; i < nPointCount; ++i)
+	{
+		if (heights[i] != batchHeights[i])
+			++nMismatch;
+	}
+	OUTPUT_LOG("terrain elevation: %d points, per call %d us, batched %d us, %d mismatches\n", nPointCount, nPerCallTime, nBatchTime, nMismatch);
+}
+#endif
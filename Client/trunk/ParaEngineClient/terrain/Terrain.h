@@ -369,6 +369,23 @@ namespace ParaTerrain
 		// void operator()(int nResult, AssetFileEntry* pAssetFileEntry);
 	};
 
+	/** the part of a terrain tile config file that must be loaded in the main thread, such as textures and regions. 
+	* see Terrain::LoadFromConfigFile() and Terrain::LoadDeferredResources() */
+	struct TerrainDeferredLoad
+	{
+		TerrainDeferredLoad() :m_fSize(0.f), m_bReloadAll(false), m_bLoadMask(false){};
+		std::string m_sFileName;
+		std::string m_sRelativePath;
+		float m_fSize;
+		/** if true, the whole config file is loaded again in the main thread. */
+		bool m_bReloadAll;
+		std::string m_sMainTextureFile;
+		std::string m_sCommonTextureFile;
+		bool m_bLoadMask;
+		/** region layer name and file pairs */
+		std::vector< std::pair<std::string, std::string> > m_regions;
+	};
+
 	enum TerrainInfoType
 	{
 		tit_none = 0,
@@ -863,6 +880,10 @@ namespace ParaTerrain
 		/// \param texU Filled with the coordinate within the TextureCell where the intersection point is (range from 0.0 to 1.0.)
 		/// \param texV Filled with the coordinate within the TextureCell where the intersection point is (range from 0.0 to 1.0.)
 		float IntersectRay(float startX, float startY, float startZ, float dirX, float dirY, float dirZ, float &intersectX, float &intersectY, float &intersectZ, int &textureCellX, int &textureCellY, float &texU, float &texV, float fMaxDistance = INFINITY);
+		/// \brief same as IntersectRay, except that it tests the ray against every terrain block whose bounding box it touches, 
+		/// instead of marching through the min/max height pyramid front to back. It is slower and kept for comparison. 
+		/// IMPORTANT: it is assumed that the ray is specified in local coordinate system
+		float IntersectRayBlocks(float startX, float startY, float startZ, float dirX, float dirY, float dirZ, float &intersectX, float &intersectY, float &intersectZ, float fMaxDistance = INFINITY);
 		/// \brief Quickly find the 3D point on the terrain where a given point on the screen is (for example, for mouse picking.) 
 
 		/// This is cheaper and faster than using the ray tracing methods, but far less accurate.
@@ -1181,6 +1202,8 @@ namespace ParaTerrain
 		Vector3 *m_pNormals;
 		mutable int m_refCount;
 		CTerrainMaskFileCallbackData* m_pMaskFileCallbackData;
+		/** not NULL if the tile is loaded with bDeferResources and LoadDeferredResources() is not called yet. */
+		TerrainDeferredLoad* m_pDeferredLoad;
 	    
 		static std::map < std::string, TextureGenerator * >m_TextureGenerators;
 		int m_BaseTextureWidth, m_BaseTextureHeight;
@@ -1225,6 +1248,32 @@ namespace ParaTerrain
 		inline byte GetVertexStatus(int index){return m_pVertexStatus[index];};
 
 		void BuildBlocks();
+
+		/** min and max elevation of a cell in the height pyramid */
+		struct HeightRange
+		{
+			float m_fMin;
+			float m_fMax;
+		};
+		/** a level of the height pyramid */
+		struct HeightPyramidLevel
+		{
+			int m_nOffset;
+			int m_nCols;
+			int m_nRows;
+		};
+		/** min/max height pyramid for ray casting. level 0 has a range for each quad of the height map, and each higher level 
+		* has a range for each 2*2 cells of the level below, up to a single cell. 
+		* It is rebuilt on first use after any elevation is changed. */
+		std::vector<HeightRange> m_heightPyramid;
+		std::vector<HeightPyramidLevel> m_heightPyramidLevels;
+		bool m_bHeightPyramidDirty;
+
+		void BuildHeightPyramid();
+		/** intersect a ray with a cell of the height pyramid and its children front to back. 
+		* @param fLowestDistance: [in|out] only closer hits are accepted, and it is updated on each hit. */
+		void IntersectRayHeightCell(int nLevel, int nCol, int nRow, const Vector3& vOrig, const Vector3& vDir, float& fLowestDistance, Vector3& vHit);
+
 		void ChopTexture(const uint8 * pImage, int width, int height, int tileSize);
 		void PreloadTextures();
 		void BuildVertices(int widthVertices, int heightVertices, float vertexSpacing);
@@ -1361,9 +1410,22 @@ namespace ParaTerrain
 		* @param fSize: if fSize is not 0, it will override the size read from the configuration file
 		* @param relativePath: if sFileName is not found, it will try appending relativePath before sFileName.
 		*  relativePath is trimmed to the last slash character. i.e. "terrain/abc.txt" and "terrain/" are the same relative path.
+		* @param bDeferResources: if true, only elevations, holes and terrain info are loaded, which is safe to do in a background thread. 
+		*  Textures, masks and regions use the render device or the asset manager, so they are loaded later by LoadDeferredResources() in the main thread. 
+		*  Image height maps are decoded with the render device, so the whole file is deferred in that case. 
 		* @return : return true if succeeded
 		*/
-		bool LoadFromConfigFile(const char* sFileName, float fSize=0, const char* relativePath=NULL);
+		bool LoadFromConfigFile(const char* sFileName, float fSize=0, const char* relativePath=NULL, bool bDeferResources = false);
+
+		/** load the resources deferred by LoadFromConfigFile(). This function must be called in the main thread. */
+		void LoadDeferredResources();
+
+		/** whether LoadDeferredResources() needs to be called. */
+		bool HasDeferredResources() const { return m_pDeferredLoad != NULL; }
+
+		/** get the approximate system memory used by the height field and per vertex data of this tile in bytes.
+		* it does not include textures. */
+		int GetMemorySize() const;
 
 		/** this function is automatically called after the terrain has been loaded. 
 		* it usually does the following things in the given order: 
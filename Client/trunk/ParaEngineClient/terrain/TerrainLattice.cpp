@@ -11,6 +11,7 @@
 #include "WorldInfo.h"
 #include "OceanManager.h"
 #include "TTerrain.h"
+#include "AsyncLoader.h"
 
 #include "memdebug.h"
  
@@ -21,6 +22,9 @@ using namespace ParaEngine;
 /** @def set how many terrain tile(including height fields, etc) are cached in memory. */
 #define DEFAULT_TERRAIN_TILE_CACHE_SIZE	18
 
+/** @def the largest number of tiles evicted in a single frame. */
+#define MAX_EVICTED_TILES_PER_FRAME	4
+
 /** @def the smallest y scale. */
 #define MIN_Y_SCALE		0.0001f
 
@@ -28,8 +32,9 @@ using namespace ParaTerrain;
 using namespace std;
 
 TerrainLattice::TerrainLattice(TerrainLatticeLoader * pLoader,bool useGeoMipmap)
-	:m_bIsGlobalConfigModified(false)
+	:m_bAsyncLoading(false), m_nPrefetchRadius(1), m_nTileMemoryBudget(0), m_bIsGlobalConfigModified(false)
 {
+	m_pAsyncState.reset(new TerrainLatticeAsyncState(this, pLoader));
 	m_pLoader = pLoader;
 	m_nMaxCacheSize = DEFAULT_TERRAIN_TILE_CACHE_SIZE;
 	
@@ -54,6 +59,12 @@ TerrainLattice::TerrainLattice(TerrainLatticeLoader * pLoader,bool useGeoMipmap)
 
 TerrainLattice::~TerrainLattice()
 {
+	{
+		// tiles still being loaded are discarded. this also waits for the tile being prepared in the background.
+		ParaEngine::Lock lock_(m_pAsyncState->m_mutex);
+		m_pAsyncState->m_pLattice = NULL;
+		m_pAsyncState->m_pLoader = NULL;
+	}
 	if (m_pIndices)
 		m_pIndices.ReleaseBuffer();
 	
@@ -223,8 +234,9 @@ Terrain *TerrainLattice::GetTerrainRelative(Terrain * pTerrain, int positionX, i
 		pTerrainCenter->GetLatticePosition(centerX, centerY);
 		if (abs(x - centerX) <= m_WidthActiveTerrains && abs(y - centerY) <= m_HeightActiveTerrains)
 		{
+			// a neighbour that is still loading is stitched after it is loaded.
 			if (0 <= x && 0 <= y)
-				pRequestedTerrain = GetTerrain(x, y);
+				pRequestedTerrain = GetTerrainAsync(x, y);
 		}
 	}
 	return pRequestedTerrain;
@@ -244,28 +256,108 @@ Terrain * TerrainLattice::LoadTerrain(int index)
 	if(GetXYFromTileID(index, &indexX, &indexY))
 	{
 		pTerrain = m_pLoader->LoadTerrainAt( NULL, indexX, indexY, m_useGeoMipmap);
+		AddTerrainTile(index, pTerrain);
+	}
+	return pTerrain;
+}
+
+void TerrainLattice::AddTerrainTile(int index, Terrain* pTerrain)
+{
+	pair<TerrainTileCacheMap_type::iterator, bool> res = m_pCachedTerrains.insert(pair<int, TerrainTileCacheItem>(index, TerrainTileCacheItem(pTerrain)));
+	if(res.second ==false)
+	{
+		/// replace the old object, if the terrain already exist
+		OUTPUT_LOG("replacing old tile, this is really unexpected\n");
+		SAFE_DELETE((*(res.first)).second.pTerrain);
+		(*(res.first)).second.pTerrain = pTerrain;
+	}
+	if(pTerrain)
+	{
+		pTerrain->OnLoad();
 
-		pair<TerrainTileCacheMap_type::iterator, bool> res = m_pCachedTerrains.insert(pair<int, TerrainTileCacheItem>(index, TerrainTileCacheItem(pTerrain)));
-		if(res.second ==false)
+		//GeoMipmapCode
+		if(m_useGeoMipmap)
 		{
-			/// replace the old object, if the terrain already exist
-			OUTPUT_LOG("replacing old tile, this is really unexpected\n");
-			SAFE_DELETE((*(res.first)).second.pTerrain);
-			(*(res.first)).second.pTerrain = pTerrain;
+			pTerrain->SetSharedIB(m_pIndices);
+			pTerrain->SetSharedIndexInfoGroup(&m_geoMipmapIndices);
 		}
-		if(pTerrain)
-		{
-			pTerrain->OnLoad();
+	}
+}
 
-			//GeoMipmapCode
-			if(m_useGeoMipmap)
+void TerrainLattice::RequestTerrain(int index)
+{
+	if(m_pCachedTerrains.find(index) != m_pCachedTerrains.end() || m_pendingTiles.find(index) != m_pendingTiles.end())
+		return;
+	m_pendingTiles.insert(index);
+	if (!CAsyncLoader::GetSingleton().TryAddWorkItem(new CTerrainTileLoader(index), new CTerrainTileProcessor(m_pAsyncState, index, m_useGeoMipmap), NULL, NULL, ResourceRequestID_Local))
+	{
+		// the tile is requested again later, or loaded synchronously when it becomes the center tile.
+		m_pendingTiles.erase(index);
+	}
+}
+
+void TerrainLattice::OnTilePrepared(int nTileID, Terrain* pTerrain)
+{
+	m_pendingTiles.erase(nTileID);
+	if(m_pCachedTerrains.find(nTileID) != m_pCachedTerrains.end())
+	{
+		// the tile is loaded synchronously while it is pending. 
+		SAFE_DELETE(pTerrain);
+		return;
+	}
+	if(pTerrain == NULL)
+	{
+		LoadTerrain(nTileID);
+		return;
+	}
+	pTerrain->LoadDeferredResources();
+	AddTerrainTile(nTileID, pTerrain);
+}
+
+Terrain *TerrainLattice::GetTerrainAsync(int positionX, int positionY)
+{
+	if(!m_bAsyncLoading)
+		return GetTerrain(positionX, positionY);
+	int nTileID = GetTileIDFromXY(positionX, positionY);
+	TerrainTileCacheMap_type::iterator iter = m_pCachedTerrains.find(nTileID);
+	if(iter != m_pCachedTerrains.end())
+	{
+		(*iter).second.OnHit();
+		return (*iter).second.pTerrain;
+	}
+	RequestTerrain(nTileID);
+	return NULL;
+}
+
+float TerrainLattice::GetPlaceholderElevation(int indexX, int indexY, float x, float y)
+{
+	// use the nearest point on a loaded neighbour tile, so that there is no step at the tile border. 
+	Terrain* pNearest = NULL;
+	float fMinDist = 0.f, fNearestX = x, fNearestY = y;
+	for (int dy = -1; dy <= 1; ++dy)
+	{
+		for (int dx = -1; dx <= 1; ++dx)
+		{
+			if(dx == 0 && dy == 0)
+				continue;
+			TerrainTileCacheMap_type::iterator iter = m_pCachedTerrains.find(GetTileIDFromXY(indexX + dx, indexY + dy));
+			if(iter == m_pCachedTerrains.end() || (*iter).second.pTerrain == NULL)
+				continue;
+			float fLeft = (indexX + dx) * m_TerrainWidth;
+			float fTop = (indexY + dy) * m_TerrainHeight;
+			float fX = max(fLeft, min(x, fLeft + m_TerrainWidth * 0.999f));
+			float fY = max(fTop, min(y, fTop + m_TerrainHeight * 0.999f));
+			float fDist = (fX - x)*(fX - x) + (fY - y)*(fY - y);
+			if(pNearest == NULL || fDist < fMinDist)
 			{
-				pTerrain->SetSharedIB(m_pIndices);
-				pTerrain->SetSharedIndexInfoGroup(&m_geoMipmapIndices);
+				pNearest = (*iter).second.pTerrain;
+				fMinDist = fDist;
+				fNearestX = fX;
+				fNearestY = fY;
 			}
 		}
 	}
-	return pTerrain;
+	return (pNearest != NULL) ? pNearest->GetElevationW(fNearestX, fNearestY) : 0.0f;
 }
 
 DWORD TerrainLattice::GetRegionValue(const string& sLayerName, float x, float y)
@@ -279,16 +371,65 @@ DWORD TerrainLattice::GetRegionValue(const string& sLayerName, float x, float y)
 
 float TerrainLattice::GetElevation(float x, float y)
 {
-	Terrain *pTerrain = GetTerrainAtPoint(x, y);
+	int indexX = (int)(x / m_TerrainWidth);
+	int indexY = (int)(y / m_TerrainHeight);
+	Terrain *pTerrain = GetTerrainAsync(indexX, indexY);
 	if (pTerrain != NULL)
 		return pTerrain->GetElevationW(x, y);
 	else
-		return 0.0f;
+		return GetPlaceholderElevation(indexX, indexY, x, y);
+}
+
+void TerrainLattice::GetElevations(int nCount, const float* pX, const float* pY, int nStride, float* pOutElevations)
+{
+	Terrain *pTerrain = NULL;
+	int nLastX = 0, nLastY = 0;
+	for (int i = 0; i < nCount; ++i, pX += nStride, pY += nStride)
+	{
+		float x = *pX, y = *pY;
+		int indexX = (int)(x / m_TerrainWidth);
+		int indexY = (int)(y / m_TerrainHeight);
+		if (i == 0 || indexX != nLastX || indexY != nLastY)
+		{
+			pTerrain = GetTerrainAsync(indexX, indexY);
+			nLastX = indexX;
+			nLastY = indexY;
+		}
+		pOutElevations[i] = (pTerrain != NULL) ? pTerrain->GetElevationW(x, y) : GetPlaceholderElevation(indexX, indexY, x, y);
+	}
+}
+
+void TerrainLattice::GetNormals(int nCount, const float* pX, const float* pY, int nStride, float* pOutNormals)
+{
+	Terrain *pTerrain = NULL;
+	int nLastX = 0, nLastY = 0;
+	for (int i = 0; i < nCount; ++i, pX += nStride, pY += nStride, pOutNormals += 3)
+	{
+		float x = *pX, y = *pY;
+		int indexX = (int)(x / m_TerrainWidth);
+		int indexY = (int)(y / m_TerrainHeight);
+		if (i == 0 || indexX != nLastX || indexY != nLastY)
+		{
+			pTerrain = GetTerrainAsync(indexX, indexY);
+			nLastX = indexX;
+			nLastY = indexY;
+		}
+		if (pTerrain != NULL)
+		{
+			pTerrain->GetNormalW(x, y, pOutNormals[0], pOutNormals[1], pOutNormals[2]);
+		}
+		else
+		{
+			pOutNormals[0] = 0;
+			pOutNormals[1] = 0;
+			pOutNormals[2] = 1.0f;
+		}
+	}
 }
 
 void TerrainLattice::GetNormal(float x, float y, float &normalX, float &normalY, float &normalZ)
 {
-	Terrain *pTerrain = GetTerrainAtPoint(x, y);
+	Terrain *pTerrain = GetTerrainAsync((int)(x / m_TerrainWidth), (int)(y / m_TerrainHeight));
 	if (pTerrain != NULL)
 		return pTerrain->GetNormalW(x, y,normalX,normalY,normalZ );
 	else
@@ -358,40 +499,104 @@ void TerrainLattice::SetCameraPosition(float x, float y, float z)
 		TerrainTileCacheMap_type::iterator iter = m_pCachedTerrains.find(m_CurrentTerrainIndex[dir]);
 		if(iter == m_pCachedTerrains.end())
 		{
-			LoadTerrain(m_CurrentTerrainIndex[dir]);
+			// the camera tile is needed at once if it is never requested, such as after a teleport. 
+			if(!m_bAsyncLoading || (dir == ParaTerrain::DIR_CENTER && m_pendingTiles.find(m_CurrentTerrainIndex[dir]) == m_pendingTiles.end()))
+				LoadTerrain(m_CurrentTerrainIndex[dir]);
+			else
+				RequestTerrain(m_CurrentTerrainIndex[dir]);
 		}
 		else
 		{
 			(*iter).second.OnHit();
 		}
 	}
-	/** garbage collect other terrain tiles; while frame move all active tiles */
-	if((int)m_pCachedTerrains.size() > m_nMaxCacheSize)
+	/** prefetch tiles beyond the 9 tiles in the background */
+	if(m_bAsyncLoading)
 	{
-		TerrainTileCacheMap_type::iterator itCurCP, oldestCP, itEndCP = m_pCachedTerrains.end();
-		oldestCP = itEndCP;
-		///  use 0x3fffffff, instead of 0xffffffff prevents the current frame used terrain to be deleted.
-		DWORD nHit = 0x3fffffff;
-		for( itCurCP = m_pCachedTerrains.begin(); itCurCP != itEndCP; ++ itCurCP)
+		for (int dy = -m_nPrefetchRadius; dy <= m_nPrefetchRadius; ++dy)
 		{
-			if((*itCurCP).second.nHitCount < nHit)
+			for (int dx = -m_nPrefetchRadius; dx <= m_nPrefetchRadius; ++dx)
 			{
-				oldestCP = itCurCP;
-				nHit = (*itCurCP).second.nHitCount;
+				if(abs(dx) > 1 || abs(dy) > 1)
+					RequestTerrain(GetTileIDFromXY(indexX + dx, indexY + dy));
 			}
-			(*itCurCP).second.FrameMove();
-		}	
-		if(oldestCP != itEndCP)
-		{
-			delete ((*oldestCP).second.pTerrain);
-			m_pCachedTerrains.erase(oldestCP);
 		}
 	}
+	/** garbage collect other terrain tiles; while frame move all active tiles */
+	EvictTiles(indexX, indexY);
 
 	m_camPosX = x;
 	m_camPosY = y;
 }
 
+void TerrainLattice::EvictTiles(int nCenterX, int nCenterY)
+{
+	int64 nMemory = (m_nTileMemoryBudget > 0) ? GetCachedTileMemory() : 0;
+	for (int nEvicted = 0; nEvicted < MAX_EVICTED_TILES_PER_FRAME; ++nEvicted)
+	{
+		bool bOverBudget = m_nTileMemoryBudget > 0 && nMemory > (int64)m_nTileMemoryBudget * 1024 * 1024;
+		if((int)m_pCachedTerrains.size() <= m_nMaxCacheSize && !bOverBudget)
+			break;
+		TerrainTileCacheMap_type::iterator itCurCP, farthestCP, itEndCP = m_pCachedTerrains.end();
+		farthestCP = itEndCP;
+		int nFarthest = 0;
+		for( itCurCP = m_pCachedTerrains.begin(); itCurCP != itEndCP; ++ itCurCP)
+		{
+			TerrainTileCacheItem& item = (*itCurCP).second;
+			int x = 0, y = 0;
+			GetXYFromTileID((*itCurCP).first, &x, &y);
+			int nDist = max(abs(x - nCenterX), abs(y - nCenterY));
+			///  tiles within the prefetch radius, used in the last two frames (0x3fffffff) or not saved are never evicted. 
+			if(nDist <= m_nPrefetchRadius || item.nHitCount >= 0x3fffffff || (item.pTerrain != NULL && item.pTerrain->IsModified()))
+				continue;
+			if(farthestCP == itEndCP || nDist > nFarthest || (nDist == nFarthest && item.nHitCount < (*farthestCP).second.nHitCount))
+			{
+				farthestCP = itCurCP;
+				nFarthest = nDist;
+			}
+		}
+		if(farthestCP == itEndCP)
+			break;
+		if((*farthestCP).second.pTerrain != NULL)
+			nMemory -= (*farthestCP).second.pTerrain->GetMemorySize();
+		delete ((*farthestCP).second.pTerrain);
+		m_pCachedTerrains.erase(farthestCP);
+	}
+
+	TerrainTileCacheMap_type::iterator itCurCP, itEndCP = m_pCachedTerrains.end();
+	for( itCurCP = m_pCachedTerrains.begin(); itCurCP != itEndCP; ++ itCurCP)
+	{
+		(*itCurCP).second.FrameMove();
+	}
+}
+
+int TerrainLattice::GetCachedTileMemory()
+{
+	int nSize = 0;
+	TerrainTileCacheMap_type::iterator itCurCP, itEndCP = m_pCachedTerrains.end();
+	for( itCurCP = m_pCachedTerrains.begin(); itCurCP != itEndCP; ++ itCurCP)
+	{
+		if((*itCurCP).second.pTerrain != NULL)
+			nSize += (*itCurCP).second.pTerrain->GetMemorySize();
+	}
+	return nSize;
+}
+
+void TerrainLattice::SetAsyncLoading(bool bEnable)
+{
+	m_bAsyncLoading = bEnable;
+}
+
+void TerrainLattice::SetPrefetchRadius(int nRadius)
+{
+	m_nPrefetchRadius = max(1, min(nRadius, 3));
+}
+
+void TerrainLattice::SetTileMemoryBudget(int nMB)
+{
+	m_nTileMemoryBudget = max(nMB, 0);
+}
+
 int TerrainLattice::GetMaxTileCacheSize()
 {
 	return m_nMaxCacheSize;
@@ -604,7 +809,7 @@ void ParaTerrain::TerrainLattice::UpdateHoles(float x, float y)
 
 bool ParaTerrain::TerrainLattice::IsHole( float x, float y )
 {
-	Terrain *pTerrain = GetTerrainAtPoint(x, y);
+	Terrain *pTerrain = GetTerrainAsync((int)(x / m_TerrainWidth), (int)(y / m_TerrainHeight));
 	if(pTerrain!=NULL)
 	{
 		return pTerrain->IsHoleW(x,y);
@@ -1543,7 +1748,7 @@ void TerrainLattice::SetVertexInfo(float x,float y,uint32 data,uint32 bitMask,ui
 
 bool TerrainLattice::IsWalkable(float x ,float y,Vector3& oNormal)
 {
-	Terrain *pTerrain = GetTerrainAtPoint(x, y);
+	Terrain *pTerrain = GetTerrainAsync((int)(x / m_TerrainWidth), (int)(y / m_TerrainHeight));
 	if (pTerrain != NULL)
 		return pTerrain->IsWalkable(x, y, oNormal);
 	else
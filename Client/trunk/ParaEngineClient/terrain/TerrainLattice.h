@@ -5,6 +5,8 @@
 #include "TextureFactory.h"
 #include "TTerrain.h"
 #include "TerrainGeoMipmapIndices.h"
+#include "TerrainTileLoader.h"
+#include <set>
 
 namespace ParaEngine
 {
@@ -31,6 +33,11 @@ namespace ParaTerrain
 	public:
 		/// \brief Called by the TerrainLattice when a Terrain object in the lattice has entered the visible region and, therefore, needs to be loaded into RAM.
 		virtual Terrain * LoadTerrainAt(Terrain *pTerrain, int latticeX, int latticeY, bool useGeoMipmap = false) = 0;
+		/** \brief Called from a background thread to create a Terrain object and load the parts of it that do not need the render device, such as elevations.
+		* The TerrainLattice calls Terrain::LoadDeferredResources() on the returned terrain in the main thread. 
+		* The default implementation returns NULL, in which case the tile is loaded by LoadTerrainAt() in the main thread. 
+		*/
+		virtual Terrain * PrepareTerrainAt(int latticeX, int latticeY, bool useGeoMipmap = false) { return NULL; };
 		/// \brief Called by the TerrainLattice when a Terrain object in the lattice is no longer within the visible region and can, therefore, be disposed of, freeing RAM for other visible Terrain objects.
 		virtual void UnloadTerrain(int latticeX, int latticeY, Terrain * pTerrain) = 0;
 		/// \brief Returns the width in world units of each of the individual Terrain objects in the lattice (they must all be the same width.)
@@ -83,6 +90,18 @@ namespace ParaTerrain
 		void Render();
 		float GetElevation(float x, float y);
 
+		/** get elevations of many points in world units in one call. Consecutive points on the same tile share a single tile lookup, 
+		* so callers should group points by location if possible. 
+		* @param pX, pY: the first x and y of points, the next point is nStride floats away. 
+		* @param pOutElevations: array of nCount elevations. 
+		*/
+		void GetElevations(int nCount, const float* pX, const float* pY, int nStride, float* pOutElevations);
+
+		/** get surface normals of many points in world units in one call. see GetElevations()
+		* @param pOutNormals: array of nCount normals of 3 floats each (x, y, z), where z is up. 
+		*/
+		void GetNormals(int nCount, const float* pX, const float* pY, int nStride, float* pOutNormals);
+
 		/** get value of a given terrain region layer
 		* @param x The x location of the point on the Terrain's surface in world units.
 		* @param y The y location of the point on the Terrain's surface in world units.
@@ -289,6 +308,38 @@ namespace ParaTerrain
 		*/
 		void SetMaxTileCacheSize(int nNum);
 
+		/** whether tiles are loaded in the async loader's background thread. default to false.
+		* When enabled, tiles around the camera are prefetched in the background, and elevation queries on a tile 
+		* that is still loading return a placeholder elevation from the nearest loaded neighbour instead of waiting. 
+		* The tile under the camera is still loaded synchronously if it was never requested, such as after a teleport. 
+		* Editing functions always load tiles synchronously. 
+		* It is off by default, because GetElevation(), GetNormal(), IsHole() and IsWalkable() callers, such as physics and 
+		* the AI, expect exact values; only enable it when the game can tolerate placeholder values near the camera. 
+		*/
+		void SetAsyncLoading(bool bEnable);
+		bool IsAsyncLoading() const { return m_bAsyncLoading; }
+
+		/** the number of tiles around the camera tile to load. 1 loads the 3*3 tiles around the camera. default to 1, at most 3. 
+		* tiles within this radius are never evicted. */
+		void SetPrefetchRadius(int nRadius);
+		int GetPrefetchRadius() const { return m_nPrefetchRadius; }
+
+		/** the system memory budget of cached tiles in MB, see Terrain::GetMemorySize(). 
+		* When either this or the max tile cache size is exceeded, the tiles farthest from the camera are evicted first. 
+		* 0 (default) means that only the tile count is limited. */
+		void SetTileMemoryBudget(int nMB);
+		int GetTileMemoryBudget() const { return m_nTileMemoryBudget; }
+
+		/** get the number of tiles being loaded in the background. */
+		int GetPendingTileCount() const { return (int)m_pendingTiles.size(); }
+
+		/** get the approximate system memory used by all cached tiles in bytes. */
+		int GetCachedTileMemory();
+
+		/** called by CTerrainTileProcessor in the main thread when a tile is prepared in the background.
+		* @param pTerrain: the prepared tile, which is owned by the lattice afterwards. If NULL, the tile is loaded synchronously. */
+		void OnTilePrepared(int nTileID, Terrain* pTerrain);
+
 		/** resize all texture mask width */
 		void ResizeTextureMaskWidth(int nWidth);
 
@@ -326,6 +377,16 @@ namespace ParaTerrain
 		Terrain *GetTerrainRelative(Terrain * pTerrain, int positionX, int positionY);
 		Terrain *GetTerrainRelative(Terrain * pTerrain, ParaTerrain::DIRECTION direction);
 		Terrain *LoadTerrain(int index);
+		/** add a loaded tile to the cache and call its on load script. */
+		void AddTerrainTile(int index, Terrain* pTerrain);
+		/** request a tile to be loaded in the background, if it is not cached or pending. */
+		void RequestTerrain(int index);
+		/** get the cached tile at the tile location. If it is not loaded, it is requested in the background and NULL is returned, unless async loading is disabled. */
+		Terrain *GetTerrainAsync(int positionX, int positionY);
+		/** elevation of a point on a tile that is being loaded, which is the elevation of the nearest point on a loaded neighbour tile, or 0. */
+		float GetPlaceholderElevation(int indexX, int indexY, float x, float y);
+		/** evict tiles farthest from the camera tile, while there are too many tiles or they use too much memory. */
+		void EvictTiles(int nCenterX, int nCenterY);
 		TerrainLatticeLoader *m_pLoader;
 		//int m_WidthTerrains, m_HeightTerrains;
 		int m_WidthActiveTerrains, m_HeightActiveTerrains;
@@ -336,6 +397,13 @@ namespace ParaTerrain
 		/** cached or loaded terrain tiles */
 		TerrainTileCacheMap_type m_pCachedTerrains;
 		int m_nMaxCacheSize;
+		/** tiles that are being loaded in the background */
+		std::set<int> m_pendingTiles;
+		TerrainLatticeAsyncState_ptr m_pAsyncState;
+		bool m_bAsyncLoading;
+		int m_nPrefetchRadius;
+		/** in MB */
+		int m_nTileMemoryBudget;
 
 		int m_CurrentTerrainIndex[9];
 
@@ -0,0 +1,105 @@
+//-----------------------------------------------------------------------------
+// Class:	CTerrainTileLoader
+// Company: ParaEngine
+// Desc: load terrain lattice tiles in the async loader's local processor thread.
+//-----------------------------------------------------------------------------
+#include "ParaEngine.h"
+#include "Terrain.h"
+#include "TerrainLattice.h"
+#include "TerrainTileLoader.h"
+
+using namespace ParaEngine;
+using namespace ParaTerrain;
+
+ParaTerrain::CTerrainTileLoader::CTerrainTileLoader(int nTileID)
+{
+	char sName[64];
+	snprintf(sName, sizeof(sName), "terrain tile %d", nTileID);
+	m_sName = sName;
+}
+
+const char* ParaTerrain::CTerrainTileLoader::GetFileName()
+{
+	return m_sName.c_str();
+}
+
+HRESULT ParaTerrain::CTerrainTileLoader::Decompress(void** ppData, int* pcBytes)
+{
+	return S_OK;
+}
+
+HRESULT ParaTerrain::CTerrainTileLoader::Destroy()
+{
+	return S_OK;
+}
+
+HRESULT ParaTerrain::CTerrainTileLoader::Load()
+{
+	return S_OK;
+}
+
+//////////////////////////////////////////////////////////////////////////
+//
+// CTerrainTileProcessor
+//
+//////////////////////////////////////////////////////////////////////////
+ParaTerrain::CTerrainTileProcessor::CTerrainTileProcessor(const TerrainLatticeAsyncState_ptr& pState, int nTileID, bool bUseGeoMipmap)
+	:m_pState(pState), m_nTileID(nTileID), m_bUseGeoMipmap(bUseGeoMipmap), m_pTerrain(NULL)
+{
+}
+
+ParaTerrain::CTerrainTileProcessor::~CTerrainTileProcessor()
+{
+	SAFE_DELETE(m_pTerrain);
+}
+
+HRESULT ParaTerrain::CTerrainTileProcessor::Process(void* pData, int cBytes)
+{
+	int nX, nY;
+	if (!TerrainLattice::GetXYFromTileID(m_nTileID, &nX, &nY))
+		return S_OK;
+	ParaEngine::Lock lock_(m_pState->m_mutex);
+	if (m_pState->m_pLattice == 0 || m_pState->m_pLoader == 0)
+		return S_OK;
+	try
+	{
+		m_pTerrain = m_pState->m_pLoader->PrepareTerrainAt(nX, nY, m_bUseGeoMipmap);
+	}
+	catch (...)
+	{
+		OUTPUT_LOG("warning: failed to prepare terrain tile %d in background, it will be loaded in the main thread\n", m_nTileID);
+		m_pTerrain = NULL;
+	}
+	// always succeed, so that the lattice is notified and can load the tile in the main thread if m_pTerrain is NULL. 
+	return S_OK;
+}
+
+HRESULT ParaTerrain::CTerrainTileProcessor::LockDeviceObject()
+{
+	return S_OK;
+}
+
+HRESULT ParaTerrain::CTerrainTileProcessor::CopyToResource()
+{
+	return S_OK;
+}
+
+HRESULT ParaTerrain::CTerrainTileProcessor::UnLockDeviceObject()
+{
+	// this is called in the main thread, which is the only thread that destroys the lattice. 
+	if (m_pState->m_pLattice)
+	{
+		m_pState->m_pLattice->OnTilePrepared(m_nTileID, m_pTerrain);
+		m_pTerrain = NULL;
+	}
+	return S_OK;
+}
+
+HRESULT ParaTerrain::CTerrainTileProcessor::Destroy()
+{
+	return S_OK;
+}
+
+void ParaTerrain::CTerrainTileProcessor::SetResourceError()
+{
+}
@@ -0,0 +1,69 @@
+#pragma once
+#include "IDataLoader.h"
+#include "util/mutex.h"
+#include <boost/shared_ptr.hpp>
+#include <string>
+
+namespace ParaTerrain
+{
+	class Terrain;
+	class TerrainLattice;
+	class TerrainLatticeLoader;
+
+	/** state shared by a terrain lattice and its pending tile requests. 
+	* The lattice sets m_pLattice to NULL under the lock when it is destroyed, which also waits for any tile being prepared. 
+	*/
+	struct TerrainLatticeAsyncState
+	{
+		TerrainLatticeAsyncState(TerrainLattice* pLattice, TerrainLatticeLoader* pLoader) :m_pLattice(pLattice), m_pLoader(pLoader){};
+		TerrainLattice* m_pLattice;
+		TerrainLatticeLoader* m_pLoader;
+		ParaEngine::mutex m_mutex;
+	};
+	typedef boost::shared_ptr<TerrainLatticeAsyncState> TerrainLatticeAsyncState_ptr;
+
+	/**
+	* CTerrainTileLoader implementation of IDataLoader. 
+	* All file IO is done by the loader's PrepareTerrainAt() in the processor thread, so this class does nothing. 
+	*/
+	class CTerrainTileLoader : public ParaEngine::IDataLoader
+	{
+	public:
+		CTerrainTileLoader(int nTileID);
+
+		// overrides
+	public:
+		const char* GetFileName();
+		HRESULT Decompress(void** ppData, int* pcBytes);
+		HRESULT Destroy();
+		HRESULT Load();
+	private:
+		std::string m_sName;
+	};
+
+	/**
+	* CTerrainTileProcessor implementation of IDataProcessor. 
+	* It creates the terrain tile in a processor thread, and hands it to the lattice in the main thread. 
+	*/
+	class CTerrainTileProcessor : public ParaEngine::IDataProcessor
+	{
+	public:
+		CTerrainTileProcessor(const TerrainLatticeAsyncState_ptr& pState, int nTileID, bool bUseGeoMipmap);
+		~CTerrainTileProcessor();
+
+		// overrides
+	public:
+		HRESULT LockDeviceObject();
+		HRESULT UnLockDeviceObject();
+		HRESULT Destroy();
+		HRESULT Process(void* pData, int cBytes);
+		HRESULT CopyToResource();
+		void    SetResourceError();
+	private:
+		TerrainLatticeAsyncState_ptr m_pState;
+		int m_nTileID;
+		bool m_bUseGeoMipmap;
+		/** the prepared terrain, which is owned by this object until it is handed to the lattice. */
+		Terrain* m_pTerrain;
+	};
+}
@@ -0,0 +1,279 @@
+//-----------------------------------------------------------------------------
+// Class:	CAsyncLogWriter
+// Company: ParaEngine
+// Desc: per thread lock-free log rings, drained and batch written by a background thread.
+//-----------------------------------------------------------------------------
+#include "ParaEngine.h"
+#include "Log.h"
+#include "util/ParaTime.h"
+#include "AsyncLogWriter.h"
+
+using namespace ParaEngine;
+
+//////////////////////////////////////////////////////////////////////////
+//
+// CLogRingBuffer
+//
+//////////////////////////////////////////////////////////////////////////
+
+ParaEngine::CLogRingBuffer::CLogRingBuffer(int nCapacity)
+	: m_nHead(0), m_nTail(0), m_bOrphaned(false)
+{
+	uint32_t nSize = 1024;
+	while (nSize < (uint32_t)nCapacity && nSize < 0x40000000)
+		nSize <<= 1;
+	m_nCapacity = nSize;
+	m_nMask = nSize - 1;
+	m_buffer.resize(nSize);
+}
+
+uint32_t ParaEngine::CLogRingBuffer::GetUsedSize() const
+{
+	return m_nHead.load(std::memory_order_acquire) - m_nTail.load(std::memory_order_acquire);
+}
+
+void ParaEngine::CLogRingBuffer::CopyIn(uint32_t nPos, const char* pData, uint32_t nLength)
+{
+	uint32_t nOffset = nPos & m_nMask;
+	uint32_t nFirst = (std::min)(nLength, m_nCapacity - nOffset);
+	memcpy(&m_buffer[nOffset], pData, nFirst);
+	if (nFirst < nLength)
+		memcpy(&m_buffer[0], pData + nFirst, nLength - nFirst);
+}
+
+void ParaEngine::CLogRingBuffer::CopyOut(uint32_t nPos, char* pData, uint32_t nLength)
+{
+	uint32_t nOffset = nPos & m_nMask;
+	uint32_t nFirst = (std::min)(nLength, m_nCapacity - nOffset);
+	memcpy(pData, &m_buffer[nOffset], nFirst);
+	if (nFirst < nLength)
+		memcpy(pData + nFirst, &m_buffer[0], nLength - nFirst);
+}
+
+bool ParaEngine::CLogRingBuffer::Push(const char* pData, int nLength)
+{
+	if (nLength <= 0)
+		return true;
+	uint32_t nRecordSize = (uint32_t)nLength + sizeof(uint32_t);
+	uint32_t nHead = m_nHead.load(std::memory_order_relaxed);
+	uint32_t nTail = m_nTail.load(std::memory_order_acquire);
+	if ((m_nCapacity - (nHead - nTail)) < nRecordSize)
+		return false;
+	uint32_t nLen = (uint32_t)nLength;
+	CopyIn(nHead, (const char*)&nLen, sizeof(uint32_t));
+	CopyIn(nHead + sizeof(uint32_t), pData, nLen);
+	m_nHead.store(nHead + nRecordSize, std::memory_order_release);
+	return true;
+}
+
+int ParaEngine::CLogRingBuffer::PopAll(std::vector<char>& output)
+{
+	uint32_t nTail = m_nTail.load(std::memory_order_relaxed);
+	uint32_t nHead = m_nHead.load(std::memory_order_acquire);
+	int nCount = 0;
+	while (nTail != nHead)
+	{
+		uint32_t nLen = 0;
+		CopyOut(nTail, (char*)&nLen, sizeof(uint32_t));
+		size_t nOldSize = output.size();
+		output.resize(nOldSize + nLen);
+		CopyOut(nTail + sizeof(uint32_t), &output[nOldSize], nLen);
+		nTail += nLen + sizeof(uint32_t);
+		++nCount;
+	}
+	m_nTail.store(nTail, std::memory_order_release);
+	return nCount;
+}
+
+//////////////////////////////////////////////////////////////////////////
+//
+// CAsyncLogWriter
+//
+//////////////////////////////////////////////////////////////////////////
+
+ParaEngine::CAsyncLogWriter::CAsyncLogWriter(CLogger* pLogger, int nRingBufferSize)
+	: m_pLogger(pLogger), m_nRingBufferSize(nRingBufferSize), m_nFlushInterval(50), m_bStop(false),
+	m_nDroppedCount(0), m_nLastReportedDropCount(0), m_nWrittenCount(0), m_nBatchCount(0)
+{
+	static std::atomic<uint32_t> s_nNextEpoch(1);
+	m_nEpoch = s_nNextEpoch++;
+	m_batch.reserve(64 * 1024);
+	Start();
+}
+
+ParaEngine::CAsyncLogWriter::~CAsyncLogWriter()
+{
+	Stop();
+}
+
+void ParaEngine::CAsyncLogWriter::Start()
+{
+	if (!m_thread.joinable())
+	{
+		m_bStop = false;
+		m_thread = std::thread(std::bind(&CAsyncLogWriter::ThreadProc, this));
+	}
+}
+
+void ParaEngine::CAsyncLogWriter::SetRingBufferSize(int nRingBufferSize)
+{
+	m_nRingBufferSize = nRingBufferSize;
+}
+
+void ParaEngine::CAsyncLogWriter::Stop()
+{
+	if (m_thread.joinable())
+	{
+		{
+			std::lock_guard<std::mutex> lock_(m_signal_mutex);
+			m_bStop = true;
+		}
+		m_signal.notify_one();
+		m_thread.join();
+	}
+	// write anything that is queued after the thread exits
+	std::lock_guard<std::mutex> lock_(m_drain_mutex);
+	DrainAll_unlocked();
+}
+
+CLogRingBuffer* ParaEngine::CAsyncLogWriter::GetThreadRing()
+{
+	ThreadRingHandle* pHandle = m_thread_ring.get();
+	if (pHandle == 0 || pHandle->m_nEpoch != m_nEpoch)
+	{
+		// first time called by this thread, or the handle is left by a previous writer, whose ring is no longer drained.
+		std::shared_ptr<CLogRingBuffer> pRing(new CLogRingBuffer(m_nRingBufferSize));
+		{
+			std::lock_guard<std::mutex> lock_(m_rings_mutex);
+			m_rings.push_back(pRing);
+		}
+		pHandle = new ThreadRingHandle(pRing, m_nEpoch);
+		m_thread_ring.reset(pHandle);
+	}
+	return pHandle->m_pRing.get();
+}
+
+bool ParaEngine::CAsyncLogWriter::Push(const char* pData, int nLength)
+{
+	if (pData == 0 || nLength <= 0)
+		return true;
+	CLogRingBuffer* pRing = GetThreadRing();
+	if ((uint32_t)nLength > (pRing->GetCapacity() >> 2))
+	{
+		// the same as the synchronous logger, which never truncates Write(). 
+		std::lock_guard<std::mutex> lock_(m_drain_mutex);
+		DrainAll_unlocked();
+		m_pLogger->WriteBatch(pData, nLength);
+		++m_nWrittenCount;
+		return true;
+	}
+	if (!pRing->Push(pData, nLength))
+	{
+		++m_nDroppedCount;
+		m_signal.notify_one();
+		return false;
+	}
+	// wake up the writer early if the ring is getting full.
+	if (pRing->GetUsedSize() > (pRing->GetCapacity() >> 1))
+		m_signal.notify_one();
+	return true;
+}
+
+void ParaEngine::CAsyncLogWriter::Flush()
+{
+	std::lock_guard<std::mutex> lock_(m_drain_mutex);
+	DrainAll_unlocked();
+}
+
+void ParaEngine::CAsyncLogWriter::SetFlushInterval(int nMilliSeconds)
+{
+	m_nFlushInterval = (std::max)(nMilliSeconds, 1);
+}
+
+int ParaEngine::CAsyncLogWriter::GetFlushInterval() const
+{
+	return m_nFlushInterval;
+}
+
+void ParaEngine::CAsyncLogWriter::DrainAll_unlocked()
+{
+	m_batch.clear();
+	int nCount = 0;
+	{
+		std::lock_guard<std::mutex> lock_(m_rings_mutex);
+		for (auto it = m_rings.begin(); it != m_rings.end();)
+		{
+			// read orphaned flag before draining, so that we never delete a ring with pending records.
+			bool bOrphaned = (*it)->IsOrphaned();
+			nCount += (*it)->PopAll(m_batch);
+			if (bOrphaned)
+				it = m_rings.erase(it);
+			else
+				++it;
+		}
+	}
+	int64_t nDropped = m_nDroppedCount;
+	if (nDropped != m_nLastReportedDropCount)
+	{
+		char tmp[128];
+		int nSize = snprintf(tmp, sizeof(tmp), "==>%d log messages dropped, because async log buffer is full\n", (int)(nDropped - m_nLastReportedDropCount));
+		m_nLastReportedDropCount = nDropped;
+		if (nSize > 0)
+			m_batch.insert(m_batch.end(), tmp, tmp + nSize);
+	}
+	if (!m_batch.empty())
+	{
+		m_pLogger->WriteBatch(&m_batch[0], (int)m_batch.size());
+		m_nWrittenCount += nCount;
+		++m_nBatchCount;
+	}
+}
+
+void ParaEngine::CAsyncLogWriter::ThreadProc()
+{
+	while (!m_bStop)
+	{
+		{
+			std::unique_lock<std::mutex> lock_(m_signal_mutex);
+			if (!m_bStop)
+				m_signal.wait_for(lock_, std::chrono::milliseconds((int)m_nFlushInterval));
+		}
+		std::lock_guard<std::mutex> lock_(m_drain_mutex);
+		DrainAll_unlocked();
+	}
+}
+
+#ifdef _DEBUG
+#include <boost/thread.hpp>
+/** compare async and sync log with many logging threads. */
+void Test_AsyncLog()
+{
+	const int nThreadCount = 8;
+	const int nCount = 20000;
+	for (int nPass = 0; nPass < 2; ++nPass)
+	{
+		bool bAsync = (nPass == 1);
+		ParaEngine::CLogger logger;
+		logger.SetLogFile(bAsync ? "temp/async_log_test.txt" : "temp/sync_log_test.txt");
+		logger.SetAppendMode(false);
+		logger.SetForceFlush(false);
+		logger.SetAsyncMode(bAsync);
+		logger.SetMaxLogFileSize(16 * 1024 * 1024);
+		int64 nFromTime = ParaEngine::GetTimeUS();
+		{
+			boost::thread_group threads;
+			for (int i = 0; i < nThreadCount; ++i)
+			{
+				threads.create_thread([&logger, i, nCount]() {
+					for (int j = 0; j < nCount; ++j)
+						logger.WriteFormated("thread %d: test log message %d\n", i, j);
+				});
+			}
+			threads.join_all();
+		}
+		int nTimeUS = (int)(ParaEngine::GetTimeUS() - nFromTime);
+		OUTPUT_LOG("%s logging: %d threads * %d messages in %d us, %d dropped\n", bAsync ? "async" : "sync", nThreadCount, nCount, nTimeUS, (int)logger.GetDroppedLogCount());
+		logger.SetAsyncMode(false);
+	}
+}
+#endif
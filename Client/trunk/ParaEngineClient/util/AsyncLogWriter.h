@@ -0,0 +1,145 @@
+#pragma once
+#include <stdint.h>
+#include <vector>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+#include <boost/thread/tss.hpp>
+
+namespace ParaEngine
+{
+	class CLogger;
+
+	/** a single producer single consumer lock-free byte ring.
+	* each record is stored as [uint32 length][bytes], and may wrap around the end of the buffer.
+	* the producer is the logging thread that owns the ring, the consumer is the CAsyncLogWriter.
+	*/
+	class CLogRingBuffer
+	{
+	public:
+		/** @param nCapacity: buffer size in bytes, it will be rounded up to power of 2. */
+		CLogRingBuffer(int nCapacity);
+
+		/** [producer thread] push a record.
+		* @return false if there is not enough space left, in which case the record is dropped.
+		*/
+		bool Push(const char* pData, int nLength);
+
+		/** [consumer thread] append all pending records to output buffer.
+		* @return number of records popped.
+		*/
+		int PopAll(std::vector<char>& output);
+
+		/** number of bytes used. it is only an approximation when called from other threads. */
+		uint32_t GetUsedSize() const;
+		uint32_t GetCapacity() const { return m_nCapacity; }
+
+		/** set when the producer thread exits. the ring is deleted by the writer after it is fully drained. */
+		void SetOrphaned() { m_bOrphaned = true; }
+		bool IsOrphaned() const { return m_bOrphaned; }
+
+	protected:
+		void CopyIn(uint32_t nPos, const char* pData, uint32_t nLength);
+		void CopyOut(uint32_t nPos, char* pData, uint32_t nLength);
+	protected:
+		std::vector<char> m_buffer;
+		uint32_t m_nCapacity;
+		uint32_t m_nMask;
+		/** monotonically increasing write position, only modified by producer. */
+		std::atomic<uint32_t> m_nHead;
+		/** monotonically increasing read position, only modified by consumer. */
+		std::atomic<uint32_t> m_nTail;
+		std::atomic<bool> m_bOrphaned;
+	};
+
+	/** background writer for CLogger in async mode.
+	* each logging thread gets its own lock-free ring on first use, so that OUTPUT_LOG never blocks on disk IO or a shared mutex.
+	* A single background thread drains all rings every few milliseconds, and writes them to the log file in one batch.
+	* If a ring is full, the message is dropped and counted, instead of blocking the calling thread.
+	* Log file rotation by size or time is also done in the writer thread.
+	*/
+	class CAsyncLogWriter
+	{
+	public:
+		/**
+		* @param pLogger: the owner logger, all batches are written via CLogger::WriteBatch
+		* @param nRingBufferSize: per thread ring buffer size in bytes.
+		*/
+		CAsyncLogWriter(CLogger* pLogger, int nRingBufferSize = 64 * 1024);
+		~CAsyncLogWriter();
+
+		/** [thread safe and lock free] queue a log record from the calling thread.
+		* a record larger than a quarter of the ring is not queued, but written directly after all queued records, so it is never truncated.
+		* @return false if the record is dropped because the ring is full.
+		*/
+		bool Push(const char* pData, int nLength);
+
+		/** [thread safe] block until all records queued so far are written to file. */
+		void Flush();
+
+		/** total number of dropped records since the writer is created. */
+		int64_t GetDroppedCount() const { return m_nDroppedCount; }
+		/** total number of records written to file. */
+		int64_t GetWrittenCount() const { return m_nWrittenCount; }
+		/** total number of batched write calls. */
+		int64_t GetBatchCount() const { return m_nBatchCount; }
+
+		/** start the background thread again after Stop(). */
+		void Start();
+		/** stop the background thread and write all pending records. Push() can still be called afterwards, 
+		* but its records are only written by the next Flush(), Start() or the destructor. */
+		void Stop();
+
+		/** ring buffer size of threads that log for the first time after this call. */
+		void SetRingBufferSize(int nRingBufferSize);
+
+		/** how often the background thread wakes up to drain the rings. default to 50 ms. */
+		void SetFlushInterval(int nMilliSeconds);
+		int GetFlushInterval() const;
+
+	protected:
+		CLogRingBuffer* GetThreadRing();
+		void ThreadProc();
+		/** drain all rings and write them. m_drain_mutex must be locked. */
+		void DrainAll_unlocked();
+
+	protected:
+		/** per thread handle to its ring. deleting it on thread exit marks the ring as orphaned. */
+		struct ThreadRingHandle
+		{
+			ThreadRingHandle(const std::shared_ptr<CLogRingBuffer>& pRing, uint32_t nEpoch) :m_pRing(pRing), m_nEpoch(nEpoch){};
+			~ThreadRingHandle(){ m_pRing->SetOrphaned(); }
+			std::shared_ptr<CLogRingBuffer> m_pRing;
+			/** epoch of the writer that registered the ring */
+			uint32_t m_nEpoch;
+		};
+		boost::thread_specific_ptr<ThreadRingHandle> m_thread_ring;
+		/** unique id of this writer. A writer created at the address of a deleted one shares its thread specific slots,
+		* so a thread must register a new ring if its handle is from another epoch. */
+		uint32_t m_nEpoch;
+
+		CLogger* m_pLogger;
+		std::atomic<int> m_nRingBufferSize;
+		std::atomic<int> m_nFlushInterval;
+
+		/** all rings, guarded by m_rings_mutex. rings are only added by producers and removed by the consumer. */
+		std::vector<std::shared_ptr<CLogRingBuffer> > m_rings;
+		std::mutex m_rings_mutex;
+
+		/** there is only one consumer at a time, either the writer thread or a thread calling Flush(). */
+		std::mutex m_drain_mutex;
+		std::vector<char> m_batch;
+
+		std::mutex m_signal_mutex;
+		std::condition_variable m_signal;
+		std::thread m_thread;
+		std::atomic<bool> m_bStop;
+
+		std::atomic<int64_t> m_nDroppedCount;
+		int64_t m_nLastReportedDropCount;
+		std::atomic<int64_t> m_nWrittenCount;
+		std::atomic<int64_t> m_nBatchCount;
+	};
+}
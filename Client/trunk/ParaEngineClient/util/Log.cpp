@@ -12,11 +12,26 @@
 #include "util/mutex.h"
 #include "Log.h"
 #include "util/os_calls.h"
+#include "AsyncLogWriter.h"
 #include <boost/thread/tss.hpp>
 
 /** the etc length when too many characters are printed. This is larger then strlen("...\n")*/
 #define LOG_TAIL_ETC_LENGTH		5
 
+namespace ParaEngine
+{
+	int CLogger::FormatLogBuffer(char* buffer, int nPrefixSize, const char * zFormat, va_list args)
+	{
+		int nSize2 = vsnprintf(buffer + nPrefixSize, MAX_DEBUG_STRING_LENGTH - LOG_TAIL_ETC_LENGTH - nPrefixSize, zFormat, args);
+		if (nSize2 < 0 || nSize2 >= (MAX_DEBUG_STRING_LENGTH - LOG_TAIL_ETC_LENGTH - 1 - nPrefixSize))
+		{
+			nSize2 = MAX_DEBUG_STRING_LENGTH - LOG_TAIL_ETC_LENGTH - 1 - nPrefixSize;
+			nSize2 += snprintf(buffer + MAX_DEBUG_STRING_LENGTH - LOG_TAIL_ETC_LENGTH - 1, LOG_TAIL_ETC_LENGTH, "...\n");
+		}
+		return nPrefixSize + nSize2;
+	}
+}
+
 namespace ParaEngine
 {
 	namespace LogDetail
@@ -171,7 +186,7 @@ namespace ParaEngine
 namespace ParaEngine
 {
 	CLogger::CLogger(void)
-		:m_file_handle(NULL), m_level(0)
+		:m_file_handle(NULL), m_level(0), m_pAsyncWriter(NULL), m_pAsyncWriterOwned(NULL), m_nMaxLogFileSize(0), m_nLogRotateInterval(0), m_nMaxRotatedFiles(5), m_nLogOpenTime(0)
 	{
 #ifdef PARAENGINE_MOBILE
 		m_is_first_time_open = true;
@@ -195,6 +210,9 @@ namespace ParaEngine
 
 	CLogger::~CLogger(void)
 	{
+		SetAsyncMode(false);
+		// any record pushed while async mode was switched off is written here. 
+		SAFE_DELETE(m_pAsyncWriterOwned);
 		CloseLog();
 	}
 
@@ -208,6 +226,76 @@ namespace ParaEngine
 		m_bForceFlush = bForceFlush;
 	}
 
+	void CLogger::SetAsyncMode(bool bAsync, int nRingBufferSize)
+	{
+		ParaEngine::Lock lock_(m_async_mutex);
+		if (bAsync && m_pAsyncWriter == NULL)
+		{
+			if (m_pAsyncWriterOwned == NULL)
+				m_pAsyncWriterOwned = new CAsyncLogWriter(this, nRingBufferSize);
+			else
+			{
+				m_pAsyncWriterOwned->SetRingBufferSize(nRingBufferSize);
+				m_pAsyncWriterOwned->Start();
+			}
+			m_pAsyncWriter = m_pAsyncWriterOwned;
+		}
+		else if (!bAsync && m_pAsyncWriter != NULL)
+		{
+			m_pAsyncWriter = NULL;
+			// this will write all pending messages. the writer is not deleted, since other threads may still be inside its Push(). 
+			m_pAsyncWriterOwned->Stop();
+		}
+	}
+
+	bool CLogger::IsAsyncMode()
+	{
+		return m_pAsyncWriter != NULL;
+	}
+
+	void CLogger::Flush()
+	{
+		CAsyncLogWriter* pWriter = m_pAsyncWriter;
+		if (pWriter)
+			pWriter->Flush();
+	}
+
+	int64_t CLogger::GetDroppedLogCount()
+	{
+		CAsyncLogWriter* pWriter = m_pAsyncWriter;
+		return pWriter ? pWriter->GetDroppedCount() : 0;
+	}
+
+	void CLogger::SetMaxLogFileSize(int nBytes)
+	{
+		m_nMaxLogFileSize = nBytes;
+	}
+
+	int CLogger::GetMaxLogFileSize()
+	{
+		return m_nMaxLogFileSize;
+	}
+
+	void CLogger::SetLogRotateInterval(int nSeconds)
+	{
+		m_nLogRotateInterval = nSeconds;
+	}
+
+	int CLogger::GetLogRotateInterval()
+	{
+		return m_nLogRotateInterval;
+	}
+
+	void CLogger::SetMaxRotatedFiles(int nCount)
+	{
+		m_nMaxRotatedFiles = nCount;
+	}
+
+	int CLogger::GetMaxRotatedFiles()
+	{
+		return m_nMaxRotatedFiles;
+	}
+
 	CLogger& CLogger::GetSingleton()
 	{
 		static CLogger g_app_logger;
@@ -219,6 +307,7 @@ namespace ParaEngine
 		if (m_file_handle==NULL) 
 		{
 			m_file_handle = fopen(m_log_file_name.c_str(),m_is_first_time_open ? "w+" : "a+");
+			m_nLogOpenTime = time(NULL);
 		}
 		if(m_file_handle)
 		{
@@ -277,6 +366,23 @@ namespace ParaEngine
 
 	void CLogger::AddLogStr(const char * pStr)
 	{
+		CAsyncLogWriter* pWriter = m_pAsyncWriter;
+		if (pWriter)
+		{
+			if (pStr == NULL)
+				return;
+			int nLength = (int)strnlen(pStr, MAX_DEBUG_STRING_LENGTH);
+			if (nLength < MAX_DEBUG_STRING_LENGTH)
+				pWriter->Push(pStr, nLength);
+			else
+			{
+				// the same as AddLogStr_st()
+				static const char s_sIgnored[] = "==>log message ignored, because it is longer than 1024\n";
+				pWriter->Push(pStr, MAX_DEBUG_STRING_LENGTH - 1);
+				pWriter->Push(s_sIgnored, (int)sizeof(s_sIgnored) - 1);
+			}
+			return;
+		}
 		ParaEngine::Lock lock_(m_mutex);
 		AddLogStr_st(pStr);
 	}
@@ -299,10 +405,55 @@ namespace ParaEngine
 	}
 	int CLogger::Write(const char * buf, int nLength)
 	{
+		CAsyncLogWriter* pWriter = m_pAsyncWriter;
+		if (pWriter)
+		{
+			if (buf == NULL || nLength <= 0)
+				return -1;
+			return pWriter->Push(buf, nLength) ? nLength : -1;
+		}
 		ParaEngine::Lock lock_(m_mutex);
 		return Write_st(buf, nLength);
 	}
 
+	int CLogger::WriteBatch(const char * buf, int nLength)
+	{
+		ParaEngine::Lock lock_(m_mutex);
+		int nCount = Write_st(buf, nLength);
+		if (m_file_handle && (m_nMaxLogFileSize > 0 || m_nLogRotateInterval > 0))
+		{
+			if ((m_nMaxLogFileSize > 0 && ftell(m_file_handle) >= m_nMaxLogFileSize) ||
+				(m_nLogRotateInterval > 0 && (time(NULL) - m_nLogOpenTime) >= m_nLogRotateInterval))
+			{
+				RotateLog_st();
+			}
+		}
+		return nCount;
+	}
+
+	void CLogger::RotateLog_st()
+	{
+		CloseLog();
+		if (m_nMaxRotatedFiles > 0)
+		{
+			char sFrom[16], sTo[16];
+			snprintf(sTo, sizeof(sTo), ".%d", m_nMaxRotatedFiles);
+			remove((m_log_file_name + sTo).c_str());
+			for (int i = m_nMaxRotatedFiles - 1; i >= 1; --i)
+			{
+				snprintf(sFrom, sizeof(sFrom), ".%d", i);
+				snprintf(sTo, sizeof(sTo), ".%d", i + 1);
+				rename((m_log_file_name + sFrom).c_str(), (m_log_file_name + sTo).c_str());
+			}
+			rename(m_log_file_name.c_str(), (m_log_file_name + ".1").c_str());
+		}
+		// always start a new file after rotation
+		bool bFirstTimeOpen = m_is_first_time_open;
+		m_is_first_time_open = true;
+		GetLogFileHandle();
+		m_is_first_time_open = bFirstTimeOpen;
+	}
+
 	void CLogger::AddLogStr_st(const wchar_t * pStr)
 	{
 		if (pStr==NULL) {
@@ -331,6 +482,19 @@ namespace ParaEngine
 		std::string date_str = ParaEngine::GetDateFormat("yyyy-MM-dd");
 		std::string time_str = ParaEngine::GetTimeFormat(NULL);
 
+		CAsyncLogWriter* pWriter = m_pAsyncWriter;
+		if (pWriter)
+		{
+			char buffer[MAX_DEBUG_STRING_LENGTH];
+			int nSize = snprintf(buffer, MAX_DEBUG_STRING_LENGTH, "%s %s|%d|", date_str.c_str(), time_str.c_str(), ParaEngine::GetThisThreadID());
+			va_list args;
+			va_start(args, zFormat);
+			nSize = FormatLogBuffer(buffer, nSize, zFormat, args);
+			va_end(args);
+			pWriter->Push(buffer, nSize);
+			return;
+		}
+
 		ParaEngine::Lock lock_(m_mutex);
 		int nSize = snprintf(m_buffer, MAX_DEBUG_STRING_LENGTH, "%s %s|%d|", date_str.c_str(), time_str.c_str(), ParaEngine::GetThisThreadID());
 		va_list args;
@@ -348,6 +512,17 @@ namespace ParaEngine
 
 	void CLogger::WriteFormated(const char * zFormat,...)
 	{
+		CAsyncLogWriter* pWriter = m_pAsyncWriter;
+		if (pWriter)
+		{
+			char buffer[MAX_DEBUG_STRING_LENGTH];
+			va_list args;
+			va_start(args, zFormat);
+			int nSize = FormatLogBuffer(buffer, 0, zFormat, args);
+			va_end(args);
+			pWriter->Push(buffer, nSize);
+			return;
+		}
 		ParaEngine::Lock lock_(m_mutex);
 		va_list args;
 		va_start(args, zFormat);
@@ -377,6 +552,13 @@ namespace ParaEngine
 
 	void CLogger::WriteFormatedVarList(const char * zFormat, va_list args)
 	{
+		CAsyncLogWriter* pWriter = m_pAsyncWriter;
+		if (pWriter)
+		{
+			char buffer[MAX_DEBUG_STRING_LENGTH];
+			pWriter->Push(buffer, FormatLogBuffer(buffer, 0, zFormat, args));
+			return;
+		}
 		ParaEngine::Lock lock_(m_mutex);
 		int nSize2 = vsnprintf(m_buffer, MAX_DEBUG_STRING_LENGTH - LOG_TAIL_ETC_LENGTH, zFormat, args);
 		if (nSize2 < 0 || nSize2 >= (MAX_DEBUG_STRING_LENGTH - LOG_TAIL_ETC_LENGTH - 1))
@@ -390,6 +572,8 @@ namespace ParaEngine
 
 	int CLogger::GetPos()
 	{
+		// async writer thread locks m_mutex inside, so flush before locking. 
+		Flush();
 		ParaEngine::Lock lock_(m_mutex);
 		FILE * pFile = GetLogFileHandle();
 		if(pFile)
@@ -414,6 +598,7 @@ namespace ParaEngine
 
 	const char* CLogger::GetLog(int fromPos, int nCount)
 	{
+		Flush();
 		ParaEngine::Lock lock_(m_mutex);
 		static boost::thread_specific_ptr< std::vector<char> > g_text_;
 		if( ! g_text_.get() ) {
@@ -428,7 +613,8 @@ namespace ParaEngine
 		{
 			if(nCount <0)
 			{
-				nCount = GetPos() - fromPos;
+				// do not call GetPos() here, since it flushes the async writer, which may lock m_mutex in another thread. 
+				nCount = (int)ftell(pFile) - fromPos;
 			}
 			if(nCount>0)
 			{
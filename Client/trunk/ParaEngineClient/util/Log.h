@@ -1,12 +1,16 @@
 #pragma once
 #include "util/mutex.h"
 #include <string>
+#include <time.h>
+#include <stdint.h>
+#include <atomic>
 
 #define MAX_DEBUG_STRING_LENGTH 1024
 
 namespace ParaEngine
 {
 	class CLogger;
+	class CAsyncLogWriter;
 
 	namespace LogDetail
 	{
@@ -103,6 +107,8 @@ namespace ParaEngine
 	* char and wchar_t are supported. Both multi-threaded and single-threaded logging functions are supported. 
 	* Internally we use a mutex to sync write. 
 	* Messages are written immediately to file; it uses the system IO cache. 
+	* In async mode (see SetAsyncMode), thread safe functions never lock or touch the disk, 
+	* messages are queued to a per thread lock-free ring and batch written by a background thread. 
 	*/
 	class PE_CORE_DECL CLogger
 	{
@@ -150,6 +156,12 @@ namespace ParaEngine
 		/** single threaded version */
 		int Write_st(const char * buf, int nLength);
 
+		/** write a batch of log records that is already formatted, and rotate log file if needed. 
+		* this is called by the async log writer thread. 
+		* [thread safe]
+		*/
+		int WriteBatch(const char * buf, int nLength);
+
 		/** get the current log file position. it is equivalent to the log file size in bytes. 
 		one can later get log text between two Log positions. 
 		*/
@@ -189,6 +201,33 @@ namespace ParaEngine
 		*/
 		void SetForceFlush(bool bForceFlush);
 
+		/** in async mode, thread safe logging functions format the message on the calling thread and queue it to 
+		* a per thread lock-free ring buffer. A background thread drains all rings and writes them in batches. 
+		* If a ring is full, the message is dropped and counted. Records too large for a ring are written directly after the queued ones. 
+		* It can be switched at any time. The writer is only stopped when async mode is off, and is reused when it is on again. 
+		* @param nRingBufferSize: per thread ring buffer size in bytes. It applies to rings created after this call. 
+		*/
+		void SetAsyncMode(bool bAsync, int nRingBufferSize = 64 * 1024);
+		bool IsAsyncMode();
+
+		/** block until all queued async log messages are written to file. it does nothing in sync mode. */
+		void Flush();
+
+		/** number of log messages dropped in async mode because ring buffer is full. */
+		int64_t GetDroppedLogCount();
+
+		/** in async mode, rotate the log file when its size in bytes exceeds this value. 0 (default) to disable. */
+		void SetMaxLogFileSize(int nBytes);
+		int GetMaxLogFileSize();
+
+		/** in async mode, rotate the log file every given seconds. 0 (default) to disable. */
+		void SetLogRotateInterval(int nSeconds);
+		int GetLogRotateInterval();
+
+		/** max number of rotated files to keep, such as log.txt.1, log.txt.2. default to 5. */
+		void SetMaxRotatedFiles(int nCount);
+		int GetMaxRotatedFiles();
+
 		/**
 		Returns the assigned Level
 		@return Level - the assigned Level
@@ -268,6 +307,28 @@ namespace ParaEngine
 		which case it is inherited from parent. */
 		int m_level;
 
+		/** not null in async mode. Logging threads read it without a lock, so it only ever points to m_pAsyncWriterOwned. */
+		std::atomic<CAsyncLogWriter*> m_pAsyncWriter;
+		/** created on first use and deleted with the logger, since other threads may still be inside its Push() after async mode is off. */
+		CAsyncLogWriter* m_pAsyncWriterOwned;
+		/** serialize SetAsyncMode(). it is not m_mutex, because the writer thread locks m_mutex while it is being stopped. */
+		mutex m_async_mutex;
+		/** rotate log when file size exceeds this value. 0 to disable. */
+		int m_nMaxLogFileSize;
+		/** rotate log every this number of seconds. 0 to disable. */
+		int m_nLogRotateInterval;
+		int m_nMaxRotatedFiles;
+		/** time when the current log file is opened. */
+		time_t m_nLogOpenTime;
+
+	protected:
+		/** rename current log file to log.txt.1, and shift older ones. m_mutex must be locked. */
+		void RotateLog_st();
+
+		/** format to a caller provided buffer of MAX_DEBUG_STRING_LENGTH bytes after nPrefixSize bytes, and truncate with "...\n" if too long. 
+		* @return number of bytes in the buffer, including the prefix. 
+		*/
+		static int FormatLogBuffer(char* buffer, int nPrefixSize, const char * zFormat, va_list args);
 	};
 #ifdef WIN32
 #pragma warning( pop ) 
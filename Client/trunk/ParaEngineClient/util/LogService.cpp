@@ -33,6 +33,18 @@ void ParaEngine::CServiceLogger::WriteServiceFormated(const char * zFormat, ...)
 	std::string date_str = ParaEngine::GetDateFormat("yyyy-MM-dd");
 	std::string time_str = ParaEngine::GetTimeFormat(NULL);
 
+	if (IsAsyncMode())
+	{
+		char buffer[MAX_DEBUG_STRING_LENGTH];
+		int nSize = snprintf(buffer, MAX_DEBUG_STRING_LENGTH, "%s %s|%d|", date_str.c_str(), time_str.c_str(), ParaEngine::GetThisThreadID());
+		va_list args;
+		va_start(args, zFormat);
+		nSize = FormatLogBuffer(buffer, nSize, zFormat, args);
+		va_end(args);
+		Write(buffer, nSize);
+		return;
+	}
+
 	ParaEngine::Lock lock_(m_mutex);
 	int nSize = snprintf(m_buffer, MAX_DEBUG_STRING_LENGTH, "%s %s|%d|", date_str.c_str(), time_str.c_str(), ParaEngine::GetThisThreadID());
 
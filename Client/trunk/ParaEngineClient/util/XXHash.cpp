@@ -0,0 +1,213 @@
+//-----------------------------------------------------------------------------
+// Class:	XXHash64
+// Based on:	the xxHash algorithm by Yann Collet (BSD 2-Clause License)
+// Company: ParaEngine
+// Desc: XXH64 hash.
+//-----------------------------------------------------------------------------
+#include "ParaEngine.h"
+#include "XXHash.h"
+
+using namespace ParaEngine;
+
+namespace
+{
+	const uint64 PRIME64_1 = 11400714785074694791ULL;
+	const uint64 PRIME64_2 = 14029467366897019727ULL;
+	const uint64 PRIME64_3 = 1609587929392839161ULL;
+	const uint64 PRIME64_4 = 9650029242287828579ULL;
+	const uint64 PRIME64_5 = 2870177450012600261ULL;
+
+	inline uint64 RotateLeft(uint64 x, int r)
+	{
+		return (x << r) | (x >> (64 - r));
+	}
+
+	/** little endian read. the compiler turns the shifts into a single load on little endian CPUs. */
+	inline uint64 Read64(const unsigned char* p)
+	{
+		return (uint64)p[0] | ((uint64)p[1] << 8) | ((uint64)p[2] << 16) | ((uint64)p[3] << 24) |
+			((uint64)p[4] << 32) | ((uint64)p[5] << 40) | ((uint64)p[6] << 48) | ((uint64)p[7] << 56);
+	}
+
+	inline uint64 Read32(const unsigned char* p)
+	{
+		return (uint64)p[0] | ((uint64)p[1] << 8) | ((uint64)p[2] << 16) | ((uint64)p[3] << 24);
+	}
+
+	inline uint64 Round(uint64 acc, uint64 input)
+	{
+		acc += input * PRIME64_2;
+		acc = RotateLeft(acc, 31);
+		return acc * PRIME64_1;
+	}
+
+	inline uint64 MergeRound(uint64 acc, uint64 val)
+	{
+		acc ^= Round(0, val);
+		return acc * PRIME64_1 + PRIME64_4;
+	}
+
+	/** process all 32 bytes stripes and return the first byte not processed. */
+	inline const unsigned char* ProcessStripes(uint64* v, const unsigned char* p, const unsigned char* pEnd)
+	{
+		// the four lanes are independent, so that the CPU can run them in parallel.
+		uint64 v1 = v[0], v2 = v[1], v3 = v[2], v4 = v[3];
+		while (p + 32 <= pEnd)
+		{
+			v1 = Round(v1, Read64(p));
+			v2 = Round(v2, Read64(p + 8));
+			v3 = Round(v3, Read64(p + 16));
+			v4 = Round(v4, Read64(p + 24));
+			p += 32;
+		}
+		v[0] = v1; v[1] = v2; v[2] = v3; v[3] = v4;
+		return p;
+	}
+
+	uint64 Finalize(uint64 h, const unsigned char* p, size_t nSize)
+	{
+		const unsigned char* pEnd = p + nSize;
+		while (p + 8 <= pEnd)
+		{
+			h ^= Round(0, Read64(p));
+			h = RotateLeft(h, 27) * PRIME64_1 + PRIME64_4;
+			p += 8;
+		}
+		if (p + 4 <= pEnd)
+		{
+			h ^= Read32(p) * PRIME64_1;
+			h = RotateLeft(h, 23) * PRIME64_2 + PRIME64_3;
+			p += 4;
+		}
+		while (p < pEnd)
+		{
+			h ^= (*p) * PRIME64_5;
+			h = RotateLeft(h, 11) * PRIME64_1;
+			++p;
+		}
+		h ^= h >> 33;
+		h *= PRIME64_2;
+		h ^= h >> 29;
+		h *= PRIME64_3;
+		h ^= h >> 32;
+		return h;
+	}
+
+	inline uint64 MergeLanes(const uint64* v)
+	{
+		uint64 h = RotateLeft(v[0], 1) + RotateLeft(v[1], 7) + RotateLeft(v[2], 12) + RotateLeft(v[3], 18);
+		h = MergeRound(h, v[0]);
+		h = MergeRound(h, v[1]);
+		h = MergeRound(h, v[2]);
+		h = MergeRound(h, v[3]);
+		return h;
+	}
+}
+
+XXHash64::XXHash64(uint64 nSeed)
+{
+	reset(nSeed);
+}
+
+void XXHash64::reset(uint64 nSeed)
+{
+	m_nSeed = nSeed;
+	m_v[0] = nSeed + PRIME64_1 + PRIME64_2;
+	m_v[1] = nSeed + PRIME64_2;
+	m_v[2] = nSeed;
+	m_v[3] = nSeed - PRIME64_1;
+	m_nTotalSize = 0;
+	m_nBufSize = 0;
+}
+
+void XXHash64::feed(const void* data, size_t nSize)
+{
+	const unsigned char* p = (const unsigned char*)data;
+	const unsigned char* pEnd = p + nSize;
+	m_nTotalSize += nSize;
+
+	if (m_nBufSize + nSize < 32)
+	{
+		if (nSize > 0)
+			memcpy(m_buf + m_nBufSize, p, nSize);
+		m_nBufSize += (int)nSize;
+		return;
+	}
+	if (m_nBufSize > 0)
+	{
+		int nCopy = 32 - m_nBufSize;
+		memcpy(m_buf + m_nBufSize, p, nCopy);
+		ProcessStripes(m_v, m_buf, m_buf + 32);
+		p += nCopy;
+		m_nBufSize = 0;
+	}
+	p = ProcessStripes(m_v, p, pEnd);
+	if (p < pEnd)
+	{
+		m_nBufSize = (int)(pEnd - p);
+		memcpy(m_buf, p, m_nBufSize);
+	}
+}
+
+uint64 XXHash64::digest() const
+{
+	uint64 h;
+	if (m_nTotalSize >= 32)
+		h = MergeLanes(m_v);
+	else
+		h = m_nSeed + PRIME64_5;
+	h += m_nTotalSize;
+	return Finalize(h, m_buf, m_nBufSize);
+}
+
+uint64 XXHash64::Hash(const void* data, size_t nSize, uint64 nSeed)
+{
+	const unsigned char* p = (const unsigned char*)data;
+	const unsigned char* pEnd = p + nSize;
+	uint64 h;
+	if (nSize >= 32)
+	{
+		uint64 v[4] = { nSeed + PRIME64_1 + PRIME64_2, nSeed + PRIME64_2, nSeed, nSeed - PRIME64_1 };
+		p = ProcessStripes(v, p, pEnd);
+		h = MergeLanes(v);
+	}
+	else
+		h = nSeed + PRIME64_5;
+	h += (uint64)nSize;
+	return Finalize(h, p, (size_t)(pEnd - p));
+}
+
+std::string XXHash64::ToHex(uint64 nHash)
+{
+	static const char s_hex[] = "0123456789abcdef";
+	std::string sHex(16, '0');
+	for (int i = 15; i >= 0; --i)
+	{
+		sHex[i] = s_hex[nHash & 0xf];
+		nHash >>= 4;
+	}
+	return sHex;
+}
+
+bool XXHash64::FromHex(const char* sHex, uint64& nHash)
+{
+	if (!sHex)
+		return false;
+	uint64 nValue = 0;
+	for (int i = 0; i < 16; ++i)
+	{
+		char c = sHex[i];
+		int nDigit;
+		if (c >= '0' && c <= '9')
+			nDigit = c - '0';
+		else if (c >= 'a' && c <= 'f')
+			nDigit = c - 'a' + 10;
+		else if (c >= 'A' && c <= 'F')
+			nDigit = c - 'A' + 10;
+		else
+			return false;
+		nValue = (nValue << 4) | (uint64)nDigit;
+	}
+	nHash = nValue;
+	return true;
+}
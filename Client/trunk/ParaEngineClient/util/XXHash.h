@@ -0,0 +1,43 @@
+#pragma once
+#include <string>
+
+namespace ParaEngine
+{
+	/**
+	* 64 bits xxHash (XXH64) by Yann Collet. It is a non-cryptographic hash, which runs at memory speed,
+	* so it is used to check the integrity of large asset files instead of MD5.
+	* The result is the same as the reference implementation, so it can be computed by external tools.
+	*/
+	class XXHash64
+	{
+	public:
+		XXHash64(uint64 nSeed = 0);
+
+		/** feed the hash. it can be called multiple times. */
+		void feed(const void* data, size_t nSize);
+
+		/** get the hash value of all data fed so far. One can still feed more data after this call. */
+		uint64 digest() const;
+
+		/** reset the hash */
+		void reset(uint64 nSeed = 0);
+
+		/** hash a buffer in one call */
+		static uint64 Hash(const void* data, size_t nSize, uint64 nSeed = 0);
+
+		/** 16 lower case hex characters, most significant first. */
+		static std::string ToHex(uint64 nHash);
+
+		/** parse the output of ToHex()
+		* @return false if the input is not 16 hex characters.
+		*/
+		static bool FromHex(const char* sHex, uint64& nHash);
+
+	private:
+		uint64 m_v[4];
+		uint64 m_nSeed;
+		uint64 m_nTotalSize;
+		unsigned char m_buf[32];
+		int m_nBufSize;
+	};
+}
@@ -323,6 +323,59 @@ IParaPhysicsActor* ParaEngine::CParaPhysicsWorld::RaycastClosestShape(const PARA
 	}
 }
 
+int ParaEngine::CParaPhysicsWorld::RaycastClosestShapes(const ParaPhysicsRayQuery* pQueries, int nCount, ParaPhysicsQueryHit* pHits)
+{
+	int nHitCount = 0;
+	for (int i = 0; i < nCount; ++i)
+	{
+		const ParaPhysicsRayQuery& query = pQueries[i];
+		pHits[i].m_pActor = RaycastClosestShape(query.m_vOrigin, query.m_vDirection, 0, pHits[i], query.m_nGroupMask, query.m_fSensorRange);
+		if (pHits[i].m_pActor)
+			++nHitCount;
+	}
+	return nHitCount;
+}
+
+int ParaEngine::CParaPhysicsWorld::SweepSphereClosestShapes(const ParaPhysicsSweepQuery* pQueries, int nCount, ParaPhysicsQueryHit* pHits)
+{
+	int nHitCount = 0;
+	for (int i = 0; i < nCount; ++i)
+	{
+		const ParaPhysicsSweepQuery& query = pQueries[i];
+		ParaPhysicsQueryHit& hit = pHits[i];
+		float fSensorRange = (query.m_fSensorRange < 0.f) ? 200.f : query.m_fSensorRange;
+		btVector3 vFrom(query.m_vOrigin.x, query.m_vOrigin.y, query.m_vOrigin.z);
+		btVector3 vTo = vFrom + btVector3(query.m_vDirection.x, query.m_vDirection.y, query.m_vDirection.z) * fSensorRange;
+		btTransform from, to;
+		from.setIdentity();
+		from.setOrigin(vFrom);
+		to.setIdentity();
+		to.setOrigin(vTo);
+
+		btSphereShape sphere(query.m_fRadius);
+		btCollisionWorld::ClosestConvexResultCallback cb(vFrom, vTo);
+		cb.m_collisionFilterMask = query.m_nGroupMask;
+		m_dynamicsWorld->convexSweepTest(&sphere, from, to, cb);
+		if (cb.hasHit())
+		{
+			hit.m_vHitPointWorld = CONVERT_PARAVECTOR3(cb.m_hitPointWorld);
+			hit.m_vHitNormalWorld = CONVERT_PARAVECTOR3(cb.m_hitNormalWorld.normalize());
+			hit.m_fDistance = cb.m_closestHitFraction * fSensorRange;
+			hit.m_pActor = (IParaPhysicsActor*)(cb.m_hitCollisionObject->getUserPointer());
+			++nHitCount;
+		}
+		else
+		{
+			hit.m_vHitPointWorld = CONVERT_PARAVECTOR3(vTo);
+			btVector3 tem(1.0, 0.0, 0.0);
+			hit.m_vHitNormalWorld = CONVERT_PARAVECTOR3(tem);
+			hit.m_fDistance = fSensorRange;
+			hit.m_pActor = NULL;
+		}
+	}
+	return nHitCount;
+}
+
 void ParaEngine::CParaPhysicsWorld::SetDebugDrawer(IParaDebugDraw* debugDrawer)
 {
 	m_physics_debug_draw.SetParaDebugDrawInterface(debugDrawer);
@@ -355,4 +408,8 @@ void ParaEngine::CParaPhysicsWorld::SetDebugDrawMode(int debugMode)
 int ParaEngine::CParaPhysicsWorld::GetDebugDrawMode()
 {
 	return m_physics_debug_draw.getDebugMode();
+}
+
+void ParaEngine::CParaPhysicsWorld::SetShapeCacheDirectory(const char* sDirectory)
+{
 }
\ No newline at end of file
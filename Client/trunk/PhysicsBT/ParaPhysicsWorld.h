@@ -102,6 +102,12 @@ namespace ParaEngine
 		/** ray cast a given group. */
 		virtual IParaPhysicsActor* RaycastClosestShape(const PARAVECTOR3& vOrigin, const PARAVECTOR3& vDirection, DWORD dwType, RayCastHitResult& hit, short dwGroupMask, float fSensorRange);
 
+		/** ray cast a batch of queries one by one. */
+		virtual int RaycastClosestShapes(const ParaPhysicsRayQuery* pQueries, int nCount, ParaPhysicsQueryHit* pHits);
+
+		/** sweep a sphere for a batch of queries one by one. */
+		virtual int SweepSphereClosestShapes(const ParaPhysicsSweepQuery* pQueries, int nCount, ParaPhysicsQueryHit* pHits);
+
 		/** set the debug draw object for debugging physics world. */
 		virtual void	SetDebugDrawer(IParaDebugDraw*	debugDrawer);
 
@@ -119,6 +125,9 @@ namespace ParaEngine
 
 		/** bitwise of PhysicsDebugDrawModes */
 		virtual int		GetDebugDrawMode();
+
+		/** BVH trees are not cached in this version. see the PhysicsBT plugin in externals/bullet3 */
+		virtual void SetShapeCacheDirectory(const char* sDirectory);
 	public:
 		/** get a pointer to physics scene object */
 		virtual btDynamicsWorld* GetScene()
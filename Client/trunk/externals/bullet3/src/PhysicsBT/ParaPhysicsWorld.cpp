@@ -6,20 +6,319 @@
 //-----------------------------------------------------------------------------
 #include "PluginAPI.h"
 #include "ParaPhysicsWorld.h"
+#include "BulletDynamics/Dynamics/btDiscreteDynamicsWorldMt.h"
+#include "BulletDynamics/Dynamics/btSimulationIslandManagerMt.h"
+#include <stdio.h>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <vector>
 
 /// @def using motion state is recommended, it provides interpolation capabilities, and only synchronizes 'active' objects
 #define USE_MOTIONSTATE 1
 
+/// @def BVH trees of smaller meshes are not cached, since building them is faster than reading a file.
+#define BVH_CACHE_MIN_TRIANGLES		256
+/// @def "PBVH"
+#define BVH_CACHE_FILE_MAGIC		0x48564250
+#define BVH_CACHE_FILE_VERSION		1
+/// @def number of queries that a thread takes at a time in batched queries. smaller batches are done on the calling thread.
+#define QUERY_BATCH_SIZE			32
+
 using namespace ParaEngine;
 
+namespace ParaEngine
+{
+	/** header of a BVH cache file. It is followed by the BVH serialized in place. */
+	struct BvhCacheFileHeader
+	{
+		uint32 m_nMagic;
+		uint32 m_nVersion;
+		/** in-place serialization depends on the bullet version and the precision of btScalar. */
+		uint32 m_nBulletVersion;
+		uint32 m_nScalarSize;
+		uint32 m_nNumTriangles;
+		uint32 m_nNumVertices;
+		uint64 m_nMeshHash;
+		uint32 m_nBvhSize;
+		uint32 m_nReserved;
+	};
+}
+
+namespace ParaEngine
+{
+	/** a fixed number of worker threads owned by the physics world. the calling thread also takes part in each job.
+	* Only one job runs at a time. If the pool is busy, for example when a query is made during a step on another thread,
+	* the job is done on the calling thread instead of waiting for the pool. */
+	class ParaPhysicsThreadPool
+	{
+	public:
+		/** @param nThreadCount: number of threads that run a job, including the calling thread. */
+		ParaPhysicsThreadPool(int nThreadCount)
+			: m_pFunc(NULL), m_nTaskCount(0), m_nNextTask(0), m_nJobId(0), m_nActiveWorkers(0), m_bStop(false)
+		{
+			for (int i = 1; i < nThreadCount; ++i)
+				m_workers.push_back(std::thread(&ParaPhysicsThreadPool::WorkerLoop, this));
+		}
+
+		~ParaPhysicsThreadPool()
+		{
+			{
+				std::lock_guard<std::mutex> lock_(m_mutex);
+				m_bStop = true;
+			}
+			m_job_cond.notify_all();
+			for (auto& worker : m_workers)
+				worker.join();
+		}
+
+		/** number of threads that run a job, including the calling thread. */
+		int GetThreadCount() const { return (int)m_workers.size() + 1; }
+
+		/** call func(i) for all i in [0, nTaskCount) and return after all of them are done. */
+		void ParallelFor(int nTaskCount, const std::function<void(int)>& func)
+		{
+			std::unique_lock<std::mutex> job_lock(m_job_mutex, std::try_to_lock);
+			if (nTaskCount <= 1 || m_workers.empty() || !job_lock.owns_lock())
+			{
+				for (int i = 0; i < nTaskCount; ++i)
+					func(i);
+				return;
+			}
+			{
+				std::lock_guard<std::mutex> lock_(m_mutex);
+				m_pFunc = &func;
+				m_nTaskCount = nTaskCount;
+				m_nNextTask = 0;
+				m_nActiveWorkers = (int)m_workers.size();
+				++m_nJobId;
+			}
+			m_job_cond.notify_all();
+			RunTasks();
+			std::unique_lock<std::mutex> lock_(m_mutex);
+			m_done_cond.wait(lock_, [this]() { return m_nActiveWorkers == 0; });
+			m_pFunc = NULL;
+		}
+
+	protected:
+		void RunTasks()
+		{
+			int nTask;
+			while ((nTask = m_nNextTask.fetch_add(1)) < m_nTaskCount)
+				(*m_pFunc)(nTask);
+		}
+
+		void WorkerLoop()
+		{
+			int nLastJobId = 0;
+			for (;;)
+			{
+				{
+					std::unique_lock<std::mutex> lock_(m_mutex);
+					m_job_cond.wait(lock_, [&]() { return m_bStop || m_nJobId != nLastJobId; });
+					if (m_bStop)
+						return;
+					nLastJobId = m_nJobId;
+				}
+				RunTasks();
+				{
+					std::lock_guard<std::mutex> lock_(m_mutex);
+					// the next job is not started until all workers are done with this one, so no job is missed. 
+					if (--m_nActiveWorkers == 0)
+						m_done_cond.notify_one();
+				}
+			}
+		}
+
+		std::vector<std::thread> m_workers;
+		/** serializes jobs. */
+		std::mutex m_job_mutex;
+		/** guards the job states below, except m_nNextTask. */
+		std::mutex m_mutex;
+		std::condition_variable m_job_cond;
+		std::condition_variable m_done_cond;
+		const std::function<void(int)>* m_pFunc;
+		int m_nTaskCount;
+		std::atomic<int> m_nNextTask;
+		int m_nJobId;
+		int m_nActiveWorkers;
+		bool m_bStop;
+	};
+}
+
+/** call func(nFrom, nTo) for all batches of [0, nCount) on the thread pool. a single batch is done on the calling thread. */
+template <typename Func>
+static void ParallelForBatches(ParaPhysicsThreadPool* pThreadPool, int nCount, const Func& func)
+{
+	int nBatchCount = (nCount + QUERY_BATCH_SIZE - 1) / QUERY_BATCH_SIZE;
+	if (nBatchCount <= 1 || pThreadPool == 0)
+	{
+		func(0, nCount);
+		return;
+	}
+	pThreadPool->ParallelFor(nBatchCount, [&](int nBatch) {
+		int nFrom = nBatch * QUERY_BATCH_SIZE;
+		func(nFrom, btMin(nFrom + QUERY_BATCH_SIZE, nCount));
+	});
+}
+
+/** visit broadphase leaves along a ray. Unlike btDbvtBroadphase::rayTest, which shares one traversal stack, it is safe to use from multiple threads. */
+struct RayQueryLeafCallback : public btDbvt::ICollide
+{
+	RayQueryLeafCallback(const btVector3& vFrom, const btVector3& vTo, btCollisionWorld::RayResultCallback& resultCallback)
+		: m_resultCallback(resultCallback)
+	{
+		m_rayFromTrans.setIdentity();
+		m_rayFromTrans.setOrigin(vFrom);
+		m_rayToTrans.setIdentity();
+		m_rayToTrans.setOrigin(vTo);
+	}
+
+	void Process(const btDbvtNode* leaf)
+	{
+		if (m_resultCallback.m_closestHitFraction == btScalar(0.f))
+			return;
+		btBroadphaseProxy* proxy = (btBroadphaseProxy*)leaf->data;
+		if (m_resultCallback.needsCollision(proxy))
+		{
+			btCollisionObject* collisionObject = (btCollisionObject*)proxy->m_clientObject;
+			btCollisionWorld::rayTestSingle(m_rayFromTrans, m_rayToTrans, collisionObject, collisionObject->getCollisionShape(), collisionObject->getWorldTransform(), m_resultCallback);
+		}
+	}
+
+	btTransform m_rayFromTrans;
+	btTransform m_rayToTrans;
+	btCollisionWorld::RayResultCallback& m_resultCallback;
+};
+
+/** visit broadphase leaves overlapping the bounding box of a convex sweep. it is safe to use from multiple threads. */
+struct SweepQueryLeafCallback : public btDbvt::ICollide
+{
+	SweepQueryLeafCallback(const btConvexShape* pCastShape, const btTransform& from, const btTransform& to, btCollisionWorld::ConvexResultCallback& resultCallback, btScalar fAllowedPenetration)
+		: m_pCastShape(pCastShape), m_convexFromTrans(from), m_convexToTrans(to), m_resultCallback(resultCallback), m_fAllowedPenetration(fAllowedPenetration)
+	{
+	}
+
+	void Process(const btDbvtNode* leaf)
+	{
+		if (m_resultCallback.m_closestHitFraction == btScalar(0.f))
+			return;
+		btBroadphaseProxy* proxy = (btBroadphaseProxy*)leaf->data;
+		if (m_resultCallback.needsCollision(proxy))
+		{
+			btCollisionObject* collisionObject = (btCollisionObject*)proxy->m_clientObject;
+			btCollisionWorld::objectQuerySingle(m_pCastShape, m_convexFromTrans, m_convexToTrans, collisionObject, collisionObject->getCollisionShape(), collisionObject->getWorldTransform(), m_resultCallback, m_fAllowedPenetration);
+		}
+	}
+
+	const btConvexShape* m_pCastShape;
+	btTransform m_convexFromTrans;
+	btTransform m_convexToTrans;
+	btCollisionWorld::ConvexResultCallback& m_resultCallback;
+	btScalar m_fAllowedPenetration;
+};
+
+#if BT_THREADSAFE
+/** thread pool of the world to solve simulation islands, see ParallelIslandDispatch(). the dispatch function takes no user data. */
+static ParaPhysicsThreadPool* s_pSolverThreadPool = NULL;
+
+/** solve simulation islands on multiple threads. Islands are sorted from large to small, so that large ones are taken first. */
+static void ParallelIslandDispatch(btAlignedObjectArray<btSimulationIslandManagerMt::Island*>* pIslands, btSimulationIslandManagerMt::IslandCallback* pCallback)
+{
+	btAlignedObjectArray<btSimulationIslandManagerMt::Island*>& islands = *pIslands;
+	int nIslandCount = islands.size();
+	auto solveIsland = [&](int nIndex) {
+		btSimulationIslandManagerMt::Island* island = islands[nIndex];
+		btPersistentManifold** manifolds = island->manifoldArray.size() ? &island->manifoldArray[0] : NULL;
+		btTypedConstraint** constraints = island->constraintArray.size() ? &island->constraintArray[0] : NULL;
+		pCallback->processIsland(&island->bodyArray[0], island->bodyArray.size(), manifolds, island->manifoldArray.size(), constraints, island->constraintArray.size(), island->id);
+	};
+	if (s_pSolverThreadPool == 0)
+	{
+		for (int i = 0; i < nIslandCount; ++i)
+			solveIsland(i);
+		return;
+	}
+	s_pSolverThreadPool->ParallelFor(nIslandCount, solveIsland);
+}
+
+/** btDiscreteDynamicsWorldMt solves islands concurrently with the same solver, so each island locks one of several solvers instead. */
+class ParaConstraintSolverPool : public btConstraintSolver
+{
+public:
+	ParaConstraintSolverPool(int nCount)
+		: m_solvers(nCount), m_locks(nCount)
+	{
+		for (int i = 0; i < nCount; ++i)
+			m_solvers[i] = new btSequentialImpulseConstraintSolver();
+	}
+
+	virtual ~ParaConstraintSolverPool()
+	{
+		for (auto pSolver : m_solvers)
+			delete pSolver;
+	}
+
+	virtual btScalar solveGroup(btCollisionObject** bodies, int numBodies, btPersistentManifold** manifolds, int numManifolds, btTypedConstraint** constraints, int numConstraints, const btContactSolverInfo& info, btIDebugDraw* debugDrawer, btDispatcher* dispatcher)
+	{
+		int nCount = (int)m_solvers.size();
+		for (int i = 0;; i = (i + 1) % nCount)
+		{
+			if (m_locks[i].try_lock())
+			{
+				m_solvers[i]->solveGroup(bodies, numBodies, manifolds, numManifolds, constraints, numConstraints, info, debugDrawer, dispatcher);
+				m_locks[i].unlock();
+				return 0.f;
+			}
+		}
+	}
+
+	virtual void reset()
+	{
+		for (auto pSolver : m_solvers)
+			pSolver->reset();
+	}
+
+	virtual btConstraintSolverType getSolverType() const
+	{
+		return BT_SEQUENTIAL_IMPULSE_SOLVER;
+	}
+
+protected:
+	std::vector<btSequentialImpulseConstraintSolver*> m_solvers;
+	std::vector<std::mutex> m_locks;
+};
+#endif
+
+/** FNV-1a hash of a memory block, continuing from nHash. */
+static uint64 HashMemory(const void* pData, size_t nSize, uint64 nHash = 14695981039346656037ULL)
+{
+	const unsigned char* p = (const unsigned char*)pData;
+	for (size_t i = 0; i < nSize; ++i)
+	{
+		nHash ^= p[i];
+		nHash *= 1099511628211ULL;
+	}
+	return nHash;
+}
+
 BulletPhysicsShape::BulletPhysicsShape()
-	:m_pShape(NULL), m_indexVertexArrays(NULL), m_triangleIndices(NULL), m_vertices(NULL)
+	:m_pShape(NULL), m_indexVertexArrays(NULL), m_triangleIndices(NULL), m_vertices(NULL), m_pCachedBvh(NULL)
 {
 }
 
 BulletPhysicsShape::~BulletPhysicsShape()
 {
 	SAFE_DELETE(m_pShape);
+	if (m_pCachedBvh)
+	{
+		// the bvh is constructed in place at the beginning of the aligned buffer
+		m_pCachedBvh->~btOptimizedBvh();
+		btAlignedFree(m_pCachedBvh);
+		m_pCachedBvh = NULL;
+	}
 	SAFE_DELETE(m_indexVertexArrays);
 	SAFE_DELETE_ARRAY(m_triangleIndices);
 	SAFE_DELETE_ARRAY(m_vertices);
@@ -52,8 +351,11 @@ void ParaEngine::BulletPhysicsActor::Release()
 // Physics World
 //
 CParaPhysicsWorld::CParaPhysicsWorld()
-	: m_dynamicsWorld(NULL), m_collisionWorld(NULL), m_broadphase(NULL), m_dispatcher(NULL), m_solver(NULL), m_collisionConfiguration(NULL), m_bInvertFaceWinding(false)
+	: m_dynamicsWorld(NULL), m_collisionWorld(NULL), m_broadphase(NULL), m_dispatcher(NULL), m_solver(NULL), m_collisionConfiguration(NULL), m_bInvertFaceWinding(false), m_pThreadPool(NULL)
 {
+	m_nMaxThreads = (int)std::thread::hardware_concurrency();
+	if (m_nMaxThreads < 1)
+		m_nMaxThreads = 1;
 #ifdef WIN32
 	m_bInvertFaceWinding = true;
 #endif
@@ -61,7 +363,7 @@ CParaPhysicsWorld::CParaPhysicsWorld()
 
 CParaPhysicsWorld::~CParaPhysicsWorld()
 {
-
+	SAFE_DELETE(m_pThreadPool);
 }
 
 void CParaPhysicsWorld::Release()
@@ -80,8 +382,26 @@ bool CParaPhysicsWorld::InitPhysics()
 
 	m_broadphase = new btDbvtBroadphase();
 
-	m_solver = new btSequentialImpulseConstraintSolver();
-	m_dynamicsWorld = new btDiscreteDynamicsWorld(m_dispatcher, m_broadphase, m_solver, m_collisionConfiguration);
+	// worker threads are created once here and shared by batched queries and the solver. 
+	if (m_nMaxThreads > 1 && m_pThreadPool == 0)
+		m_pThreadPool = new ParaPhysicsThreadPool(m_nMaxThreads);
+
+#if BT_THREADSAFE
+	if (m_pThreadPool)
+	{
+		// simulation islands are solved in parallel. it requires bullet to be built with BULLET2_USE_THREAD_LOCKS.
+		s_pSolverThreadPool = m_pThreadPool;
+		m_solver = new ParaConstraintSolverPool(m_nMaxThreads);
+		btDiscreteDynamicsWorldMt* pWorld = new btDiscreteDynamicsWorldMt(m_dispatcher, m_broadphase, m_solver, m_collisionConfiguration);
+		static_cast<btSimulationIslandManagerMt*>(pWorld->getSimulationIslandManager())->setIslandDispatchFunction(ParallelIslandDispatch);
+		m_dynamicsWorld = pWorld;
+	}
+	else
+#endif
+	{
+		m_solver = new btSequentialImpulseConstraintSolver();
+		m_dynamicsWorld = new btDiscreteDynamicsWorld(m_dispatcher, m_broadphase, m_solver, m_collisionConfiguration);
+	}
 
 	if (m_dynamicsWorld)
 	{
@@ -146,6 +466,11 @@ bool CParaPhysicsWorld::ExitPhysics()
 
 	SAFE_DELETE(m_collisionConfiguration);
 
+#if BT_THREADSAFE
+	if (s_pSolverThreadPool == m_pThreadPool)
+		s_pSolverThreadPool = NULL;
+#endif
+	SAFE_DELETE(m_pThreadPool);
 	return true;
 }
 
@@ -216,7 +541,32 @@ IParaPhysicsShape* CParaPhysicsWorld::CreateTriangleMeshShap(const ParaPhysicsTr
 
 	bool useQuantizedAabbCompression = true;
 
-	pShape->m_pShape = new btBvhTriangleMeshShape(pShape->m_indexVertexArrays, useQuantizedAabbCompression);
+	// the cache file is keyed by the hash of mesh content. The scaling is included, since vertices are already scaled by the caller. 
+	std::string sCacheFile;
+	uint64 nMeshHash = 0;
+	if (!m_sShapeCacheDir.empty() && meshDesc.m_numTriangles >= BVH_CACHE_MIN_TRIANGLES)
+	{
+		nMeshHash = HashMemory(pShape->m_triangleIndices, sizeof(int32) * 3 * meshDesc.m_numTriangles);
+		nMeshHash = HashMemory(pShape->m_vertices, meshDesc.m_pointStrideBytes * meshDesc.m_numVertices, nMeshHash);
+		char sName[64];
+		snprintf(sName, sizeof(sName), "%08x%08x_%u.bvh", (unsigned int)(nMeshHash >> 32), (unsigned int)(nMeshHash & 0xffffffff), (unsigned int)meshDesc.m_numTriangles);
+		sCacheFile = m_sShapeCacheDir + sName;
+		pShape->m_pCachedBvh = LoadCachedBvh(sCacheFile, meshDesc.m_numTriangles, meshDesc.m_numVertices, nMeshHash);
+	}
+
+	if (pShape->m_pCachedBvh)
+	{
+		btBvhTriangleMeshShape* pMeshShape = new btBvhTriangleMeshShape(pShape->m_indexVertexArrays, useQuantizedAabbCompression, false);
+		pMeshShape->setOptimizedBvh(pShape->m_pCachedBvh);
+		pShape->m_pShape = pMeshShape;
+	}
+	else
+	{
+		btBvhTriangleMeshShape* pMeshShape = new btBvhTriangleMeshShape(pShape->m_indexVertexArrays, useQuantizedAabbCompression);
+		pShape->m_pShape = pMeshShape;
+		if (!sCacheFile.empty())
+			SaveCachedBvh(sCacheFile, pMeshShape->getOptimizedBvh(), meshDesc.m_numTriangles, meshDesc.m_numVertices, nMeshHash);
+	}
 	pShape->m_pShape->setUserPointer(pShape);
 
 	m_collisionShapes.insert(pShape);
@@ -324,6 +674,114 @@ IParaPhysicsActor* ParaEngine::CParaPhysicsWorld::RaycastClosestShape(const PARA
 	}
 }
 
+int ParaEngine::CParaPhysicsWorld::RaycastClosestShapes(const ParaPhysicsRayQuery* pQueries, int nCount, ParaPhysicsQueryHit* pHits)
+{
+	if (m_dynamicsWorld == 0 || nCount <= 0)
+		return 0;
+	// InitPhysics() always creates a btDbvtBroadphase, which keeps dynamic proxies in m_sets[0] and static ones in m_sets[1].
+	// The trees are only read here, so the world must not be stepped or changed until all queries are done.
+	btDbvtBroadphase* pBroadphase = static_cast<btDbvtBroadphase*>(m_broadphase);
+	std::atomic<int> nHitCount(0);
+	ParallelForBatches(m_pThreadPool, nCount, [&](int nFrom, int nTo) {
+		int nHits = 0;
+		for (int i = nFrom; i < nTo; ++i)
+		{
+			const ParaPhysicsRayQuery& query = pQueries[i];
+			ParaPhysicsQueryHit& hit = pHits[i];
+			btScalar fSensorRange = (query.m_fSensorRange < 0.f) ? 200.f : query.m_fSensorRange;
+			btVector3 vFrom(query.m_vOrigin.x, query.m_vOrigin.y, query.m_vOrigin.z);
+			btVector3 vTo = vFrom + btVector3(query.m_vDirection.x, query.m_vDirection.y, query.m_vDirection.z) * fSensorRange;
+
+			btCollisionWorld::ClosestRayResultCallback cb(vFrom, vTo);
+			cb.m_collisionFilterMask = query.m_nGroupMask;
+			cb.m_flags = 1;// btTriangleRaycastCallback::kF_FilterBackfaces;
+			RayQueryLeafCallback leafCallback(vFrom, vTo, cb);
+			btDbvt::rayTest(pBroadphase->m_sets[0].m_root, vFrom, vTo, leafCallback);
+			btDbvt::rayTest(pBroadphase->m_sets[1].m_root, vFrom, vTo, leafCallback);
+
+			if (cb.hasHit())
+			{
+				hit.m_vHitPointWorld = CONVERT_PARAVECTOR3(cb.m_hitPointWorld);
+				hit.m_vHitNormalWorld = CONVERT_PARAVECTOR3(cb.m_hitNormalWorld.normalize());
+				hit.m_fDistance = cb.m_hitPointWorld.distance(vFrom);
+				hit.m_pActor = (IParaPhysicsActor*)(cb.m_collisionObject->getUserPointer());
+				++nHits;
+			}
+			else
+			{
+				hit.m_vHitPointWorld = CONVERT_PARAVECTOR3(vTo);
+				btVector3 tem(1.0, 0.0, 0.0);
+				hit.m_vHitNormalWorld = CONVERT_PARAVECTOR3(tem);
+				hit.m_fDistance = fSensorRange;
+				hit.m_pActor = NULL;
+			}
+		}
+		nHitCount += nHits;
+	});
+	return nHitCount;
+}
+
+int ParaEngine::CParaPhysicsWorld::SweepSphereClosestShapes(const ParaPhysicsSweepQuery* pQueries, int nCount, ParaPhysicsQueryHit* pHits)
+{
+	if (m_dynamicsWorld == 0 || nCount <= 0)
+		return 0;
+	btDbvtBroadphase* pBroadphase = static_cast<btDbvtBroadphase*>(m_broadphase);
+	btScalar fAllowedPenetration = m_dynamicsWorld->getDispatchInfo().m_allowedCcdPenetration;
+	std::atomic<int> nHitCount(0);
+	ParallelForBatches(m_pThreadPool, nCount, [&](int nFrom, int nTo) {
+		int nHits = 0;
+		for (int i = nFrom; i < nTo; ++i)
+		{
+			const ParaPhysicsSweepQuery& query = pQueries[i];
+			ParaPhysicsQueryHit& hit = pHits[i];
+			btScalar fSensorRange = (query.m_fSensorRange < 0.f) ? 200.f : query.m_fSensorRange;
+			btVector3 vFrom(query.m_vOrigin.x, query.m_vOrigin.y, query.m_vOrigin.z);
+			btVector3 vTo = vFrom + btVector3(query.m_vDirection.x, query.m_vDirection.y, query.m_vDirection.z) * fSensorRange;
+			btTransform from, to;
+			from.setIdentity();
+			from.setOrigin(vFrom);
+			to.setIdentity();
+			to.setOrigin(vTo);
+
+			btSphereShape sphere(query.m_fRadius);
+			btCollisionWorld::ClosestConvexResultCallback cb(vFrom, vTo);
+			cb.m_collisionFilterMask = query.m_nGroupMask;
+			SweepQueryLeafCallback leafCallback(&sphere, from, to, cb, fAllowedPenetration);
+			btVector3 vRadius(query.m_fRadius, query.m_fRadius, query.m_fRadius);
+			btVector3 vMin = vFrom, vMax = vFrom;
+			vMin.setMin(vTo);
+			vMax.setMax(vTo);
+			btDbvtVolume volume = btDbvtVolume::FromMM(vMin - vRadius, vMax + vRadius);
+			pBroadphase->m_sets[0].collideTV(pBroadphase->m_sets[0].m_root, volume, leafCallback);
+			pBroadphase->m_sets[1].collideTV(pBroadphase->m_sets[1].m_root, volume, leafCallback);
+
+			if (cb.hasHit())
+			{
+				hit.m_vHitPointWorld = CONVERT_PARAVECTOR3(cb.m_hitPointWorld);
+				hit.m_vHitNormalWorld = CONVERT_PARAVECTOR3(cb.m_hitNormalWorld.normalize());
+				hit.m_fDistance = cb.m_closestHitFraction * fSensorRange;
+				hit.m_pActor = (IParaPhysicsActor*)(cb.m_hitCollisionObject->getUserPointer());
+				++nHits;
+			}
+			else
+			{
+				hit.m_vHitPointWorld = CONVERT_PARAVECTOR3(vTo);
+				btVector3 tem(1.0, 0.0, 0.0);
+				hit.m_vHitNormalWorld = CONVERT_PARAVECTOR3(tem);
+				hit.m_fDistance = fSensorRange;
+				hit.m_pActor = NULL;
+			}
+		}
+		nHitCount += nHits;
+	});
+	return nHitCount;
+}
+
+void ParaEngine::CParaPhysicsWorld::SetMaxThreads(int nCount)
+{
+	m_nMaxThreads = (nCount > 0) ? nCount : 1;
+}
+
 void ParaEngine::CParaPhysicsWorld::SetDebugDrawer(IParaDebugDraw* debugDrawer)
 {
 	m_physics_debug_draw.SetParaDebugDrawInterface(debugDrawer);
@@ -356,4 +814,69 @@ void ParaEngine::CParaPhysicsWorld::SetDebugDrawMode(int debugMode)
 int ParaEngine::CParaPhysicsWorld::GetDebugDrawMode()
 {
 	return m_physics_debug_draw.getDebugMode();
+}
+
+void ParaEngine::CParaPhysicsWorld::SetShapeCacheDirectory(const char* sDirectory)
+{
+	m_sShapeCacheDir = (sDirectory != NULL) ? sDirectory : "";
+}
+
+btOptimizedBvh* ParaEngine::CParaPhysicsWorld::LoadCachedBvh(const std::string& sFileName, uint32 nNumTriangles, uint32 nNumVertices, uint64 nMeshHash)
+{
+	FILE* file = fopen(sFileName.c_str(), "rb");
+	if (file == NULL)
+		return NULL;
+
+	btOptimizedBvh* pBvh = NULL;
+	BvhCacheFileHeader header;
+	if (fread(&header, sizeof(header), 1, file) == 1 && header.m_nMagic == BVH_CACHE_FILE_MAGIC && header.m_nVersion == BVH_CACHE_FILE_VERSION
+		&& header.m_nBulletVersion == BT_BULLET_VERSION && header.m_nScalarSize == sizeof(btScalar)
+		&& header.m_nNumTriangles == nNumTriangles && header.m_nNumVertices == nNumVertices && header.m_nMeshHash == nMeshHash && header.m_nBvhSize > 0)
+	{
+		// the buffer must be 16 bytes aligned, since the bvh is deserialized in place and keeps using it.
+		void* pBuffer = btAlignedAlloc(header.m_nBvhSize, 16);
+		if (fread(pBuffer, 1, header.m_nBvhSize, file) == header.m_nBvhSize)
+			pBvh = btOptimizedBvh::deSerializeInPlace(pBuffer, header.m_nBvhSize, false);
+		if (pBvh == NULL)
+			btAlignedFree(pBuffer);
+	}
+	fclose(file);
+	return pBvh;
+}
+
+void ParaEngine::CParaPhysicsWorld::SaveCachedBvh(const std::string& sFileName, btOptimizedBvh* pBvh, uint32 nNumTriangles, uint32 nNumVertices, uint64 nMeshHash)
+{
+	if (pBvh == NULL)
+		return;
+	unsigned int nSize = pBvh->calculateSerializeBufferSize();
+	void* pBuffer = btAlignedAlloc(nSize, 16);
+	if (pBvh->serializeInPlace(pBuffer, nSize, false))
+	{
+		// write to a temporary file first, so that a partially written file is never loaded. 
+		std::string sTempFile = sFileName + ".tmp";
+		FILE* file = fopen(sTempFile.c_str(), "wb");
+		if (file != NULL)
+		{
+			BvhCacheFileHeader header;
+			header.m_nMagic = BVH_CACHE_FILE_MAGIC;
+			header.m_nVersion = BVH_CACHE_FILE_VERSION;
+			header.m_nBulletVersion = BT_BULLET_VERSION;
+			header.m_nScalarSize = sizeof(btScalar);
+			header.m_nNumTriangles = nNumTriangles;
+			header.m_nNumVertices = nNumVertices;
+			header.m_nMeshHash = nMeshHash;
+			header.m_nBvhSize = nSize;
+			header.m_nReserved = 0;
+			bool bSucceed = fwrite(&header, sizeof(header), 1, file) == 1 && fwrite(pBuffer, 1, nSize, file) == nSize;
+			fclose(file);
+#ifdef WIN32
+			// rename() does not replace an existing file on windows, such as an outdated cache of the same mesh. 
+			if (bSucceed)
+				remove(sFileName.c_str());
+#endif
+			if (!bSucceed || rename(sTempFile.c_str(), sFileName.c_str()) != 0)
+				remove(sTempFile.c_str());
+		}
+	}
+	btAlignedFree(pBuffer);
 }
\ No newline at end of file
@@ -6,6 +6,7 @@
 
 #include <set>
 #include <list>
+#include <string>
 
 #define CONVERT_BTVECTOR3(x) *((btVector3*)&(x))
 
@@ -20,6 +21,8 @@ NxActor  <--------> btRigidBody
 */
 namespace ParaEngine
 {
+	class ParaPhysicsThreadPool;
+
 	/** it is represent a shape that can be used to create various actors in the scene. */
 	struct BulletPhysicsShape : public IParaPhysicsShape
 	{
@@ -37,6 +40,8 @@ namespace ParaEngine
 		btTriangleIndexVertexArray* m_indexVertexArrays;
 		int32* m_triangleIndices;
 		btScalar* m_vertices;
+		/// BVH deserialized in place from the shape cache file. The shape does not own it, so it is freed by us after the shape. 
+		btOptimizedBvh* m_pCachedBvh;
 
 		/// keep some user data here
 		void* m_pUserData;
@@ -102,6 +107,12 @@ namespace ParaEngine
 		/** ray cast a given group. */
 		virtual IParaPhysicsActor* RaycastClosestShape(const PARAVECTOR3& vOrigin, const PARAVECTOR3& vDirection, DWORD dwType, RayCastHitResult& hit, short dwGroupMask, float fSensorRange);
 
+		/** ray cast a batch of queries in parallel over the broadphase trees. */
+		virtual int RaycastClosestShapes(const ParaPhysicsRayQuery* pQueries, int nCount, ParaPhysicsQueryHit* pHits);
+
+		/** sweep a sphere for a batch of queries in parallel over the broadphase trees. */
+		virtual int SweepSphereClosestShapes(const ParaPhysicsSweepQuery* pQueries, int nCount, ParaPhysicsQueryHit* pHits);
+
 		/** set the debug draw object for debugging physics world. */
 		virtual void	SetDebugDrawer(IParaDebugDraw*	debugDrawer);
 
@@ -119,7 +130,15 @@ namespace ParaEngine
 
 		/** bitwise of PhysicsDebugDrawModes */
 		virtual int		GetDebugDrawMode();
+
+		/** set the directory to cache serialized BVH trees of triangle mesh shapes. */
+		virtual void SetShapeCacheDirectory(const char* sDirectory);
 	public:
+		/** max number of threads for batched queries and, if bullet is built with BULLET2_USE_THREAD_LOCKS, for the constraint solver.
+		* It defaults to the number of hardware threads. The worker threads are created once in InitPhysics(), so it only applies before that. */
+		void SetMaxThreads(int nCount);
+		int GetMaxThreads() const { return m_nMaxThreads; }
+
 		/** get a pointer to physics scene object */
 		virtual btDynamicsWorld* GetScene()
 		{
@@ -127,6 +146,12 @@ namespace ParaEngine
 		}
 
 	protected:
+		/** load the BVH of a mesh from a cache file. 
+		* @return NULL if the file does not exist or does not match the mesh. */
+		btOptimizedBvh* LoadCachedBvh(const std::string& sFileName, uint32 nNumTriangles, uint32 nNumVertices, uint64 nMeshHash);
+		/** save the BVH of a mesh to a cache file. */
+		void SaveCachedBvh(const std::string& sFileName, btOptimizedBvh* pBvh, uint32 nNumTriangles, uint32 nNumVertices, uint64 nMeshHash);
+
 		btBroadphaseInterface*	m_broadphase;
 		btCollisionDispatcher*	m_dispatcher;
 		btConstraintSolver*	m_solver;
@@ -143,5 +168,10 @@ namespace ParaEngine
 
 		CPhysicsDebugDraw m_physics_debug_draw;
 		bool m_bInvertFaceWinding;
+		/** where serialized BVH trees are cached. empty to disable. */
+		std::string m_sShapeCacheDir;
+		int m_nMaxThreads;
+		/** worker threads for batched queries and the solver. NULL if m_nMaxThreads is 1. */
+		ParaPhysicsThreadPool* m_pThreadPool;
 	};
 }
\ No newline at end of file